@@ -0,0 +1,830 @@
+/**
+ * @file bench.cpp
+ * @date 19.10.2026
+ *
+ * microbenchmarks of the hot paths on the host (NETWORK_POSIX)
+ *  - frame encode: createHeader, sendFrame (copy and headerToPayload) into a counting sink
+ *  - frame decode: handleWebsocket of masked client frames from a socketpair
+ *  - STOMP parse: StompCommandParser::parse of a MESSAGE frame
+ *  - STOMP send: StompClient::sendMessage with a JSON body over a loopback connection
+ *  - permessage-deflate: sendFrame through deflateFrame and handleWebsocket of compressed frames
+ *    over telemetry messages, ratio = bytes on the wire / payload bytes
+ *  - handshake: acceptKey (SHA-1 + base64, see WEBSOCKETS_SHA_NI) and base64_encode
+ *  - accept storm: bursts of clients connecting to WebSocketsServer at once, one op = one
+ *    handshake (ns/op = 1e9 / handshakes/s), peak_heap = max heap in use during the storm
+ * the benchmarks run with payloads of 64 B to 4 KB and report ns/op, MB/s and allocations/op
+ * --json writes the results in the JSON format of Google Benchmark, so two commits can be
+ * compared with its tools/compare.py
+ * --capture runs the deflate benchmarks also over the sent frames of a WebSocketsCapture
+ * (Automata::setCapture, ws_fleet --capture)
+ *
+ * usage: ws_bench [--filter=substring] [--min_time=seconds] [--json=file] [--capture=file]
+ */
+
+#include <Arduino.h>
+#include <WebSocketsServer.h>
+#include <WebSocketsClient.h>
+#include <StompClient.h>
+#include <WebSocketsCapture.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <vector>
+
+#define BENCH_PORT 18082
+#define BENCH_STORM_PORT 18083
+#define BENCH_STORM_CLIENTS (64)    ///< clients connecting at once in the accept storm
+
+/*
+ * allocation counter
+ * with glibc malloc itself is counted, this includes operator new and the malloc of src/
+ * on other libc only operator new is seen
+ */
+static uint64_t allocations = 0;
+
+/*
+ * heap in use, only with glibc (malloc_usable_size)
+ * signed, memory of memalign & co. is not counted but freed
+ */
+static int64_t heapInUse = 0;
+static int64_t heapPeak  = 0;
+
+#ifdef __GLIBC__
+#include <malloc.h>
+
+#define BENCH_HAS_HEAP
+
+extern "C" {
+void * __libc_malloc(size_t size);
+void * __libc_calloc(size_t n, size_t size);
+void * __libc_realloc(void * ptr, size_t size);
+void __libc_free(void * ptr);
+
+static void heapAdd(void * ptr) {
+    if(ptr) {
+        heapInUse += malloc_usable_size(ptr);
+        heapPeak = std::max(heapPeak, heapInUse);
+    }
+}
+
+void * malloc(size_t size) {
+    allocations++;
+    void * ptr = __libc_malloc(size);
+    heapAdd(ptr);
+    return ptr;
+}
+
+void * calloc(size_t n, size_t size) {
+    allocations++;
+    void * ptr = __libc_calloc(n, size);
+    heapAdd(ptr);
+    return ptr;
+}
+
+void * realloc(void * ptr, size_t size) {
+    allocations++;
+    size_t old   = ptr ? malloc_usable_size(ptr) : 0;
+    void * moved = __libc_realloc(ptr, size);
+    if(moved || size == 0) {
+        heapInUse -= old;
+        heapAdd(moved);
+    }
+    return moved;
+}
+
+void free(void * ptr) {
+    if(ptr) {
+        heapInUse -= malloc_usable_size(ptr);
+    }
+    __libc_free(ptr);
+}
+}
+#else
+#include <new>
+
+void * operator new(size_t size) {
+    allocations++;
+    void * p = malloc(size ? size : 1);
+    if(!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void * operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void * p) noexcept {
+    free(p);
+}
+
+void operator delete[](void * p) noexcept {
+    free(p);
+}
+
+void operator delete(void * p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void * p, size_t) noexcept {
+    free(p);
+}
+#endif
+
+/**
+ * state of one run, the benchmark does state.iterations operations
+ * setup between the operations goes into pause() / resume()
+ */
+class BenchState {
+  public:
+    BenchState(size_t size, uint64_t iterations)
+        : size(size), iterations(iterations) {}
+
+    void pause(void) {
+        _pausedAt     = std::chrono::steady_clock::now();
+        _pausedAllocs = allocations;
+    }
+
+    void resume(void) {
+        _paused += std::chrono::steady_clock::now() - _pausedAt;
+        _skippedAllocs += allocations - _pausedAllocs;
+    }
+
+    const size_t size;              ///< payload size of the run
+    const uint64_t iterations;      ///< operations to do
+    uint64_t bytes = 0;             ///< bytes processed, for MB/s
+    const char * error = nullptr;   ///< set if the run failed
+    const char * counterName = nullptr;    ///< extra result of the benchmark, like a user counter of Google Benchmark
+    double counter           = 0;
+
+  protected:
+    friend class BenchRunner;
+    std::chrono::steady_clock::time_point _pausedAt;
+    std::chrono::steady_clock::duration _paused = std::chrono::steady_clock::duration::zero();
+    uint64_t _pausedAllocs  = 0;
+    uint64_t _skippedAllocs = 0;
+};
+
+typedef void (*BenchFunction)(BenchState & state);
+
+typedef struct {
+    String name;
+    uint64_t iterations;
+    double ns;
+    double bytesPerSecond;
+    double allocs;
+    const char * error;
+    const char * counterName;
+    double counter;
+} BenchResult_t;
+
+class BenchRunner {
+  public:
+    double minTime = 0.5;    ///< seconds every benchmark runs at least
+
+    /**
+     * runs the benchmark with growing iteration counts until it takes minTime
+     */
+    BenchResult_t run(const String & name, BenchFunction function, size_t size) {
+        uint64_t iterations = 1;
+        while(true) {
+            BenchState state(size, iterations);
+            uint64_t allocsStart = allocations;
+            auto start           = std::chrono::steady_clock::now();
+            function(state);
+            auto elapsed        = std::chrono::steady_clock::now() - start - state._paused;
+            uint64_t allocs     = allocations - allocsStart - state._skippedAllocs;
+            double seconds      = std::chrono::duration<double>(elapsed).count();
+            if(state.error || seconds >= minTime || iterations >= 1000000000ULL) {
+                return { name, iterations, seconds * 1e9 / iterations, (seconds > 0) ? state.bytes / seconds : 0, (double)allocs / iterations, state.error, state.counterName, state.counter };
+            }
+            // same growth as Google Benchmark
+            double multiplier = (seconds > 0) ? std::min(10.0, minTime * 1.4 / seconds) : 10.0;
+            iterations        = std::max(iterations + 1, (uint64_t)(iterations * multiplier));
+        }
+    }
+};
+
+/**
+ * WebSockets with the protected API in reach
+ * write goes into a counting sink, received messages are only counted
+ */
+class BenchSocket : public WebSockets {
+  public:
+    using WebSockets::acceptKey;
+    using WebSockets::base64_encode;
+    using WebSockets::createHeader;
+    using WebSockets::handleWebsocket;
+    using WebSockets::sendFrame;
+
+    BenchSocket(bool isClient) {
+        client.status    = WSC_CONNECTED;
+        client.cIsClient = isClient;
+    }
+
+    ~BenchSocket() {
+#ifdef WEBSOCKETS_HAS_DEFLATE
+        releaseDeflate(&client);
+#endif
+        if(client.tcp) {
+            delete client.tcp;
+        }
+    }
+
+    WSclient_t client;
+    uint64_t written  = 0;    ///< bytes written into the sink
+    uint64_t received = 0;    ///< messages received
+    uint8_t check     = 0;    ///< keeps the compiler from dropping the data
+    std::vector<uint8_t> * record = nullptr;    ///< the written data is also appended here
+
+  protected:
+    void clientDisconnect(WSclient_t * c) override {
+        c->status = WSC_NOT_CONNECTED;
+    }
+
+    bool clientIsConnected(WSclient_t * c) override {
+        return c->status == WSC_CONNECTED;
+    }
+
+    void messageReceived(WSclient_t * c, WSopcode_t opcode, uint8_t * payload, size_t length, bool fin) override {
+        received++;
+        check ^= (length > 0) ? payload[length - 1] : 0;
+    }
+
+    size_t write(WSclient_t * c, uint8_t * out, size_t n) override {
+        if(record) {
+            record->insert(record->end(), out, out + n);
+        }
+        written += n;
+        check ^= (n > 0) ? out[n - 1] : 0;
+        return n;
+    }
+};
+
+/**
+ * JSON object of exactly size bytes, like the state updates of a device
+ */
+static String jsonPayload(size_t size) {
+    String json = "{\"type\":\"state\",\"device\":\"bench\",\"values\":{";
+    for(int i = 0; json.length() + 24 < size; i++) {
+        if(i > 0) {
+            json += ",";
+        }
+        json += "\"sensor" + String(i) + "\":" + String(20 + i % 10) + "." + String(i % 100);
+    }
+    json += ",\"pad\":\"";
+    while(json.length() + 3 < size) {
+        json += 'x';
+    }
+    json += "\"}}";
+    return json;
+}
+
+/**
+ * state update of a device with about size bytes, the values change with seq
+ */
+static String telemetryPayload(size_t size, uint32_t seq) {
+    String json = "{\"type\":\"telemetry\",\"device\":\"bench-0042\",\"seq\":" + String(seq) + ",\"ts\":" + String(1760000000UL + seq * 5) + ",\"values\":{";
+    for(int i = 0; json.length() + 28 < size; i++) {
+        if(i > 0) {
+            json += ",";
+        }
+        uint32_t value = (seq * 7919 + i * 104729) % 1000;
+        json += "\"sensor" + String(i) + "\":" + String(value / 10) + "." + String(value % 10);
+    }
+    json += "},\"ok\":true}";
+    return json;
+}
+
+/**
+ * sent text / binary frames of the --capture file
+ */
+static std::vector<String> captured;
+
+static bool loadCapture(const char * path) {
+#ifdef WEBSOCKETS_HAS_CAPTURE
+    FILE * file = fopen(path, "rb");
+    if(!file) {
+        return false;
+    }
+    std::vector<uint8_t> data;
+    uint8_t buffer[4096];
+    size_t n;
+    while((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + n);
+    }
+    fclose(file);
+
+    WebSocketsCaptureReader reader(data.data(), data.size());
+    WScaptureRecord_t record;
+    while(reader.next(&record)) {
+        uint8_t opcode = record.arg & 0x7F;
+        if(record.type == WSCAP_TX && (opcode == WSop_text || opcode == WSop_binary) && record.length > 0) {
+            String frame;
+            frame.concat((const char *)record.payload, record.length);
+            captured.push_back(frame);
+        }
+    }
+    return reader.valid() && !captured.empty();
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+/**
+ * messages of a deflate benchmark, size 0 = the frames of the capture
+ */
+static std::vector<String> telemetryMessages(size_t size) {
+    if(size == 0) {
+        return captured;
+    }
+    std::vector<String> messages;
+    for(uint32_t seq = 0; seq < 32; seq++) {
+        messages.push_back(telemetryPayload(size, seq));
+    }
+    return messages;
+}
+
+static void benchCreateHeader(BenchState & state) {
+    BenchSocket ws(true);
+    uint8_t buffer[WEBSOCKETS_MAX_HEADER_SIZE];
+    uint8_t maskKey[4] = { 0x12, 0x34, 0x56, 0x78 };
+    uint32_t check     = 0;
+    for(uint64_t i = 0; i < state.iterations; i++) {
+        check += ws.createHeader(buffer, WSop_text, state.size, true, maskKey, true);
+        check += buffer[1];
+    }
+    state.bytes = state.iterations * state.size;
+    ws.check ^= check;
+}
+
+static void benchSendFrame(BenchState & state) {
+    BenchSocket ws(true);
+    String json = jsonPayload(state.size);
+    std::vector<uint8_t> payload(json.c_str(), json.c_str() + json.length());
+    for(uint64_t i = 0; i < state.iterations; i++) {
+        ws.sendFrame(&ws.client, WSop_text, payload.data(), payload.size());
+    }
+    state.bytes = state.iterations * state.size;
+    if(ws.written < state.bytes) {
+        state.error = "sendFrame did not write the payload";
+    }
+}
+
+static void benchSendFrameHeaderToPayload(BenchState & state) {
+    BenchSocket ws(true);
+    String json = jsonPayload(state.size);
+    std::vector<uint8_t> payload(WEBSOCKETS_MAX_HEADER_SIZE + json.length());
+    memcpy(payload.data() + WEBSOCKETS_MAX_HEADER_SIZE, json.c_str(), json.length());
+    for(uint64_t i = 0; i < state.iterations; i++) {
+        // the mask is applied in place, the payload does not have to stay readable here
+        ws.sendFrame(&ws.client, WSop_text, payload.data(), json.length(), true, true);
+    }
+    state.bytes = state.iterations * state.size;
+    if(ws.written < state.bytes) {
+        state.error = "sendFrame did not write the payload";
+    }
+}
+
+static void benchHandleWebsocket(BenchState & state) {
+    int fds[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        state.error = "socketpair failed";
+        return;
+    }
+    BenchSocket ws(false);
+    ws.client.tcp = new WSPosixClient(fds[0]);
+
+    // masked text frame as a client sends it
+    String json        = jsonPayload(state.size);
+    uint8_t maskKey[4] = { 0x12, 0x34, 0x56, 0x78 };
+    uint8_t header[WEBSOCKETS_MAX_HEADER_SIZE];
+    uint8_t headerSize = ws.createHeader(header, WSop_text, json.length(), true, maskKey, true);
+    std::vector<uint8_t> frame(header, header + headerSize);
+    for(size_t i = 0; i < json.length(); i++) {
+        frame.push_back(json[i] ^ maskKey[i % 4]);
+    }
+
+    // the frames of one batch go in with one write and have to fit into the socket buffer
+    uint64_t batch = std::max<uint64_t>(1, (64 * 1024) / frame.size());
+    std::vector<uint8_t> frames;
+    for(uint64_t f = 0; f < batch; f++) {
+        frames.insert(frames.end(), frame.begin(), frame.end());
+    }
+    for(uint64_t done = 0; done < state.iterations && !state.error;) {
+        uint64_t n = std::min(batch, state.iterations - done);
+        state.pause();
+        if(::write(fds[1], frames.data(), n * frame.size()) != (ssize_t)(n * frame.size())) {
+            state.error = "socketpair write failed";
+        }
+        state.resume();
+        done += n;
+        while(ws.received < done && ws.client.status == WSC_CONNECTED) {
+            ws.handleWebsocket(&ws.client);
+        }
+        if(ws.received < done) {
+            state.error = "handleWebsocket dropped the connection";
+        }
+    }
+    state.bytes = state.iterations * state.size;
+    close(fds[1]);
+}
+
+static void benchStompParse(BenchState & state) {
+    // escaped like the SockJS frames StompClient gets
+    String frame = "MESSAGE\\ndestination:/topic/devices/bench\\nsubscription:sub-0\\nmessage-id:bench-1\\ncontent-type:application/json\\n\\n";
+    frame += jsonPayload(state.size);
+    frame += "\\u0000";
+    Stomp::StompCommandParser parser;
+    size_t check = 0;
+    for(uint64_t i = 0; i < state.iterations; i++) {
+        Stomp::StompCommand cmd = parser.parse(frame);
+        check += cmd.body.length();
+    }
+    state.bytes = state.iterations * state.size;
+    if(check < state.iterations * state.size) {
+        state.error = "StompCommandParser lost the body";
+    }
+}
+
+static void benchStompSend(BenchState & state) {
+    static WebSocketsServer * server = nullptr;
+    static WebSocketsClient * socket = nullptr;
+    static Stomp::StompClient * stomp = nullptr;
+    static uint64_t serverReceived    = 0;
+    static bool stompOpened           = false;
+
+    if(!server) {
+        // one connection for all runs, the server only counts the frames
+        server = new WebSocketsServer(BENCH_PORT);
+        server->onEvent([](uint8_t num, WStype_t type, uint8_t * payload, size_t length) {
+            if(type != WStype_TEXT) {
+                return;
+            }
+            if(strstr((char *)payload, "CONNECT\\n")) {
+                stompOpened = true;
+            } else {
+                serverReceived++;
+            }
+        });
+        server->begin();
+        socket = new WebSocketsClient();
+        stomp  = new Stomp::StompClient(*socket, "127.0.0.1", BENCH_PORT, "/", false);
+        stomp->begin();
+        unsigned long start = millis();
+        while(!stompOpened && millis() - start < 5000) {
+            stomp->loop();
+            server->loop();
+        }
+    }
+    if(!stompOpened) {
+        state.error = "no connection to the local server";
+        return;
+    }
+
+    String destination = "/app/devices/bench/state";
+    String json        = jsonPayload(state.size);
+    uint64_t batch     = std::max<uint64_t>(1, (32 * 1024) / state.size);
+    uint64_t expected  = serverReceived;
+    for(uint64_t done = 0; done < state.iterations;) {
+        uint64_t n = std::min(batch, state.iterations - done);
+        for(uint64_t m = 0; m < n; m++) {
+            stomp->sendMessage(destination, json);
+        }
+        done += n;
+        expected += n;
+        state.pause();
+        unsigned long start = millis();
+        while(serverReceived < expected && millis() - start < 2000) {
+            server->loop();
+        }
+        state.resume();
+        if(serverReceived < expected) {
+            state.error = "server did not get all messages";
+            return;
+        }
+    }
+    state.bytes = state.iterations * state.size;
+}
+
+#ifdef WEBSOCKETS_HAS_DEFLATE
+static void benchDeflateFrame(BenchState & state) {
+    BenchSocket ws(true);
+    ws.client.cDeflate       = true;
+    ws.client.cDeflateTxBits = 15;
+    std::vector<String> messages = telemetryMessages(state.size);
+    std::vector<std::vector<uint8_t>> payloads;
+    for(const String & m : messages) {
+        payloads.push_back(std::vector<uint8_t>(m.c_str(), m.c_str() + m.length()));
+    }
+    for(uint64_t i = 0; i < state.iterations; i++) {
+        std::vector<uint8_t> & payload = payloads[i % payloads.size()];
+        ws.sendFrame(&ws.client, WSop_text, payload.data(), payload.size());
+        state.bytes += payload.size();
+    }
+    state.counterName = "ratio";
+    state.counter     = (double)ws.written / state.bytes;
+    if(ws.written == 0) {
+        state.error = "sendFrame did not write the payload";
+    }
+}
+
+static void benchInflate(BenchState & state) {
+    int fds[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        state.error = "socketpair failed";
+        return;
+    }
+
+    // compressed and masked frames as a client with permessage-deflate sends them
+    std::vector<String> messages = telemetryMessages(state.size);
+    std::vector<std::vector<uint8_t>> frames;
+    std::vector<size_t> lengths;
+    {
+        BenchSocket sender(true);
+        sender.client.cDeflate       = true;
+        sender.client.cDeflateTxBits = 15;
+        for(const String & m : messages) {
+            std::vector<uint8_t> payload(m.c_str(), m.c_str() + m.length());
+            frames.push_back(std::vector<uint8_t>());
+            sender.record = &frames.back();
+            sender.sendFrame(&sender.client, WSop_text, payload.data(), payload.size());
+            lengths.push_back(m.length());
+        }
+    }
+
+    BenchSocket ws(false);
+    ws.client.tcp            = new WSPosixClient(fds[0]);
+    ws.client.cDeflate       = true;
+    ws.client.cDeflateRxBits = 15;
+
+    uint64_t wire = 0;
+    for(uint64_t done = 0; done < state.iterations && !state.error;) {
+        // a batch has to fit into the socket buffer
+        std::vector<uint8_t> batch;
+        uint64_t n = 0;
+        state.pause();
+        while(done + n < state.iterations && (batch.empty() || batch.size() + frames[(done + n) % frames.size()].size() <= 64 * 1024)) {
+            size_t index = (done + n) % frames.size();
+            batch.insert(batch.end(), frames[index].begin(), frames[index].end());
+            state.bytes += lengths[index];
+            n++;
+        }
+        if(::write(fds[1], batch.data(), batch.size()) != (ssize_t)batch.size()) {
+            state.error = "socketpair write failed";
+        }
+        state.resume();
+        wire += batch.size();
+        done += n;
+        while(ws.received < done && ws.client.status == WSC_CONNECTED) {
+            ws.handleWebsocket(&ws.client);
+        }
+        if(ws.received < done) {
+            state.error = "handleWebsocket dropped the connection";
+        }
+    }
+    state.counterName = "ratio";
+    state.counter     = (double)wire / state.bytes;
+    close(fds[1]);
+}
+#endif
+
+static void benchAcceptKey(BenchState & state) {
+    BenchSocket ws(false);
+    // example of RFC 6455 1.3
+    const char * key = "dGhlIHNhbXBsZSBub25jZQ==";
+    char out[WEBSOCKETS_ACCEPT_KEY_LENGTH + 1];
+    for(uint64_t i = 0; i < state.iterations; i++) {
+        ws.acceptKey(key, 24, out);
+        ws.check ^= out[i % WEBSOCKETS_ACCEPT_KEY_LENGTH];
+    }
+    state.bytes = state.iterations * 24;
+    if(strcmp(out, "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") != 0) {
+        state.error = "wrong accept key";
+    }
+}
+
+static void benchBase64(BenchState & state) {
+    BenchSocket ws(false);
+    std::vector<uint8_t> data(state.size);
+    for(size_t i = 0; i < data.size(); i++) {
+        data[i] = (uint8_t)(i * 31);
+    }
+    std::vector<char> out(((state.size + 2) / 3) * 4 + 1);
+    size_t len = 0;
+    for(uint64_t i = 0; i < state.iterations; i++) {
+        len = ws.base64_encode(data.data(), data.size(), out.data(), out.size());
+        ws.check ^= out[i % len];
+    }
+    state.bytes = state.iterations * state.size;
+    if(len != out.size() - 1) {
+        state.error = "base64_encode did not encode the data";
+    }
+}
+
+/**
+ * a burst of BENCH_STORM_CLIENTS raw TCP clients sends the upgrade request at once,
+ * the server loops until all are connected (timed), then the clients close (not timed)
+ */
+static void benchAcceptStorm(BenchState & state) {
+    static WebSocketsServer * server = nullptr;
+    state.pause();
+    if(!server) {
+        server = new WebSocketsServer(BENCH_STORM_PORT);
+        server->begin();
+    }
+    state.resume();
+
+    const char * request =
+        "GET / HTTP/1.1\r\n"
+        "Host: 127.0.0.1\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+        "Sec-WebSocket-Version: 13\r\n"
+        "\r\n";
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(BENCH_STORM_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int64_t heapStart = heapInUse;
+    heapPeak          = heapInUse;
+    for(uint64_t done = 0; done < state.iterations && !state.error;) {
+        int n = (int)std::min<uint64_t>(BENCH_STORM_CLIENTS, state.iterations - done);
+        int fds[BENCH_STORM_CLIENTS];
+
+        state.pause();
+        for(int c = 0; c < n; c++) {
+            fds[c] = socket(AF_INET, SOCK_STREAM, 0);
+            if(fds[c] < 0 || connect(fds[c], (struct sockaddr *)&addr, sizeof(addr)) != 0 || ::write(fds[c], request, strlen(request)) != (ssize_t)strlen(request)) {
+                state.error = "connect to the local server failed";
+            }
+        }
+        state.resume();
+
+        unsigned long start = millis();
+        while(server->connectedClients() < n && millis() - start < 5000) {
+            server->loop();
+        }
+
+        state.pause();
+        if(server->connectedClients() < n) {
+            state.error = "server did not take all clients";
+        }
+        for(int c = 0; c < n; c++) {
+            char response[13] = { 0 };
+            if(fds[c] >= 0) {
+                if(read(fds[c], response, 12) != 12 || strcmp(response, "HTTP/1.1 101") != 0) {
+                    state.error = "no 101 Switching Protocols";
+                }
+                close(fds[c]);
+            }
+        }
+        start = millis();
+        while(server->connectedClients() > 0 && millis() - start < 5000) {
+            server->loop();
+        }
+        state.resume();
+        done += n;
+    }
+#ifdef BENCH_HAS_HEAP
+    state.counterName = "peak_heap";
+    state.counter     = (double)(heapPeak - heapStart);
+#endif
+}
+
+typedef enum {
+    BENCH_SIZES,     ///< payloads of 64 B to 4 KB
+    BENCH_CORPUS,    ///< the payload sizes and the frames of --capture
+    BENCH_ONCE,      ///< no payload
+} BenchRuns_t;
+
+typedef struct {
+    const char * name;
+    BenchFunction function;
+    BenchRuns_t runs;
+} BenchDefinition_t;
+
+static const BenchDefinition_t benchmarks[] = {
+    { "createHeader", benchCreateHeader, BENCH_SIZES },
+    { "sendFrame", benchSendFrame, BENCH_SIZES },
+    { "sendFrame_headerToPayload", benchSendFrameHeaderToPayload, BENCH_SIZES },
+    { "handleWebsocket", benchHandleWebsocket, BENCH_SIZES },
+    { "StompCommandParser_parse", benchStompParse, BENCH_SIZES },
+    { "StompClient_sendMessage_json", benchStompSend, BENCH_SIZES },
+#ifdef WEBSOCKETS_HAS_DEFLATE
+    { "deflateFrame_telemetry", benchDeflateFrame, BENCH_CORPUS },
+    { "inflate_telemetry", benchInflate, BENCH_CORPUS },
+#endif
+    { "acceptKey", benchAcceptKey, BENCH_ONCE },
+    { "base64_encode", benchBase64, BENCH_SIZES },
+    { "acceptStorm", benchAcceptStorm, BENCH_ONCE },
+};
+
+static const size_t sizes[] = { 64, 256, 1024, 4096 };
+
+static void writeJson(FILE * f, const std::vector<BenchResult_t> & results) {
+    char date[32];
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+    fprintf(f, "{\n  \"context\": {\n    \"date\": \"%s\",\n    \"executable\": \"ws_bench\",\n    \"num_cpus\": %ld,\n    \"library_build_type\": \"%s\"\n  },\n", date, sysconf(_SC_NPROCESSORS_ONLN),
+#ifdef NDEBUG
+        "release"
+#else
+        "debug"
+#endif
+    );
+    fprintf(f, "  \"benchmarks\": [\n");
+    for(size_t i = 0; i < results.size(); i++) {
+        const BenchResult_t & r = results[i];
+        fprintf(f, "    {\n      \"name\": \"%s\",\n      \"run_name\": \"%s\",\n      \"run_type\": \"iteration\",\n      \"repetitions\": 1,\n      \"repetition_index\": 0,\n      \"threads\": 1,\n", r.name.c_str(), r.name.c_str());
+        fprintf(f, "      \"iterations\": %llu,\n      \"real_time\": %.3f,\n      \"cpu_time\": %.3f,\n      \"time_unit\": \"ns\",\n", (unsigned long long)r.iterations, r.ns, r.ns);
+        fprintf(f, "      \"bytes_per_second\": %.1f,\n      \"allocs_per_iter\": %.3f", r.bytesPerSecond, r.allocs);
+        if(r.counterName) {
+            fprintf(f, ",\n      \"%s\": %.4f", r.counterName, r.counter);
+        }
+        if(r.error) {
+            fprintf(f, ",\n      \"error_occurred\": true,\n      \"error_message\": \"%s\"", r.error);
+        }
+        fprintf(f, "\n    }%s\n", (i + 1 < results.size()) ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+}
+
+int main(int argc, char ** argv) {
+    BenchRunner runner;
+    const char * filter = "";
+    const char * json   = nullptr;
+    for(int i = 1; i < argc; i++) {
+        if(strncmp(argv[i], "--filter=", 9) == 0) {
+            filter = argv[i] + 9;
+        } else if(strncmp(argv[i], "--min_time=", 11) == 0) {
+            runner.minTime = atof(argv[i] + 11);
+        } else if(strncmp(argv[i], "--json=", 7) == 0) {
+            json = argv[i] + 7;
+        } else if(strncmp(argv[i], "--capture=", 10) == 0) {
+            if(!loadCapture(argv[i] + 10)) {
+                fprintf(stderr, "no frames in capture %s\n", argv[i] + 10);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "usage: %s [--filter=substring] [--min_time=seconds] [--json=file] [--capture=file]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<BenchResult_t> results;
+    bool failed = false;
+    printf("%-40s %12s %12s %10s %12s\n", "benchmark", "ns/op", "MB/s", "allocs/op", "iterations");
+    for(const BenchDefinition_t & b : benchmarks) {
+        std::vector<size_t> runs;
+        if(b.runs != BENCH_ONCE) {
+            runs.assign(std::begin(sizes), std::end(sizes));
+        }
+        if(b.runs == BENCH_ONCE || (b.runs == BENCH_CORPUS && !captured.empty())) {
+            runs.push_back(0);
+        }
+        for(size_t size : runs) {
+            String name = String(b.name);
+            if(size) {
+                name += "/" + String((unsigned long)size);
+            } else if(b.runs == BENCH_CORPUS) {
+                name += "/capture";
+            }
+            if(!strstr(name.c_str(), filter)) {
+                continue;
+            }
+            BenchResult_t r = runner.run(name, b.function, size);
+            if(r.error) {
+                printf("%-40s ERROR: %s\n", r.name.c_str(), r.error);
+                failed = true;
+            } else {
+                printf("%-40s %12.1f %12.1f %10.2f %12llu", r.name.c_str(), r.ns, r.bytesPerSecond / 1e6, r.allocs, (unsigned long long)r.iterations);
+                if(r.counterName) {
+                    printf("  %s %.3f", r.counterName, r.counter);
+                }
+                printf("\n");
+            }
+            fflush(stdout);
+            results.push_back(r);
+        }
+    }
+
+    if(json) {
+        FILE * f = (strcmp(json, "-") == 0) ? stdout : fopen(json, "w");
+        if(!f) {
+            fprintf(stderr, "can not write %s\n", json);
+            return 1;
+        }
+        writeJson(f, results);
+        if(f != stdout) {
+            fclose(f);
+        }
+    }
+    return failed ? 1 : 0;
+}
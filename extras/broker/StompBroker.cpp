@@ -0,0 +1,801 @@
+/**
+ * @file StompBroker.cpp
+ * @date 19.10.2026
+ *
+ * STOMP broker on WebSocketsServer for host tests, see StompBroker.h
+ */
+
+#include "StompBroker.h"
+
+/**
+ * value of a STOMP header without the escaping of STOMP 1.1 (\c \n \r \\)
+ */
+static String headerDecode(const String & value) {
+    if(value.indexOf('\\') < 0) {
+        return value;
+    }
+    String out;
+    for(unsigned int i = 0; i < value.length(); i++) {
+        char c = value[i];
+        if(c == '\\' && i + 1 < value.length()) {
+            switch(value[++i]) {
+                case 'c':
+                    c = ':';
+                    break;
+                case 'n':
+                    c = '\n';
+                    break;
+                case 'r':
+                    c = '\r';
+                    break;
+                default:
+                    c = value[i];
+                    break;
+            }
+        }
+        out += c;
+    }
+    return out;
+}
+
+static String headerEncode(const String & value) {
+    String out;
+    for(unsigned int i = 0; i < value.length(); i++) {
+        switch(value[i]) {
+            case ':':
+                out += "\\c";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            case '\r':
+                out += "\\r";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            default:
+                out += value[i];
+                break;
+        }
+    }
+    return out;
+}
+
+String StompBrokerFrame::header(const char * name) const {
+    for(const auto & h : headers) {
+        if(h.first == name) {
+            return h.second;
+        }
+    }
+    return String();
+}
+
+void StompBrokerFrame::addHeader(const String & name, const String & value) {
+    headers.push_back(std::make_pair(name, value));
+}
+
+/**
+ * parse a frame, EOLs in front of it are heart-beats
+ * @param text String   one frame, the NUL at the end is optional
+ * @return false if there is no frame (heart-beat)
+ */
+bool StompBrokerFrame::parse(const String & text) {
+    unsigned int pos = 0;
+    unsigned int len = text.length();
+    while(pos < len && (text[pos] == '\n' || text[pos] == '\r')) {
+        pos++;
+    }
+    if(pos >= len || text[pos] == '\0') {
+        return false;
+    }
+
+    command = String();
+    headers.clear();
+    body = String();
+
+    int eol = text.indexOf('\n', pos);
+    if(eol < 0) {
+        command = text.substring(pos);
+        command.trim();
+        return true;
+    }
+    command = text.substring(pos, eol);
+    command.trim();
+    pos = eol + 1;
+
+    // CONNECT / CONNECTED headers are not escaped (STOMP 1.2)
+    bool escaped = !(command == "CONNECT" || command == "CONNECTED" || command == "STOMP");
+    while(pos < len) {
+        eol              = text.indexOf('\n', pos);
+        unsigned int end = (eol < 0) ? len : eol;
+        String line      = text.substring(pos, end);
+        pos              = end + 1;
+        if(line.endsWith("\r")) {
+            line.remove(line.length() - 1);
+        }
+        if(line.length() == 0) {
+            break;
+        }
+        int colon = line.indexOf(':');
+        if(colon < 0) {
+            continue;
+        }
+        String name  = line.substring(0, colon);
+        String value = line.substring(colon + 1);
+        addHeader(escaped ? headerDecode(name) : name, escaped ? headerDecode(value) : value);
+    }
+
+    if(pos < len) {
+        String contentLength = header("content-length");
+        unsigned int bodyEnd;
+        if(contentLength.length() > 0) {
+            bodyEnd = std::min(len, pos + (unsigned int)contentLength.toInt());
+        } else {
+            int nul = text.indexOf('\0', pos);
+            bodyEnd = (nul < 0) ? len : nul;
+        }
+        body = text.substring(pos, bodyEnd);
+    }
+    return true;
+}
+
+String StompBrokerFrame::encode(void) const {
+    bool escaped = (command != "CONNECTED");
+    String frame = command;
+    frame += '\n';
+    for(const auto & h : headers) {
+        frame += escaped ? headerEncode(h.first) : h.first;
+        frame += ':';
+        frame += escaped ? headerEncode(h.second) : h.second;
+        frame += '\n';
+    }
+    frame += '\n';
+    frame += body;
+    frame += '\0';
+    return frame;
+}
+
+StompBroker::StompBroker(uint16_t port, uint8_t shards)
+    : _port(port)
+    , _appPrefix("/app/")
+    , _heartbeatSend(STOMP_BROKER_HEARTBEAT)
+    , _heartbeatReceive(STOMP_BROKER_HEARTBEAT)
+    , _lastCheck(0)
+    , _messageCount(0) {
+    memset(&_stats, 0, sizeof(_stats));
+    for(uint8_t i = 0; i < std::max<uint8_t>(shards, 1); i++) {
+        WebSocketsServer * server      = new WebSocketsServer(port + i);
+        WebSocketsPollerPosix * poller = new WebSocketsPollerPosix();
+        server->setPoller(poller);
+        server->onEvent([this, i](uint8_t num, WStype_t type, uint8_t * payload, size_t length) {
+            handleEvent(i, num, type, payload, length);
+        });
+        _shards.push_back(server);
+        _pollers.push_back(poller);
+        _sessions.push_back(std::vector<StompBrokerSessionState_t>(WEBSOCKETS_SERVER_CLIENT_MAX));
+    }
+}
+
+StompBroker::~StompBroker(void) {
+    close();
+    for(size_t i = 0; i < _shards.size(); i++) {
+        delete _shards[i];
+        delete _pollers[i];
+    }
+}
+
+void StompBroker::begin(void) {
+    for(WebSocketsServer * server : _shards) {
+        server->begin();
+    }
+}
+
+void StompBroker::loop(void) {
+    for(WebSocketsServer * server : _shards) {
+        server->loop();
+    }
+    unsigned long now = millis();
+    if(now - _lastCheck >= 100) {
+        _lastCheck = now;
+        checkHeartbeats();
+    }
+}
+
+void StompBroker::close(void) {
+    for(size_t shard = 0; shard < _shards.size(); shard++) {
+        for(size_t num = 0; num < _sessions[shard].size(); num++) {
+            if(_sessions[shard][num].open) {
+                StompBrokerSession session = (shard << 8) | num;
+                if(_sessions[shard][num].sockjs) {
+                    // SockJS close frame
+                    _shards[shard]->sendTXT(num, "c[3000,\"Go away!\"]");
+                }
+                disconnect(session);
+            }
+        }
+        _shards[shard]->close();
+    }
+}
+
+/**
+ * heart-beat the broker offers in CONNECTED, 0 = none
+ * @param send unsigned long     ms between heart-beats of the broker
+ * @param receive unsigned long  ms the broker wants to get something from the client
+ */
+void StompBroker::setHeartbeat(unsigned long send, unsigned long receive) {
+    _heartbeatSend    = send;
+    _heartbeatReceive = receive;
+}
+
+/**
+ * SEND to destinations with this prefix goes to the onSend handler instead of subscribers
+ */
+void StompBroker::setAppPrefix(const char * prefix) {
+    _appPrefix = prefix;
+}
+
+void StompBroker::onSend(StompBrokerSendHandler handler) {
+    _sendHandler = handler;
+}
+
+/**
+ * the handler can refuse a CONNECT by returning false, the client gets an ERROR
+ */
+void StompBroker::onConnect(StompBrokerConnectHandler handler) {
+    _connectHandler = handler;
+}
+
+/**
+ * send a MESSAGE to every subscriber of destination
+ * @return number of subscribers that got it
+ */
+uint32_t StompBroker::publish(const String & destination, const String & body, const char * contentType) {
+    _stats.published++;
+    auto route = _routes.find(destination);
+    if(route == _routes.end()) {
+        _stats.unrouted++;
+        return 0;
+    }
+
+    // a failed send may close the session and change the route
+    std::vector<std::pair<StompBrokerSession, String>> targets = route->second;
+    uint32_t delivered = 0;
+    for(const auto & target : targets) {
+        StompBrokerSessionState_t * s = state(target.first);
+        if(!s || !s->connected) {
+            continue;
+        }
+        StompBrokerSubscription_t * subscription = NULL;
+        for(auto & sub : s->subscriptions) {
+            if(sub.id == target.second) {
+                subscription = &sub;
+                break;
+            }
+        }
+        if(!subscription) {
+            continue;
+        }
+
+        uint32_t number = ++_messageCount;
+        StompBrokerFrame message;
+        message.command = "MESSAGE";
+        message.addHeader("subscription", subscription->id);
+        message.addHeader("message-id", String(number));
+        message.addHeader("ack", String(number));
+        message.addHeader("destination", destination);
+        if(contentType) {
+            message.addHeader("content-type", contentType);
+        }
+        message.body = body;
+
+        if(subscription->ack != STOMP_BROKER_ACK_AUTO) {
+            subscription->pending.push_back(number);
+            if(subscription->pending.size() > STOMP_BROKER_PENDING_MAX) {
+                subscription->pending.pop_front();
+                _stats.unacked++;
+            }
+        }
+        if(send(target.first, message)) {
+            delivered++;
+        }
+    }
+    _stats.delivered += delivered;
+    if(delivered == 0) {
+        _stats.unrouted++;
+    }
+    return delivered;
+}
+
+/**
+ * send a frame to one session
+ */
+bool StompBroker::send(StompBrokerSession session, const StompBrokerFrame & frame) {
+    if(!sendText(session, frame.encode())) {
+        return false;
+    }
+    _stats.framesOut++;
+    return true;
+}
+
+void StompBroker::disconnect(StompBrokerSession session) {
+    uint8_t shard = session >> 8;
+    if(!state(session)) {
+        return;
+    }
+    releaseSession(session);
+    _shards[shard]->disconnect(session & 0xFF);
+}
+
+uint16_t StompBroker::port(uint8_t shard) const {
+    return _port + shard;
+}
+
+uint32_t StompBroker::subscribers(const String & destination) const {
+    auto route = _routes.find(destination);
+    return (route == _routes.end()) ? 0 : route->second.size();
+}
+
+const StompBrokerStats_t & StompBroker::stats(void) const {
+    return _stats;
+}
+
+/**
+ * text as content of a JSON string (SockJS frames)
+ */
+String StompBroker::escape(const String & text) {
+    String out;
+    out.reserve(text.length() + text.length() / 8 + 8);
+    for(unsigned int i = 0; i < text.length(); i++) {
+        unsigned char c = text[i];
+        switch(c) {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            case '\r':
+                out += "\\r";
+                break;
+            case '\t':
+                out += "\\t";
+                break;
+            default:
+                if(c < 0x20) {
+                    char u[8];
+                    snprintf(u, sizeof(u), "\\u%04x", c);
+                    out += u;
+                } else {
+                    out += (char)c;
+                }
+                break;
+        }
+    }
+    return out;
+}
+
+/**
+ * content of a JSON string
+ * @param text const char *   first char after the opening quote
+ * @param end const char **   set to the closing quote (or the end of text)
+ */
+String StompBroker::unescape(const char * text, const char ** end) {
+    String out;
+    const char * p = text;
+    while(*p && *p != '"') {
+        if(*p != '\\' || !p[1]) {
+            out += *p++;
+            continue;
+        }
+        p++;
+        switch(*p) {
+            case 'n':
+                out += '\n';
+                break;
+            case 'r':
+                out += '\r';
+                break;
+            case 't':
+                out += '\t';
+                break;
+            case 'b':
+                out += '\b';
+                break;
+            case 'f':
+                out += '\f';
+                break;
+            case 'u': {
+                char hex[5] = { 0 };
+                for(int i = 0; i < 4 && p[1]; i++) {
+                    hex[i] = *++p;
+                }
+                unsigned long cp = strtoul(hex, NULL, 16);
+                // UTF-8
+                if(cp < 0x80) {
+                    out += (char)cp;
+                } else if(cp < 0x800) {
+                    out += (char)(0xC0 | (cp >> 6));
+                    out += (char)(0x80 | (cp & 0x3F));
+                } else {
+                    out += (char)(0xE0 | (cp >> 12));
+                    out += (char)(0x80 | ((cp >> 6) & 0x3F));
+                    out += (char)(0x80 | (cp & 0x3F));
+                }
+                break;
+            }
+            default:
+                // \" \\ \/
+                out += *p;
+                break;
+        }
+        p++;
+    }
+    if(end) {
+        *end = p;
+    }
+    return out;
+}
+
+StompBroker::StompBrokerSessionState_t * StompBroker::state(StompBrokerSession session) {
+    uint8_t shard = session >> 8;
+    uint8_t num   = session & 0xFF;
+    if(shard >= _sessions.size() || num >= _sessions[shard].size() || !_sessions[shard][num].open) {
+        return NULL;
+    }
+    return &_sessions[shard][num];
+}
+
+void StompBroker::handleEvent(uint8_t shard, uint8_t num, WStype_t type, uint8_t * payload, size_t length) {
+    StompBrokerSession session   = (shard << 8) | num;
+    StompBrokerSessionState_t & s = _sessions[shard][num];
+
+    switch(type) {
+        case WStype_CONNECTED: {
+            s        = StompBrokerSessionState_t();
+            s.open   = true;
+            s.lastRx = s.lastTx = s.lastSockJs = millis();
+            // payload is the URL, SockJS: /<prefix>/<server>/<session>/websocket
+            String url = (char *)payload;
+            s.sockjs   = url.endsWith("/websocket");
+            _stats.sessions++;
+            if(s.sockjs) {
+                _shards[shard]->sendTXT(num, "o");
+            }
+            break;
+        }
+        case WStype_DISCONNECTED:
+            releaseSession(session);
+            break;
+        case WStype_TEXT: {
+            if(!s.open) {
+                break;
+            }
+            s.lastRx = millis();
+            std::vector<String> frames;
+            const char * p = (const char *)payload;
+            if(*p == '[') {
+                // SockJS client frame, JSON array of strings
+                p++;
+                while(*p) {
+                    while(*p == ' ' || *p == ',') {
+                        p++;
+                    }
+                    if(*p != '"') {
+                        break;
+                    }
+                    frames.push_back(unescape(p + 1, &p));
+                    if(*p) {
+                        p++;
+                    }
+                }
+            } else {
+                String text;
+                text.concat(p, length);
+                frames.push_back(text);
+            }
+
+            for(const String & text : frames) {
+                StompBrokerFrame frame;
+                if(!frame.parse(text)) {
+                    _stats.heartbeatsIn++;
+                    continue;
+                }
+                _stats.framesIn++;
+                handleFrame(session, frame);
+                if(!state(session)) {
+                    // closed by the frame
+                    break;
+                }
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void StompBroker::handleFrame(StompBrokerSession session, StompBrokerFrame & frame) {
+    StompBrokerSessionState_t * s = state(session);
+
+    if(frame.command == "CONNECT" || frame.command == "STOMP") {
+        handleConnect(session, frame);
+        return;
+    }
+    if(!s->connected) {
+        sendError(session, "not connected", &frame);
+        return;
+    }
+
+    if(frame.command == "SUBSCRIBE") {
+        handleSubscribe(session, frame);
+    } else if(frame.command == "UNSUBSCRIBE") {
+        handleUnsubscribe(session, frame);
+    } else if(frame.command == "SEND") {
+        handleSend(session, frame);
+    } else if(frame.command == "ACK") {
+        handleAck(session, frame, true);
+    } else if(frame.command == "NACK") {
+        handleAck(session, frame, false);
+    } else if(frame.command == "DISCONNECT") {
+        sendReceipt(session, frame);
+        disconnect(session);
+        return;
+    } else {
+        sendError(session, "unknown command " + frame.command, &frame);
+        return;
+    }
+
+    if(state(session)) {
+        sendReceipt(session, frame);
+    }
+}
+
+void StompBroker::handleConnect(StompBrokerSession session, StompBrokerFrame & frame) {
+    StompBrokerSessionState_t * s = state(session);
+
+    String accept  = frame.header("accept-version");
+    String version = "1.0";
+    if(accept.indexOf("1.2") >= 0) {
+        version = "1.2";
+    } else if(accept.indexOf("1.1") >= 0) {
+        version = "1.1";
+    } else if(accept.length() > 0 && accept.indexOf("1.0") < 0) {
+        sendError(session, "supported protocol versions are 1.0 1.1 1.2", &frame);
+        return;
+    }
+
+    if(_connectHandler && !_connectHandler(session, frame)) {
+        _stats.refused++;
+        sendError(session, "connect refused", &frame);
+        return;
+    }
+
+    // heart-beat: cx,cy of the client against what the broker offers
+    String heartbeat = frame.header("heart-beat");
+    int comma        = heartbeat.indexOf(',');
+    unsigned long cx = (comma > 0) ? heartbeat.substring(0, comma).toInt() : 0;
+    unsigned long cy = (comma > 0) ? heartbeat.substring(comma + 1).toInt() : 0;
+    s->txInterval    = (_heartbeatSend && cy) ? std::max(_heartbeatSend, cy) : 0;
+    s->rxInterval    = (_heartbeatReceive && cx) ? std::max(_heartbeatReceive, cx) : 0;
+    s->connected     = true;
+
+    StompBrokerFrame connected;
+    connected.command = "CONNECTED";
+    connected.addHeader("version", version);
+    connected.addHeader("heart-beat", String(_heartbeatSend) + "," + String(_heartbeatReceive));
+    connected.addHeader("session", "session-" + String((unsigned int)session));
+    connected.addHeader("server", "StompBroker");
+    send(session, connected);
+    _stats.connects++;
+}
+
+void StompBroker::handleSubscribe(StompBrokerSession session, StompBrokerFrame & frame) {
+    StompBrokerSessionState_t * s = state(session);
+    StompBrokerSubscription_t subscription;
+    subscription.id          = frame.header("id");
+    subscription.destination = frame.header("destination");
+    if(subscription.destination.length() == 0) {
+        sendError(session, "SUBSCRIBE without destination", &frame);
+        return;
+    }
+    for(const auto & sub : s->subscriptions) {
+        if(sub.id == subscription.id) {
+            sendError(session, "subscription " + subscription.id + " exists", &frame);
+            return;
+        }
+    }
+
+    String ack = frame.header("ack");
+    if(ack == "client") {
+        subscription.ack = STOMP_BROKER_ACK_CLIENT;
+    } else if(ack == "client-individual") {
+        subscription.ack = STOMP_BROKER_ACK_CLIENT_INDIVIDUAL;
+    } else {
+        subscription.ack = STOMP_BROKER_ACK_AUTO;
+    }
+
+    _routes[subscription.destination].push_back(std::make_pair(session, subscription.id));
+    s->subscriptions.push_back(subscription);
+}
+
+void StompBroker::handleUnsubscribe(StompBrokerSession session, StompBrokerFrame & frame) {
+    StompBrokerSessionState_t * s = state(session);
+    String id                     = frame.header("id");
+    for(auto it = s->subscriptions.begin(); it != s->subscriptions.end(); ++it) {
+        if(it->id == id) {
+            _stats.unacked += it->pending.size();
+            removeRoute(session, *it);
+            s->subscriptions.erase(it);
+            return;
+        }
+    }
+    sendError(session, "no subscription " + id, &frame);
+}
+
+void StompBroker::handleSend(StompBrokerSession session, StompBrokerFrame & frame) {
+    String destination = frame.header("destination");
+    if(destination.length() == 0) {
+        sendError(session, "SEND without destination", &frame);
+        return;
+    }
+
+    if(_appPrefix.length() > 0 && destination.startsWith(_appPrefix)) {
+        if(_sendHandler) {
+            _sendHandler(session, frame);
+        } else {
+            _stats.unrouted++;
+        }
+        return;
+    }
+
+    String contentType = frame.header("content-type");
+    publish(destination, frame.body, (contentType.length() > 0) ? contentType.c_str() : NULL);
+}
+
+/**
+ * ACK / NACK, ack:client covers all older messages of the subscription
+ */
+void StompBroker::handleAck(StompBrokerSession session, StompBrokerFrame & frame, bool ack) {
+    StompBrokerSessionState_t * s = state(session);
+    String id                     = frame.header("id");
+    if(id.length() == 0) {
+        id = frame.header("message-id");
+    }
+    uint32_t number = id.toInt();
+
+    for(auto & sub : s->subscriptions) {
+        for(auto it = sub.pending.begin(); it != sub.pending.end(); ++it) {
+            if(*it != number) {
+                continue;
+            }
+            if(sub.ack == STOMP_BROKER_ACK_CLIENT) {
+                sub.pending.erase(sub.pending.begin(), it + 1);
+            } else {
+                sub.pending.erase(it);
+            }
+            if(ack) {
+                _stats.acked++;
+            } else {
+                _stats.nacked++;
+            }
+            return;
+        }
+    }
+    sendError(session, "no message " + id + " to " + frame.command, &frame);
+}
+
+/**
+ * ERROR and close, like STOMP wants it
+ */
+void StompBroker::sendError(StompBrokerSession session, const String & message, const StompBrokerFrame * cause) {
+    StompBrokerFrame error;
+    error.command = "ERROR";
+    error.addHeader("message", message);
+    if(cause) {
+        String receipt = cause->header("receipt");
+        if(receipt.length() > 0) {
+            error.addHeader("receipt-id", receipt);
+        }
+    }
+    error.addHeader("content-type", "text/plain");
+    error.body = message;
+    send(session, error);
+    _stats.errors++;
+    disconnect(session);
+}
+
+void StompBroker::sendReceipt(StompBrokerSession session, const StompBrokerFrame & frame) {
+    String receipt = frame.header("receipt");
+    if(receipt.length() == 0) {
+        return;
+    }
+    StompBrokerFrame answer;
+    answer.command = "RECEIPT";
+    answer.addHeader("receipt-id", receipt);
+    send(session, answer);
+}
+
+/**
+ * StompClient reads the escaped form in both modes, SockJS puts it in an array frame
+ * empty text is a STOMP heart-beat
+ */
+bool StompBroker::sendText(StompBrokerSession session, const String & text) {
+    StompBrokerSessionState_t * s = state(session);
+    if(!s) {
+        return false;
+    }
+    String out;
+    if(s->sockjs) {
+        out = "a[\"" + escape(text.length() ? text : String("\n")) + "\"]";
+    } else {
+        out = escape(text.length() ? text : String("\n"));
+    }
+    if(!_shards[session >> 8]->sendTXT(session & 0xFF, out)) {
+        return false;
+    }
+    s->lastTx = s->lastSockJs = millis();
+    return true;
+}
+
+void StompBroker::removeRoute(StompBrokerSession session, const StompBrokerSubscription_t & subscription) {
+    auto route = _routes.find(subscription.destination);
+    if(route == _routes.end()) {
+        return;
+    }
+    auto & targets = route->second;
+    for(auto it = targets.begin(); it != targets.end(); ++it) {
+        if(it->first == session && it->second == subscription.id) {
+            targets.erase(it);
+            break;
+        }
+    }
+    if(targets.empty()) {
+        _routes.erase(route);
+    }
+}
+
+/**
+ * drop the routes of a session, called once per session
+ */
+void StompBroker::releaseSession(StompBrokerSession session) {
+    StompBrokerSessionState_t * s = state(session);
+    if(!s) {
+        return;
+    }
+    for(const auto & sub : s->subscriptions) {
+        _stats.unacked += sub.pending.size();
+        removeRoute(session, sub);
+    }
+    *s = StompBrokerSessionState_t();
+    _stats.sessions--;
+}
+
+void StompBroker::checkHeartbeats(void) {
+    unsigned long now = millis();
+    for(size_t shard = 0; shard < _sessions.size(); shard++) {
+        for(size_t num = 0; num < _sessions[shard].size(); num++) {
+            StompBrokerSessionState_t & s = _sessions[shard][num];
+            if(!s.open) {
+                continue;
+            }
+            StompBrokerSession session = (shard << 8) | num;
+            if(s.connected && s.rxInterval && (now - s.lastRx) > s.rxInterval * STOMP_BROKER_HEARTBEAT_GRACE) {
+                _stats.timeouts++;
+                disconnect(session);
+                continue;
+            }
+            if(s.connected && s.txInterval && (now - s.lastTx) >= s.txInterval) {
+                if(sendText(session, String())) {
+                    _stats.heartbeatsOut++;
+                }
+            } else if(s.sockjs && (now - s.lastSockJs) >= STOMP_BROKER_SOCKJS_HEARTBEAT) {
+                _shards[shard]->sendTXT(num, "h");
+                s.lastSockJs = now;
+            }
+        }
+    }
+}
@@ -0,0 +1,175 @@
+/**
+ * @file StompBroker.h
+ * @date 19.10.2026
+ *
+ * STOMP broker on WebSocketsServer for host tests, the counterpart of StompClient / Automata
+ *  - SockJS websocket transport (/<prefix>/<server>/<session>/websocket): o / h / a / c frames
+ *  - plain WebSocket sessions get the escaped frames StompClient reads without SockJS
+ *  - CONNECT / STOMP, SUBSCRIBE, UNSUBSCRIBE, SEND, ACK, NACK, DISCONNECT, receipts, heart-beats
+ *  - SEND to a broker destination goes to its subscribers as MESSAGE,
+ *    application destinations (/app/ like Spring) go to the onSend handler
+ * client ids of WebSocketsServer are uint8_t, more sessions are spread over
+ * several listen ports (shards) that share one routing table
+ */
+
+#ifndef STOMPBROKER_H_
+#define STOMPBROKER_H_
+
+#include <Arduino.h>
+#include <WebSocketsServer.h>
+
+#include <map>
+#include <vector>
+#include <deque>
+
+// SockJS heart-beat frame of the server (ms)
+#ifndef STOMP_BROKER_SOCKJS_HEARTBEAT
+#define STOMP_BROKER_SOCKJS_HEARTBEAT (25000)
+#endif
+
+// heart-beat the broker offers in CONNECTED (ms)
+#ifndef STOMP_BROKER_HEARTBEAT
+#define STOMP_BROKER_HEARTBEAT (10000)
+#endif
+
+// a session that sends nothing for this many heart-beat periods is closed
+#ifndef STOMP_BROKER_HEARTBEAT_GRACE
+#define STOMP_BROKER_HEARTBEAT_GRACE (2)
+#endif
+
+// messages of a client / client-individual subscription waiting for ACK, older ones are given up
+// (Automata subscribes with ack:client and never acks)
+#ifndef STOMP_BROKER_PENDING_MAX
+#define STOMP_BROKER_PENDING_MAX (64)
+#endif
+
+/**
+ * one decoded STOMP frame, real line ends and no escaping
+ */
+class StompBrokerFrame {
+  public:
+    String command;
+    std::vector<std::pair<String, String>> headers;
+    String body;
+
+    /**
+     * @return the value of the first header with this name, empty if missing
+     */
+    String header(const char * name) const;
+    void addHeader(const String & name, const String & value);
+
+    bool parse(const String & text);
+    String encode(void) const;
+};
+
+typedef uint16_t StompBrokerSession;    ///< shard << 8 | client id
+
+typedef std::function<void(StompBrokerSession session, const StompBrokerFrame & frame)> StompBrokerSendHandler;
+typedef std::function<bool(StompBrokerSession session, const StompBrokerFrame & frame)> StompBrokerConnectHandler;
+
+typedef struct {
+    uint32_t sessions;       ///< WebSocket sessions open
+    uint32_t connects;       ///< CONNECTED sent
+    uint32_t refused;        ///< CONNECT answered with ERROR
+    uint32_t framesIn;       ///< STOMP frames received, heart-beats not counted
+    uint32_t framesOut;      ///< STOMP frames sent
+    uint32_t heartbeatsIn;
+    uint32_t heartbeatsOut;
+    uint32_t published;      ///< SEND / publish to a broker destination
+    uint32_t delivered;      ///< MESSAGE frames to subscribers
+    uint32_t unrouted;       ///< SEND / publish without a subscriber or handler
+    uint32_t acked;
+    uint32_t nacked;
+    uint32_t unacked;        ///< messages given up without ACK / NACK
+    uint32_t errors;         ///< ERROR frames sent
+    uint32_t timeouts;       ///< sessions closed by the heart-beat check
+} StompBrokerStats_t;
+
+class StompBroker {
+  public:
+    StompBroker(uint16_t port, uint8_t shards = 1);
+    virtual ~StompBroker(void);
+
+    void begin(void);
+    void loop(void);
+    void close(void);
+
+    void setHeartbeat(unsigned long send, unsigned long receive);
+    void setAppPrefix(const char * prefix);
+
+    void onSend(StompBrokerSendHandler handler);
+    void onConnect(StompBrokerConnectHandler handler);
+
+    uint32_t publish(const String & destination, const String & body, const char * contentType = "application/json");
+    bool send(StompBrokerSession session, const StompBrokerFrame & frame);
+    void disconnect(StompBrokerSession session);
+
+    uint16_t port(uint8_t shard = 0) const;
+    uint32_t subscribers(const String & destination) const;
+    const StompBrokerStats_t & stats(void) const;
+
+    static String escape(const String & text);
+    static String unescape(const char * text, const char ** end = NULL);
+
+  protected:
+    typedef enum {
+        STOMP_BROKER_ACK_AUTO,
+        STOMP_BROKER_ACK_CLIENT,
+        STOMP_BROKER_ACK_CLIENT_INDIVIDUAL
+    } StompBrokerAck_t;
+
+    typedef struct {
+        String id;
+        String destination;
+        StompBrokerAck_t ack;
+        std::deque<uint32_t> pending;    ///< message numbers not acked yet
+    } StompBrokerSubscription_t;
+
+    typedef struct {
+        bool open;
+        bool sockjs;
+        bool connected;                   ///< STOMP CONNECTED sent
+        unsigned long lastRx;
+        unsigned long lastTx;
+        unsigned long lastSockJs;
+        unsigned long txInterval;         ///< negotiated heart-beat broker -> client (ms), 0 = none
+        unsigned long rxInterval;         ///< negotiated heart-beat client -> broker (ms), 0 = none
+        std::vector<StompBrokerSubscription_t> subscriptions;
+    } StompBrokerSessionState_t;
+
+    uint16_t _port;
+    std::vector<WebSocketsServer *> _shards;
+    std::vector<WebSocketsPollerPosix *> _pollers;
+    std::vector<std::vector<StompBrokerSessionState_t>> _sessions;    ///< [shard][client id]
+    std::map<String, std::vector<std::pair<StompBrokerSession, String>>> _routes;    ///< destination -> session, subscription id
+
+    String _appPrefix;
+    unsigned long _heartbeatSend;
+    unsigned long _heartbeatReceive;
+    unsigned long _lastCheck;
+    uint32_t _messageCount;
+
+    StompBrokerSendHandler _sendHandler;
+    StompBrokerConnectHandler _connectHandler;
+    StompBrokerStats_t _stats;
+
+    StompBrokerSessionState_t * state(StompBrokerSession session);
+
+    virtual void handleEvent(uint8_t shard, uint8_t num, WStype_t type, uint8_t * payload, size_t length);
+    virtual void handleFrame(StompBrokerSession session, StompBrokerFrame & frame);
+
+    void handleConnect(StompBrokerSession session, StompBrokerFrame & frame);
+    void handleSubscribe(StompBrokerSession session, StompBrokerFrame & frame);
+    void handleUnsubscribe(StompBrokerSession session, StompBrokerFrame & frame);
+    void handleSend(StompBrokerSession session, StompBrokerFrame & frame);
+    void handleAck(StompBrokerSession session, StompBrokerFrame & frame, bool ack);
+
+    void sendError(StompBrokerSession session, const String & message, const StompBrokerFrame * cause = NULL);
+    void sendReceipt(StompBrokerSession session, const StompBrokerFrame & frame);
+    bool sendText(StompBrokerSession session, const String & text);
+    void removeRoute(StompBrokerSession session, const StompBrokerSubscription_t & subscription);
+    void releaseSession(StompBrokerSession session);
+    void checkHeartbeats(void);
+};
+
+#endif /* STOMPBROKER_H_ */
@@ -0,0 +1,107 @@
+/**
+ * @file broker.cpp
+ * @date 19.10.2026
+ *
+ * StompBroker as a local stand-in of the STOMP endpoint of the backend
+ * devices connect with StompClient (SockJS) to ws://<host>:<port>/ws/
+ * SEND to /app/ destinations is counted per destination, everything else is routed
+ * to the subscribers, prints the counters every 10 s until SIGINT
+ * acks with stage times ("tr":[..] of Automata::handleAction) give the percentiles per stage of the interval
+ *
+ * usage: stomp_broker [port] [shards]
+ */
+
+#include <Arduino.h>
+#include <StompBroker.h>
+
+#include <signal.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+
+static volatile bool running = true;
+
+static void stop(int) {
+    running = false;
+}
+
+static const char * stageNames[] = { "receive", "unframe", "parse", "decode", "handler", "ack" };
+
+#define STAGES (sizeof(stageNames) / sizeof(stageNames[0]))
+
+/**
+ * add the values of "tr":[..] to the samples of the stages
+ */
+static void addStages(const String & body, std::vector<uint32_t> * stages) {
+    const char * p = strstr(body.c_str(), "tr");
+    if(!p || !(p = strchr(p, '['))) {
+        return;
+    }
+    uint32_t values[STAGES];
+    char * end;
+    for(size_t i = 0; i < STAGES; i++) {
+        values[i] = strtoul(p + 1, &end, 10);
+        if(end == p + 1) {
+            return;
+        }
+        p = end;
+    }
+    for(size_t i = 0; i < STAGES; i++) {
+        stages[i].push_back(values[i]);
+    }
+}
+
+static void printStages(std::vector<uint32_t> * stages) {
+    for(size_t i = 0; i < STAGES; i++) {
+        std::vector<uint32_t> & v = stages[i];
+        if(v.empty()) {
+            continue;
+        }
+        std::sort(v.begin(), v.end());
+        printf("  %-8s n %zu  p50 %u us  p90 %u us  p99 %u us  max %u us\n", stageNames[i], v.size(), v[v.size() * 50 / 100], v[v.size() * 90 / 100], v[v.size() * 99 / 100], v.back());
+        v.clear();
+    }
+}
+
+int main(int argc, char ** argv) {
+    uint16_t port  = (argc > 1) ? atoi(argv[1]) : 8080;
+    uint8_t shards = (argc > 2) ? atoi(argv[2]) : 1;
+    if(port == 0 || shards == 0) {
+        fprintf(stderr, "usage: %s [port] [shards]\n", argv[0]);
+        return 1;
+    }
+
+    StompBroker broker(port, shards);
+    std::map<String, uint32_t> app;
+    std::vector<uint32_t> stages[STAGES];
+    broker.onSend([&](StompBrokerSession session, const StompBrokerFrame & frame) {
+        String destination = frame.header("destination");
+        app[destination]++;
+        if(destination == "/app/ackAction") {
+            addStages(frame.body, stages);
+        }
+    });
+    broker.begin();
+    printf("STOMP broker on port %u..%u, SockJS on /<prefix>/<server>/<session>/websocket\n", port, port + shards - 1);
+    fflush(stdout);
+
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+    unsigned long last = millis();
+    while(running) {
+        broker.loop();
+        if(millis() - last >= 10000 || !running) {
+            last                         = millis();
+            const StompBrokerStats_t & s = broker.stats();
+            printf("sessions %u connects %u refused %u in %u out %u delivered %u unrouted %u acked %u nacked %u errors %u timeouts %u\n", s.sessions, s.connects, s.refused, s.framesIn, s.framesOut, s.delivered, s.unrouted, s.acked, s.nacked, s.errors, s.timeouts);
+            for(const auto & d : app) {
+                printf("  %-32s %u\n", d.first.c_str(), d.second);
+            }
+            printStages(stages);
+            fflush(stdout);
+        }
+        usleep(200);
+    }
+    broker.close();
+    return 0;
+}
@@ -0,0 +1,690 @@
+/**
+ * @file fleet.cpp
+ * @date 19.10.2026
+ *
+ * load generator: N virtual Automata devices against a local stand-in of the backend
+ * every device runs the protocol of Automata.cpp
+ *  - POST /api/v1/main/register, retried with the backoff of Automata::registerDevice
+ *  - SockJS / STOMP CONNECT on /ws/, SUBSCRIBE /topic/update/<id> and /topic/action/<id>
+ *  - /app/sendData and /app/sendLiveData, escaped like Automata::send
+ *  - /app/ackAction for every action, with the stage times of StompTrace like Automata::handleAction
+ * the devices are split over worker threads, each thread runs its devices in one loop
+ * the stand-in runs in its own thread: an HTTP listener for register and a StompBroker
+ * (client ids are uint8_t, one broker shard takes FLEET_SHARD_CLIENTS devices)
+ * it pushes actions to the devices and measures the data latency and the action round trip,
+ * the stage times of the acks ("tr") give the percentiles per stage of the device side
+ *
+ * usage: ws_fleet [--devices=n] [--threads=n] [--seconds=n] [--ramp=ms] [--interval=ms]
+ *                 [--live=ms] [--attributes=n] [--action=ms] [--fail=percent] [--port=n]
+ *                 [--capture=file]   session of device 0 for ws_replay
+ */
+
+#include <Arduino.h>
+#include <WebSocketsServer.h>
+#include <WebSocketsClient.h>
+#include <StompClient.h>
+#include <StompBroker.h>
+
+#include <sys/resource.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#define FLEET_HOST "127.0.0.1"
+
+// devices of one broker shard, the rest of the client ids stay free for the handshake
+#define FLEET_SHARD_CLIENTS (WEBSOCKETS_SERVER_CLIENT_MAX - 5)
+
+typedef struct {
+    int devices              = 100;
+    int threads              = 4;
+    unsigned long seconds    = 10;
+    unsigned long ramp       = 1000;     ///< devices boot spread over this time (ms)
+    unsigned long interval   = 1000;     ///< /app/sendData per device (ms), 0 = off
+    unsigned long live       = 0;        ///< /app/sendLiveData per device (ms), 0 = off
+    int attributes           = 8;        ///< values in one data message
+    unsigned long action     = 5000;     ///< action from the stand-in per device (ms), 0 = off
+    int fail                 = 0;        ///< register requests the stand-in refuses (%)
+    uint16_t port            = 18090;    ///< HTTP, the STOMP shards follow
+    const char * capture     = NULL;     ///< WebSocketsCapture of device 0
+} FleetConfig_t;
+
+/**
+ * Print to a file for WebSocketsCapture
+ */
+class FleetFile : public Print {
+  public:
+    explicit FleetFile(FILE * file)
+        : _file(file) {
+    }
+    size_t write(uint8_t c) override {
+        return (fputc(c, _file) != EOF);
+    }
+    size_t write(const uint8_t * buffer, size_t size) override {
+        return fwrite(buffer, 1, size, _file);
+    }
+
+  protected:
+    FILE * _file;
+};
+
+/**
+ * latency samples in us
+ */
+class FleetSamples {
+  public:
+    void add(uint64_t us) {
+        _samples.push_back(us);
+    }
+
+    void add(const FleetSamples & other) {
+        _samples.insert(_samples.end(), other._samples.begin(), other._samples.end());
+    }
+
+    size_t count(void) const {
+        return _samples.size();
+    }
+
+    String summary(void) {
+        if(_samples.empty()) {
+            return "-";
+        }
+        std::sort(_samples.begin(), _samples.end());
+        char s[96];
+        snprintf(s, sizeof(s), "p50 %.2f ms  p99 %.2f ms  max %.2f ms", at(50) / 1000.0, at(99) / 1000.0, _samples.back() / 1000.0);
+        return String(s);
+    }
+
+    String summaryUs(void) {
+        if(_samples.empty()) {
+            return "-";
+        }
+        std::sort(_samples.begin(), _samples.end());
+        char s[96];
+        snprintf(s, sizeof(s), "p50 %llu us  p99 %llu us  max %llu us", (unsigned long long)at(50), (unsigned long long)at(99), (unsigned long long)_samples.back());
+        return String(s);
+    }
+
+  protected:
+    std::vector<uint64_t> _samples;
+
+    uint64_t at(int percent) const {
+        return _samples[std::min(_samples.size() - 1, _samples.size() * percent / 100)];
+    }
+};
+
+/**
+ * value of "key\":<number> in an escaped JSON body, 0 if missing
+ */
+static uint64_t jsonNumber(const char * body, const char * key) {
+    const char * p = strstr(body, key);
+    if(!p) {
+        return 0;
+    }
+    p += strlen(key);
+    while(*p == '\\' || *p == '"' || *p == ':') {
+        p++;
+    }
+    return strtoull(p, NULL, 10);
+}
+
+/**
+ * values of "key\":[n,n,..] in an escaped JSON body
+ * @return count of values, 0 if missing
+ */
+static size_t jsonNumbers(const char * body, const char * key, uint64_t * out, size_t max) {
+    const char * p = strstr(body, key);
+    if(!p || !(p = strchr(p + strlen(key), '['))) {
+        return 0;
+    }
+    size_t n = 0;
+    char * end;
+    p++;
+    while(n < max) {
+        out[n] = strtoull(p, &end, 10);
+        if(end == p) {
+            break;
+        }
+        n++;
+        p = end;
+        if(*p != ',') {
+            break;
+        }
+        p++;
+    }
+    return n;
+}
+
+static const char * stageNames[Stomp::STOMP_TRACE_STAGES] = { "receive", "unframe", "parse", "decode", "handler", "ack" };
+
+/**
+ * stand-in of the backend: register over HTTP and StompBroker for SockJS / STOMP
+ */
+class FleetStandIn {
+  public:
+    explicit FleetStandIn(const FleetConfig_t & config)
+        : _config(config)
+        , _http(config.port)
+        , _broker(config.port + 1, (config.devices + FLEET_SHARD_CLIENTS - 1) / FLEET_SHARD_CLIENTS) {
+        _broker.onSend([this](StompBrokerSession session, const StompBrokerFrame & frame) {
+            handleSend(frame);
+        });
+    }
+
+    void begin(void) {
+        _http.begin();
+        _broker.begin();
+    }
+
+    void loop(void) {
+        while(_http.hasClient()) {
+            WSPosixClient client = _http.available();
+            handleRegister(client);
+        }
+        _broker.loop();
+        if(_config.action > 0 && millis() != _lastActionCheck) {
+            _lastActionCheck = millis();
+            sendActions();
+        }
+    }
+
+    const StompBrokerStats_t & broker(void) const {
+        return _broker.stats();
+    }
+
+    uint32_t registerRequests = 0;
+    uint32_t registerRefused  = 0;
+    uint32_t dataReceived     = 0;
+    uint32_t liveReceived     = 0;
+    uint32_t actionsSent      = 0;
+    uint32_t actionsAcked     = 0;
+    FleetSamples dataLatency;
+    FleetSamples actionRoundTrip;
+    FleetSamples actionStages[Stomp::STOMP_TRACE_STAGES];    ///< device side of the round trip
+
+  protected:
+    typedef struct {
+        String id;
+        unsigned long nextAction;
+    } FleetRegistration_t;
+
+    const FleetConfig_t & _config;
+    WSPosixServer _http;
+    StompBroker _broker;
+    std::vector<FleetRegistration_t> _devices;    ///< registered device ids
+    unsigned long _lastActionCheck = 0;
+
+    /**
+     * answers one HTTP request, POST /api/v1/main/register gets a device id
+     */
+    void handleRegister(WSPosixClient & client) {
+        String request;
+        uint8_t buffer[1024];
+        unsigned long start = millis();
+        int headerEnd       = -1;
+        long contentLength  = 0;
+        while(millis() - start < 200) {
+            int n = client.read(buffer, sizeof(buffer));
+            if(n > 0) {
+                request.concat((const char *)buffer, n);
+            } else if(!client.connected()) {
+                break;
+            }
+            if(headerEnd < 0 && (headerEnd = request.indexOf("\r\n\r\n")) >= 0) {
+                int cl = request.indexOf("Content-Length:");
+                contentLength = (cl >= 0) ? request.substring(cl + 15).toInt() : 0;
+            }
+            if(headerEnd >= 0 && request.length() >= headerEnd + 4 + contentLength) {
+                break;
+            }
+        }
+
+        registerRequests++;
+        String response;
+        if(headerEnd < 0 || !request.startsWith("POST /api/v1/main/register ")) {
+            response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        } else if(random(100) < _config.fail) {
+            registerRefused++;
+            response = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        } else {
+            String id   = "dev-" + String(registerRequests);
+            String body = "{\"id\":\"" + id + "\"}";
+            response    = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " + String(body.length()) + "\r\nConnection: close\r\n\r\n" + body;
+            _devices.push_back({ id, millis() + ((_config.action > 0) ? random(_config.action) : 0) });
+        }
+        client.write((const uint8_t *)response.c_str(), response.length());
+        client.stop();
+    }
+
+    /**
+     * /app/ destinations, what the backend gets from the devices
+     */
+    void handleSend(const StompBrokerFrame & frame) {
+        String destination = frame.header("destination");
+        uint64_t ts        = jsonNumber(frame.body.c_str(), "ts");
+        if(destination == "/app/sendData") {
+            dataReceived++;
+            dataLatency.add(micros() - ts);
+        } else if(destination == "/app/sendLiveData") {
+            liveReceived++;
+            dataLatency.add(micros() - ts);
+        } else if(destination == "/app/ackAction") {
+            actionsAcked++;
+            actionRoundTrip.add(micros() - ts);
+            uint64_t stages[Stomp::STOMP_TRACE_STAGES];
+            if(jsonNumbers(frame.body.c_str(), "tr", stages, Stomp::STOMP_TRACE_STAGES) == Stomp::STOMP_TRACE_STAGES) {
+                for(int i = 0; i < Stomp::STOMP_TRACE_STAGES; i++) {
+                    actionStages[i].add(stages[i]);
+                }
+            }
+        }
+    }
+
+    void sendActions(void) {
+        unsigned long now = millis();
+        for(FleetRegistration_t & device : _devices) {
+            if((long)(now - device.nextAction) < 0) {
+                continue;
+            }
+            device.nextAction += _config.action;
+            String body = "{\"reboot\":false,\"ts\":" + String((unsigned long)micros()) + "}";
+            if(_broker.publish("/topic/action/" + device.id, body) > 0) {
+                actionsSent++;
+            }
+        }
+    }
+};
+
+typedef struct {
+    uint32_t registerFailures = 0;
+    uint32_t stompErrors      = 0;
+    uint32_t disconnects      = 0;
+    uint32_t dataSent         = 0;
+    uint32_t liveSent         = 0;
+    uint32_t dropped          = 0;    ///< sends that were due while not connected
+    uint32_t actions          = 0;
+    bool registered           = false;
+    bool connected            = false;
+    FleetSamples registerTime;
+    FleetSamples connectTime;    ///< boot to the first STOMP CONNECTED
+} FleetDeviceStats_t;
+
+/**
+ * one virtual device, the protocol of Automata without the ESP32 parts
+ * the STOMP handlers are plain functions, the worker sets current before loop()
+ */
+class FleetDevice {
+  public:
+    FleetDevice(int index, const FleetConfig_t & config)
+        : _index(index)
+        , _config(config)
+        , _stomp(_ws, FLEET_HOST, config.port + 1 + index / FLEET_SHARD_CLIENTS, "/ws/", true) {
+        _bootAt = millis() + ((config.ramp > 0) ? random(config.ramp) : 0);
+        _stomp.onConnect(onConnect);
+        _stomp.onError(onError);
+    }
+
+    static thread_local FleetDevice * current;
+
+    FleetDeviceStats_t stats;
+
+    void setCapture(WebSocketsCapture * capture) {
+        _capture = capture;
+        _ws.setCapture(capture);
+    }
+
+    void loop(bool sending) {
+        unsigned long now = millis();
+        if((long)(now - _bootAt) < 0) {
+            return;
+        }
+        if(!stats.registered) {
+            if((long)(now - _registerAt) >= 0) {
+                registerDevice();
+            }
+            return;
+        }
+
+        _stomp.loop();
+        if(_stompConnected && !_ws.isConnected()) {
+            _stompConnected = false;
+            stats.disconnects++;
+        }
+        if(!sending || !stats.connected) {
+            return;
+        }
+
+        // like the delayed update of Automata::loop, all messages of one tick go out in one write
+        bool data = (_config.interval > 0 && (long)(now - _nextData) >= 0);
+        bool live = (_config.live > 0 && (long)(now - _nextLive) >= 0);
+        if(!data && !live) {
+            return;
+        }
+        if(data) {
+            _nextData += _config.interval;
+        }
+        if(live) {
+            _nextLive += _config.live;
+        }
+        if(!_stompConnected) {
+            stats.dropped += data + live;
+            return;
+        }
+        _ws.cork();
+        if(data) {
+            _stomp.sendMessage("/app/sendData", send(values()));
+            stats.dataSent++;
+        }
+        if(live) {
+            _stomp.sendMessage("/app/sendLiveData", send(values()));
+            stats.liveSent++;
+        }
+        _ws.uncork();
+    }
+
+  protected:
+    int _index;
+    const FleetConfig_t & _config;
+    WebSocketsClient _ws;
+    Stomp::StompClient _stomp;
+    String _deviceId;
+    bool _stompConnected = false;
+    WebSocketsCapture * _capture = nullptr;
+    unsigned long _bootAt;
+    unsigned long _registerAt = 0;
+    unsigned long _nextData   = 0;
+    unsigned long _nextLive   = 0;
+    // registration retries like Automata
+    WebSocketsReconnect _registerRetry { 1000, 60000, 0 };
+
+    /**
+     * Automata::registerDevice, blocking like the HTTPClient on the device
+     */
+    void registerDevice(void) {
+        String body = "{\"name\":\"fleet " + String(_index) + "\",\"deviceId\":\"\",\"type\":\"sensor\",\"updateInterval\":" + String(_config.interval) + ",\"status\":\"ONLINE\",\"attributes\":[";
+        for(int i = 0; i < _config.attributes; i++) {
+            body += String((i > 0) ? "," : "") + "{\"value\":\"\",\"displayName\":\"Value " + String(i) + "\",\"key\":\"v" + String(i) + "\",\"units\":\"\",\"type\":\"DATA\",\"visible\":true,\"valueDataType\":\"String\"}";
+        }
+        body += "]}";
+
+        uint64_t start = micros();
+        String result;
+        int id;
+        if(sendHttp(body, result) && (id = result.indexOf("\"id\":\"")) >= 0) {
+            stats.registerTime.add(micros() - start);
+            _deviceId        = result.substring(id + 6, result.indexOf('"', id + 6));
+            stats.registered = true;
+            _registerRetry.reset();
+            _stomp.begin();
+            return;
+        }
+        stats.registerFailures++;
+        _registerAt = millis() + _registerRetry.next(millis());
+    }
+
+    bool sendHttp(const String & body, String & result) {
+        if(_capture) {
+            _capture->httpRequest("register", body);
+        }
+        WSPosixClient client;
+        if(!client.connect(FLEET_HOST, _config.port, 1000)) {
+            if(_capture) {
+                _capture->httpResponse(-1, result);
+            }
+            return false;
+        }
+        String request = "POST /api/v1/main/register HTTP/1.1\r\nHost: " FLEET_HOST "\r\nContent-Type: application/json\r\nContent-Length: " + String(body.length()) + "\r\nConnection: close\r\n\r\n" + body;
+        client.write((const uint8_t *)request.c_str(), request.length());
+
+        String response;
+        uint8_t buffer[512];
+        unsigned long start = millis();
+        while(millis() - start < 2000) {
+            int n = client.read(buffer, sizeof(buffer));
+            if(n > 0) {
+                response.concat((const char *)buffer, n);
+            } else if(!client.connected()) {
+                break;
+            } else {
+                yield();
+            }
+        }
+        client.stop();
+
+        int code = response.startsWith("HTTP/1.1 ") ? response.substring(9, 12).toInt() : 0;
+        int end  = response.indexOf("\r\n\r\n");
+        result   = (end >= 0) ? response.substring(end + 4) : String();
+        if(_capture) {
+            _capture->httpResponse(code, result);
+        }
+        return (code >= 200 && code < 300);
+    }
+
+    /**
+     * data message with the configured number of values and the send time for the stand-in
+     */
+    String values(void) {
+        String json = "{";
+        for(int i = 0; i < _config.attributes; i++) {
+            json += "\"v" + String(i) + "\":\"" + String(20 + (_index + i) % 10) + "." + String(i % 10) + "\",";
+        }
+        json += "\"ts\":" + String((unsigned long)micros()) + ",\"device_id\":\"" + _deviceId + "\"}";
+        return json;
+    }
+
+    /**
+     * Automata::send, quotes are escaped for the SockJS frame
+     */
+    static String send(const String & json) {
+        String escaped;
+        escaped.reserve(json.length() + json.length() / 4);
+        for(unsigned int i = 0; i < json.length(); i++) {
+            if(json[i] == '"') {
+                escaped += '\\';
+            }
+            escaped += json[i];
+        }
+        return escaped;
+    }
+
+    static void onConnect(Stomp::StompCommand cmd) {
+        FleetDevice * device = current;
+        if(!device->stats.connected) {
+            device->stats.connected = true;
+            device->stats.connectTime.add((millis() - device->_bootAt) * 1000ULL);
+        }
+        device->_stompConnected = true;
+        unsigned long now       = millis();
+        device->_nextData       = now + ((device->_config.interval > 0) ? random(device->_config.interval) : 0);
+        device->_nextLive       = now + ((device->_config.live > 0) ? random(device->_config.live) : 0);
+
+        // Automata::subscribe
+        String update = "/topic/update/" + device->_deviceId;
+        String action = "/topic/action/" + device->_deviceId;
+        device->_stomp.subscribe((char *)update.c_str(), Stomp::CLIENT, onUpdate);
+        device->_stomp.subscribe((char *)action.c_str(), Stomp::CLIENT, onAction);
+    }
+
+    static void onError(Stomp::StompCommand cmd) {
+        current->stats.stompErrors++;
+    }
+
+    static Stomp::Stomp_Ack_t onUpdate(Stomp::StompCommand cmd) {
+        return Stomp::CONTINUE;
+    }
+
+    /**
+     * Automata::handleAction, the ack carries the time stamp of the action and the stage times back
+     */
+    static Stomp::Stomp_Ack_t onAction(Stomp::StompCommand cmd) {
+        FleetDevice * device = current;
+        Stomp::StompTrace & trace = device->_stomp.trace();
+        device->stats.actions++;
+        uint64_t ts = jsonNumber(cmd.body.c_str(), "ts");
+        trace.mark(Stomp::STOMP_TRACE_DECODE);
+        trace.mark(Stomp::STOMP_TRACE_HANDLER);
+        String ack = "{\"key\":\"actionAck\",\"actionAck\":\"Success\",\"ts\":" + String((unsigned long)ts) + ",\"device_id\":\"" + device->_deviceId + "\",\"tr\":[";
+        uint32_t durations[Stomp::STOMP_TRACE_STAGES];
+        trace.mark(Stomp::STOMP_TRACE_ACK);
+        trace.durations(durations);
+        for(int i = 0; i < Stomp::STOMP_TRACE_STAGES; i++) {
+            ack += (i ? "," : "") + String(durations[i]);
+        }
+        ack += "]}";
+        device->_stomp.sendMessage("/app/ackAction", send(ack));
+        return Stomp::CONTINUE;
+    }
+};
+
+thread_local FleetDevice * FleetDevice::current = nullptr;
+
+static bool option(const char * arg, const char * name, unsigned long & value) {
+    size_t len = strlen(name);
+    if(strncmp(arg, name, len) != 0 || arg[len] != '=') {
+        return false;
+    }
+    value = strtoul(arg + len + 1, NULL, 10);
+    return true;
+}
+
+int main(int argc, char ** argv) {
+    FleetConfig_t config;
+    for(int i = 1; i < argc; i++) {
+        unsigned long v;
+        if(option(argv[i], "--devices", v)) {
+            config.devices = v;
+        } else if(option(argv[i], "--threads", v)) {
+            config.threads = v;
+        } else if(option(argv[i], "--seconds", v)) {
+            config.seconds = v;
+        } else if(option(argv[i], "--ramp", v)) {
+            config.ramp = v;
+        } else if(option(argv[i], "--interval", v)) {
+            config.interval = v;
+        } else if(option(argv[i], "--live", v)) {
+            config.live = v;
+        } else if(option(argv[i], "--attributes", v)) {
+            config.attributes = v;
+        } else if(option(argv[i], "--action", v)) {
+            config.action = v;
+        } else if(option(argv[i], "--fail", v)) {
+            config.fail = v;
+        } else if(option(argv[i], "--port", v)) {
+            config.port = v;
+        } else if(strncmp(argv[i], "--capture=", 10) == 0) {
+            config.capture = argv[i] + 10;
+        } else {
+            fprintf(stderr, "usage: %s [--devices=n] [--threads=n] [--seconds=n] [--ramp=ms] [--interval=ms] [--live=ms] [--attributes=n] [--action=ms] [--fail=percent] [--port=n] [--capture=file]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(config.devices < 1 || config.threads < 1) {
+        fprintf(stderr, "need at least one device and one thread\n");
+        return 1;
+    }
+
+    // both ends of every connection live in this process
+    struct rlimit limit;
+    if(getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    FleetStandIn standIn(config);
+    standIn.begin();
+
+    std::vector<FleetDevice *> fleet;
+    for(int i = 0; i < config.devices; i++) {
+        fleet.push_back(new FleetDevice(i, config));
+    }
+
+    FILE * captureFile = NULL;
+    FleetFile * captureOut = NULL;
+    WebSocketsCapture * capture = NULL;
+    if(config.capture) {
+        captureFile = fopen(config.capture, "wb");
+        if(!captureFile) {
+            perror(config.capture);
+            return 1;
+        }
+        captureOut = new FleetFile(captureFile);
+        capture    = new WebSocketsCapture(*captureOut);
+        capture->begin();
+        fleet[0]->setCapture(capture);
+    }
+
+    printf("%d devices on %d threads, stand-in on " FLEET_HOST ":%u, %d STOMP shards\n", config.devices, config.threads, config.port, (config.devices + FLEET_SHARD_CLIENTS - 1) / FLEET_SHARD_CLIENTS);
+    fflush(stdout);
+
+    std::atomic<bool> running(true);
+    std::thread server([&]() {
+        while(running) {
+            standIn.loop();
+        }
+    });
+
+    // devices send until the end, the last second only drains what is in flight
+    unsigned long start = millis();
+    unsigned long end   = start + config.seconds * 1000;
+    std::vector<std::thread> workers;
+    for(int t = 0; t < config.threads; t++) {
+        workers.emplace_back([&, t]() {
+            while((long)(millis() - (end + 1000)) < 0) {
+                bool sending = (long)(millis() - end) < 0;
+                for(size_t i = t; i < fleet.size(); i += config.threads) {
+                    FleetDevice::current = fleet[i];
+                    fleet[i]->loop(sending);
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        });
+    }
+    for(std::thread & worker : workers) {
+        worker.join();
+    }
+    running = false;
+    server.join();
+
+    FleetDeviceStats_t total;
+    int registered = 0;
+    int connected  = 0;
+    for(FleetDevice * device : fleet) {
+        const FleetDeviceStats_t & s = device->stats;
+        registered += s.registered;
+        connected += s.connected;
+        total.registerFailures += s.registerFailures;
+        total.stompErrors += s.stompErrors;
+        total.disconnects += s.disconnects;
+        total.dataSent += s.dataSent;
+        total.liveSent += s.liveSent;
+        total.dropped += s.dropped;
+        total.actions += s.actions;
+        total.registerTime.add(s.registerTime);
+        total.connectTime.add(s.connectTime);
+    }
+
+    double seconds = config.seconds;
+    uint32_t sent  = total.dataSent + total.liveSent;
+    uint32_t recv  = standIn.dataReceived + standIn.liveReceived;
+    printf("registered %d/%d  connected %d/%d\n", registered, config.devices, connected, config.devices);
+    printf("register   %u requests, %u refused, %u device retries  %s\n", standIn.registerRequests, standIn.registerRefused, total.registerFailures, total.registerTime.summary().c_str());
+    printf("connect    %u STOMP CONNECTED  boot to CONNECTED %s\n", standIn.broker().connects, total.connectTime.summary().c_str());
+    printf("data       sent %u received %u (%.0f msg/s)  latency %s\n", sent, recv, recv / seconds, standIn.dataLatency.summary().c_str());
+    printf("actions    sent %u received %u acked %u  round trip %s\n", standIn.actionsSent, total.actions, standIn.actionsAcked, standIn.actionRoundTrip.summary().c_str());
+    for(int i = 0; i < Stomp::STOMP_TRACE_STAGES; i++) {
+        printf("  %-8s %s\n", stageNames[i], standIn.actionStages[i].summaryUs().c_str());
+    }
+    printf("errors     lost %u (%.2f %%)  dropped while offline %u  STOMP ERROR %u  disconnects %u  heart-beat timeouts %u\n", sent - std::min(sent, recv), sent ? 100.0 * (sent - std::min(sent, recv)) / sent : 0.0, total.dropped, total.stompErrors, total.disconnects, standIn.broker().timeouts);
+
+    for(FleetDevice * device : fleet) {
+        delete device;
+    }
+    if(capture) {
+        capture->end();
+        printf("capture    %u records %u bytes in %s\n", capture->records(), capture->bytes(), config.capture);
+        fclose(captureFile);
+        delete capture;
+        delete captureOut;
+    }
+    return (connected == config.devices && recv == sent) ? 0 : 1;
+}
@@ -0,0 +1,408 @@
+/**
+ * @file Arduino.h
+ * @date 19.10.2026
+ *
+ * minimal Arduino API for host builds (Linux / macOS) of the library
+ * String, millis / micros / delay / yield, random, Print / Stream / Client and Serial
+ * only what src/ uses, see CMakeLists.txt
+ */
+
+#ifndef HOST_ARDUINO_H_
+#define HOST_ARDUINO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (s)
+#define HEX 16
+#define DEC 10
+#define bit(b) (1UL << (b))
+
+inline unsigned long millis(void) {
+    static auto start = std::chrono::steady_clock::now();
+    return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline unsigned long micros(void) {
+    static auto start = std::chrono::steady_clock::now();
+    return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline void delay(unsigned long ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+inline void yield(void) {
+    std::this_thread::yield();
+}
+
+inline void randomSeed(unsigned long seed) {
+    srandom(seed);
+}
+
+inline long random(long max) {
+    return (max > 0) ? ::random() % max : 0;
+}
+
+inline long random(long min, long max) {
+    return (min >= max) ? min : min + ::random() % (max - min);
+}
+
+/**
+ * Arduino String on top of std::string
+ */
+class String {
+  public:
+    String(const char * s = "")
+        : _s(s ? s : "") {}
+    String(const std::string & s)
+        : _s(s) {}
+    explicit String(char c)
+        : _s(1, c) {}
+    String(int v, int base = DEC) {
+        number(v, base);
+    }
+    String(unsigned int v, int base = DEC) {
+        number(v, base);
+    }
+    String(long v, int base = DEC) {
+        number(v, base);
+    }
+    String(unsigned long v, int base = DEC) {
+        number(v, base);
+    }
+    String(unsigned char v, int base = DEC) {
+        number(v, base);
+    }
+    String(double v, unsigned char decimals = 2) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+        _s = buf;
+    }
+
+    unsigned int length(void) const {
+        return _s.size();
+    }
+    const char * c_str(void) const {
+        return _s.c_str();
+    }
+    bool reserve(unsigned int size) {
+        _s.reserve(size);
+        return true;
+    }
+    char charAt(unsigned int i) const {
+        return (i < _s.size()) ? _s[i] : 0;
+    }
+    char operator[](unsigned int i) const {
+        return charAt(i);
+    }
+    char & operator[](unsigned int i) {
+        return _s[i];
+    }
+
+    String & operator+=(const String & o) {
+        _s += o._s;
+        return *this;
+    }
+    String & operator+=(const char * o) {
+        _s += o ? o : "";
+        return *this;
+    }
+    String & operator+=(char c) {
+        _s += c;
+        return *this;
+    }
+    String & operator+=(int v) {
+        return *this += String(v);
+    }
+    String & operator+=(unsigned int v) {
+        return *this += String(v);
+    }
+    String & operator+=(long v) {
+        return *this += String(v);
+    }
+    String & operator+=(unsigned long v) {
+        return *this += String(v);
+    }
+    bool concat(const String & o) {
+        _s += o._s;
+        return true;
+    }
+    bool concat(const char * o, unsigned int len) {
+        _s.append(o, len);
+        return true;
+    }
+    bool concat(char c) {
+        _s += c;
+        return true;
+    }
+
+    friend String operator+(const String & a, const String & b) {
+        return String(a._s + b._s);
+    }
+    friend String operator+(const String & a, const char * b) {
+        return String(a._s + (b ? b : ""));
+    }
+    friend String operator+(const char * a, const String & b) {
+        return String(std::string(a ? a : "") + b._s);
+    }
+    friend String operator+(const String & a, char b) {
+        return String(a._s + b);
+    }
+    friend String operator+(const String & a, int b) {
+        return a + String(b);
+    }
+    friend String operator+(const String & a, unsigned int b) {
+        return a + String(b);
+    }
+    friend String operator+(const String & a, long b) {
+        return a + String(b);
+    }
+    friend String operator+(const String & a, unsigned long b) {
+        return a + String(b);
+    }
+
+    bool operator==(const String & o) const {
+        return _s == o._s;
+    }
+    bool operator==(const char * o) const {
+        return _s == (o ? o : "");
+    }
+    bool operator!=(const String & o) const {
+        return _s != o._s;
+    }
+    bool operator!=(const char * o) const {
+        return !(*this == o);
+    }
+    bool operator<(const String & o) const {
+        return _s < o._s;
+    }
+    bool equals(const String & o) const {
+        return _s == o._s;
+    }
+    bool equalsIgnoreCase(const String & o) const {
+        return _s.size() == o._s.size() && strncasecmp(_s.c_str(), o._s.c_str(), _s.size()) == 0;
+    }
+    bool startsWith(const String & prefix) const {
+        return _s.compare(0, prefix._s.size(), prefix._s) == 0;
+    }
+    bool endsWith(const String & suffix) const {
+        return _s.size() >= suffix._s.size() && _s.compare(_s.size() - suffix._s.size(), suffix._s.size(), suffix._s) == 0;
+    }
+
+    int indexOf(char c, unsigned int from = 0) const {
+        return found(_s.find(c, from));
+    }
+    int indexOf(const String & s, unsigned int from = 0) const {
+        return found(_s.find(s._s, from));
+    }
+    int lastIndexOf(char c) const {
+        return found(_s.rfind(c));
+    }
+    int lastIndexOf(const String & s) const {
+        return found(_s.rfind(s._s));
+    }
+    String substring(unsigned int from) const {
+        return (from >= _s.size()) ? String() : String(_s.substr(from));
+    }
+    String substring(unsigned int from, unsigned int to) const {
+        if(from > to) {
+            std::swap(from, to);
+        }
+        if(from >= _s.size()) {
+            return String();
+        }
+        return String(_s.substr(from, std::min<size_t>(to, _s.size()) - from));
+    }
+    void trim(void) {
+        size_t begin = 0;
+        size_t end   = _s.size();
+        while(begin < end && isspace((unsigned char)_s[begin])) {
+            begin++;
+        }
+        while(end > begin && isspace((unsigned char)_s[end - 1])) {
+            end--;
+        }
+        _s = _s.substr(begin, end - begin);
+    }
+    void remove(unsigned int index, unsigned int count = (unsigned int)-1) {
+        if(index < _s.size()) {
+            _s.erase(index, count);
+        }
+    }
+    void replace(const String & find, const String & with) {
+        if(find._s.empty()) {
+            return;
+        }
+        size_t pos = 0;
+        while((pos = _s.find(find._s, pos)) != std::string::npos) {
+            _s.replace(pos, find._s.size(), with._s);
+            pos += with._s.size();
+        }
+    }
+    void toLowerCase(void) {
+        for(auto & c : _s) {
+            c = tolower((unsigned char)c);
+        }
+    }
+    void toUpperCase(void) {
+        for(auto & c : _s) {
+            c = toupper((unsigned char)c);
+        }
+    }
+    long toInt(void) const {
+        return strtol(_s.c_str(), NULL, 10);
+    }
+
+  protected:
+    std::string _s;
+
+    static int found(size_t pos) {
+        return (pos == std::string::npos) ? -1 : (int)pos;
+    }
+
+    void number(long long v, int base) {
+        char buf[70];
+        snprintf(buf, sizeof(buf), (base == HEX) ? "%llx" : "%lld", v);
+        _s = buf;
+    }
+};
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t * buf, size_t size) {
+        size_t n = 0;
+        while(size--) {
+            n += write(*buf++);
+        }
+        return n;
+    }
+    size_t write(const char * s) {
+        return s ? write((const uint8_t *)s, strlen(s)) : 0;
+    }
+    virtual void flush() {}
+};
+
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read()      = 0;
+    virtual int peek()      = 0;
+    virtual int read(uint8_t * buf, size_t size) {
+        size_t n = 0;
+        while(n < size) {
+            int c = read();
+            if(c < 0) {
+                break;
+            }
+            buf[n++] = c;
+        }
+        return n;
+    }
+
+    void setTimeout(unsigned long timeout) {
+        _timeout = timeout;
+    }
+
+    size_t readBytes(char * buf, size_t size) {
+        return readBytes((uint8_t *)buf, size);
+    }
+    size_t readBytes(uint8_t * buf, size_t size) {
+        size_t n            = 0;
+        unsigned long start = millis();
+        while(n < size && millis() - start < _timeout) {
+            int c = read();
+            if(c < 0) {
+                yield();
+                continue;
+            }
+            buf[n++] = c;
+        }
+        return n;
+    }
+    String readStringUntil(char terminator) {
+        String s;
+        unsigned long start = millis();
+        while(millis() - start < _timeout) {
+            int c = read();
+            if(c < 0) {
+                yield();
+                continue;
+            }
+            if(c == terminator) {
+                break;
+            }
+            s += (char)c;
+        }
+        return s;
+    }
+
+  protected:
+    unsigned long _timeout = 1000;
+};
+
+/**
+ * Serial goes to stdout
+ */
+class HostSerial {
+  public:
+    void begin(unsigned long) {}
+    template <typename T>
+    void print(const T & v) {
+        fputs(String(v).c_str(), stdout);
+    }
+    template <typename T>
+    void println(const T & v) {
+        print(v);
+        fputs("\n", stdout);
+    }
+    void println(void) {
+        fputs("\n", stdout);
+    }
+    int printf(const char * format, ...) __attribute__((format(printf, 2, 3))) {
+        va_list args;
+        va_start(args, format);
+        int n = vprintf(format, args);
+        va_end(args);
+        return n;
+    }
+};
+
+static HostSerial Serial __attribute__((unused));
+
+#include <IPAddress.h>
+
+class Client : public Stream {
+  public:
+    virtual int connect(IPAddress ip, uint16_t port)           = 0;
+    virtual int connect(const char * host, uint16_t port)      = 0;
+    virtual size_t write(uint8_t)                              = 0;
+    virtual size_t write(const uint8_t * buf, size_t size)     = 0;
+    virtual int available()                                    = 0;
+    virtual int read()                                         = 0;
+    virtual int read(uint8_t * buf, size_t size)               = 0;
+    virtual int peek()                                         = 0;
+    virtual void flush()                                       = 0;
+    virtual void stop()                                        = 0;
+    virtual uint8_t connected()                                = 0;
+    virtual operator bool()                                    = 0;
+};
+
+#endif /* HOST_ARDUINO_H_ */
@@ -0,0 +1,57 @@
+/**
+ * @file IPAddress.h
+ * @date 19.10.2026
+ *
+ * IPv4 address for host builds, stored in network byte order like the Arduino cores
+ */
+
+#ifndef HOST_IPADDRESS_H_
+#define HOST_IPADDRESS_H_
+
+#include <Arduino.h>
+
+class IPAddress {
+  public:
+    IPAddress() {
+        memset(_bytes, 0, sizeof(_bytes));
+    }
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+        _bytes[0] = a;
+        _bytes[1] = b;
+        _bytes[2] = c;
+        _bytes[3] = d;
+    }
+    IPAddress(uint32_t address) {
+        memcpy(_bytes, &address, sizeof(_bytes));
+    }
+
+    operator uint32_t() const {
+        uint32_t address;
+        memcpy(&address, _bytes, sizeof(address));
+        return address;
+    }
+    uint8_t operator[](int i) const {
+        return _bytes[i];
+    }
+
+    bool fromString(const char * address) {
+        unsigned int a, b, c, d;
+        char end;
+        if(sscanf(address, "%u.%u.%u.%u%c", &a, &b, &c, &d, &end) != 4 || a > 255 || b > 255 || c > 255 || d > 255) {
+            return false;
+        }
+        *this = IPAddress(a, b, c, d);
+        return true;
+    }
+
+    String toString() const {
+        char s[16];
+        snprintf(s, sizeof(s), "%u.%u.%u.%u", _bytes[0], _bytes[1], _bytes[2], _bytes[3]);
+        return String(s);
+    }
+
+  protected:
+    uint8_t _bytes[4];
+};
+
+#endif /* HOST_IPADDRESS_H_ */
@@ -0,0 +1,120 @@
+/**
+ * @file loadtest.cpp
+ * @date 19.10.2026
+ *
+ * load test of WebSocketsServer on the host (NETWORK_POSIX)
+ * N WebSocketsClient connect over loopback, the server echoes every text message
+ * the first [senders] clients send one message per loop, the others stay idle
+ * prints messages/s and the round trip latency (p50 / p99)
+ *
+ * usage: ws_loadtest [clients] [poller 0/1] [senders] [seconds] [payload bytes]
+ */
+
+#include <Arduino.h>
+#include <WebSocketsServer.h>
+#include <WebSocketsClient.h>
+
+#include <vector>
+
+#define LOADTEST_PORT 18081
+
+int main(int argc, char ** argv) {
+    int clients        = (argc > 1) ? atoi(argv[1]) : 50;
+    bool usePoller     = (argc > 2) ? atoi(argv[2]) : 1;
+    int senders        = (argc > 3) ? atoi(argv[3]) : std::min(clients, 5);
+    unsigned long secs = (argc > 4) ? strtoul(argv[4], NULL, 10) : 2;
+    size_t size        = (argc > 5) ? strtoul(argv[5], NULL, 10) : 64;
+
+    if(clients < 1 || clients > WEBSOCKETS_SERVER_CLIENT_MAX || size < sizeof(uint64_t)) {
+        fprintf(stderr, "usage: %s [clients 1..%d] [poller 0/1] [senders] [seconds] [payload bytes >= 8]\n", argv[0], WEBSOCKETS_SERVER_CLIENT_MAX);
+        return 1;
+    }
+
+    WebSocketsServer server(LOADTEST_PORT);
+    WebSocketsPollerPosix poller;
+    if(usePoller) {
+        server.setPoller(&poller);
+    }
+    server.onEvent([&](uint8_t num, WStype_t type, uint8_t * payload, size_t length) {
+        if(type == WStype_TEXT) {
+            server.sendTXT(num, payload, length);
+        }
+    });
+    server.begin();
+
+    std::vector<WebSocketsClient *> fleet;
+    std::vector<uint64_t> latency;
+    int connected = 0;
+    long received = 0;
+    for(int i = 0; i < clients; i++) {
+        WebSocketsClient * client = new WebSocketsClient();
+        client->onEvent([&](WStype_t type, uint8_t * payload, size_t length) {
+            if(type == WStype_CONNECTED) {
+                connected++;
+            } else if(type == WStype_TEXT && length >= sizeof(uint64_t)) {
+                uint64_t sent;
+                memcpy(&sent, payload, sizeof(sent));
+                latency.push_back(micros() - sent);
+                received++;
+            }
+        });
+        client->setReconnectInterval(0);
+        client->begin("127.0.0.1", LOADTEST_PORT, "/");
+        fleet.push_back(client);
+    }
+
+    unsigned long start = millis();
+    while(connected < clients && millis() - start < 10000) {
+        for(WebSocketsClient * client : fleet) {
+            client->loop();
+            server.loop();
+        }
+    }
+    printf("connected %d/%d in %lu ms, server sees %d\n", connected, clients, millis() - start, server.connectedClients());
+    if(connected < clients) {
+        return 1;
+    }
+
+    std::vector<uint8_t> message(size, 'x');
+    long sent           = 0;
+    unsigned long begin = micros();
+    while(micros() - begin < secs * 1000000UL) {
+        for(int i = 0; i < senders && i < clients; i++) {
+            uint64_t now = micros();
+            memcpy(message.data(), &now, sizeof(now));
+            fleet[i]->sendTXT(message.data(), message.size());
+            sent++;
+        }
+        server.loop();
+        for(int i = 0; i < senders && i < clients; i++) {
+            fleet[i]->loop();
+        }
+    }
+    // collect the echoes still in flight
+    unsigned long drain = millis();
+    while(received < sent && millis() - drain < 2000) {
+        server.loop();
+        for(int i = 0; i < senders && i < clients; i++) {
+            fleet[i]->loop();
+        }
+    }
+    double elapsed = (micros() - begin) / 1e6;
+
+    std::sort(latency.begin(), latency.end());
+    printf("poller=%d payload=%u sent %ld recv %ld  %.0f msg/s", usePoller, (unsigned int)size, sent, received, received / elapsed);
+    if(!latency.empty()) {
+        printf("  p50 %llu us p99 %llu us", (unsigned long long)latency[latency.size() / 2], (unsigned long long)latency[latency.size() * 99 / 100]);
+    }
+    printf("\n");
+
+    for(WebSocketsClient * client : fleet) {
+        client->disconnect();
+        delete client;
+    }
+    drain = millis();
+    while(server.connectedClients() > 0 && millis() - drain < 2000) {
+        server.loop();
+    }
+    printf("after disconnect server sees %d\n", server.connectedClients());
+    return (received == sent) ? 0 : 1;
+}
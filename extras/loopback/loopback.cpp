@@ -0,0 +1,285 @@
+/**
+ * @file loopback.cpp
+ * @date 19.10.2026
+ *
+ * the library on the host (NETWORK_POSIX): WebSocketsServer, WebSocketsClient and
+ * StompClient talk over 127.0.0.1 in one loop
+ * the server echoes text messages and answers a STOMP CONNECT with CONNECTED
+ * stalled and overlong HTTP requests must not hold up other handshakes
+ * a client that stops reading checks that WSQ_DROP_OLDEST drops whole queued messages
+ * and that the server does not wait for its close frame
+ *
+ * usage: ws_loopback [messages]
+ */
+
+#include <Arduino.h>
+#include <WebSocketsServer.h>
+#include <WebSocketsClient.h>
+#include <StompClient.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define LOOPBACK_PORT 18080
+
+// payload of the messages sent to the slow client
+#define SLOW_MESSAGE_SIZE 16384
+
+static bool stompConnected = false;
+
+static void onStompConnect(Stomp::StompCommand) {
+    stompConnected = true;
+}
+
+/**
+ * plain TCP connection to the server
+ * @param rcvbuf int  SO_RCVBUF, 0 = default
+ * @return fd, -1 on error
+ */
+static int rawConnect(int rcvbuf) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(rcvbuf > 0) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(LOOPBACK_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * clients that stop in the middle of a header line must not hold up other handshakes,
+ * a header line longer than WEBSOCKETS_SERVER_HEADER_LINE_SIZE is answered with 431
+ */
+static bool slowHandshakes(WebSocketsServer & server) {
+    int slow[6];
+    const char * partial = "GET / HTTP/1.1\r\nHost: 127.0.0.1\r\nX-Slow: ";
+    for(int & fd : slow) {
+        fd = rawConnect(0);
+        if(fd >= 0) {
+            send(fd, partial, strlen(partial), 0);
+        }
+    }
+
+    int longFd = rawConnect(0);
+    String request("GET / HTTP/1.1\r\nX-Long: ");
+    for(int i = 0; i < WEBSOCKETS_SERVER_HEADER_LINE_SIZE; i++) {
+        request += 'a';
+    }
+    request += "\r\n\r\n";
+    send(longFd, request.c_str(), request.length(), 0);
+
+    WebSocketsClient ws;
+    bool connected = false;
+    ws.onEvent([&](WStype_t type, uint8_t *, size_t) {
+        if(type == WStype_CONNECTED) {
+            connected = true;
+        }
+    });
+    ws.begin("127.0.0.1", LOOPBACK_PORT, "/");
+
+    unsigned long start = millis();
+    while(!connected && millis() - start < 1000) {
+        ws.loop();
+        server.loop();
+    }
+    unsigned long elapsed = millis() - start;
+
+    char answer[64] = { 0 };
+    struct timeval tv = { 0, 100000 };
+    setsockopt(longFd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    recv(longFd, answer, sizeof(answer) - 1, 0);
+    bool refused = (strncmp(answer, "HTTP/1.1 431", 12) == 0);
+
+    ws.disconnect();
+    close(longFd);
+    for(int fd : slow) {
+        close(fd);
+    }
+    printf("handshake: %s in %lu ms with 6 stalled requests, overlong header line %s\n", connected ? "connected" : "not connected", elapsed, refused ? "refused (431)" : "not refused");
+    return connected && refused;
+}
+
+#ifdef WEBSOCKETS_HAS_SERVER_QUEUE
+/**
+ * a raw client with a small receive buffer does the handshake and stops reading
+ * the server sends until its queue drops messages and disconnects it, then the client reads everything
+ * every frame has to be a complete message, received + dropped has to be sent and the close frame comes last
+ */
+static bool slowClient(WebSocketsServer & server, int & slowNum) {
+    int fd = rawConnect(4096);
+    if(fd < 0) {
+        return false;
+    }
+    const char * request =
+        "GET / HTTP/1.1\r\nHost: 127.0.0.1\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+    send(fd, request, strlen(request), 0);
+
+    slowNum             = -1;
+    unsigned long start = millis();
+    while(slowNum < 0 && millis() - start < 2000) {
+        server.loop();
+    }
+    if(slowNum < 0) {
+        close(fd);
+        return false;
+    }
+
+    // fill the socket buffers and the queue
+    server.setQueuePolicy(WSQ_DROP_OLDEST);
+    static uint8_t payload[SLOW_MESSAGE_SIZE];
+    memset(payload, 'x', sizeof(payload));
+    long sent = 0;
+    while(server.queueDropped(slowNum) < 4 && sent < 10000) {
+        int n = snprintf((char *)payload, 16, "%ld", sent);
+        payload[n] = ' ';
+        server.sendTXT(slowNum, payload, sizeof(payload));
+        sent++;
+    }
+    // the close frame goes behind the queue, disconnect does not wait for it
+    unsigned long closeStart = millis();
+    server.disconnect(slowNum);
+    unsigned long closeTime = millis() - closeStart;
+    uint32_t dropped        = server.queueDropped(slowNum);
+
+    // read the response header, then the frames
+    static uint8_t rx[4 * SLOW_MESSAGE_SIZE];
+    size_t have     = 0;
+    bool header     = false;
+    long received   = 0;
+    long last       = -1;
+    bool ok         = true;
+    bool closed     = false;
+    struct timeval tv = { 0, 10000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    start = millis();
+    while(ok && !closed && millis() - start < 5000) {
+        server.loop();
+        ssize_t r = recv(fd, rx + have, sizeof(rx) - have, 0);
+        if(r > 0) {
+            have += r;
+        }
+        if(!header) {
+            uint8_t * end = (uint8_t *)memmem(rx, have, "\r\n\r\n", 4);
+            if(!end) {
+                continue;
+            }
+            header = true;
+            have -= (end + 4 - rx);
+            memmove(rx, end + 4, have);
+        }
+        while(have >= 4) {
+            size_t len = rx[1] & 0x7F;
+            size_t hdr = 2;
+            if(len == 126) {
+                len = (rx[2] << 8) | rx[3];
+                hdr = 4;
+            } else if(len == 127) {
+                ok = false;
+                break;
+            }
+            if(have < hdr + len) {
+                break;
+            }
+            if(rx[0] == 0x88) {
+                closed = true;
+                break;
+            }
+            if(rx[0] & 0x08) {
+                // ping of the heartbeat
+                have -= (hdr + len);
+                memmove(rx, rx + hdr + len, have);
+                continue;
+            }
+            long seq = atol((char *)rx + hdr);
+            if(rx[0] != 0x81 || len != SLOW_MESSAGE_SIZE || seq <= last) {
+                printf("slow client: broken frame 0x%02X length %u after %ld\n", rx[0], (unsigned)len, last);
+                ok = false;
+                break;
+            }
+            last = seq;
+            received++;
+            have -= (hdr + len);
+            memmove(rx, rx + hdr + len, have);
+        }
+    }
+    close(fd);
+    printf("slow client: %ld sent, %ld received, %u dropped (WSQ_DROP_OLDEST), disconnect %lu ms, close frame %s\n", sent, received, dropped, closeTime, closed ? "received" : "missing");
+    return ok && closed && closeTime < 100 && dropped > 0 && (received + (long)dropped) == sent && !server.clientIsConnected(slowNum);
+}
+#endif
+
+int main(int argc, char ** argv) {
+    long messages = (argc > 1) ? atol(argv[1]) : 1000;
+
+    WebSocketsServer server(LOOPBACK_PORT);
+    int slowNum = -1;
+    server.onEvent([&](uint8_t num, WStype_t type, uint8_t * payload, size_t length) {
+        if(type == WStype_CONNECTED) {
+            slowNum = num;
+        }
+        if(type != WStype_TEXT) {
+            return;
+        }
+        if(strstr((char *)payload, "CONNECT\\n")) {
+            // STOMP frames of StompClient are escaped like SockJS ones
+            server.sendTXT(num, "CONNECTED\\nversion:1.1\\nheart-beat:0,0\\n\\n");
+        } else {
+            server.sendTXT(num, payload, length);
+        }
+    });
+    server.begin();
+
+    // WebSocket echo
+    WebSocketsClient ws;
+    long received = 0;
+    ws.onEvent([&](WStype_t type, uint8_t * payload, size_t length) {
+        if(type == WStype_CONNECTED) {
+            ws.sendTXT("0");
+        } else if(type == WStype_TEXT) {
+            if(++received < messages) {
+                String next(received);
+                ws.sendTXT(next);
+            }
+        }
+    });
+    ws.begin("127.0.0.1", LOOPBACK_PORT, "/");
+
+    unsigned long start = millis();
+    while(received < messages && millis() - start < 10000) {
+        ws.loop();
+        server.loop();
+    }
+    unsigned long elapsed = millis() - start;
+    const WSconnectStats_t & stats = ws.connectStats();
+    printf("websocket: %ld/%ld echoes in %lu ms, connect tcp %u ms upgrade %u ms\n", received, messages, elapsed, stats.duration[WSCP_TCP], stats.duration[WSCP_UPGRADE]);
+    ws.disconnect();
+
+    // STOMP CONNECT
+    WebSocketsClient stompSocket;
+    Stomp::StompClient stomp(stompSocket, "127.0.0.1", LOOPBACK_PORT, "/", false);
+    stomp.onConnect(onStompConnect);
+    stomp.begin();
+    start = millis();
+    while(!stompConnected && millis() - start < 5000) {
+        stomp.loop();
+        server.loop();
+    }
+    printf("stomp: %s in %lu ms\n", stompConnected ? "connected" : "not connected", millis() - start);
+
+    bool slow = slowHandshakes(server);
+#ifdef WEBSOCKETS_HAS_SERVER_QUEUE
+    slow = slowClient(server, slowNum) && slow;
+#endif
+
+    return (received == messages && stompConnected && slow) ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+/**
+ * @file reconnect_sim.cpp
+ * @date 19.10.2026
+ *
+ * host simulation of a fleet that lost its server
+ * every device runs a WebSocketsReconnect, the server is down for some time and
+ * can do a limited number of TLS handshakes per second after the restart
+ * prints the connection attempts and connects per second, once for the old fixed
+ * interval and once for the backoff with jitter
+ *
+ * usage: reconnect_sim [devices] [down ms] [handshakes/s] [seconds]
+ */
+
+#include <Arduino.h>
+#include "WebSocketsReconnect.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <queue>
+#include <vector>
+
+typedef struct {
+    unsigned long at;
+    uint16_t device;
+} attempt_t;
+
+struct later {
+    bool operator()(const attempt_t & a, const attempt_t & b) const {
+        return a.at > b.at;
+    }
+};
+
+typedef struct {
+    unsigned long base;
+    unsigned long max;
+    const char * name;
+} policy_t;
+
+static void simulate(const policy_t & policy, int devices, unsigned long down, unsigned long rate, int seconds) {
+    std::vector<WebSocketsReconnect> fleet(devices, WebSocketsReconnect(policy.base, policy.max));
+    std::priority_queue<attempt_t, std::vector<attempt_t>, later> queue;
+    std::vector<uint32_t> attempts(seconds, 0);
+    std::vector<uint32_t> connects(seconds, 0);
+    unsigned long end = (unsigned long)seconds * 1000;
+    int connected     = 0;
+    unsigned long last = 0;
+
+    randomSeed(1);
+    for(int i = 0; i < devices; i++) {
+        // every device was up for a long time, the server restart drops it within 100 ms
+        fleet[i].connected(0);
+        unsigned long lost = 100000 + random(0, 100);
+        queue.push({ lost + fleet[i].next(lost), (uint16_t)i });
+    }
+
+    uint32_t windowSecond = 0;
+    uint32_t handshakes   = 0;
+    while(!queue.empty()) {
+        attempt_t a = queue.top();
+        queue.pop();
+        unsigned long t = a.at - 100000;
+        if(t >= end) {
+            break;
+        }
+        uint32_t second = t / 1000;
+        if(second != windowSecond) {
+            windowSecond = second;
+            handshakes   = 0;
+        }
+        attempts[second]++;
+
+        // refused while down, then the TLS terminator drops what it can not handle
+        if(t >= down && handshakes < rate) {
+            handshakes++;
+            connects[second]++;
+            connected++;
+            last = t;
+            continue;
+        }
+        unsigned long now = a.at + 5;
+        queue.push({ now + fleet[a.device].next(now), a.device });
+    }
+
+    printf("\n%s (base %lu ms, max %lu ms)\n", policy.name, policy.base, policy.max);
+    printf("  sec  attempts  connects\n");
+    for(int s = 0; s < seconds; s++) {
+        if(attempts[s] == 0 && connects[s] == 0) {
+            continue;
+        }
+        printf("  %3d  %8u  %8u  ", s, attempts[s], connects[s]);
+        for(uint32_t b = 0; b < attempts[s] / 50; b++) {
+            putchar('#');
+        }
+        putchar('\n');
+    }
+    uint32_t total = 0;
+    uint32_t peak  = 0;
+    for(int s = 0; s < seconds; s++) {
+        total += attempts[s];
+        if(attempts[s] > peak) {
+            peak = attempts[s];
+        }
+    }
+    printf("  connected %d/%d, last at %lu ms, %u attempts, peak %u attempts/s\n", connected, devices, last, total, peak);
+}
+
+int main(int argc, char ** argv) {
+    int devices        = (argc > 1) ? atoi(argv[1]) : 1000;
+    unsigned long down = (argc > 2) ? strtoul(argv[2], NULL, 10) : 20000;
+    unsigned long rate = (argc > 3) ? strtoul(argv[3], NULL, 10) : 100;
+    int seconds        = (argc > 4) ? atoi(argv[4]) : 120;
+
+    if(devices < 1 || devices > 0xFFFF || seconds < 1) {
+        fprintf(stderr, "usage: %s [devices] [down ms] [handshakes/s] [seconds]\n", argv[0]);
+        return 1;
+    }
+    printf("%d devices, server down %lu ms, %lu handshakes/s after the restart\n", devices, down, rate);
+
+    simulate({ 500, 500, "fixed interval" }, devices, down, rate, seconds);
+    simulate({ 500, WEBSOCKETS_RECONNECT_MAX_INTERVAL, "exponential backoff, full jitter" }, devices, down, rate, seconds);
+    return 0;
+}
@@ -0,0 +1,505 @@
+/**
+ * @file replay.cpp
+ * @date 19.10.2026
+ *
+ * replay of a session recorded with WebSocketsCapture (Automata::setCapture, ws_fleet --capture)
+ * a WebSocketsServer on loopback plays the server side: the received frames of the capture
+ * are sent to a WebSocketsClient + StompClient (SockJS) at the recorded times (--speed=1),
+ * n times faster or as fast as possible (--speed=0)
+ *  - the application is emulated: the destinations of the recorded SUBSCRIBE frames are
+ *    subscribed on CONNECTED, SEND frames (data, acks of actions) are sent as recorded
+ *  - everything else the client sends (CONNECT, SUBSCRIBE, ACK) comes from the library,
+ *    the replay waits for it before the next record and compares it with the capture
+ *  - sendHttp blocks the loop of the device, the replay blocks for the recorded time
+ * the order of the frames does not depend on the timing, so runs with --speed=0 can be compared
+ * prints the differences to the capture and the reaction time (received frame -> answer of the client)
+ *
+ * usage: ws_replay <capture> [--speed=x] [--port=n] [--dump] [--verbose]
+ */
+
+#include <Arduino.h>
+#include <WebSocketsServer.h>
+#include <WebSocketsClient.h>
+#include <StompClient.h>
+#include <StompBroker.h>
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#ifndef WEBSOCKETS_HAS_CAPTURE
+#error "ws_replay needs WEBSOCKETS_HAS_CAPTURE"
+#endif
+
+#define REPLAY_HOST "127.0.0.1"
+#define REPLAY_WAIT_MS (2000)    ///< max wait for a frame of the client or a (re)connect
+
+typedef struct {
+    double speed     = 1.0;      ///< 0 = as fast as possible
+    uint16_t port    = 18097;
+    bool dump        = false;
+    bool verbose     = false;
+} ReplayConfig_t;
+
+/**
+ * sends the frames exactly as recorded, incl. fragments and control frames
+ */
+class ReplayServer : public WebSocketsServer {
+  public:
+    explicit ReplayServer(uint16_t port)
+        : WebSocketsServer(port) {
+    }
+
+    bool frame(uint8_t num, uint8_t opcode, const uint8_t * payload, size_t length, bool fin) {
+        if(num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+            return false;
+        }
+        return sendFrame(&_clients[num], (WSopcode_t)opcode, (uint8_t *)payload, length, fin);
+    }
+};
+
+/**
+ * SockJS array ["..."] to the STOMP frame, a plain STOMP frame stays as it is
+ */
+static String unwrap(const uint8_t * payload, size_t length) {
+    String text;
+    text.concat((const char *)payload, length);
+    if(text.startsWith("[\"")) {
+        return StompBroker::unescape(text.c_str() + 2);
+    }
+    return text;
+}
+
+static String stompCommand(const String & frame) {
+    int end = frame.indexOf('\n');
+    return (end >= 0) ? frame.substring(0, end) : frame;
+}
+
+static String stompHeader(const String & frame, const char * name) {
+    String key = "\n" + String(name) + ":";
+    int start  = frame.indexOf(key);
+    int body   = frame.indexOf("\n\n");
+    if(start < 0 || (body >= 0 && start > body)) {
+        return String();
+    }
+    start += key.length();
+    return frame.substring(start, frame.indexOf('\n', start));
+}
+
+static bool isHeartbeat(const String & frame) {
+    return (frame == "\n" || frame.length() == 0);
+}
+
+static uint64_t percentile(std::vector<uint64_t> & samples, int p) {
+    if(samples.empty()) {
+        return 0;
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[std::min(samples.size() - 1, samples.size() * p / 100)];
+}
+
+static const char * typeName(WScaptureType_t type) {
+    switch(type) {
+        case WSCAP_OPEN:
+            return "open";
+        case WSCAP_CLOSE:
+            return "close";
+        case WSCAP_RX:
+            return "rx";
+        case WSCAP_TX:
+            return "tx";
+        case WSCAP_HTTP_REQUEST:
+            return "http>";
+        case WSCAP_HTTP_RESPONSE:
+            return "http<";
+    }
+    return "?";
+}
+
+/**
+ * printable start of a payload, control chars escaped
+ */
+static String preview(const uint8_t * payload, size_t length, size_t max = 100) {
+    String out;
+    for(size_t i = 0; i < length && i < max; i++) {
+        char c = payload[i];
+        if(c == '\n') {
+            out += "\\n";
+        } else if(c == '\r') {
+            out += "\\r";
+        } else if(c < 0x20 || c == 0x7F) {
+            out += '.';
+        } else {
+            out += c;
+        }
+    }
+    if(length > max) {
+        out += "...";
+    }
+    return out;
+}
+
+typedef struct {
+    std::vector<std::pair<String, Stomp::Stomp_AckMode_t>> subscriptions;
+} ReplayConnection_t;
+
+typedef struct {
+    uint8_t opcode;
+    String frame;          ///< STOMP frame or binary payload
+    unsigned long at;      ///< micros() when the server got it
+} ReplayFrame_t;
+
+typedef struct {
+    String frame;          ///< what the client has to send (STOMP frame or binary payload)
+    uint8_t opcode;
+    uint64_t rxTime;       ///< recorded time of the frame it answers, 0 = none
+} ReplayExpected_t;
+
+static std::vector<ReplayConnection_t> connections;
+static int connection                   = -1;
+static Stomp::StompClient * replayStomp = nullptr;
+
+static Stomp::Stomp_Ack_t onMessage(Stomp::StompCommand cmd) {
+    return Stomp::CONTINUE;
+}
+
+/**
+ * Automata::subscribe with the destinations of the capture
+ */
+static void onConnect(Stomp::StompCommand cmd) {
+    if(connection < 0 || connection >= (int)connections.size()) {
+        return;
+    }
+    for(auto & subscription : connections[connection].subscriptions) {
+        replayStomp->subscribe((char *)subscription.first.c_str(), subscription.second, onMessage);
+    }
+}
+
+static bool option(const char * arg, const char * name, const char ** value) {
+    size_t len = strlen(name);
+    if(strncmp(arg, name, len) != 0 || arg[len] != '=') {
+        return false;
+    }
+    *value = arg + len + 1;
+    return true;
+}
+
+int main(int argc, char ** argv) {
+    ReplayConfig_t config;
+    const char * path = NULL;
+    for(int i = 1; i < argc; i++) {
+        const char * v;
+        if(option(argv[i], "--speed", &v)) {
+            config.speed = atof(v);
+        } else if(option(argv[i], "--port", &v)) {
+            config.port = atoi(v);
+        } else if(strcmp(argv[i], "--dump") == 0) {
+            config.dump = true;
+        } else if(strcmp(argv[i], "--verbose") == 0) {
+            config.verbose = true;
+        } else if(argv[i][0] != '-' && !path) {
+            path = argv[i];
+        } else {
+            path = NULL;
+            break;
+        }
+    }
+    if(!path) {
+        fprintf(stderr, "usage: %s <capture> [--speed=x] [--port=n] [--dump] [--verbose]\n", argv[0]);
+        return 1;
+    }
+
+    FILE * file = fopen(path, "rb");
+    if(!file) {
+        perror(path);
+        return 1;
+    }
+    std::vector<uint8_t> data;
+    uint8_t buffer[4096];
+    size_t n;
+    while((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + n);
+    }
+    fclose(file);
+
+    WebSocketsCaptureReader reader(data.data(), data.size());
+    if(!reader.valid()) {
+        fprintf(stderr, "%s: not a capture (version %d)\n", path, WEBSOCKETS_CAPTURE_VERSION);
+        return 1;
+    }
+
+    // first pass: what the application did per connection, the url and the totals
+    WScaptureRecord_t record;
+    String url;
+    uint32_t records  = 0;
+    uint32_t counts[WSCAP_HTTP_RESPONSE + 1] = { 0 };
+    uint64_t duration = 0;
+    while(reader.next(&record)) {
+        records++;
+        counts[record.type]++;
+        duration = record.time;
+        if(config.dump) {
+            int arg = (record.type == WSCAP_HTTP_RESPONSE) ? WebSocketsCapture::unzigzag(record.arg) : record.arg;
+            printf("%12.6f %-5s %4d %6zu  %s\n", record.time / 1e6, typeName(record.type), arg, record.length, preview(record.payload, record.length).c_str());
+        }
+        if(record.type == WSCAP_OPEN) {
+            if(url.length() == 0) {
+                url.concat((const char *)record.payload, record.length);
+            }
+            connections.push_back(ReplayConnection_t());
+        } else if(record.type == WSCAP_TX && !connections.empty()) {
+            String frame = unwrap(record.payload, record.length);
+            if(stompCommand(frame) == "SUBSCRIBE") {
+                String ack = stompHeader(frame, "ack");
+                connections.back().subscriptions.push_back({ stompHeader(frame, "destination"), (ack == "client") ? Stomp::CLIENT : ((ack == "client-individual") ? Stomp::CLIENT_INDIVIDUAL : Stomp::AUTO) });
+            }
+        }
+    }
+    if(data.size() > 5 && records == 0) {
+        fprintf(stderr, "%s: no complete record\n", path);
+        return 1;
+    }
+    printf("%s: %u records in %.1f s, %u connections, %u frames received, %u sent, %u HTTP requests\n", path, records, duration / 1e6, counts[WSCAP_OPEN], counts[WSCAP_RX], counts[WSCAP_TX], counts[WSCAP_HTTP_REQUEST]);
+    if(config.dump || counts[WSCAP_OPEN] == 0) {
+        return 0;
+    }
+
+    // /ws/<server>/<session>/websocket of SockJS back to the base url of StompClient
+    bool sockjs = url.endsWith("/websocket");
+    String base = url;
+    if(sockjs) {
+        for(int i = 0; i < 3; i++) {
+            base = base.substring(0, base.lastIndexOf('/'));
+        }
+        base += "/";
+    }
+
+    ReplayServer server(config.port);
+    int clientNum = -1;
+    std::deque<ReplayFrame_t> received;
+    server.onEvent([&](uint8_t num, WStype_t type, uint8_t * payload, size_t length) {
+        switch(type) {
+            case WStype_CONNECTED:
+                clientNum = num;
+                break;
+            case WStype_DISCONNECTED:
+                if(clientNum == num) {
+                    clientNum = -1;
+                }
+                break;
+            case WStype_TEXT:
+                received.push_back({ WSop_text, unwrap(payload, length), micros() });
+                break;
+            case WStype_BIN:
+                received.push_back({ WSop_binary, String(), micros() });
+                received.back().frame.concat((const char *)payload, length);
+                break;
+            default:
+                break;
+        }
+    });
+    server.begin();
+
+    WebSocketsClient ws;
+    Stomp::StompClient stomp(ws, REPLAY_HOST, config.port, base.c_str(), sockjs);
+    replayStomp = &stomp;
+    ws.setReconnectInterval(10);
+    stomp.onConnect(onConnect);
+
+    auto pump = [&](void) {
+        server.loop();
+        stomp.loop();
+    };
+
+    auto waitFor = [&](std::function<bool(void)> done) {
+        unsigned long start = millis();
+        while(!done()) {
+            if(millis() - start > REPLAY_WAIT_MS) {
+                return false;
+            }
+            pump();
+        }
+        return true;
+    };
+
+    std::deque<ReplayExpected_t> expected;
+    uint32_t matched    = 0;
+    uint32_t different  = 0;
+    uint32_t missing    = 0;
+    uint32_t heartbeats = 0;
+    uint32_t injected   = 0;
+    uint64_t blocked    = 0;
+    uint64_t lastRx     = 0;    ///< recorded time of the last received frame nobody answered yet
+    unsigned long lastRxSent = 0;
+    std::vector<uint64_t> reactionRecorded;
+    std::vector<uint64_t> reactionReplay;
+
+    // compares what the client sent with the capture, frames sent before the capture has them wait
+    auto check = [&](void) {
+        while(!received.empty()) {
+            ReplayFrame_t frame = received.front();
+            if(frame.opcode == WSop_text && isHeartbeat(frame.frame)) {
+                received.pop_front();
+                heartbeats++;
+                continue;
+            }
+            if(expected.empty()) {
+                break;
+            }
+            received.pop_front();
+            ReplayExpected_t & want = expected.front();
+            if(want.opcode == frame.opcode && want.frame == frame.frame) {
+                matched++;
+            } else {
+                different++;
+                if(config.verbose) {
+                    printf("expected  %s\nreceived  %s\n", preview((const uint8_t *)want.frame.c_str(), want.frame.length()).c_str(), preview((const uint8_t *)frame.frame.c_str(), frame.frame.length()).c_str());
+                }
+            }
+            if(want.rxTime > 0) {
+                reactionReplay.push_back(frame.at - lastRxSent);
+            }
+            expected.pop_front();
+        }
+    };
+
+    reader.rewind();
+    unsigned long start = micros();
+    uint64_t offset     = 0;    ///< us the replay is behind the capture (waits, blocked HTTP)
+    while(reader.next(&record)) {
+        if(config.speed > 0) {
+            uint64_t at = offset + (uint64_t)(record.time / config.speed);
+            while((uint64_t)(micros() - start) < at) {
+                pump();
+                check();
+            }
+        }
+
+        switch(record.type) {
+            case WSCAP_OPEN:
+                connection++;
+                if(connection == 0) {
+                    stomp.begin();
+                }
+                if(!waitFor([&](void) { return clientNum >= 0 && ws.isConnected(); })) {
+                    printf("connection %d: client did not connect\n", connection);
+                    return 1;
+                }
+                break;
+
+            case WSCAP_CLOSE:
+                if(clientNum >= 0) {
+                    server.disconnect(clientNum);
+                }
+                waitFor([&](void) { return clientNum < 0; });
+                break;
+
+            case WSCAP_RX:
+                if(clientNum >= 0) {
+                    server.frame(clientNum, record.arg & 0x0F, record.payload, record.length, record.arg & 0x80);
+                    lastRx     = record.time;
+                    lastRxSent = micros();
+                }
+                break;
+
+            case WSCAP_TX: {
+                uint8_t opcode = (record.arg & 0x0F);
+                String frame;
+                if(opcode & 0x08) {
+                    // ping / pong / close are answered by the library on both ends, WebSocketsServer even pings after the handshake
+                    break;
+                } else if(opcode == WSop_text) {
+                    frame = unwrap(record.payload, record.length);
+                    if(isHeartbeat(frame)) {
+                        break;
+                    }
+                } else {
+                    frame.concat((const char *)record.payload, record.length);
+                }
+                String command = stompCommand(frame);
+                bool app       = (opcode == WSop_binary || (opcode == WSop_text && (command == "SEND" || command == "DISCONNECT" || command == "UNSUBSCRIBE" || command == "BEGIN" || command == "COMMIT" || command == "ABORT")));
+                // the first frame the library sends after a received one is the reaction to it
+                bool reaction = (!app && lastRx > 0);
+                expected.push_back({ frame, opcode, reaction ? lastRx : 0 });
+                if(reaction) {
+                    reactionRecorded.push_back(record.time - lastRx);
+                    lastRx = 0;
+                }
+                if(app) {
+                    if(opcode == WSop_binary) {
+                        ws.sendBIN(record.payload, record.length);
+                    } else {
+                        ws.sendTXT(record.payload, record.length);
+                    }
+                    injected++;
+                }
+                break;
+            }
+
+            case WSCAP_HTTP_REQUEST: {
+                // the loop of the device stands still in sendHttp until the response
+                WebSocketsCaptureReader ahead = reader;
+                WScaptureRecord_t response = {};
+                while(ahead.next(&response) && response.type != WSCAP_HTTP_RESPONSE) {
+                }
+                if(response.type == WSCAP_HTTP_RESPONSE) {
+                    String text;
+                    text.concat((const char *)record.payload, record.length);
+                    uint64_t us = response.time - record.time;
+                    printf("http %-12s %4d %8.1f ms\n", text.substring(0, text.indexOf('\n')).c_str(), WebSocketsCapture::unzigzag(response.arg), us / 1e3);
+                    blocked += us;
+                    if(config.speed > 0) {
+                        delay(us / config.speed / 1000);
+                    }
+                }
+                break;
+            }
+
+            case WSCAP_HTTP_RESPONSE:
+                break;
+        }
+
+        // the answers of the client have to be there before the next record
+        if(!waitFor([&](void) {
+               check();
+               return expected.empty();
+           })) {
+            missing += expected.size();
+            if(config.verbose) {
+                for(ReplayExpected_t & want : expected) {
+                    printf("missing   %s\n", preview((const uint8_t *)want.frame.c_str(), want.frame.length()).c_str());
+                }
+            }
+            expected.clear();
+        }
+
+        if(config.speed > 0) {
+            // catch up with the capture after waiting
+            uint64_t now = micros() - start;
+            uint64_t at  = offset + (uint64_t)(record.time / config.speed);
+            if(now > at + 100000) {
+                offset += now - at;
+            }
+        }
+    }
+
+    check();
+    uint32_t extra = received.size();
+    if(config.verbose) {
+        for(ReplayFrame_t & frame : received) {
+            printf("extra     %s\n", preview((const uint8_t *)frame.frame.c_str(), frame.frame.length()).c_str());
+        }
+    }
+
+    unsigned long wall = micros() - start;
+    printf("replay at %s: %.2f s (capture %.2f s)\n", (config.speed > 0) ? (String(config.speed) + "x").c_str() : "full speed", wall / 1e6, duration / 1e6);
+    printf("client frames: %u as recorded, %u different, %u missing, %u extra, %u heart-beats skipped, %u sent by the application\n", matched, different, missing, extra, heartbeats, injected);
+    printf("reaction   capture p50 %8.3f ms p99 %8.3f ms   replay p50 %8.3f ms p99 %8.3f ms (%zu)\n", percentile(reactionRecorded, 50) / 1e3, percentile(reactionRecorded, 99) / 1e3, percentile(reactionReplay, 50) / 1e3, percentile(reactionReplay, 99) / 1e3, reactionReplay.size());
+    if(blocked > 0) {
+        printf("http       %.1f ms of the capture blocked in sendHttp\n", blocked / 1e3);
+    }
+
+    ws.disconnect();
+    server.close();
+    return (missing == 0) ? 0 : 1;
+}
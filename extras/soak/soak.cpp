@@ -0,0 +1,344 @@
+/**
+ * @file soak.cpp
+ * @date 19.10.2026
+ *
+ * soak test: days of Automata traffic in minutes on the host, built with the allocation profiler
+ * (WEBSOCKETS_ALLOC_PROFILE) to find the call sites that churn or leak the heap
+ * N devices (WebSocketsClient + StompClient over SockJS) and a StompBroker in one thread,
+ * the simulated clock runs as fast as the messages are delivered
+ *  - /app/sendData every --interval s with --attributes values, escaped like Automata::send
+ *  - an action every --action s, answered like Automata::handleAction
+ *  - the connection is dropped every --reconnect s (WiFi loss, broker restart)
+ * prints one line per simulated hour (allocations, live bytes, heap) and the table per call site,
+ * the counters start after --warmup hours, a growing live size after that is a leak
+ * the WebSocketsServer of the broker shares the ws.* sites with the clients, soak.broker is the rest of it
+ *
+ * usage: ws_soak [--devices=n] [--hours=n] [--warmup=n] [--interval=s] [--action=s]
+ *                [--reconnect=s] [--attributes=n] [--port=n]
+ */
+
+#include <Arduino.h>
+#include <WebSocketsClient.h>
+#include <StompClient.h>
+#include <StompBroker.h>
+
+#include <vector>
+
+#ifndef WEBSOCKETS_HAS_ALLOC_PROFILE
+#error "ws_soak needs the allocation profiler (WEBSOCKETS_ALLOC_PROFILE)"
+#endif
+
+#define SOAK_HOST "127.0.0.1"
+
+typedef struct {
+    int devices              = 20;
+    unsigned long hours      = 24;
+    unsigned long warmup     = 1;        ///< simulated hours before the counters start
+    unsigned long interval   = 60;       ///< /app/sendData per device (s), like Automata d = 60000
+    unsigned long action     = 300;      ///< action per device (s), 0 = off
+    unsigned long reconnect  = 21600;    ///< connection dropped per device (s), 0 = never
+    int attributes           = 8;
+    uint16_t port            = 18095;
+} SoakConfig_t;
+
+/**
+ * Print on stdout for WebSocketsAlloc::printTo
+ */
+class SoakOut : public Print {
+  public:
+    size_t write(uint8_t c) override {
+        return (fputc(c, stdout) != EOF);
+    }
+    size_t write(const uint8_t * buffer, size_t size) override {
+        return fwrite(buffer, 1, size, stdout);
+    }
+};
+
+/**
+ * Automata::send, quotes escaped for the JSON string of the StompClient frame
+ */
+static String escape(const String & json) {
+    String escaped = "";
+    for(unsigned int i = 0; i < json.length(); i++) {
+        if(json.charAt(i) == '"') {
+            escaped += '\\';
+        }
+        escaped += json.charAt(i);
+    }
+    return escaped;
+}
+
+class SoakDevice {
+  public:
+    static SoakDevice * current;
+
+    uint32_t connects = 0;
+    uint32_t actions  = 0;
+
+    SoakDevice(int index, const SoakConfig_t & config)
+        : _index(index)
+        , _config(config)
+        , _stomp(_ws, SOAK_HOST, config.port, "/ws/", true) {
+        _deviceId = "soak-" + String(index);
+        _ws.setReconnectInterval(20);
+        _stomp.onConnect(onConnect);
+        _stomp.onDisconnect(onDisconnect);
+    }
+
+    void begin(void) {
+        _stomp.begin();
+    }
+
+    void loop(void) {
+        current = this;
+        _stomp.loop();
+    }
+
+    bool connected(void) const {
+        return _connected;
+    }
+
+    /**
+     * Automata::sendData with the delayed update of Automata::loop
+     */
+    bool sendData(uint32_t now) {
+        if(!_connected) {
+            return false;
+        }
+        WEBSOCKETS_ALLOC_SCOPE("automata.send");
+        String json = "{\"key\":\"data\"";
+        for(int i = 0; i < _config.attributes; i++) {
+            json += ",\"v" + String(i) + "\":" + String((now % 1000) / 10.0 + i);
+        }
+        json += ",\"device_id\":\"" + _deviceId + "\"}";
+        current = this;
+        _ws.cork();
+        _stomp.sendMessage("/app/sendData", escape(json));
+        _ws.uncork();
+        return true;
+    }
+
+    void drop(void) {
+        _connected = false;
+        _ws.disconnect();
+    }
+
+  protected:
+    int _index;
+    const SoakConfig_t & _config;
+    WebSocketsClient _ws;
+    Stomp::StompClient _stomp;
+    String _deviceId;
+    bool _connected = false;
+
+    static void onConnect(Stomp::StompCommand cmd) {
+        SoakDevice * device = current;
+        device->connects++;
+        device->_connected = true;
+
+        // Automata::subscribe
+        String update = "/topic/update/" + device->_deviceId;
+        String action = "/topic/action/" + device->_deviceId;
+        device->_stomp.subscribe((char *)update.c_str(), Stomp::CLIENT, onUpdate);
+        device->_stomp.subscribe((char *)action.c_str(), Stomp::CLIENT, onAction);
+    }
+
+    static void onDisconnect(Stomp::StompCommand cmd) {
+        current->_connected = false;
+    }
+
+    static Stomp::Stomp_Ack_t onUpdate(Stomp::StompCommand cmd) {
+        return Stomp::CONTINUE;
+    }
+
+    /**
+     * Automata::handleAction: parseString, the handler and the ack
+     */
+    static Stomp::Stomp_Ack_t onAction(Stomp::StompCommand cmd) {
+        WEBSOCKETS_ALLOC_SCOPE("automata.action");
+        SoakDevice * device = current;
+        device->actions++;
+        String str = String(cmd.body);
+        str.trim();
+        str.replace("\\", "");
+        bool reboot = (str.indexOf("\"reboot\":true") >= 0);
+
+        String ack = "{";
+        if(reboot) {
+            ack += "\"command\":\"reboot\",";
+        }
+        ack += "\"key\":\"actionAck\",\"actionAck\":\"Success\",\"device_id\":\"" + device->_deviceId + "\"}";
+        device->_stomp.sendMessage("/app/ackAction", escape(ack));
+        return Stomp::CONTINUE;
+    }
+};
+
+SoakDevice * SoakDevice::current = nullptr;
+
+static bool option(const char * arg, const char * name, unsigned long & value) {
+    size_t len = strlen(name);
+    if(strncmp(arg, name, len) != 0 || arg[len] != '=') {
+        return false;
+    }
+    value = strtoul(arg + len + 1, NULL, 10);
+    return true;
+}
+
+int main(int argc, char ** argv) {
+    SoakConfig_t config;
+    for(int i = 1; i < argc; i++) {
+        unsigned long v;
+        if(option(argv[i], "--devices", v)) {
+            config.devices = v;
+        } else if(option(argv[i], "--hours", v)) {
+            config.hours = v;
+        } else if(option(argv[i], "--warmup", v)) {
+            config.warmup = v;
+        } else if(option(argv[i], "--interval", v)) {
+            config.interval = v;
+        } else if(option(argv[i], "--action", v)) {
+            config.action = v;
+        } else if(option(argv[i], "--reconnect", v)) {
+            config.reconnect = v;
+        } else if(option(argv[i], "--attributes", v)) {
+            config.attributes = v;
+        } else if(option(argv[i], "--port", v)) {
+            config.port = v;
+        } else {
+            fprintf(stderr, "usage: %s [--devices=n] [--hours=n] [--warmup=n] [--interval=s] [--action=s] [--reconnect=s] [--attributes=n] [--port=n]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(config.devices < 1 || config.devices > WEBSOCKETS_SERVER_CLIENT_MAX - 5 || config.interval == 0) {
+        fprintf(stderr, "--devices 1..%d, --interval > 0\n", WEBSOCKETS_SERVER_CLIENT_MAX - 5);
+        return 1;
+    }
+
+    uint32_t received = 0;
+    uint32_t acked    = 0;
+    StompBroker broker(config.port);
+    broker.onSend([&](StompBrokerSession session, const StompBrokerFrame & frame) {
+        String destination = frame.header("destination");
+        if(destination == "/app/sendData") {
+            received++;
+        } else if(destination == "/app/ackAction") {
+            acked++;
+        }
+    });
+    broker.begin();
+
+    std::vector<SoakDevice *> devices;
+    for(int i = 0; i < config.devices; i++) {
+        devices.push_back(new SoakDevice(i, config));
+        devices.back()->begin();
+    }
+
+    auto pump = [&](void) {
+        {
+            // the broker runs in the same process, keep it out of the sites of the devices
+            WEBSOCKETS_ALLOC_SCOPE("soak.broker");
+            broker.loop();
+        }
+        for(SoakDevice * device : devices) {
+            device->loop();
+        }
+    };
+
+    // everything connected before the clock starts
+    unsigned long wait = millis();
+    while(millis() - wait < 10000) {
+        pump();
+        int up = 0;
+        for(SoakDevice * device : devices) {
+            up += device->connected();
+        }
+        if(up == config.devices) {
+            break;
+        }
+    }
+
+    SoakOut out;
+    uint32_t sent          = 0;
+    uint32_t actionsSent   = 0;
+    uint32_t lost          = 0;
+    uint32_t actionsLost   = 0;
+    uint32_t messagesStart = 0;
+    size_t liveStart       = 0;
+    unsigned long start    = millis();
+    if(config.warmup == 0) {
+        WebSocketsAlloc::reset();
+        liveStart = WebSocketsAlloc::live();
+    }
+    printf("%d devices, %lu simulated hours, data every %lu s, action every %lu s, reconnect every %lu s\n", config.devices, config.hours, config.interval, config.action, config.reconnect);
+    printf("%5s %9s %9s %11s %9s %10s %10s %5s\n", "hour", "messages", "allocs", "allocs/msg", "frees", "live B", "peak B", "frag");
+
+    for(uint32_t now = 1; now <= config.hours * 3600; now++) {
+        bool busy = false;
+        for(int i = 0; i < config.devices; i++) {
+            // spread the devices over the interval like their boot times
+            uint32_t t = now + i * 7;
+            if(config.reconnect > 0 && t % config.reconnect == 0) {
+                devices[i]->drop();
+                busy = true;
+            }
+            if(t % config.interval == 0) {
+                sent += devices[i]->sendData(now);
+                busy = true;
+            }
+            if(config.action > 0 && t % config.action == 0 && devices[i]->connected()) {
+                WEBSOCKETS_ALLOC_SCOPE("soak.broker");
+                broker.publish("/topic/action/soak-" + String(i), "{\"reboot\":false,\"ts\":" + String(now) + "}");
+                actionsSent++;
+                busy = true;
+            }
+        }
+
+        // the clock only moves on when everything sent has arrived and the devices are back
+        if(busy) {
+            unsigned long deadline = millis() + 2000;
+            while((long)(millis() - deadline) < 0) {
+                pump();
+                int up = 0;
+                for(SoakDevice * device : devices) {
+                    up += device->connected();
+                }
+                if(received + lost >= sent && acked + actionsLost >= actionsSent && up == config.devices) {
+                    break;
+                }
+            }
+            if(received + lost < sent) {
+                lost = sent - received;
+            }
+            if(acked + actionsLost < actionsSent) {
+                actionsLost = actionsSent - acked;
+            }
+        }
+
+        if(now % 3600 == 0) {
+            uint32_t hour = now / 3600;
+            if(hour == config.warmup) {
+                WebSocketsAlloc::reset();
+                liveStart     = WebSocketsAlloc::live();
+                messagesStart = received + acked;
+            }
+            WebSocketsAlloc::sample();
+            uint32_t messages = received + acked - messagesStart;
+            printf("%5u %9u %9u %11.1f %9u %10zu %10zu %4u%%\n", hour, messages, WebSocketsAlloc::allocs(), messages ? (double)WebSocketsAlloc::allocs() / messages : 0.0, WebSocketsAlloc::frees(), WebSocketsAlloc::live(), WebSocketsAlloc::peak(), WebSocketsAlloc::heap().last.fragmentation);
+            fflush(stdout);
+        }
+    }
+
+    printf("\n%lu simulated hours in %.1f s: data sent %u received %u, actions %u acked %u\n", config.hours, (millis() - start) / 1000.0, sent, received, actionsSent, acked);
+    if(config.hours <= config.warmup) {
+        printf("[alloc] --hours has to be more than --warmup for the counters\n");
+    }
+    WebSocketsAlloc::printTo(out);
+    long growth = (long)WebSocketsAlloc::live() - (long)liveStart;
+    printf("[alloc] live bytes since warm-up %+ld (%.1f B per simulated hour)\n", growth, (config.hours > config.warmup) ? (double)growth / (config.hours - config.warmup) : 0.0);
+
+    for(SoakDevice * device : devices) {
+        delete device;
+    }
+    broker.close();
+    return (lost == 0 && actionsLost == 0) ? 0 : 1;
+}
@@ -0,0 +1,336 @@
+/**
+ * @file socketio.cpp
+ * @date 19.10.2026
+ *
+ * SocketIOclient against a minimal Engine.IO / Socket.IO server on loopback (NETWORK_POSIX)
+ * the server is a WebSocketsServer that answers the polling request of the Engine.IO handshake
+ * with the open packet (sid) and takes the upgrade to WebSocket on the same connection,
+ * after that it plays a fixed script, once with EIO=3 and once with EIO=4:
+ *  - server EVENT with ack id, the client answers with sendACK
+ *  - server BINARY_EVENT in a namespace with two attachments
+ *  - client EVENT with ack, the server answers with ACK
+ *  - client BINARY_EVENT with ack, the server checks the attachment format
+ *    (EIO=3: message type 4 in front, EIO=4: plain) and answers with a BINARY_ACK
+ *  - client EVENT the server does not answer, the ack times out
+ *  - client EVENTs through the send paths of sendJoined: headerToPayload, small (corked)
+ *    and bigger than WEBSOCKETS_CORK_BUFFER_SIZE (copied), the server compares the frames
+ *  - client EVENT the server answers by closing the connection, failAcks calls the ack with NULL
+ *
+ * usage: ws_socketio [--port=n]
+ */
+
+#include <Arduino.h>
+#include <WebSocketsServer.h>
+#include <SocketIOclient.h>
+
+#define SOCKETIO_PORT 18098
+#define SOCKETIO_ACK_TIMEOUT (200)    ///< ack timeout of the unanswered event (ms)
+#define SOCKETIO_WAIT_MS (5000)       ///< max time of one run
+
+static int failures = 0;
+
+static void check(const char * name, bool ok) {
+    printf("  %-4s %s\n", ok ? "ok" : "FAIL", name);
+    if(!ok) {
+        failures++;
+    }
+}
+
+static bool equals(const uint8_t * data, size_t length, const char * text) {
+    return data && length == strlen(text) && memcmp(data, text, length) == 0;
+}
+
+/**
+ * event bigger than the cork buffer
+ */
+static String bigEvent(void) {
+    String event = "[\"big\",\"";
+    while(event.length() < (WEBSOCKETS_CORK_BUFFER_SIZE + 1000)) {
+        event += "0123456789";
+    }
+    event += "\"]";
+    return event;
+}
+
+/**
+ * minimal Engine.IO / Socket.IO server, one client at a time
+ */
+class EngineIOServer : public WebSocketsServer {
+  public:
+    explicit EngineIOServer(uint16_t port)
+        : WebSocketsServer(port) {
+        onEvent(std::bind(&EngineIOServer::handleEvent, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4));
+    }
+
+  protected:
+    bool _eio4 = false;
+    String _binHeader;    ///< text part of a binary packet of the client
+    uint8_t _binExpected = 0;
+    uint8_t _binReceived = 0;
+    bool _binFormatOk    = true;
+    uint8_t _binData[64];    ///< first attachment without the EIO=3 prefix
+    size_t _binLength = 0;
+
+    /**
+     * Engine.IO starts with a polling request, the sid of the open packet is all the client needs
+     */
+    void handleNonWebsocketConnection(WSclient_t * client) override {
+        if(client->cUrl.indexOf("transport=polling") < 0) {
+            WebSocketsServer::handleNonWebsocketConnection(client);
+            return;
+        }
+        const char * body = "0{\"sid\":\"loopback\",\"upgrades\":[\"websocket\"],\"pingInterval\":25000,\"pingTimeout\":20000}\n";
+        char response[256];
+        snprintf(response, sizeof(response),
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: text/plain; charset=UTF-8\r\n"
+            "Content-Length: %u\r\n"
+            "Connection: keep-alive\r\n"
+            "\r\n"
+            "%s",
+            (unsigned)strlen(body), body);
+        // the client sends the upgrade request on the same connection
+        client->tcp->write((const uint8_t *)response, strlen(response));
+    }
+
+    /**
+     * Socket.IO header after the Engine.IO type: type [count '-'] [nsp ','] [id]
+     * @return position of the data
+     */
+    static const char * parseHeader(const char * packet, int * count, int * id) {
+        const char * p = packet + 1;
+        *count         = 0;
+        *id            = -1;
+        if(packet[0] == sIOtype_BINARY_EVENT || packet[0] == sIOtype_BINARY_ACK) {
+            *count = atoi(p);
+            p      = strchr(p, '-');
+            p      = p ? p + 1 : packet + strlen(packet);
+        }
+        if(*p == '/') {
+            const char * end = strchr(p, ',');
+            p                = end ? end + 1 : packet + strlen(packet);
+        }
+        if(isdigit((unsigned char)*p)) {
+            *id = atoi(p);
+            while(isdigit((unsigned char)*p)) {
+                p++;
+            }
+        }
+        return p;
+    }
+
+    void sendAttachment(uint8_t num, const uint8_t * data, size_t length) {
+        uint8_t frame[64];
+        size_t used = 0;
+        if(!_eio4) {
+            frame[used++] = (eIOtype_MESSAGE - '0');
+        }
+        memcpy(&frame[used], data, length);
+        sendBIN(num, frame, used + length);
+    }
+
+    void handleEvent(uint8_t num, WStype_t type, uint8_t * payload, size_t length) {
+        switch(type) {
+            case WStype_CONNECTED:
+                _eio4        = (strstr((char *)payload, "EIO=4") != NULL);
+                _binExpected = 0;
+                break;
+            case WStype_TEXT:
+                handleText(num, (char *)payload);
+                break;
+            case WStype_BIN:
+                if(_binReceived >= _binExpected) {
+                    break;
+                }
+                if(!_eio4) {
+                    _binFormatOk &= (length > 0 && payload[0] == (eIOtype_MESSAGE - '0'));
+                    payload++;
+                    length--;
+                }
+                if(_binReceived == 0) {
+                    _binLength = std::min(length, sizeof(_binData));
+                    memcpy(_binData, payload, _binLength);
+                }
+                if(++_binReceived == _binExpected) {
+                    handleClientEvent(num, _binHeader.c_str());
+                    _binExpected = 0;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    void handleText(uint8_t num, const char * text) {
+        if(strcmp(text, "2probe") == 0) {
+            sendTXT(num, "3probe");
+        } else if(strcmp(text, "2") == 0) {
+            sendTXT(num, "3");
+        } else if(text[0] == eIOtype_MESSAGE) {
+            switch(text[1]) {
+                case sIOtype_CONNECT:
+                    sendTXT(num, _eio4 ? "40{\"sid\":\"loopback\"}" : "40");
+                    sendTXT(num, "421[\"hello\",1]");
+                    break;
+                case sIOtype_ACK:
+                    check("ack of a server event", strcmp(text, "431[\"hi\"]") == 0);
+                    sendTXT(num, "452-/chat,[\"bin\",{\"_placeholder\":true,\"num\":0},{\"_placeholder\":true,\"num\":1}]");
+                    sendAttachment(num, (const uint8_t *)"\x00\x01\x02", 3);
+                    sendAttachment(num, (const uint8_t *)"\xff", 1);
+                    break;
+                case sIOtype_EVENT:
+                    handleClientEvent(num, &text[1]);
+                    break;
+                case sIOtype_BINARY_EVENT: {
+                    int id;
+                    int count;
+                    parseHeader(&text[1], &count, &id);
+                    _binHeader   = &text[1];
+                    _binExpected = count;
+                    _binReceived = 0;
+                    _binFormatOk = true;
+                    _binLength   = 0;
+                } break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    void handleClientEvent(uint8_t num, const char * packet) {
+        int id;
+        int count;
+        const char * data = parseHeader(packet, &count, &id);
+        char answer[128];
+        if(strncmp(data, "[\"echo\"", 7) == 0) {
+            snprintf(answer, sizeof(answer), "43%d%s", id, data);
+            sendTXT(num, answer);
+        } else if(strncmp(data, "[\"upload\"", 9) == 0) {
+            check(_eio4 ? "attachment of the client is plain (EIO=4)" : "attachment of the client starts with 4 (EIO=3)", _binFormatOk && count == 1);
+            // the attachment comes back reversed
+            uint8_t reversed[64];
+            for(size_t i = 0; i < _binLength; i++) {
+                reversed[i] = _binData[_binLength - 1 - i];
+            }
+            snprintf(answer, sizeof(answer), "461-%d[{\"_placeholder\":true,\"num\":0}]", id);
+            sendTXT(num, answer);
+            sendAttachment(num, reversed, _binLength);
+        } else if(strncmp(data, "[\"zero\"", 7) == 0) {
+            check("event sent with headerToPayload", strcmp(packet, "2[\"zero\",\"copy\"]") == 0);
+        } else if(strncmp(data, "[\"small\"", 8) == 0) {
+            check("small event (corked)", strcmp(packet, "2[\"small\",1]") == 0);
+        } else if(strncmp(data, "[\"big\"", 6) == 0) {
+            check("event bigger than the cork buffer (copied)", bigEvent() == data);
+        } else if(strncmp(data, "[\"bye\"", 6) == 0) {
+            disconnect(num);
+        }
+        // "silent" gets no answer
+    }
+};
+
+/**
+ * one connection of SocketIOclient, the checks run in the callbacks one after the other
+ */
+static bool run(EngineIOServer & server, uint16_t port, bool eio4) {
+    SocketIOclient io;
+    bool done         = false;
+    bool byeFailed    = false;
+    unsigned long now = 0;
+
+    printf("EIO=%d\n", eio4 ? 4 : 3);
+
+    io.onEvent([&](socketIOmessageType_t type, uint8_t * payload, size_t length) {
+        const SocketIOpacket_t * packet = io.packet();
+        switch(type) {
+            case sIOtype_CONNECT:
+                io.send(sIOtype_CONNECT, "/");
+                break;
+            case sIOtype_DISCONNECT:
+                check("acks failed before the disconnect event", byeFailed && io.pendingAcks() == 0);
+                done = true;
+                break;
+            case sIOtype_EVENT:
+                check("event of the server with ack id", packet && packet->id == 1 && equals(packet->data, packet->length, "[\"hello\",1]"));
+                if(packet && packet->id >= 0) {
+                    io.sendACK(packet->id, "[\"hi\"]");
+                }
+                break;
+            case sIOtype_BINARY_EVENT: {
+                bool ok = packet && packet->count == 2 && packet->nspLength == 5 && memcmp(packet->nsp, "/chat", 5) == 0;
+                ok      = ok && packet->attachments[0].length == 3 && memcmp(packet->attachments[0].data, "\x00\x01\x02", 3) == 0;
+                ok      = ok && packet->attachments[1].length == 1 && packet->attachments[1].data[0] == 0xFF;
+                check("binary event of the server, namespace and two attachments", ok);
+
+                String echo = "[\"echo\",42]";
+                io.sendEVENT(echo, [&](const SocketIOpacket_t * ack) {
+                    check("ack of a client event", ack && ack->type == sIOtype_ACK && equals(ack->data, ack->length, "[\"echo\",42]"));
+
+                    static const uint8_t blob[]     = { 1, 2, 3, 0, 5 };
+                    SocketIOattachment_t attachment = { blob, sizeof(blob) };
+                    String upload                   = "[\"upload\",{\"_placeholder\":true,\"num\":0}]";
+                    io.sendEVENT(upload, &attachment, 1, [&](const SocketIOpacket_t * binaryAck) {
+                        static const uint8_t reversed[] = { 5, 0, 3, 2, 1 };
+                        bool binaryOk                   = binaryAck && binaryAck->type == sIOtype_BINARY_ACK && binaryAck->count == 1;
+                        binaryOk                        = binaryOk && binaryAck->attachments[0].length == sizeof(reversed) && memcmp(binaryAck->attachments[0].data, reversed, sizeof(reversed)) == 0;
+                        check("binary ack of a binary client event", binaryOk);
+
+                        String silent = "[\"silent\"]";
+                        now           = millis();
+                        io.sendEVENT(
+                            silent, [&](const SocketIOpacket_t * timeoutAck) {
+                                unsigned long elapsed = millis() - now;
+                                check("ack timeout", timeoutAck == NULL && elapsed >= SOCKETIO_ACK_TIMEOUT && elapsed < SOCKETIO_ACK_TIMEOUT + 100);
+
+                                static uint8_t zero[SIO_MAX_HEADER_SIZE + 32];
+                                strcpy((char *)&zero[SIO_MAX_HEADER_SIZE], "[\"zero\",\"copy\"]");
+                                io.sendEVENT(zero, strlen((char *)&zero[SIO_MAX_HEADER_SIZE]), true);
+                                io.sendEVENT("[\"small\",1]");
+                                String big = bigEvent();
+                                io.sendEVENT(big);
+
+                                String bye = "[\"bye\"]";
+                                io.sendEVENT(bye, [&](const SocketIOpacket_t * byeAck) {
+                                    byeFailed = (byeAck == NULL && !done);
+                                });
+                            },
+                            SOCKETIO_ACK_TIMEOUT);
+                    });
+                });
+            } break;
+            default:
+                break;
+        }
+        (void)payload;
+        (void)length;
+    });
+    io.begin("127.0.0.1", port, eio4 ? "/socket.io/?EIO=4" : "/socket.io/?EIO=3");
+
+    unsigned long start = millis();
+    while(!done && millis() - start < SOCKETIO_WAIT_MS) {
+        io.loop();
+        server.loop();
+        delay(1);
+    }
+    if(!done) {
+        check("script finished", false);
+    }
+    return done;
+}
+
+int main(int argc, char ** argv) {
+    uint16_t port = SOCKETIO_PORT;
+    for(int i = 1; i < argc; i++) {
+        if(strncmp(argv[i], "--port=", 7) == 0) {
+            port = atoi(&argv[i][7]);
+        }
+    }
+
+    EngineIOServer server(port);
+    server.begin();
+
+    run(server, port, false);
+    run(server, port, true);
+
+    printf("%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -399,18 +399,15 @@ void Automata::keepWiFiAliveOld()
     }
 }
 
-long regTime = millis();
-long regWait = 30000;
-
 void Automata::loop()
 {
-
+    unsigned long start = micros();
     unsigned long currentMillis = millis();
 
     if (wifiMulti.run() == WL_CONNECTED)
     {
-        // Maintain connections
-        webSocket.loop();
+        // Maintain connections (STOMP heart-beats and CONNECT retries run in stomper.loop)
+        stomper.loop();
 
         ArduinoOTA.handle();
         // Serial.println(isDeviceRegistered);
@@ -418,21 +415,31 @@ void Automata::loop()
         // Handle periodic tasks
         if (currentMillis - previousMillis >= getDelay())
         {
+            // sendData / sendLive of one update go out in a single write
+            webSocket.cork();
             _handleDelay();
+            webSocket.uncork();
             previousMillis = millis(); // prevents drift
         }
 
         // Handle device registration retry
-        if (!isDeviceRegistered && (currentMillis - regTime) >= regWait)
+        if (!isDeviceRegistered && (long)(currentMillis - registerAt) >= 0)
         {
             registerDevice();
-            regTime = currentMillis;
+        }
+
+        // Fleet health without a serial console
+        if (AUTOMATA_METRICS_INTERVAL > 0 && currentMillis - metricsAt >= AUTOMATA_METRICS_INTERVAL)
+        {
+            metricsAt = currentMillis;
+            sendMetrics();
         }
     }
     else
     {
         // Optional: Handle disconnected state (e.g., LED blink or minimal work)
     }
+    WEBSOCKETS_METRIC_RECORD("loop.us", micros() - start);
 }
 
 void Automata::setOTA()
@@ -487,8 +494,30 @@ void Automata::sendAction(JsonDocument doc)
     stomper.sendMessage("/app/action", send(doc));
 }
 
+void Automata::sendMetrics()
+{
+#ifdef WEBSOCKETS_HAS_METRICS
+#ifdef WEBSOCKETS_HAS_ALLOC_PROFILE
+    // allocations per call site, only on the serial console
+    WebSocketsAlloc::sample();
+    WebSocketsAlloc::printTo(Serial);
+#endif
+    if (!isDeviceRegistered || !webSocket.isConnected())
+    {
+        // the histograms keep collecting until the snapshot can be sent
+        return;
+    }
+    JsonDocument doc;
+    if (deserializeJson(doc, WebSocketsMetrics::snapshot()) == DeserializationError::Ok)
+    {
+        stomper.sendMessage("/app/metrics", send(doc));
+    }
+#endif
+}
+
 String Automata::send(JsonDocument doc)
 {
+    WEBSOCKETS_ALLOC_SCOPE("automata.send");
     doc["device_id"] = deviceId;
 
     String output;
@@ -518,19 +547,10 @@ void Automata::addAttribute(String key, String displayName, String unit, String
 }
 void Automata::registerDevice()
 {
-    static uint8_t retryCount = 0;
-    static unsigned long lastAttempt = 0;
-
     // if (isDeviceRegistered)
     //     return;
 
-    unsigned long now = millis();
-    unsigned long backoff = min(60000UL, (1UL << retryCount) * 1000); // max 60s
-
-    // if (retryCount > 0 && now - lastAttempt < backoff)
-    //     return;
-
-    Serial.printf("Registering Device (attempt %d)...\n", retryCount + 1);
+    Serial.printf("Registering Device (attempt %d)...\n", registerRetry.failures() + 1);
 
     StaticJsonDocument<1024> doc;
     doc["name"] = deviceName;
@@ -570,26 +590,24 @@ void Automata::registerDevice()
             deviceId = resp["id"].as<String>();
             preferences.putString("deviceId", deviceId);
             isDeviceRegistered = true;
-            retryCount = 0;
+            registerRetry.reset();
             Serial.println("Device Registered");
             vTaskDelay(200);
             ws();
             // getAutomationsList();
             // getMasterList();
+            return;
         }
     }
-    else
+
+    unsigned long wait = registerRetry.next(millis());
+    registerAt = millis() + wait;
+    Serial.printf("Device registration failed (attempt %d), retry in %lu ms\n", registerRetry.failures(), wait);
+    if (registerRetry.failures() > 8)
     {
-        retryCount++;
-        Serial.printf("Device registration failed (attempt %d)\n", retryCount);
-        if (retryCount > 8)
-        {
-            Serial.println("Max retries reached, rebooting...");
-            // ESP.restart();
-        }
+        Serial.println("Max retries reached, rebooting...");
+        // ESP.restart();
     }
-
-    lastAttempt = now;
 }
 
 int maxRetries = 2;
@@ -606,9 +624,23 @@ bool Automata::sendHttp(const String &output, const String &endpoint, String &re
 
     client.setInsecure();
     // client.setBufferSizes(512, 512);
+    unsigned long start = millis();
+#ifdef WEBSOCKETS_HAS_CAPTURE
+    if (capture)
+    {
+        capture->httpRequest(endpoint, output);
+    }
+#endif
 
     if (!http.begin(client, url)) {
         Serial.println("[HTTP] http.begin() failed");
+        WEBSOCKETS_METRIC_ADD("http.errors", 1);
+#ifdef WEBSOCKETS_HAS_CAPTURE
+        if (capture)
+        {
+            capture->httpResponse(HTTPC_ERROR_CONNECTION_REFUSED, result);
+        }
+#endif
         return false;
     }
 
@@ -625,7 +657,27 @@ bool Automata::sendHttp(const String &output, const String &endpoint, String &re
 
     http.end();
     Serial.printf("[MEM] Free heap after: %u\n", ESP.getFreeHeap());
-    return (httpCode >= 200 && httpCode < 300);
+#ifdef WEBSOCKETS_HAS_CAPTURE
+    if (capture)
+    {
+        capture->httpResponse(httpCode, result);
+    }
+#endif
+
+    bool ok = (httpCode >= 200 && httpCode < 300);
+#ifdef WEBSOCKETS_HAS_METRICS
+    // one histogram per endpoint, looked up by name (rare enough)
+    WebSocketsHistogram *latency = WebSocketsMetrics::histogram(("http." + endpoint + ".ms").c_str());
+    if (latency)
+    {
+        latency->record(millis() - start);
+    }
+#endif
+    if (!ok)
+    {
+        WEBSOCKETS_METRIC_ADD("http.errors", 1);
+    }
+    return ok;
 }
 
 
@@ -711,6 +763,7 @@ Stomp::Stomp_Ack_t freeHandleAction(Stomp::StompCommand cmd)
 
 JsonDocument Automata::parseString(String str)
 {
+    WEBSOCKETS_ALLOC_SCOPE("automata.parseString");
     JsonDocument resp;
     Serial.println("Action Received");
 
@@ -729,12 +782,16 @@ JsonDocument Automata::parseString(String str)
 
 Stomp::Stomp_Ack_t Automata::handleAction(const Stomp::StompCommand cmd)
 {
+    WEBSOCKETS_ALLOC_SCOPE("automata.action");
+    unsigned long start = micros();
     String res = String(cmd.body);
     JsonDocument resp = parseString(res);
+    stomper.trace().mark(Stomp::STOMP_TRACE_DECODE);
     Action action;
     action.data = resp;
 
     _handleAction(action);
+    stomper.trace().mark(Stomp::STOMP_TRACE_HANDLER);
     bool p1 = action.data["reboot"];
     JsonDocument doc;
     JsonDocument doc2;
@@ -746,7 +803,18 @@ Stomp::Stomp_Ack_t Automata::handleAction(const Stomp::StompCommand cmd)
 
     doc["key"] = "actionAck";
     doc["actionAck"] = "Success";
+
+    // us per stage: receive, unframe, parse, parseString, HandleAction, ack
+    uint32_t durations[Stomp::STOMP_TRACE_STAGES];
+    stomper.trace().mark(Stomp::STOMP_TRACE_ACK);
+    stomper.trace().durations(durations);
+    JsonArray trace = doc.createNestedArray("tr");
+    for (int i = 0; i < Stomp::STOMP_TRACE_STAGES; i++)
+    {
+        trace.add(durations[i]);
+    }
     stomper.sendMessage("/app/ackAction", send(doc));
+    WEBSOCKETS_METRIC_RECORD("action.us", micros() - start);
 
     if (p1)
     {
@@ -760,6 +828,16 @@ void Automata::onActionReceived(HandleAction cb)
 {
     _handleAction = cb;
 }
+
+#ifdef WEBSOCKETS_HAS_CAPTURE
+// record the session (WebSocket frames and sendHttp) for extras/replay, NULL stops it
+// File f = SD.open("/session.wscp", FILE_WRITE); static WebSocketsCapture cap(f); cap.begin(); automata.setCapture(&cap);
+void Automata::setCapture(WebSocketsCapture *capture)
+{
+    this->capture = capture;
+    webSocket.setCapture(capture);
+}
+#endif
 void Automata::delayedUpdate(HandleDelay hd)
 {
     _handleDelay = hd;
@@ -21,6 +21,11 @@
 #include "SDWebServer.h" // your SD file manager library
 #endif
 
+#ifndef AUTOMATA_METRICS_INTERVAL
+// snapshot of WebSocketsMetrics sent to /app/metrics (ms), 0 = never
+#define AUTOMATA_METRICS_INTERVAL (60000)
+#endif
+
 class Automata;
 void freeSubscribe(Stomp::StompCommand cmd);
 void freeError(Stomp::StompCommand cmd);
@@ -133,6 +138,9 @@ public:
     void error(const Stomp::StompCommand cmd);
     Stomp::Stomp_Ack_t handleUpdate(const Stomp::StompCommand cmd);
     Stomp::Stomp_Ack_t handleAction(const Stomp::StompCommand cmd);
+#ifdef WEBSOCKETS_HAS_CAPTURE
+    void setCapture(WebSocketsCapture *capture);
+#endif
 #if ENABLE_SD_FILE_SERVER
     void beginSDFileServer(AsyncWebServer *existingServer = nullptr);
 #endif
@@ -155,6 +163,7 @@ private:
     // void parseConditionToArray(const String &automationId, const JsonDocument &resp, JsonArray &automations);
     bool sendHttp(const String& output, const String& endpoint, String &result);
     String send(JsonDocument doc);
+    void sendMetrics();
     JsonDocument parseString(String str);
    
 
@@ -185,6 +194,14 @@ private:
     
     unsigned long previousMillis = millis();
     int d = 60000;
+
+    // registration retries, capped exponential backoff with jitter
+    WebSocketsReconnect registerRetry{1000, 60000, 0};
+    unsigned long registerAt = 0;
+    unsigned long metricsAt = 0;
+#ifdef WEBSOCKETS_HAS_CAPTURE
+    WebSocketsCapture *capture = nullptr;
+#endif
 #if ENABLE_SD_FILE_SERVER
     SDWebServer *sdweb; // pointer so it can be optional
 #endif
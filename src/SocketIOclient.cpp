@@ -13,6 +13,7 @@ SocketIOclient::SocketIOclient() {
 }
 
 SocketIOclient::~SocketIOclient() {
+    clearAttachments();
 }
 
 void SocketIOclient::begin(const char * host, uint16_t port, const char * url, const char * protocol) {
@@ -67,7 +68,8 @@ void SocketIOclient::configureEIOping(bool disableHeartbeat) {
 }
 
 void SocketIOclient::initClient(void) {
-    if(_client.cUrl.indexOf("EIO=4") != -1) {
+    _eio4 = (_client.cUrl.indexOf("EIO=4") != -1);
+    if(_eio4) {
         DEBUG_WEBSOCKETS("[wsIOc] found EIO=4 disable EIO ping on client\n");
         configureEIOping(true);
     }
@@ -93,35 +95,31 @@ void SocketIOclient::setReconnectInterval(unsigned long time) {
     return WebSocketsClient::setReconnectInterval(time);
 }
 
+void SocketIOclient::setReconnectBackoff(unsigned long base, unsigned long max) {
+    return WebSocketsClient::setReconnectBackoff(base, max);
+}
+
 /**
  * send text data to client
  * @param num uint8_t client id
  * @param type socketIOmessageType_t
  * @param payload uint8_t *
  * @param length size_t
- * @param headerToPayload bool (see sendFrame for more details)
+ * @param headerToPayload bool  set true if the payload has reserved SIO_MAX_HEADER_SIZE Byte at the beginning for the headers (payload need to be in RAM!)
  * @return true if ok
  */
 bool SocketIOclient::send(socketIOmessageType_t type, uint8_t * payload, size_t length, bool headerToPayload) {
-    bool ret = false;
     if(length == 0) {
-        length = strlen((const char *)payload);
+        length = strlen((const char *)(payload + (headerToPayload ? SIO_MAX_HEADER_SIZE : 0)));
     }
     if(clientIsConnected(&_client) && _client.status == WSC_CONNECTED) {
         if(!headerToPayload) {
-            // webSocket Header
-            ret = WebSocketsClient::sendFrameHeader(&_client, WSop_text, length + 2, true);
-            // Engine.IO / Socket.IO Header
-            if(ret) {
-                uint8_t buf[3] = { eIOtype_MESSAGE, type, 0x00 };
-                ret            = WebSocketsClient::write(&_client, buf, 2);
-            }
-            if(ret && payload && length > 0) {
-                ret = WebSocketsClient::write(&_client, payload, length);
-            }
-            return ret;
+            return sendPacket(type, -1, payload, length, NULL, 0);
         } else {
-            // TODO implement
+            // Engine.IO / Socket.IO Header right in front of the payload, sendFrame puts the webSocket Header in front of it
+            payload[WEBSOCKETS_MAX_HEADER_SIZE]     = eIOtype_MESSAGE;
+            payload[WEBSOCKETS_MAX_HEADER_SIZE + 1] = type;
+            return WebSocketsClient::sendFrame(&_client, WSop_text, payload, length + 2, true, true);
         }
     }
     return false;
@@ -148,7 +146,7 @@ bool SocketIOclient::send(socketIOmessageType_t type, String & payload) {
  * @param num uint8_t client id
  * @param payload uint8_t *
  * @param length size_t
- * @param headerToPayload bool  (see sendFrame for more details)
+ * @param headerToPayload bool  set true if the payload has reserved SIO_MAX_HEADER_SIZE Byte at the beginning for the headers (payload need to be in RAM!)
  * @return true if ok
  */
 bool SocketIOclient::sendEVENT(uint8_t * payload, size_t length, bool headerToPayload) {
@@ -171,6 +169,195 @@ bool SocketIOclient::sendEVENT(String & payload) {
     return sendEVENT((uint8_t *)payload.c_str(), payload.length());
 }
 
+bool SocketIOclient::sendEVENT(String & payload, SocketIOclientAck cbAck, unsigned long timeout) {
+    return sendEVENT((const uint8_t *)payload.c_str(), payload.length(), NULL, 0, cbAck, timeout);
+}
+
+bool SocketIOclient::sendEVENT(String & payload, const SocketIOattachment_t * attachments, uint8_t count, SocketIOclientAck cbAck, unsigned long timeout) {
+    return sendEVENT((const uint8_t *)payload.c_str(), payload.length(), attachments, count, cbAck, timeout);
+}
+
+/**
+ * send an event with binary attachments and / or an ack callback
+ * the attachments are referenced in the payload as {"_placeholder":true,"num":n}
+ * @param payload const uint8_t *  JSON array ["event", ...]
+ * @param length size_t
+ * @param attachments const SocketIOattachment_t *
+ * @param count uint8_t            number of attachments, > 0 sends a sIOtype_BINARY_EVENT
+ * @param cbAck SocketIOclientAck  called with the answer of the server, NULL = no ack wanted
+ * @param timeout unsigned long    ms until cbAck is called with NULL
+ * @return true if ok, false if not connected or all SIO_ACK_MAX acks are pending
+ */
+bool SocketIOclient::sendEVENT(const uint8_t * payload, size_t length, const SocketIOattachment_t * attachments, uint8_t count, SocketIOclientAck cbAck, unsigned long timeout) {
+    if(length == 0 && payload) {
+        length = strlen((const char *)payload);
+    }
+    socketIOmessageType_t type = (count > 0) ? sIOtype_BINARY_EVENT : sIOtype_EVENT;
+    if(!cbAck) {
+        return sendPacket(type, -1, payload, length, attachments, count);
+    }
+
+    uint8_t slot = 0;
+    while(slot < SIO_ACK_MAX && _ackTimers.pending(slot)) {
+        slot++;
+    }
+    if(slot == SIO_ACK_MAX) {
+        DEBUG_WEBSOCKETS("[wsIOc] no free ack slot (SIO_ACK_MAX %d)\n", SIO_ACK_MAX);
+        return false;
+    }
+
+    uint32_t id = _nextAckId;
+    _nextAckId  = (_nextAckId + 1) & 0x7FFFFFFF;
+    if(!sendPacket(type, id, payload, length, attachments, count)) {
+        return false;
+    }
+    _acks[slot]   = cbAck;
+    _ackIds[slot] = id;
+    _ackTimers.set(slot, millis() + timeout);
+    return true;
+}
+
+bool SocketIOclient::sendEVENT(const char * payload, size_t length, const SocketIOattachment_t * attachments, uint8_t count, SocketIOclientAck cbAck, unsigned long timeout) {
+    return sendEVENT((const uint8_t *)payload, length, attachments, count, cbAck, timeout);
+}
+
+/**
+ * answer an event of the server that asked for an ack (packet()->id >= 0)
+ * @param id uint32_t              packet()->id of the event
+ * @param payload const uint8_t *  JSON array of the arguments, "[]" for none
+ * @param length size_t
+ * @param attachments const SocketIOattachment_t *
+ * @param count uint8_t            > 0 sends a sIOtype_BINARY_ACK
+ * @return true if ok
+ */
+bool SocketIOclient::sendACK(uint32_t id, const uint8_t * payload, size_t length, const SocketIOattachment_t * attachments, uint8_t count) {
+    if(length == 0 && payload) {
+        length = strlen((const char *)payload);
+    }
+    return sendPacket((count > 0) ? sIOtype_BINARY_ACK : sIOtype_ACK, id, payload, length, attachments, count);
+}
+
+bool SocketIOclient::sendACK(uint32_t id, const char * payload, size_t length, const SocketIOattachment_t * attachments, uint8_t count) {
+    return sendACK(id, (const uint8_t *)payload, length, attachments, count);
+}
+
+bool SocketIOclient::sendACK(uint32_t id, String & payload) {
+    return sendACK(id, (const uint8_t *)payload.c_str(), payload.length());
+}
+
+/**
+ * the packet of the running onEvent / ack callback split into its parts
+ * @return NULL outside of the callbacks
+ */
+const SocketIOpacket_t * SocketIOclient::packet(void) {
+    return _packet;
+}
+
+/**
+ * @return events waiting for the ack of the server
+ */
+uint8_t SocketIOclient::pendingAcks(void) {
+    return _ackTimers.count();
+}
+
+/**
+ * append a number as decimal
+ * @return digits written
+ */
+static size_t appendNumber(uint8_t * out, uint32_t value) {
+    uint8_t digits[10];
+    size_t len = 0;
+    do {
+        digits[len++] = '0' + (value % 10);
+        value /= 10;
+    } while(value);
+    for(size_t i = 0; i < len; i++) {
+        out[i] = digits[len - 1 - i];
+    }
+    return len;
+}
+
+/**
+ * send prefix and payload as one frame
+ * up to WEBSOCKETS_CORK_BUFFER_SIZE header, prefix and payload are written one after the other and collected by the cork buffer
+ * bigger frames are copied behind room for the webSocket Header and go out with one write, without the memory for it they are written one after the other
+ * @param opcode WSopcode_t
+ * @param prefix const uint8_t *
+ * @param prefixLength size_t
+ * @param payload const uint8_t *
+ * @param length size_t
+ * @return true if ok
+ */
+bool SocketIOclient::sendJoined(WSopcode_t opcode, const uint8_t * prefix, size_t prefixLength, const uint8_t * payload, size_t length) {
+    size_t total = prefixLength + length;
+    if(total > WEBSOCKETS_CORK_BUFFER_SIZE && GET_FREE_HEAP > (6000 + total)) {
+        uint8_t * buffer = (uint8_t *)malloc(WEBSOCKETS_MAX_HEADER_SIZE + total + 1);
+        if(buffer) {
+            memcpy(&buffer[WEBSOCKETS_MAX_HEADER_SIZE], prefix, prefixLength);
+            if(payload && length > 0) {
+                memcpy(&buffer[WEBSOCKETS_MAX_HEADER_SIZE + prefixLength], payload, length);
+            }
+            buffer[WEBSOCKETS_MAX_HEADER_SIZE + total] = 0x00;
+            bool ret = WebSocketsClient::sendFrame(&_client, opcode, buffer, total, true, true);
+            free(buffer);
+            return ret;
+        }
+    }
+
+    bool ret = WebSocketsClient::sendFrameHeader(&_client, opcode, total, true);
+    if(ret && prefixLength > 0) {
+        ret = (WebSocketsClient::write(&_client, (uint8_t *)prefix, prefixLength) == prefixLength);
+    }
+    if(ret && payload && length > 0) {
+        ret = (WebSocketsClient::write(&_client, (uint8_t *)payload, length) == length);
+    }
+    return ret;
+}
+
+/**
+ * send a Socket.IO packet, the binary attachments follow as own frames
+ * every frame is one write and all are corked, small packets leave together
+ * @param type socketIOmessageType_t
+ * @param id int32_t               ack id, -1 = none
+ * @param payload const uint8_t *
+ * @param length size_t
+ * @param attachments const SocketIOattachment_t *
+ * @param count uint8_t
+ * @return true if ok
+ */
+bool SocketIOclient::sendPacket(socketIOmessageType_t type, int32_t id, const uint8_t * payload, size_t length, const SocketIOattachment_t * attachments, uint8_t count) {
+    if(!clientIsConnected(&_client) || _client.status != WSC_CONNECTED) {
+        return false;
+    }
+    if(count > 0 && !attachments) {
+        return false;
+    }
+
+    // Engine.IO / Socket.IO Header: 4 type [count '-'] [id]
+    uint8_t header[2 + 3 + 1 + 10];
+    size_t headerLength    = 0;
+    header[headerLength++] = eIOtype_MESSAGE;
+    header[headerLength++] = type;
+    if(count > 0) {
+        headerLength += appendNumber(&header[headerLength], count);
+        header[headerLength++] = '-';
+    }
+    if(id >= 0) {
+        headerLength += appendNumber(&header[headerLength], id);
+    }
+
+    WebSockets::cork(&_client);
+    bool ret = sendJoined(WSop_text, header, headerLength, payload, length);
+    for(uint8_t i = 0; ret && i < count; i++) {
+        uint8_t prefix = (eIOtype_MESSAGE - '0');
+        ret            = sendJoined(WSop_binary, &prefix, (_eio4 ? 0 : 1), attachments[i].data, attachments[i].length);
+    }
+    if(!WebSockets::uncork(&_client)) {
+        ret = false;
+    }
+    return ret;
+}
+
 void SocketIOclient::loop(void) {
     WebSocketsClient::loop();
     unsigned long t = millis();
@@ -179,11 +366,187 @@ void SocketIOclient::loop(void) {
         DEBUG_WEBSOCKETS("[wsIOc] send ping\n");
         WebSocketsClient::sendTXT(eIOtype_PING);
     }
+
+    int slot;
+    while((slot = _ackTimers.pop(millis())) >= 0) {
+        DEBUG_WEBSOCKETS("[wsIOc] ack %u timed out\n", _ackIds[slot]);
+        SocketIOclientAck cbAck = _acks[slot];
+        _acks[slot]             = NULL;
+        if(cbAck) {
+            cbAck(NULL);
+        }
+    }
+}
+
+/**
+ * split a Socket.IO packet: type [attachments '-'] [namespace ','] [ack id] data
+ * @param payload uint8_t *  packet starting with the socketIOmessageType_t
+ * @param length size_t
+ * @param packet SocketIOpacket_t *
+ * @return false if it is malformed
+ */
+bool SocketIOclient::parsePacket(uint8_t * payload, size_t length, SocketIOpacket_t * packet) {
+    size_t pos = 1;
+    if(length < 1) {
+        return false;
+    }
+    packet->type        = (socketIOmessageType_t)payload[0];
+    packet->id          = -1;
+    packet->nsp         = NULL;
+    packet->nspLength   = 0;
+    packet->attachments = NULL;
+    packet->count       = 0;
+
+    if(packet->type == sIOtype_BINARY_EVENT || packet->type == sIOtype_BINARY_ACK) {
+        uint32_t count = 0;
+        while(pos < length && isdigit(payload[pos])) {
+            count = count * 10 + (payload[pos++] - '0');
+            if(count > 0xFF) {
+                return false;
+            }
+        }
+        if(pos >= length || payload[pos] != '-') {
+            return false;
+        }
+        pos++;
+        packet->count = count;
+    }
+
+    if(pos < length && payload[pos] == '/') {
+        size_t start = pos;
+        while(pos < length && payload[pos] != ',') {
+            pos++;
+        }
+        packet->nsp       = (const char *)&payload[start];
+        packet->nspLength = pos - start;
+        if(pos < length) {
+            pos++;
+        }
+    }
+
+    if(pos < length && isdigit(payload[pos])) {
+        uint32_t id = 0;
+        while(pos < length && isdigit(payload[pos])) {
+            if(id > (0x7FFFFFFF / 10)) {
+                return false;
+            }
+            id = id * 10 + (payload[pos++] - '0');
+        }
+        packet->id = id;
+    }
+
+    packet->data   = &payload[pos];
+    packet->length = length - pos;
+    return true;
+}
+
+/**
+ * hand a complete packet to the ack callback waiting for it or to onEvent
+ * @param packet SocketIOpacket_t *
+ * @param payload uint8_t *  packet behind the type for onEvent, like it was received
+ * @param length size_t
+ */
+void SocketIOclient::dispatchPacket(SocketIOpacket_t * packet, uint8_t * payload, size_t length) {
+    _packet = packet;
+    if((packet->type == sIOtype_ACK || packet->type == sIOtype_BINARY_ACK) && packet->id >= 0) {
+        for(uint8_t slot = 0; slot < SIO_ACK_MAX; slot++) {
+            if(_ackTimers.pending(slot) && _ackIds[slot] == (uint32_t)packet->id) {
+                SocketIOclientAck cbAck = _acks[slot];
+                _acks[slot]             = NULL;
+                _ackTimers.cancel(slot);
+                if(cbAck) {
+                    cbAck(packet);
+                }
+                _packet = NULL;
+                return;
+            }
+        }
+        DEBUG_WEBSOCKETS("[wsIOc] ack %d is unknown or timed out\n", packet->id);
+    }
+    runIOCbEvent(packet->type, payload, length);
+    _packet = NULL;
+}
+
+/**
+ * a binary frame, the next attachment of _binPacket
+ * @param payload uint8_t *
+ * @param length size_t
+ */
+void SocketIOclient::handleAttachment(uint8_t * payload, size_t length) {
+    if(!_binBuffer) {
+        DEBUG_WEBSOCKETS("[wsIOc] binary frame without a binary packet (%d)\n", length);
+        return;
+    }
+    if(!_eio4) {
+        // EIO=3 sends the Engine.IO type in front of the data, as number not as character
+        if(length < 1 || payload[0] != (eIOtype_MESSAGE - '0')) {
+            DEBUG_WEBSOCKETS("[wsIOc] attachment is no Engine.IO message\n");
+            clearAttachments();
+            return;
+        }
+        payload++;
+        length--;
+    }
+
+    uint8_t * data = (uint8_t *)malloc(length + 1);
+    if(!data) {
+        DEBUG_WEBSOCKETS("[wsIOc] no memory for attachment (%d)\n", length);
+        clearAttachments();
+        return;
+    }
+    memcpy(data, payload, length);
+    data[length] = 0x00;
+
+    _binAttachments[_binReceived].data   = data;
+    _binAttachments[_binReceived].length = length;
+    _binReceived++;
+
+    if(_binReceived == _binPacket.count) {
+        DEBUG_WEBSOCKETS("[wsIOc] binary packet complete (%d attachments)\n", _binReceived);
+        _binPacket.attachments = _binAttachments;
+        dispatchPacket(&_binPacket, &_binBuffer[1], _binLength - 1);
+        clearAttachments();
+    }
+}
+
+/**
+ * drop the binary packet in progress
+ */
+void SocketIOclient::clearAttachments(void) {
+    for(uint8_t i = 0; i < _binReceived; i++) {
+        free((void *)_binAttachments[i].data);
+        _binAttachments[i].data   = NULL;
+        _binAttachments[i].length = 0;
+    }
+    _binReceived = 0;
+    if(_binBuffer) {
+        free(_binBuffer);
+        _binBuffer = NULL;
+    }
+    _binLength = 0;
+}
+
+/**
+ * the connection is gone, no ack will come
+ */
+void SocketIOclient::failAcks(void) {
+    for(uint8_t slot = 0; slot < SIO_ACK_MAX; slot++) {
+        if(_ackTimers.pending(slot)) {
+            SocketIOclientAck cbAck = _acks[slot];
+            _acks[slot]             = NULL;
+            _ackTimers.cancel(slot);
+            if(cbAck) {
+                cbAck(NULL);
+            }
+        }
+    }
 }
 
 void SocketIOclient::handleCbEvent(WStype_t type, uint8_t * payload, size_t length) {
     switch(type) {
         case WStype_DISCONNECTED:
+            clearAttachments();
+            failAcks();
             runIOCbEvent(sIOtype_DISCONNECT, NULL, 0);
             DEBUG_WEBSOCKETS("[wsIOc] Disconnected!\n");
             break;
@@ -217,6 +580,11 @@ void SocketIOclient::handleCbEvent(WStype_t type, uint8_t * payload, size_t leng
                     socketIOmessageType_t ioType = (socketIOmessageType_t)payload[1];
                     uint8_t * data               = &payload[2];
                     size_t lData                 = length - 2;
+                    SocketIOpacket_t packet;
+                    if(!parsePacket(&payload[1], length - 1, &packet)) {
+                        DEBUG_WEBSOCKETS("[wsIOc] malformed packet: %s\n", payload);
+                        break;
+                    }
                     switch(ioType) {
                         case sIOtype_EVENT:
                             DEBUG_WEBSOCKETS("[wsIOc] get event (%d): %s\n", lData, data);
@@ -224,18 +592,40 @@ void SocketIOclient::handleCbEvent(WStype_t type, uint8_t * payload, size_t leng
                         case sIOtype_CONNECT:
                             DEBUG_WEBSOCKETS("[wsIOc] connected (%d): %s\n", lData, data);
                             return;
-                        case sIOtype_DISCONNECT:
                         case sIOtype_ACK:
-                        case sIOtype_ERROR:
+                            DEBUG_WEBSOCKETS("[wsIOc] get ack %d (%d): %s\n", packet.id, lData, data);
+                            break;
                         case sIOtype_BINARY_EVENT:
                         case sIOtype_BINARY_ACK:
+                            DEBUG_WEBSOCKETS("[wsIOc] get binary %s with %d attachments (%d): %s\n", (ioType == sIOtype_BINARY_EVENT) ? "event" : "ack", packet.count, lData, data);
+                            if(packet.count == 0) {
+                                break;
+                            }
+                            clearAttachments();
+                            if(packet.count > SIO_MAX_ATTACHMENTS) {
+                                DEBUG_WEBSOCKETS("[wsIOc] too many attachments (SIO_MAX_ATTACHMENTS %d)\n", SIO_MAX_ATTACHMENTS);
+                                return;
+                            }
+                            // the frame buffer is reused, keep the text until the attachments are there
+                            _binBuffer = (uint8_t *)malloc(length);
+                            if(!_binBuffer) {
+                                DEBUG_WEBSOCKETS("[wsIOc] no memory for binary packet (%d)\n", length);
+                                return;
+                            }
+                            memcpy(_binBuffer, &payload[1], length - 1);
+                            _binBuffer[length - 1] = 0x00;
+                            _binLength             = length - 1;
+                            parsePacket(_binBuffer, _binLength, &_binPacket);
+                            return;
+                        case sIOtype_DISCONNECT:
+                        case sIOtype_ERROR:
                         default:
                             DEBUG_WEBSOCKETS("[wsIOc] Socket.IO Message Type %c (%02X) is not implemented\n", ioType, ioType);
                             DEBUG_WEBSOCKETS("[wsIOc] get text: %s\n", payload);
                             break;
                     }
 
-                    runIOCbEvent(ioType, data, lData);
+                    dispatchPacket(&packet, data, lData);
                 } break;
                 case eIOtype_OPEN:
                 case eIOtype_CLOSE:
@@ -247,8 +637,10 @@ void SocketIOclient::handleCbEvent(WStype_t type, uint8_t * payload, size_t leng
                     break;
             }
         } break;
-        case WStype_ERROR:
         case WStype_BIN:
+            handleAttachment(payload, length);
+            break;
+        case WStype_ERROR:
         case WStype_FRAGMENT_TEXT_START:
         case WStype_FRAGMENT_BIN_START:
         case WStype_FRAGMENT:
@@ -10,12 +10,32 @@
 
 #include "WebSockets.h"
 #include "WebSocketsClient.h"
+#include "WebSocketsTimer.h"
 
 #define EIO_HEARTBEAT_INTERVAL 20000
 
 #define EIO_MAX_HEADER_SIZE (WEBSOCKETS_MAX_HEADER_SIZE + 1)
 #define SIO_MAX_HEADER_SIZE (EIO_MAX_HEADER_SIZE + 1)
 
+// events sent with an ack callback waiting for the answer of the server
+#ifndef SIO_ACK_MAX
+#ifdef WEBSOCKETS_USE_BIG_MEM
+#define SIO_ACK_MAX (16)
+#else
+#define SIO_ACK_MAX (4)
+#endif
+#endif
+
+// default time for the server to answer an event (ms)
+#ifndef SIO_ACK_TIMEOUT
+#define SIO_ACK_TIMEOUT (10000)
+#endif
+
+// binary attachments of a received packet, they are kept in RAM until the last one is there
+#ifndef SIO_MAX_ATTACHMENTS
+#define SIO_MAX_ATTACHMENTS (4)
+#endif
+
 typedef enum {
     eIOtype_OPEN    = '0',    ///< Sent from the server when a new transport is opened (recheck)
     eIOtype_CLOSE   = '1',    ///< Request the close of this transport but does not shutdown the connection itself.
@@ -36,6 +56,25 @@ typedef enum {
     sIOtype_BINARY_ACK   = '6',
 } socketIOmessageType_t;
 
+typedef struct {
+    const uint8_t * data;
+    size_t length;
+} SocketIOattachment_t;
+
+/**
+ * a received event / ack split into its parts, the pointers are valid during the callback
+ */
+typedef struct {
+    socketIOmessageType_t type;
+    int32_t id;                                  ///< ack id, -1 = the sender does not want an ack
+    const char * nsp;                            ///< namespace without the ',', NULL = "/"
+    size_t nspLength;
+    uint8_t * data;                              ///< JSON array, ["event", ...] or the arguments of the ack
+    size_t length;
+    const SocketIOattachment_t * attachments;    ///< binary attachments, {"_placeholder":true,"num":n} in data
+    uint8_t count;
+} SocketIOpacket_t;
+
 class SocketIOclient : protected WebSocketsClient {
   public:
 #ifdef __AVR__
@@ -44,6 +83,15 @@ class SocketIOclient : protected WebSocketsClient {
     typedef std::function<void(socketIOmessageType_t type, uint8_t * payload, size_t length)> SocketIOclientEvent;
 #endif
 
+    /**
+     * answer of the server to sendEVENT(..., cbAck), ack = NULL on timeout or disconnect
+     */
+#ifdef __AVR__
+    typedef void (*SocketIOclientAck)(const SocketIOpacket_t * ack);
+#else
+    typedef std::function<void(const SocketIOpacket_t * ack)> SocketIOclientAck;
+#endif
+
     SocketIOclient(void);
     virtual ~SocketIOclient(void);
 
@@ -69,6 +117,17 @@ class SocketIOclient : protected WebSocketsClient {
     bool sendEVENT(char * payload, size_t length = 0, bool headerToPayload = false);
     bool sendEVENT(const char * payload, size_t length = 0);
     bool sendEVENT(String & payload);
+    bool sendEVENT(String & payload, SocketIOclientAck cbAck, unsigned long timeout = SIO_ACK_TIMEOUT);
+    bool sendEVENT(String & payload, const SocketIOattachment_t * attachments, uint8_t count, SocketIOclientAck cbAck = NULL, unsigned long timeout = SIO_ACK_TIMEOUT);
+    bool sendEVENT(const uint8_t * payload, size_t length, const SocketIOattachment_t * attachments, uint8_t count, SocketIOclientAck cbAck = NULL, unsigned long timeout = SIO_ACK_TIMEOUT);
+    bool sendEVENT(const char * payload, size_t length, const SocketIOattachment_t * attachments, uint8_t count, SocketIOclientAck cbAck = NULL, unsigned long timeout = SIO_ACK_TIMEOUT);
+
+    bool sendACK(uint32_t id, const uint8_t * payload, size_t length = 0, const SocketIOattachment_t * attachments = NULL, uint8_t count = 0);
+    bool sendACK(uint32_t id, const char * payload, size_t length = 0, const SocketIOattachment_t * attachments = NULL, uint8_t count = 0);
+    bool sendACK(uint32_t id, String & payload);
+
+    const SocketIOpacket_t * packet(void);
+    uint8_t pendingAcks(void);
 
     bool send(socketIOmessageType_t type, uint8_t * payload, size_t length = 0, bool headerToPayload = false);
     bool send(socketIOmessageType_t type, const uint8_t * payload, size_t length = 0);
@@ -78,6 +137,7 @@ class SocketIOclient : protected WebSocketsClient {
 
     void setExtraHeaders(const char * extraHeaders = NULL);
     void setReconnectInterval(unsigned long time);
+    void setReconnectBackoff(unsigned long base, unsigned long max = WEBSOCKETS_RECONNECT_MAX_INTERVAL);
 
     void loop(void);
 
@@ -86,7 +146,28 @@ class SocketIOclient : protected WebSocketsClient {
   protected:
     bool _disableHeartbeat  = false;
     uint64_t _lastHeartbeat = 0;
+    bool _eio4              = false;    ///< EIO=4 sends attachments as plain binary frames, EIO=3 puts the message type (4) in front
     SocketIOclientEvent _cbEvent;
+
+    SocketIOclientAck _acks[SIO_ACK_MAX];    ///< callbacks of the pending acks by slot
+    uint32_t _ackIds[SIO_ACK_MAX];
+    WebSocketsTimers<SIO_ACK_MAX> _ackTimers;    ///< timeout per slot, a slot is in use while its timer runs
+    uint32_t _nextAckId = 0;
+
+    SocketIOpacket_t * _packet = NULL;    ///< packet of the running callback
+    SocketIOpacket_t _binPacket;          ///< binary event / ack waiting for its attachments
+    uint8_t * _binBuffer = NULL;          ///< copy of the text part of _binPacket
+    size_t _binLength    = 0;
+    SocketIOattachment_t _binAttachments[SIO_MAX_ATTACHMENTS];
+    uint8_t _binReceived = 0;
+
+    bool sendJoined(WSopcode_t opcode, const uint8_t * prefix, size_t prefixLength, const uint8_t * payload, size_t length);
+    bool sendPacket(socketIOmessageType_t type, int32_t id, const uint8_t * payload, size_t length, const SocketIOattachment_t * attachments, uint8_t count);
+    bool parsePacket(uint8_t * payload, size_t length, SocketIOpacket_t * packet);
+    void dispatchPacket(SocketIOpacket_t * packet, uint8_t * payload, size_t length);
+    void handleAttachment(uint8_t * payload, size_t length);
+    void clearAttachments(void);
+    void failAcks(void);
     virtual void runIOCbEvent(socketIOmessageType_t type, uint8_t * payload, size_t length) {
         if(_cbEvent) {
             _cbEvent(type, payload, length);
@@ -40,6 +40,16 @@ typedef enum {
   DISCONNECTED
 } Stomp_State_t;
 
+/**
+ * The heart-beat and CONNECT timers of a STOMP connection
+ */
+typedef enum {
+  STOMP_TIMER_SEND,
+  STOMP_TIMER_RECEIVE,
+  STOMP_TIMER_CONNECT,
+  STOMP_TIMER_MAX
+} Stomp_Timer_t;
+
 typedef struct {
     String key;
     String value;
@@ -82,7 +92,7 @@ class StompHeaders {
      */
     String getValue(String key) {
 
-      for (uint8_t i = 0; i < _idx; i++) {
+      for (uint8_t i = 0; i < size(); i++) {
         if (_headers[i].key.equals(key)) {
           return _headers[i].value;
         }
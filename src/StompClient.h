@@ -15,8 +15,19 @@
 #define STOMP_MAX_SUBSCRIPTIONS 8
 #endif
 
+// heart-beat offered in CONNECT (ms), both directions
+#ifndef STOMP_HEARTBEAT_INTERVAL
+#define STOMP_HEARTBEAT_INTERVAL 10000
+#endif
+
+// time for the CONNECTED answer to a CONNECT (ms)
+#ifndef STOMP_CONNECT_TIMEOUT
+#define STOMP_CONNECT_TIMEOUT 10000
+#endif
+
 #include "Stomp.h"
 #include "StompCommandParser.h"
+#include "StompTrace.h"
 #include <WebSocketsClient.h>
 
 namespace Stomp
@@ -40,7 +51,8 @@ namespace Stomp
             const int port,
             const char *url,
             const bool sockjs) : _wsClient(wsClient), _host(host), _port(port), _url(url), _sockjs(sockjs), _id(0), _state(DISCONNECTED), _heartbeats(0),
-                                 _connectHandler(0), _disconnectHandler(0), _errorHandler(0), _commandCount(0)
+                                 _connectHandler(0), _disconnectHandler(0), _errorHandler(0), _commandCount(0), _sendInterval(0), _receiveInterval(0),
+                                 _reconnect(1000, WEBSOCKETS_RECONNECT_MAX_INTERVAL, WEBSOCKETS_RECONNECT_STABLE_TIME)
         {
 
             _wsClient.onEvent([this](WStype_t type, uint8_t *payload, size_t length)
@@ -65,12 +77,14 @@ namespace Stomp
             _wsClient.setExtraHeaders();
         }
 
+#if defined(HAS_SSL)
         void beginSSL()
         {
             // connect to websocket
             _wsClient.beginSSL(_host, _port, _socketUrl());
             _wsClient.setExtraHeaders();
         }
+#endif
 
         /**
            Make a new subscription. Number incrementally
@@ -157,12 +171,14 @@ namespace Stomp
 
         void sendMessage(String destination, String message)
         {
+            WEBSOCKETS_ALLOC_SCOPE("stomp.send");
             String lines[4] = {"SEND", "destination:" + destination, "", message};
             _send(lines, 4);
         }
 
         void sendMessageAndHeaders(String destination, String message, StompHeaders headers)
         {
+            WEBSOCKETS_ALLOC_SCOPE("stomp.send");
             String lines[4] = {"SEND", "destination:" + destination, "", message};
             _sendWithHeaders(lines, 4, headers);
         }
@@ -187,6 +203,71 @@ namespace Stomp
             _errorHandler = handler;
         }
 
+        /**
+           Call this in loop() instead of the loop() of the WebSocketsClient.
+           Sends the heart-beats agreed with the server, closes the connection if the server stays silent
+           and repeats a refused CONNECT with backoff
+        */
+        void loop()
+        {
+            _wsClient.loop();
+
+            int timer;
+            while ((timer = _timers.pop(millis())) >= 0)
+            {
+                switch (timer)
+                {
+                case STOMP_TIMER_SEND:
+                    _sendHeartbeat();
+                    break;
+                case STOMP_TIMER_RECEIVE:
+                    // nothing from the server for two heart-beat periods
+                    WEBSOCKETS_METRIC_ADD("stomp.timeouts", 1);
+                    _timers.clear();
+                    _state = DISCONNECTED;
+                    _wsClient.disconnect();
+                    break;
+                case STOMP_TIMER_CONNECT:
+                    if (_state == OPENING)
+                    {
+                        // no CONNECTED in time
+                        _state = DISCONNECTED;
+                        _retryConnect();
+                    }
+                    else if (_state == DISCONNECTED && _wsClient.isConnected())
+                    {
+                        _connectStomp();
+                    }
+                    break;
+                }
+            }
+        }
+
+        /**
+           Stage time stamps of the received messages. While a message handler runs, the application
+           can mark its own stages (STOMP_TRACE_DECODE .. STOMP_TRACE_ACK) and read the durations
+           @return StompTrace& - span of the message in progress and the last handled ones
+        */
+        StompTrace &trace()
+        {
+            return _trace;
+        }
+
+        /**
+           Time until loop() has the next heart-beat or timeout to handle
+           @return long - ms, 0 = now, -1 = nothing scheduled
+        */
+        long nextTimeout()
+        {
+            long own = _timers.next(millis());
+            long ws = _wsClient.nextTimeout();
+            if (own < 0 || (ws >= 0 && ws < own))
+            {
+                return ws;
+            }
+            return own;
+        }
+
     private:
         WebSocketsClient &_wsClient;
         const char *_host;
@@ -208,6 +289,14 @@ namespace Stomp
         uint32_t _heartbeats;
         uint32_t _commandCount;
 
+        WebSocketsTimers<STOMP_TIMER_MAX> _timers;
+        unsigned long _sendInterval;
+        unsigned long _receiveInterval;
+
+        WebSocketsReconnect _reconnect;
+
+        StompTrace _trace;
+
         String _socketUrl()
         {
             String socketUrl = _url;
@@ -224,12 +313,14 @@ namespace Stomp
 
         void _handleWebSocketEvent(WStype_t type, uint8_t *payload, size_t length)
         {
-            Serial.println("Event" + String((char *)payload));
+            WEBSOCKETS_ALLOC_SCOPE("stomp.receive");
+            DEBUG_WEBSOCKETS("[Stomp] event %d: %s\n", type, payload ? (char *)payload : "");
 
             switch (type)
             {
             case WStype_DISCONNECTED:
                 _state = DISCONNECTED;
+                _timers.clear();
                 break;
 
             case WStype_CONNECTED:
@@ -237,12 +328,20 @@ namespace Stomp
                 break;
 
             case WStype_TEXT:
+                _trace.begin(_wsClient.frameStart());
+                _trace.mark(STOMP_TRACE_RECEIVE);
+
+                if (_timers.pending(STOMP_TIMER_RECEIVE))
+                {
+                    _timers.set(STOMP_TIMER_RECEIVE, millis() + _receiveInterval * 2);
+                }
 
                 if (_sockjs)
                 {
                     if (payload[0] == 'h')
                     {
                         _heartbeats++;
+                        WEBSOCKETS_METRIC_ADD("stomp.rx.heartbeat", 1);
                     }
                     else if (payload[0] == 'o')
                     {
@@ -252,16 +351,21 @@ namespace Stomp
                     {
                         String frame = (char *)payload;
                         String text = unframe(frame);
-                        StompCommand command = _stompCommandParser.parse(text);
+                        _trace.mark(STOMP_TRACE_UNFRAME);
+                        StompCommand command = _parse(text);
+                        _trace.mark(STOMP_TRACE_PARSE);
                         _handleCommand(command);
                     }
                 }
                 else
                 {
                     String text = (char *)payload;
-                    StompCommand command = _stompCommandParser.parse(text);
+                    StompCommand command = _parse(text);
+                    _trace.mark(STOMP_TRACE_PARSE);
                     _handleCommand(command);
                 }
+                // only handled messages are kept
+                _trace.cancel();
 
                 break;
 
@@ -270,42 +374,64 @@ namespace Stomp
             }
         }
 
+        StompCommand _parse(const String &text)
+        {
+            WEBSOCKETS_ALLOC_SCOPE("stomp.parse");
+            return _stompCommandParser.parse(text);
+        }
+
         void _connectStomp()
         {
             if (_state != OPENING)
             {
                 _state = OPENING;
-                String msg[3] = {"CONNECT", "accept-version:1.1,1.0", "heart-beat:10000,10000"};
+                String msg[3] = {"CONNECT", "accept-version:1.1,1.0", "heart-beat:" + String(STOMP_HEARTBEAT_INTERVAL) + "," + String(STOMP_HEARTBEAT_INTERVAL)};
                 _send(msg, 3);
+                _timers.set(STOMP_TIMER_CONNECT, millis() + STOMP_CONNECT_TIMEOUT);
             }
         }
 
+        /**
+         * The broker refused or ignored the CONNECT, send it again after the backoff of the reconnect policy
+         */
+        void _retryConnect()
+        {
+            WEBSOCKETS_METRIC_ADD("stomp.reconnects", 1);
+            _timers.set(STOMP_TIMER_CONNECT, millis() + _reconnect.next(millis()));
+        }
+
         void _handleCommand(StompCommand command)
         {
 
             if (command.command.equals("CONNECTED"))
             {
-
+                WEBSOCKETS_METRIC_ADD("stomp.rx.connected", 1);
                 _handleConnected(command);
             }
             else if (command.command.equals("MESSAGE"))
             {
-
+                WEBSOCKETS_METRIC_ADD("stomp.rx.message", 1);
                 _handleMessage(command);
             }
             else if (command.command.equals("RECEIPT"))
             {
-
+                WEBSOCKETS_METRIC_ADD("stomp.rx.receipt", 1);
                 _handleReceipt(command);
             }
             else if (command.command.equals("ERROR"))
             {
-
+                WEBSOCKETS_METRIC_ADD("stomp.rx.error", 1);
                 _handleError(command);
             }
+            else if (command.command.length() == 0)
+            {
+                // heart-beat of the broker
+                WEBSOCKETS_METRIC_ADD("stomp.rx.heartbeat", 1);
+            }
             else
             {
                 // discard unsupported command
+                WEBSOCKETS_METRIC_ADD("stomp.rx.other", 1);
             }
         }
 
@@ -314,6 +440,8 @@ namespace Stomp
             if (_state != CONNECTED)
             {
                 _state = CONNECTED;
+                _reconnect.connected(millis());
+                _startHeartbeat(command.headers.getValue("heart-beat"));
                 if (_connectHandler)
                 {
                     _connectHandler(command);
@@ -342,7 +470,11 @@ namespace Stomp
             if (subscription->messageHandler)
             {
                 StompMessageHandler callback = subscription->messageHandler;
-                Stomp_Ack_t ackType = callback(message);
+                Stomp_Ack_t ackType;
+                {
+                    WEBSOCKETS_ALLOC_SCOPE("stomp.handler");
+                    ackType = callback(message);
+                }
                 switch (ackType)
                 {
                 case ACK:
@@ -357,6 +489,7 @@ namespace Stomp
                 default:
                     break;
                 }
+                _trace.commit();
             }
         }
 
@@ -380,7 +513,13 @@ namespace Stomp
 
         void _handleError(StompCommand command)
         {
+            bool refused = (_state == OPENING);
             _state = DISCONNECTED;
+            _timers.clear();
+            if (refused)
+            {
+                _retryConnect();
+            }
             if (_errorHandler)
             {
                 _errorHandler(command);
@@ -391,8 +530,75 @@ namespace Stomp
             }
         }
 
+        /**
+         * Arm the heart-beat timers with the values of the CONNECTED frame (STOMP 1.1)
+         * @param serverHeartbeat String - "sx,sy" of the server, empty if it does not do heart-beats
+         */
+        void _startHeartbeat(String serverHeartbeat)
+        {
+            int comma = serverHeartbeat.indexOf(',');
+            unsigned long sx = (comma > 0) ? serverHeartbeat.substring(0, comma).toInt() : 0;
+            unsigned long sy = (comma > 0) ? serverHeartbeat.substring(comma + 1).toInt() : 0;
+
+            _sendInterval = (sy > 0) ? std::max((unsigned long)STOMP_HEARTBEAT_INTERVAL, sy) : 0;
+            _receiveInterval = (sx > 0) ? std::max((unsigned long)STOMP_HEARTBEAT_INTERVAL, sx) : 0;
+
+            _timers.clear();
+            if (_sendInterval)
+            {
+                _timers.set(STOMP_TIMER_SEND, millis() + _sendInterval);
+            }
+            if (_receiveInterval)
+            {
+                _timers.set(STOMP_TIMER_RECEIVE, millis() + _receiveInterval * 2);
+            }
+        }
+
+        void _sendHeartbeat()
+        {
+            if (_sockjs)
+            {
+                _wsClient.sendTXT("[\"\\n\"]");
+            }
+            else
+            {
+                _wsClient.sendTXT("\n");
+            }
+            WEBSOCKETS_METRIC_ADD("stomp.tx.heartbeat", 1);
+            _timers.set(STOMP_TIMER_SEND, millis() + _sendInterval);
+        }
+
+        /**
+         * Count a sent frame per command in the metrics registry (WebSocketsMetrics.h)
+         * @param command String - first line of the frame
+         */
+        void _countSent(const String &command)
+        {
+            if (command.equals("SEND"))
+            {
+                WEBSOCKETS_METRIC_ADD("stomp.tx.send", 1);
+            }
+            else if (command.equals("ACK") || command.equals("NACK"))
+            {
+                WEBSOCKETS_METRIC_ADD("stomp.tx.ack", 1);
+            }
+            else if (command.equals("SUBSCRIBE") || command.equals("UNSUBSCRIBE"))
+            {
+                WEBSOCKETS_METRIC_ADD("stomp.tx.subscribe", 1);
+            }
+            else if (command.equals("CONNECT"))
+            {
+                WEBSOCKETS_METRIC_ADD("stomp.tx.connect", 1);
+            }
+            else
+            {
+                WEBSOCKETS_METRIC_ADD("stomp.tx.other", 1);
+            }
+        }
+
         void _send(String lines[], uint8_t nlines)
         {
+            WEBSOCKETS_ALLOC_SCOPE("stomp.send");
 
             String msg = "[\"";
             for (int i = 0; i < nlines; i++)
@@ -404,10 +610,16 @@ namespace Stomp
 
             _wsClient.sendTXT(msg.c_str(), msg.length() + 1);
             _commandCount++;
+            _countSent(lines[0]);
+            if (_timers.pending(STOMP_TIMER_SEND))
+            {
+                _timers.set(STOMP_TIMER_SEND, millis() + _sendInterval);
+            }
         }
 
         void _sendWithHeaders(String lines[], uint8_t nlines, StompHeaders headers)
         {
+            WEBSOCKETS_ALLOC_SCOPE("stomp.send");
 
             String msg = "[\"";
             // Add the command
@@ -428,6 +640,11 @@ namespace Stomp
 
             _wsClient.sendTXT(msg.c_str(), msg.length() + 1);
             _commandCount++;
+            _countSent(lines[0]);
+            if (_timers.pending(STOMP_TIMER_SEND))
+            {
+                _timers.set(STOMP_TIMER_SEND, millis() + _sendInterval);
+            }
         }
 
         String unframe(String frame)
@@ -0,0 +1,152 @@
+/**
+   StompTrace.h
+
+   Time stamps of the stages a received STOMP message passes, from the WebSocket frame
+   to the ack of the application, kept in a small ring for the last messages
+*/
+
+#ifndef STOMP_TRACE_H
+#define STOMP_TRACE_H
+
+#include <Arduino.h>
+
+#ifndef STOMP_TRACE_SIZE
+// messages kept in the ring of StompTrace
+#define STOMP_TRACE_SIZE 16
+#endif
+
+namespace Stomp
+{
+
+    /**
+     * The stages of a received message, in the order they are passed
+     */
+    typedef enum
+    {
+        STOMP_TRACE_RECEIVE, ///< WebSocket frame read, handed to the STOMP client
+        STOMP_TRACE_UNFRAME, ///< SockJS array unpacked
+        STOMP_TRACE_PARSE,   ///< STOMP frame parsed
+        STOMP_TRACE_DECODE,  ///< body decoded by the application (Automata::parseString)
+        STOMP_TRACE_HANDLER, ///< handler of the application returned (HandleAction)
+        STOMP_TRACE_ACK,     ///< answer of the application built, right before it is sent
+        STOMP_TRACE_STAGES
+    } Stomp_TraceStage_t;
+
+    typedef struct
+    {
+        unsigned long start;               ///< micros() when the first byte of the WebSocket frame was read
+        uint32_t at[STOMP_TRACE_STAGES];   ///< us since start
+        uint32_t end;                      ///< us since start when the message was handled completely
+        uint8_t reached;                   ///< bit per stage passed
+    } StompTraceSpan;
+
+    /**
+     * Span of the message in progress and a ring of the last completed ones
+     * Only touched from the loop of the StompClient, so there is no locking
+     */
+    class StompTrace
+    {
+
+    public:
+        StompTrace() : _active(false), _head(0), _count(0) {}
+
+        /**
+         * Start the span of a new message
+         * @param start unsigned long - micros() of the first byte of the frame
+         */
+        void begin(unsigned long start)
+        {
+            memset(&_span, 0, sizeof(_span));
+            _span.start = start;
+            _active = true;
+        }
+
+        /**
+         * Time stamp a stage of the message in progress, ignored if there is none
+         */
+        void mark(Stomp_TraceStage_t stage)
+        {
+            if (_active && stage < STOMP_TRACE_STAGES)
+            {
+                _span.at[stage] = micros() - _span.start;
+                _span.reached |= (1 << stage);
+            }
+        }
+
+        bool active() const
+        {
+            return _active;
+        }
+
+        /**
+         * The message is handled, keep its span in the ring
+         */
+        void commit()
+        {
+            if (!_active)
+            {
+                return;
+            }
+            _span.end = micros() - _span.start;
+            _ring[_head] = _span;
+            _head = (_head + 1) % STOMP_TRACE_SIZE;
+            if (_count < STOMP_TRACE_SIZE)
+            {
+                _count++;
+            }
+            _active = false;
+        }
+
+        /**
+         * Drop the span in progress (not a message, or nobody cares)
+         */
+        void cancel()
+        {
+            _active = false;
+        }
+
+        /**
+         * @return uint8_t - completed spans in the ring
+         */
+        uint8_t count() const
+        {
+            return _count;
+        }
+
+        /**
+         * @param index uint8_t - 0 = the newest completed span
+         */
+        const StompTraceSpan &get(uint8_t index) const
+        {
+            return _ring[(_head + STOMP_TRACE_SIZE - 1 - (index % STOMP_TRACE_SIZE)) % STOMP_TRACE_SIZE];
+        }
+
+        /**
+         * Time spent in each stage of the message in progress, a stage not passed counts 0
+         * @param out uint32_t[STOMP_TRACE_STAGES] - us
+         */
+        void durations(uint32_t *out) const
+        {
+            uint32_t last = 0;
+            for (uint8_t i = 0; i < STOMP_TRACE_STAGES; i++)
+            {
+                out[i] = 0;
+                if (_active && (_span.reached & (1 << i)))
+                {
+                    out[i] = _span.at[i] - last;
+                    last = _span.at[i];
+                }
+            }
+        }
+
+    private:
+        StompTraceSpan _span;
+        bool _active;
+        StompTraceSpan _ring[STOMP_TRACE_SIZE];
+        uint8_t _head;
+        uint8_t _count;
+    };
+
+}
+
+#endif
@@ -28,14 +28,6 @@
 #include <core_esp8266_features.h>
 #endif
 
-extern "C" {
-#ifdef CORE_HAS_LIBB64
-#include <libb64/cencode.h>
-#else
-#include "libb64/cencode_inc.h"
-#endif
-}
-
 #ifdef ESP8266
 #include <Hash.h>
 #elif defined(ESP32)
@@ -59,6 +51,12 @@ extern "C" {
 
 #endif
 
+#ifdef WEBSOCKETS_HAS_DEFLATE
+extern "C" {
+#include "libdeflate/libdeflate.h"
+}
+#endif
+
 /**
  *
  * @param client WSclient_t *  ptr to the client struct
@@ -69,6 +67,12 @@ extern "C" {
 void WebSockets::clientDisconnect(WSclient_t * client, uint16_t code, char * reason, size_t reasonLen) {
     DEBUG_WEBSOCKETS("[WS][%d][handleWebsocket] clientDisconnect code: %u\n", client->num, code);
     if(client->status == WSC_CONNECTED && code) {
+#ifdef WEBSOCKETS_HAS_SERVER_QUEUE
+        if(!client->cIsClient) {
+            // the close frame goes behind the queue, only what has to be finished stays in front of it
+            queueTrim(client);
+        }
+#endif
         if(reason) {
             sendFrame(client, WSop_close, (uint8_t *)reason, reasonLen);
         } else {
@@ -77,6 +81,19 @@ void WebSockets::clientDisconnect(WSclient_t * client, uint16_t code, char * rea
             buffer[1] = (code & 0xFF);
             sendFrame(client, WSop_close, &buffer[0], 2);
         }
+        // the close frame must leave before the connection is dropped
+        if(!flushCork(client)) {
+            return;
+        }
+#ifdef WEBSOCKETS_HAS_SERVER_QUEUE
+        if(!client->cIsClient && client->txQueueLen > 0 && client->tcp && client->tcp->connected()) {
+            // the server does not wait for a slow client, the owner drops it when the queue is written or after WEBSOCKETS_TCP_TIMEOUT
+            client->status    = WSC_CLOSING;
+            client->txClosing = millis();
+            queueWaiting(client);
+            return;
+        }
+#endif
     }
     clientDisconnect(client);
 }
@@ -89,8 +106,9 @@ void WebSockets::clientDisconnect(WSclient_t * client, uint16_t code, char * rea
  * @param mask bool             add dummy mask to the frame (needed for web browser)
  * @param maskkey uint8_t[4]    key used for payload
  * @param fin bool              can be used to send data in more then one frame (set fin on the last frame)
+ * @param rsv1 bool             payload is compressed (permessage-deflate)
  */
-uint8_t WebSockets::createHeader(uint8_t * headerPtr, WSopcode_t opcode, size_t length, bool mask, uint8_t maskKey[4], bool fin) {
+uint8_t WebSockets::createHeader(uint8_t * headerPtr, WSopcode_t opcode, size_t length, bool mask, uint8_t maskKey[4], bool fin, bool rsv1) {
     uint8_t headerSize;
     // calculate header Size
     if(length < 126) {
@@ -112,6 +130,9 @@ uint8_t WebSockets::createHeader(uint8_t * headerPtr, WSopcode_t opcode, size_t
     if(fin) {
         *headerPtr |= bit(7);    ///< set Fin
     }
+    if(rsv1) {
+        *headerPtr |= bit(6);    ///< set RSV1
+    }
     *headerPtr |= opcode;    ///< set opcode
     headerPtr++;
 
@@ -198,6 +219,7 @@ bool WebSockets::sendFrameHeader(WSclient_t * client, WSopcode_t opcode, size_t
  * @return true if ok
  */
 bool WebSockets::sendFrame(WSclient_t * client, WSopcode_t opcode, uint8_t * payload, size_t length, bool fin, bool headerToPayload) {
+    WEBSOCKETS_ALLOC_SCOPE("ws.sendFrame");
     if(client->tcp && !client->tcp->connected()) {
         DEBUG_WEBSOCKETS("[WS][%d][sendFrame] not Connected!?\n", client->num);
         return false;
@@ -208,6 +230,17 @@ bool WebSockets::sendFrame(WSclient_t * client, WSopcode_t opcode, uint8_t * pay
         return false;
     }
 
+    if(client->txStream && (opcode == WSop_text || opcode == WSop_binary)) {
+        DEBUG_WEBSOCKETS("[WS][%d][sendFrame] streamed message in progress!\n", client->num);
+        return false;
+    }
+
+#ifdef WEBSOCKETS_HAS_CAPTURE
+    if(client->capture) {
+        client->capture->frame(false, opcode, fin, (payload ? (payload + (headerToPayload ? WEBSOCKETS_MAX_HEADER_SIZE : 0)) : NULL), length);
+    }
+#endif
+
     DEBUG_WEBSOCKETS("[WS][%d][sendFrame] ------- send message frame -------\n", client->num);
     DEBUG_WEBSOCKETS("[WS][%d][sendFrame] fin: %u opCode: %u mask: %u length: %u headerToPayload: %u\n", client->num, fin, opcode, client->cIsClient, length, headerToPayload);
 
@@ -222,8 +255,31 @@ bool WebSockets::sendFrame(WSclient_t * client, WSopcode_t opcode, uint8_t * pay
     uint8_t * headerPtr;
     uint8_t * payloadPtr = payload;
     bool useInternBuffer = false;
+    bool rsv1            = false;
     bool ret             = true;
 
+#ifdef WEBSOCKETS_HAS_DEFLATE
+    // permessage-deflate, only complete text and binary messages are compressed
+    if(client->cDeflate && fin && (opcode == WSop_text || opcode == WSop_binary) && payload && (length >= WEBSOCKETS_DEFLATE_MIN_SIZE) && (GET_FREE_HEAP > (6000 + length))) {
+        uint8_t * dataPtr = (uint8_t *)malloc(length + WEBSOCKETS_MAX_HEADER_SIZE);
+        if(dataPtr) {
+            uint8_t * plain = (payload + (headerToPayload ? WEBSOCKETS_MAX_HEADER_SIZE : 0));
+            // the compressed data has to be smaller then the original
+            size_t compressedLen = raw_deflate(plain, length, (dataPtr + WEBSOCKETS_MAX_HEADER_SIZE), (length - 1), client->cDeflateTxBits);
+            if(compressedLen > 0) {
+                DEBUG_WEBSOCKETS("[WS][%d][sendFrame] deflate %u -> %u\n", client->num, length, compressedLen);
+                length          = compressedLen;
+                headerToPayload = true;
+                useInternBuffer = true;
+                rsv1            = true;
+                payloadPtr      = dataPtr;
+            } else {
+                free(dataPtr);
+            }
+        }
+    }
+#endif
+
     // calculate header Size
     if(length < 126) {
         headerSize = 2;
@@ -268,7 +324,7 @@ bool WebSockets::sendFrame(WSclient_t * client, WSopcode_t opcode, uint8_t * pay
         }
     }
 
-    createHeader(headerPtr, opcode, length, client->cIsClient, maskKey, fin);
+    createHeader(headerPtr, opcode, length, client->cIsClient, maskKey, fin, rsv1);
 
     if(client->cIsClient && useInternBuffer) {
         uint8_t * dataMaskPtr;
@@ -288,6 +344,17 @@ bool WebSockets::sendFrame(WSclient_t * client, WSopcode_t opcode, uint8_t * pay
     unsigned long start = micros();
 #endif
 
+#ifdef WEBSOCKETS_HAS_SERVER_QUEUE
+    if(!client->cIsClient && (client->txCork == 0 || client->txQueueLen > 0 || (headerSize + length) >= WEBSOCKETS_CORK_BUFFER_SIZE)) {
+        // the frame is queued as one message if the TCP buffer is full, the queue policy may drop it
+        bool whole = (fin && opcode != WSop_continuation && opcode != WSop_close);
+        if(headerToPayload) {
+            ret = queueWrite(client, opcode, whole, headerPtr, (headerSize + length));
+        } else {
+            ret = queueWrite(client, opcode, whole, headerPtr, headerSize, payloadPtr, length);
+        }
+    } else
+#endif
     if(headerToPayload) {
         // header has be added to payload
         // payload is forced to reserved 14 Byte but we may not need all based on the length and mask settings
@@ -311,6 +378,11 @@ bool WebSockets::sendFrame(WSclient_t * client, WSopcode_t opcode, uint8_t * pay
 
     DEBUG_WEBSOCKETS("[WS][%d][sendFrame] sending Frame Done (%luus).\n", client->num, (micros() - start));
 
+    if(ret) {
+        WEBSOCKETS_METRIC_ADD("ws.tx.frames", 1);
+        WEBSOCKETS_METRIC_ADD("ws.tx.bytes", length);
+    }
+
 #ifdef WEBSOCKETS_USE_BIG_MEM
     if(useInternBuffer && payloadPtr) {
         free(payloadPtr);
@@ -320,6 +392,368 @@ bool WebSockets::sendFrame(WSclient_t * client, WSopcode_t opcode, uint8_t * pay
     return ret;
 }
 
+/**
+ * write a frame encoded by frameCreate / frameDeflate (server side only, no masking)
+ * @param client WSclient_t *   ptr to the client struct
+ * @param frame WSframe_t *
+ * @return true if ok
+ */
+bool WebSockets::sendFrame(WSclient_t * client, WSframe_t * frame) {
+    if(client->tcp && !client->tcp->connected()) {
+        DEBUG_WEBSOCKETS("[WS][%d][sendFrame] not Connected!?\n", client->num);
+        return false;
+    }
+
+    if(client->status != WSC_CONNECTED) {
+        DEBUG_WEBSOCKETS("[WS][%d][sendFrame] not in WSC_CONNECTED state!?\n", client->num);
+        return false;
+    }
+
+    if(client->cIsClient) {
+        DEBUG_WEBSOCKETS("[WS][%d][sendFrame] shared frames are not masked!\n", client->num);
+        return false;
+    }
+
+    if(client->txStream && (frame->opcode == WSop_text || frame->opcode == WSop_binary)) {
+        DEBUG_WEBSOCKETS("[WS][%d][sendFrame] streamed message in progress!\n", client->num);
+        return false;
+    }
+
+    if(write(client, frame->data, frame->length) != frame->length) {
+        return false;
+    }
+
+#ifdef WEBSOCKETS_HAS_METRICS
+    // payload bytes, the length of the header is in the second byte
+    uint8_t len7 = (frame->data[1] & 0x7F);
+    WEBSOCKETS_METRIC_ADD("ws.tx.frames", 1);
+    WEBSOCKETS_METRIC_ADD("ws.tx.bytes", frame->length - (len7 == 127 ? 10 : (len7 == 126 ? 4 : 2)));
+#endif
+    return true;
+}
+
+/**
+ * encode a frame once, so the same bytes can be written to several clients
+ * @param opcode WSopcode_t
+ * @param payload const uint8_t *
+ * @param length size_t
+ * @param fin bool
+ * @return frame with one reference, NULL if there is no memory
+ */
+WSframe_t * WebSockets::frameCreate(WSopcode_t opcode, const uint8_t * payload, size_t length, bool fin) {
+    uint8_t maskKey[4]                         = { 0x00, 0x00, 0x00, 0x00 };
+    uint8_t buffer[WEBSOCKETS_MAX_HEADER_SIZE] = { 0 };
+
+    uint8_t headerSize = createHeader(&buffer[0], opcode, length, false, maskKey, fin);
+
+    WSframe_t * frame = (WSframe_t *)malloc(sizeof(WSframe_t) + headerSize + length);
+    if(!frame) {
+        DEBUG_WEBSOCKETS("[WS][frameCreate] no memory (%u)!\n", length);
+        return NULL;
+    }
+    frame->refs   = 1;
+    frame->opcode = opcode;
+    frame->whole  = fin;
+    frame->length = headerSize + length;
+    frame->data   = (uint8_t *)(frame + 1);
+
+    memcpy(frame->data, &buffer[0], headerSize);
+    if(payload && length > 0) {
+        memcpy((frame->data + headerSize), payload, length);
+    }
+    return frame;
+}
+
+#ifdef WEBSOCKETS_HAS_DEFLATE
+/**
+ * like frameCreate but the payload is compressed (permessage-deflate, no context takeover)
+ * @param windowBits uint8_t  cDeflateTxBits of the receivers
+ * @return frame with one reference, NULL if the data does not get smaller or there is no memory
+ */
+WSframe_t * WebSockets::frameDeflate(WSopcode_t opcode, const uint8_t * payload, size_t length, uint8_t windowBits) {
+    if(!payload || length < WEBSOCKETS_DEFLATE_MIN_SIZE || (GET_FREE_HEAP < (6000 + length))) {
+        return NULL;
+    }
+
+    WSframe_t * frame = (WSframe_t *)malloc(sizeof(WSframe_t) + WEBSOCKETS_MAX_HEADER_SIZE + length);
+    if(!frame) {
+        return NULL;
+    }
+    uint8_t * dataPtr = (uint8_t *)(frame + 1);
+
+    // the compressed data has to be smaller then the original
+    size_t compressedLen = raw_deflate(payload, length, (dataPtr + WEBSOCKETS_MAX_HEADER_SIZE), (length - 1), windowBits);
+    if(compressedLen == 0) {
+        free(frame);
+        return NULL;
+    }
+    DEBUG_WEBSOCKETS("[WS][frameDeflate] deflate %u -> %u\n", length, compressedLen);
+
+    uint8_t maskKey[4] = { 0x00, 0x00, 0x00, 0x00 };
+    uint8_t headerSize = createHeader(&dataPtr[0], opcode, compressedLen, false, maskKey, true, true);
+
+    // move the header in front of the compressed data
+    memmove((dataPtr + WEBSOCKETS_MAX_HEADER_SIZE - headerSize), dataPtr, headerSize);
+
+    frame->refs   = 1;
+    frame->opcode = opcode;
+    frame->whole  = true;
+    frame->length = headerSize + compressedLen;
+    frame->data   = (dataPtr + WEBSOCKETS_MAX_HEADER_SIZE - headerSize);
+    return frame;
+}
+#endif
+
+/**
+ * take a reference of a shared frame
+ * @param frame WSframe_t *
+ * @return frame
+ */
+WSframe_t * WebSockets::frameRetain(WSframe_t * frame) {
+    if(frame) {
+        frame->refs++;
+    }
+    return frame;
+}
+
+/**
+ * drop a reference, the frame is freed with the last one
+ * @param frame WSframe_t *
+ */
+void WebSockets::frameRelease(WSframe_t * frame) {
+    if(frame && --frame->refs == 0) {
+        free(frame);
+    }
+}
+
+#ifdef WEBSOCKETS_HAS_SERVER_QUEUE
+/**
+ * queue a shared frame for a server client, written as far as the TCP buffer allows
+ * @param client WSclient_t *   ptr to the client struct
+ * @param frame WSframe_t *     a reference is taken if the frame is queued
+ * @return true if the frame is written or queued
+ */
+bool WebSockets::queueFrame(WSclient_t * client, WSframe_t * frame) {
+    if(client->status != WSC_CONNECTED || !client->tcp || !client->tcp->connected()) {
+        return false;
+    }
+
+    if(client->txStream && (frame->opcode == WSop_text || frame->opcode == WSop_binary)) {
+        DEBUG_WEBSOCKETS("[WS][%d][queueFrame] streamed message in progress!\n", client->num);
+        return false;
+    }
+
+    // corked data goes first (ends up in the queue if the TCP buffer is full)
+    if(client->txBufferLen > 0 && !flushCork(client)) {
+        return false;
+    }
+
+    queueDrain(client);
+
+    if(client->txQueueLen == 0) {
+        size_t sent = writeAvailable(client, frame->data, frame->length);
+        if(sent == frame->length) {
+            return true;
+        }
+        client->txQueueSent = sent;
+    }
+    return queuePush(client, frameRetain(frame));
+}
+
+/**
+ * write the queued frames until the TCP buffer is full, never blocks
+ * @param client WSclient_t *   ptr to the client struct
+ */
+void WebSockets::queueDrain(WSclient_t * client) {
+    while(client->txQueueLen > 0) {
+        WSframe_t * frame = client->txQueue[client->txQueueHead].frame;
+        size_t sent       = writeAvailable(client, (frame->data + client->txQueueSent), (frame->length - client->txQueueSent));
+        client->txQueueSent += sent;
+        if(client->txQueueSent < frame->length) {
+            return;
+        }
+        client->txQueueSent = 0;
+        queuePop(client, 0);
+    }
+}
+
+/**
+ * drop the queued messages not started yet, the partial writes stay (they continue the byte stream)
+ * @param client WSclient_t *   ptr to the client struct
+ */
+void WebSockets::queueTrim(WSclient_t * client) {
+    uint8_t i = (client->txQueueSent > 0 ? 1 : 0);
+    while(i < client->txQueueLen) {
+        if(client->txQueue[(client->txQueueHead + i) % WEBSOCKETS_SERVER_QUEUE_SIZE].frame->whole) {
+            client->txQueueDropped++;
+            queuePop(client, i);
+        } else {
+            i++;
+        }
+    }
+}
+
+/**
+ * drop all queued frames (disconnect)
+ * @param client WSclient_t *   ptr to the client struct
+ */
+void WebSockets::queueRelease(WSclient_t * client) {
+    while(client->txQueueLen > 0) {
+        queuePop(client, 0);
+    }
+    client->txQueueHead = 0;
+    client->txQueueSent = 0;
+}
+
+/**
+ * write only what fits into the TCP buffer
+ * @return bytes written
+ */
+size_t WebSockets::writeAvailable(WSclient_t * client, uint8_t * out, size_t n) {
+    if(!client->tcp || !client->tcp->connected()) {
+        return 0;
+    }
+    int space = client->tcp->availableForWrite();
+    if(space <= 0 || n == 0) {
+        return 0;
+    }
+    size_t sent = client->tcp->write((const uint8_t *)out, std::min((size_t)space, n));
+    if(!client->tcp->connected()) {
+        connectionLost(client);
+    }
+    return sent;
+}
+
+/**
+ * write a frame as far as the TCP buffer allows and queue the rest
+ * a frame queued before any byte of it went out stays a whole message, else the rest continues the byte stream
+ * @param client WSclient_t *   ptr to the client struct
+ * @param opcode WSopcode_t     opcode of the frame
+ * @param whole bool            complete message, may be dropped by the queue policy
+ * @param header uint8_t *      encoded header (or the whole frame)
+ * @param headerLen size_t
+ * @param payload uint8_t *     payload if it does not follow the header
+ * @param length size_t
+ * @return true if the frame is written or queued
+ */
+bool WebSockets::queueWrite(WSclient_t * client, WSopcode_t opcode, bool whole, uint8_t * header, size_t headerLen, uint8_t * payload, size_t length) {
+    // corked data goes first (ends up in the queue if the TCP buffer is full)
+    if(client->txBufferLen > 0 && !flushCork(client)) {
+        return false;
+    }
+
+    queueDrain(client);
+
+    size_t sent = 0;
+    if(client->txQueueLen == 0) {
+        sent = writeAvailable(client, header, headerLen);
+        if(sent == headerLen && payload && length > 0) {
+            sent += writeAvailable(client, payload, length);
+        }
+        if(sent == (headerLen + length)) {
+            return true;
+        }
+    }
+    if(!client->tcp || !client->tcp->connected()) {
+        return false;
+    }
+
+    size_t rest       = (headerLen + length - sent);
+    WSframe_t * frame = (WSframe_t *)malloc(sizeof(WSframe_t) + rest);
+    if(!frame) {
+        DEBUG_WEBSOCKETS("[WS][%d][queueWrite] no memory for send queue, disconnect\n", client->num);
+        queueRelease(client);
+        client->tcp->stop();
+        connectionLost(client);
+        return false;
+    }
+    frame->refs   = 1;
+    frame->opcode = opcode;
+    frame->whole  = (whole && sent == 0);
+    frame->length = rest;
+    frame->data   = (uint8_t *)(frame + 1);
+    if(sent < headerLen) {
+        memcpy(frame->data, (header + sent), (headerLen - sent));
+        if(payload && length > 0) {
+            memcpy((frame->data + headerLen - sent), payload, length);
+        }
+    } else {
+        memcpy(frame->data, (payload + (sent - headerLen)), rest);
+    }
+    return queuePush(client, frame);
+}
+
+/**
+ * append a frame to the queue, the reference is owned by the queue
+ * a full queue is handled by client->txQueuePolicy, partial frames (whole == false) can not be dropped
+ * @return false if the frame is not queued (released)
+ */
+bool WebSockets::queuePush(WSclient_t * client, WSframe_t * frame) {
+    if(client->txQueueLen >= WEBSOCKETS_SERVER_QUEUE_SIZE) {
+        uint8_t drop = WEBSOCKETS_SERVER_QUEUE_SIZE;
+        if(client->txQueuePolicy != WSQ_DISCONNECT && !(client->txQueuePolicy == WSQ_DROP_NEWEST && frame->whole)) {
+            // oldest message not started yet
+            for(uint8_t i = (client->txQueueSent > 0 ? 1 : 0); i < client->txQueueLen; i++) {
+                if(client->txQueue[(client->txQueueHead + i) % WEBSOCKETS_SERVER_QUEUE_SIZE].frame->whole) {
+                    drop = i;
+                    break;
+                }
+            }
+        }
+
+        if(drop < WEBSOCKETS_SERVER_QUEUE_SIZE) {
+            DEBUG_WEBSOCKETS("[WS][%d][queuePush] queue full, oldest message dropped\n", client->num);
+            client->txQueueDropped++;
+            queuePop(client, drop);
+        } else if(frame->whole && client->txQueuePolicy != WSQ_DISCONNECT) {
+            DEBUG_WEBSOCKETS("[WS][%d][queuePush] queue full, message dropped\n", client->num);
+            client->txQueueDropped++;
+            frameRelease(frame);
+            return false;
+        } else {
+            // the byte stream can not be continued
+            DEBUG_WEBSOCKETS("[WS][%d][queuePush] queue full, disconnect slow client\n", client->num);
+            frameRelease(frame);
+            queueRelease(client);
+            client->tcp->stop();
+            connectionLost(client);
+            return false;
+        }
+    }
+
+    WSqueueEntry_t * entry = &client->txQueue[(client->txQueueHead + client->txQueueLen) % WEBSOCKETS_SERVER_QUEUE_SIZE];
+    entry->frame           = frame;
+    entry->queued          = millis();
+    client->txQueueLen++;
+    if(client->txQueueLen > client->txQueuePeak) {
+        client->txQueuePeak = client->txQueueLen;
+    }
+    if(client->txQueueLen == 1) {
+        queueWaiting(client);
+    }
+    return true;
+}
+
+/**
+ * remove entry index (0 = oldest) from the queue
+ */
+void WebSockets::queuePop(WSclient_t * client, uint8_t index) {
+    uint8_t pos = (client->txQueueHead + index) % WEBSOCKETS_SERVER_QUEUE_SIZE;
+    frameRelease(client->txQueue[pos].frame);
+    if(index == 0) {
+        client->txQueueHead = (client->txQueueHead + 1) % WEBSOCKETS_SERVER_QUEUE_SIZE;
+    } else {
+        // close the gap
+        for(uint8_t i = index; i < (client->txQueueLen - 1); i++) {
+            uint8_t next         = (pos + 1) % WEBSOCKETS_SERVER_QUEUE_SIZE;
+            client->txQueue[pos] = client->txQueue[next];
+            pos                  = next;
+        }
+    }
+    client->txQueueLen--;
+}
+#endif
+
 /**
  * callen when HTTP header is done
  * @param client WSclient_t *  ptr to the client struct
@@ -339,7 +773,9 @@ void WebSockets::headerDone(WSclient_t * client) {
  * @param client WSclient_t *  ptr to the client struct
  */
 void WebSockets::handleWebsocket(WSclient_t * client) {
+    WEBSOCKETS_ALLOC_SCOPE("ws.receive");
     if(client->cWsRXsize == 0) {
+        client->rxFrameStart = micros();
         handleWebsocketCb(client);
     }
 }
@@ -441,6 +877,20 @@ void WebSockets::handleWebsocketCb(WSclient_t * client) {
         return;
     }
 
+    if(header->rsv1) {
+        // only the first frame of a compressed text / binary message has RSV1 set
+#ifdef WEBSOCKETS_HAS_DEFLATE
+        bool compressed = (client->cDeflate && (header->opCode == WSop_text || header->opCode == WSop_binary));
+#else
+        bool compressed = false;
+#endif
+        if(!compressed) {
+            DEBUG_WEBSOCKETS("[WS][%d][handleWebsocket] RSV1 set but permessage-deflate is not negotiated!\n", client->num);
+            clientDisconnect(client, 1002);
+            return;
+        }
+    }
+
     if(header->mask) {
         headerLen += 4;
         if(!handleWebsocketWaitFor(client, headerLen)) {
@@ -451,8 +901,8 @@ void WebSockets::handleWebsocketCb(WSclient_t * client) {
     }
 
     if(header->payloadLen > 0) {
-        // if text data we need one more
-        payload = (uint8_t *)malloc(header->payloadLen + 1);
+        // if text data we need one more (compressed data 4 more for the deflate tail)
+        payload = (uint8_t *)malloc(header->payloadLen + (header->rsv1 ? 5 : 1));
 
         if(!payload) {
             DEBUG_WEBSOCKETS("[WS][%d][handleWebsocket] to less memory to handle payload %d!\n", client->num, header->payloadLen);
@@ -468,6 +918,9 @@ void WebSockets::handleWebsocketCb(WSclient_t * client) {
 void WebSockets::handleWebsocketPayloadCb(WSclient_t * client, bool ok, uint8_t * payload) {
     WSMessageHeader_t * header = &client->cWsHeaderDecode;
     if(ok) {
+        WEBSOCKETS_METRIC_ADD("ws.rx.frames", 1);
+        WEBSOCKETS_METRIC_ADD("ws.rx.bytes", header->payloadLen);
+
         if(header->payloadLen > 0) {
             payload[header->payloadLen] = 0x00;
 
@@ -479,6 +932,26 @@ void WebSockets::handleWebsocketPayloadCb(WSclient_t * client, bool ok, uint8_t
             }
         }
 
+#ifdef WEBSOCKETS_HAS_DEFLATE
+        if(header->rsv1 || (client->rxFragment && header->opCode == WSop_continuation)) {
+            // payload is replaced by the inflated message
+            if(!deflateFrame(client, header, &payload)) {
+                // message not complete yet or connection closed
+                client->cWsRXsize = 0;
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
+                handleWebsocketWaitFor(client, 2);
+#endif
+                return;
+            }
+        }
+#endif
+
+#ifdef WEBSOCKETS_HAS_CAPTURE
+        if(client->capture) {
+            client->capture->frame(true, header->opCode, header->fin, payload, header->payloadLen);
+        }
+#endif
+
         switch(header->opCode) {
             case WSop_text:
                 DEBUG_WEBSOCKETS("[WS][%d][handleWebsocket] text: %s\n", client->num, payload);
@@ -538,29 +1011,90 @@ void WebSockets::handleWebsocketPayloadCb(WSclient_t * client, bool ok, uint8_t
 }
 
 /**
- * generate the key for Sec-WebSocket-Accept
- * @param clientKey String
- * @return String Accept Key
+ * generate the key for Sec-WebSocket-Accept without heap usage
+ * @param clientKey const char *   Sec-WebSocket-Key
+ * @param keyLen size_t
+ * @param out char *                WEBSOCKETS_ACCEPT_KEY_LENGTH + 1 byte
+ * @return true if ok
  */
-String WebSockets::acceptKey(String & clientKey) {
-    uint8_t sha1HashBin[20] = { 0 };
+bool WebSockets::acceptKey(const char * clientKey, size_t keyLen, char * out) {
+    static const char guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    uint8_t sha1HashBin[20]  = { 0 };
+
+    out[0] = 0x00;
+    if(!clientKey || keyLen > WEBSOCKETS_MAX_KEY_LENGTH) {
+        return false;
+    }
+
+#if defined(ESP8266) || defined(ESP32)
+    uint8_t data[WEBSOCKETS_MAX_KEY_LENGTH + sizeof(guid)];
+    memcpy(&data[0], clientKey, keyLen);
+    memcpy(&data[keyLen], guid, sizeof(guid) - 1);
 #ifdef ESP8266
-    sha1(clientKey + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11", &sha1HashBin[0]);
-#elif defined(ESP32)
-    String data = clientKey + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
-    esp_sha(SHA1, (unsigned char *)data.c_str(), data.length(), &sha1HashBin[0]);
+    sha1(&data[0], keyLen + sizeof(guid) - 1, &sha1HashBin[0]);
+#else
+    esp_sha(SHA1, &data[0], keyLen + sizeof(guid) - 1, &sha1HashBin[0]);
+#endif
 #else
-    clientKey += "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
     SHA1_CTX ctx;
     SHA1Init(&ctx);
-    SHA1Update(&ctx, (const unsigned char *)clientKey.c_str(), clientKey.length());
+    SHA1Update(&ctx, (const unsigned char *)clientKey, keyLen);
+    SHA1Update(&ctx, (const unsigned char *)guid, sizeof(guid) - 1);
     SHA1Final(&sha1HashBin[0], &ctx);
 #endif
 
-    String key = base64_encode(sha1HashBin, 20);
-    key.trim();
+    return (base64_encode(sha1HashBin, sizeof(sha1HashBin), out, WEBSOCKETS_ACCEPT_KEY_LENGTH + 1) == WEBSOCKETS_ACCEPT_KEY_LENGTH);
+}
+
+/**
+ * generate the key for Sec-WebSocket-Accept
+ * @param clientKey String
+ * @return String Accept Key
+ */
+String WebSockets::acceptKey(String & clientKey) {
+    char key[WEBSOCKETS_ACCEPT_KEY_LENGTH + 1];
+    acceptKey(clientKey.c_str(), clientKey.length(), key);
+    return String(key);
+}
+
+/**
+ * base64_encode into a fixed buffer (no line breaks)
+ * @param data const uint8_t *
+ * @param length size_t
+ * @param out char *            needs WEBSOCKETS_BASE64_LENGTH(length) + 1 byte
+ * @param outSize size_t
+ * @return length of the encoded data, 0 if out is too small
+ */
+size_t WebSockets::base64_encode(const uint8_t * data, size_t length, char * out, size_t outSize) {
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
-    return key;
+    size_t len = WEBSOCKETS_BASE64_LENGTH(length);
+    if(!out || outSize <= len) {
+        return 0;
+    }
+
+    char * p = out;
+    while(length >= 3) {
+        uint32_t v = ((uint32_t)data[0] << 16) | ((uint32_t)data[1] << 8) | data[2];
+        *p++       = table[(v >> 18) & 0x3F];
+        *p++       = table[(v >> 12) & 0x3F];
+        *p++       = table[(v >> 6) & 0x3F];
+        *p++       = table[v & 0x3F];
+        data += 3;
+        length -= 3;
+    }
+    if(length > 0) {
+        uint32_t v = ((uint32_t)data[0] << 16);
+        if(length > 1) {
+            v |= ((uint32_t)data[1] << 8);
+        }
+        *p++ = table[(v >> 18) & 0x3F];
+        *p++ = table[(v >> 12) & 0x3F];
+        *p++ = (length > 1) ? table[(v >> 6) & 0x3F] : '=';
+        *p++ = '=';
+    }
+    *p = 0x00;
+    return len;
 }
 
 /**
@@ -570,14 +1104,10 @@ String WebSockets::acceptKey(String & clientKey) {
  * @return base64 encoded String
  */
 String WebSockets::base64_encode(uint8_t * data, size_t length) {
-    size_t size   = ((length * 1.6f) + 1);
+    size_t size   = WEBSOCKETS_BASE64_LENGTH(length) + 1;
     char * buffer = (char *)malloc(size);
     if(buffer) {
-        base64_encodestate _state;
-        base64_init_encodestate(&_state);
-        int len = base64_encode_block((const char *)&data[0], length, &buffer[0], &_state);
-        len     = base64_encode_blockend((buffer + len), &_state);
-
+        base64_encode(data, length, buffer, size);
         String base64 = String(buffer);
         free(buffer);
         return base64;
@@ -635,6 +1165,10 @@ bool WebSockets::readCb(WSclient_t * client, uint8_t * out, size_t n, WSreadWait
         }
 
         if(!client->tcp->available()) {
+            // do not wait for an answer that is still held back in the cork buffer
+            if(client->txBufferLen > 0) {
+                flushCork(client);
+            }
             WEBSOCKETS_YIELD_MORE();
             continue;
         }
@@ -662,6 +1196,7 @@ bool WebSockets::readCb(WSclient_t * client, uint8_t * out, size_t n, WSreadWait
 
 /**
  * write x byte to tcp or get timeout
+ * while the client is corked small writes are collected in the cork buffer
  * @param client WSclient_t *
  * @param out  uint8_t * data buffer
  * @param n size_t byte count
@@ -672,6 +1207,61 @@ size_t WebSockets::write(WSclient_t * client, uint8_t * out, size_t n) {
         return 0;
     if(client == NULL)
         return 0;
+#if(WEBSOCKETS_CORK_BUFFER_SIZE > 0)
+    if(client->txCork && n < WEBSOCKETS_CORK_BUFFER_SIZE) {
+        if((client->txBufferLen + n) > WEBSOCKETS_CORK_BUFFER_SIZE) {
+            if(!flushCork(client)) {
+                return 0;
+            }
+        }
+        if(!client->txBuffer) {
+            client->txBuffer = (uint8_t *)malloc(WEBSOCKETS_CORK_BUFFER_SIZE);
+        }
+        if(client->txBuffer) {
+            if(client->txBufferLen > 0) {
+                // this write shares the TCP segment / TLS record with the pending data
+                client->txCoalesced++;
+                client->txSavedBytes += WEBSOCKETS_TCP_SEGMENT_OVERHEAD;
+#if defined(HAS_SSL)
+                if(client->isSSL) {
+                    client->txSavedBytes += WEBSOCKETS_TLS_RECORD_OVERHEAD;
+                }
+#endif
+            }
+            memcpy(&client->txBuffer[client->txBufferLen], out, n);
+            client->txBufferLen += n;
+            return n;
+        }
+        DEBUG_WEBSOCKETS("[WS][%d][write] no memory for cork buffer!\n", client->num);
+    }
+    if(client->txBufferLen > 0) {
+        // keep the byte order, pending data goes first
+        if(!flushCork(client)) {
+            return 0;
+        }
+    }
+#endif
+    return writeDirect(client, out, n);
+}
+
+/**
+ * write x byte to tcp or get timeout (bypasses the cork buffer)
+ * @param client WSclient_t *
+ * @param out  uint8_t * data buffer
+ * @param n size_t byte count
+ * @return bytes send
+ */
+size_t WebSockets::writeDirect(WSclient_t * client, uint8_t * out, size_t n) {
+    if(out == NULL)
+        return 0;
+    if(client == NULL)
+        return 0;
+#ifdef WEBSOCKETS_HAS_SERVER_QUEUE
+    if(!client->cIsClient && (client->status == WSC_CONNECTED || client->status == WSC_CLOSING)) {
+        // the server never waits for a slow client, the rest is queued
+        return queueWrite(client, WSop_continuation, false, out, n) ? n : 0;
+    }
+#endif
     unsigned long t = millis();
     size_t len      = 0;
     size_t total    = 0;
@@ -684,6 +1274,7 @@ size_t WebSockets::write(WSclient_t * client, uint8_t * out, size_t n) {
 
         if(!client->tcp->connected()) {
             DEBUG_WEBSOCKETS("[write] not connected!\n");
+            connectionLost(client);
             break;
         }
 
@@ -718,6 +1309,507 @@ size_t WebSockets::write(WSclient_t * client, const char * out) {
     return write(client, (uint8_t *)out, strlen(out));
 }
 
+/**
+ * start collecting writes for the client in the cork buffer
+ * can be nested, the data is send with the last uncork
+ * @param client WSclient_t *
+ */
+void WebSockets::cork(WSclient_t * client) {
+#if(WEBSOCKETS_CORK_BUFFER_SIZE > 0)
+    if(client == NULL)
+        return;
+    if(client->txCork < 0xFF) {
+        client->txCork++;
+    }
+#else
+    UNUSED(client);
+#endif
+}
+
+/**
+ * leave cork mode and send out the collected data with one write
+ * @param client WSclient_t *
+ * @return true if ok, false if the connection is closed (see flushCork)
+ */
+bool WebSockets::uncork(WSclient_t * client) {
+    if(client == NULL)
+        return false;
+    if(client->txCork > 0) {
+        client->txCork--;
+    }
+    if(client->txCork == 0) {
+        return flushCork(client);
+    }
+    return true;
+}
+
+/**
+ * send the data collected in the cork buffer
+ * a partial write leaves a broken frame on the wire, the connection is closed then
+ * @param client WSclient_t *
+ * @return true if ok, false if the connection is closed
+ */
+bool WebSockets::flushCork(WSclient_t * client) {
+    if(client == NULL || client->txBufferLen == 0) {
+        return true;
+    }
+    size_t len          = client->txBufferLen;
+    client->txBufferLen = 0;
+    DEBUG_WEBSOCKETS("[WS][%d][flushCork] len: %u coalesced: %u saved: %u\n", client->num, len, client->txCoalesced, client->txSavedBytes);
+    if(writeDirect(client, client->txBuffer, len) != len) {
+        DEBUG_WEBSOCKETS("[WS][%d][flushCork] write failed!\n", client->num);
+        clientDisconnect(client);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * drop the cork buffer (on disconnect)
+ * @param client WSclient_t *
+ */
+void WebSockets::releaseCork(WSclient_t * client) {
+    if(client->txBuffer) {
+        free(client->txBuffer);
+        client->txBuffer = nullptr;
+    }
+    client->txBufferLen = 0;
+    client->txCork      = 0;
+}
+
+#ifdef WEBSOCKETS_HAS_DEFLATE
+/**
+ * permessage-deflate parameters of one extension offer / response
+ */
+typedef struct {
+    bool serverNoContext;
+    bool clientNoContext;
+    uint8_t serverBits;        ///< 0 = not present
+    uint8_t clientBits;        ///< 0 = not present or no value
+    bool clientBitsPresent;    ///< client_max_window_bits is present (value is optional in an offer)
+} WSdeflateParams_t;
+
+/**
+ * parse the first valid permessage-deflate element of a Sec-WebSocket-Extensions value
+ * @param extensions String
+ * @param params WSdeflateParams_t *
+ * @return true if found
+ */
+static bool parseDeflateParams(const String & extensions, WSdeflateParams_t * params) {
+    int start = 0;
+    while(start >= 0 && start < (int)extensions.length()) {
+        int end = extensions.indexOf(',', start);
+        String ext;
+        if(end < 0) {
+            ext   = extensions.substring(start);
+            start = -1;
+        } else {
+            ext   = extensions.substring(start, end);
+            start = end + 1;
+        }
+
+        int sep     = ext.indexOf(';');
+        String name = (sep < 0) ? ext : ext.substring(0, sep);
+        name.trim();
+        if(!name.equalsIgnoreCase(WEBSOCKETS_STRING("permessage-deflate"))) {
+            continue;
+        }
+
+        memset(params, 0x00, sizeof(WSdeflateParams_t));
+        bool valid = true;
+        while(sep >= 0 && valid) {
+            int next     = ext.indexOf(';', sep + 1);
+            String param = (next < 0) ? ext.substring(sep + 1) : ext.substring(sep + 1, next);
+            sep          = next;
+
+            String value;
+            int eq = param.indexOf('=');
+            if(eq >= 0) {
+                value = param.substring(eq + 1);
+                param = param.substring(0, eq);
+                value.trim();
+                value.replace("\"", "");
+            }
+            param.trim();
+
+            long bits = value.toInt();
+            if(param.equalsIgnoreCase(WEBSOCKETS_STRING("server_no_context_takeover"))) {
+                params->serverNoContext = true;
+            } else if(param.equalsIgnoreCase(WEBSOCKETS_STRING("client_no_context_takeover"))) {
+                params->clientNoContext = true;
+            } else if(param.equalsIgnoreCase(WEBSOCKETS_STRING("server_max_window_bits"))) {
+                valid              = (bits >= 8 && bits <= 15);
+                params->serverBits = bits;
+            } else if(param.equalsIgnoreCase(WEBSOCKETS_STRING("client_max_window_bits"))) {
+                valid                     = (value.length() == 0 || (bits >= 8 && bits <= 15));
+                params->clientBits        = value.length() ? bits : 0;
+                params->clientBitsPresent = true;
+            } else {
+                valid = false;
+            }
+        }
+
+        if(valid) {
+            return true;
+        }
+        DEBUG_WEBSOCKETS("[WS][parseDeflateParams] skip invalid offer: %s\n", ext.c_str());
+    }
+    return false;
+}
+
+/**
+ * create the permessage-deflate offer for the client handshake
+ * the client never uses context takeover for its messages
+ * @param client WSclient_t *
+ * @return String Sec-WebSocket-Extensions value
+ */
+String WebSockets::deflateOffer(WSclient_t * client) {
+    String offer = WEBSOCKETS_STRING("permessage-deflate; client_no_context_takeover; client_max_window_bits");
+    if(client->cDeflateBits < 15) {
+        offer += WEBSOCKETS_STRING("; server_max_window_bits=");
+        offer += String(client->cDeflateBits);
+    }
+    if(client->cDeflateNoContext) {
+        offer += WEBSOCKETS_STRING("; server_no_context_takeover");
+    }
+    return offer;
+}
+
+/**
+ * server side negotiation, accept the offer in client->cExtensions
+ * the window of the received messages is limited to client->cDeflateBits,
+ * if the client can not be limited it has to reset its context for each message
+ * @param client WSclient_t *
+ * @param response String & Sec-WebSocket-Extensions value for the handshake response
+ * @return true if permessage-deflate is used
+ */
+bool WebSockets::deflateAccept(WSclient_t * client, String & response) {
+    WSdeflateParams_t params;
+
+    client->cDeflate = false;
+    if(client->cDeflateBits == 0 || !parseDeflateParams(client->cExtensions, &params)) {
+        return false;
+    }
+
+    // our compressor never references older messages
+    response = WEBSOCKETS_STRING("permessage-deflate; server_no_context_takeover");
+
+    client->cDeflateTxBits = client->cDeflateBits;
+    if(params.serverBits) {
+        client->cDeflateTxBits = std::min(client->cDeflateTxBits, params.serverBits);
+        response += WEBSOCKETS_STRING("; server_max_window_bits=");
+        response += String(client->cDeflateTxBits);
+    }
+
+    client->cDeflateRxBits      = params.clientBits ? params.clientBits : 15;
+    client->cDeflateRxNoContext = (params.clientNoContext || client->cDeflateNoContext);
+    if(!client->cDeflateRxNoContext && client->cDeflateBits < client->cDeflateRxBits) {
+        if(params.clientBitsPresent) {
+            client->cDeflateRxBits = client->cDeflateBits;
+            response += WEBSOCKETS_STRING("; client_max_window_bits=");
+            response += String(client->cDeflateRxBits);
+        } else {
+            // window can not be limited, do not keep one
+            client->cDeflateRxNoContext = true;
+        }
+    }
+    if(client->cDeflateRxNoContext) {
+        response += WEBSOCKETS_STRING("; client_no_context_takeover");
+    }
+
+    client->cDeflate = true;
+    DEBUG_WEBSOCKETS("[WS][%d][deflateAccept] tx bits: %u rx bits: %u rx no context: %u\n", client->num, client->cDeflateTxBits, client->cDeflateRxBits, client->cDeflateRxNoContext);
+    return true;
+}
+
+/**
+ * client side negotiation, check the response in client->cExtensions against our offer
+ * @param client WSclient_t *
+ * @return false if the server response is invalid
+ */
+bool WebSockets::deflateConfirm(WSclient_t * client) {
+    WSdeflateParams_t params;
+
+    client->cDeflate = false;
+    if(client->cExtensions.length() == 0) {
+        return true;
+    }
+    if(client->cDeflateBits == 0) {
+        // nothing was offered, the server must not answer with an extension (rfc6455 9.1)
+        DEBUG_WEBSOCKETS("[WS][%d][deflateConfirm] extension not offered: %s\n", client->num, client->cExtensions.c_str());
+        return false;
+    }
+    if(!parseDeflateParams(client->cExtensions, &params)) {
+        DEBUG_WEBSOCKETS("[WS][%d][deflateConfirm] unexpected extensions: %s\n", client->num, client->cExtensions.c_str());
+        return false;
+    }
+    if(params.clientBitsPresent && params.clientBits == 0) {
+        // the value is only optional in an offer (rfc7692 7.1.2.2)
+        DEBUG_WEBSOCKETS("[WS][%d][deflateConfirm] client_max_window_bits without value\n", client->num);
+        return false;
+    }
+
+    client->cDeflateRxBits = params.serverBits ? params.serverBits : 15;
+    if(client->cDeflateRxBits > client->cDeflateBits) {
+        DEBUG_WEBSOCKETS("[WS][%d][deflateConfirm] server window too big: %u\n", client->num, client->cDeflateRxBits);
+        return false;
+    }
+    if(client->cDeflateNoContext && !params.serverNoContext) {
+        DEBUG_WEBSOCKETS("[WS][%d][deflateConfirm] server_no_context_takeover missing\n", client->num);
+        return false;
+    }
+    client->cDeflateRxNoContext = params.serverNoContext;
+    client->cDeflateTxBits      = params.clientBits ? std::min(client->cDeflateBits, params.clientBits) : client->cDeflateBits;
+
+    client->cDeflate = true;
+    DEBUG_WEBSOCKETS("[WS][%d][deflateConfirm] tx bits: %u rx bits: %u rx no context: %u\n", client->num, client->cDeflateTxBits, client->cDeflateRxBits, client->cDeflateRxNoContext);
+    return true;
+}
+
+/**
+ * inflate a received compressed frame, fragments are collected until the message is complete
+ * @param client WSclient_t *
+ * @param header WSMessageHeader_t *   opCode, payloadLen and fin are updated for the inflated message
+ * @param payload uint8_t **           in: compressed data (with 4 spare bytes), out: inflated message
+ * @return true if a message is ready
+ */
+bool WebSockets::deflateFrame(WSclient_t * client, WSMessageHeader_t * header, uint8_t ** payload) {
+    uint8_t * data = *payload;
+    size_t len     = header->payloadLen;
+    *payload       = NULL;
+
+    if(client->rxFragment && header->opCode != WSop_continuation) {
+        DEBUG_WEBSOCKETS("[WS][%d][deflateFrame] new message while fragments are pending!\n", client->num);
+        free(data);
+        clientDisconnect(client, 1002);
+        return false;
+    }
+
+    if(!header->fin || client->rxFragment) {
+        if((client->rxFragmentLen + len) > WEBSOCKETS_MAX_DATA_SIZE) {
+            DEBUG_WEBSOCKETS("[WS][%d][deflateFrame] message too big!\n", client->num);
+            free(data);
+            clientDisconnect(client, 1009);
+            return false;
+        }
+        uint8_t * buffer = (uint8_t *)realloc(client->rxFragment, client->rxFragmentLen + len + 4);
+        if(!buffer) {
+            free(data);
+            clientDisconnect(client, 1011);
+            return false;
+        }
+        if(len > 0) {
+            memcpy(&buffer[client->rxFragmentLen], data, len);
+        }
+        free(data);
+        client->rxFragment = buffer;
+        client->rxFragmentLen += len;
+        if(header->opCode != WSop_continuation) {
+            client->rxFragmentOpcode = header->opCode;
+        }
+        if(!header->fin) {
+            return false;
+        }
+
+        data                  = client->rxFragment;
+        len                   = client->rxFragmentLen;
+        header->opCode        = client->rxFragmentOpcode;
+        client->rxFragment    = NULL;
+        client->rxFragmentLen = 0;
+    } else if(!data) {
+        data = (uint8_t *)malloc(4);
+        if(!data) {
+            clientDisconnect(client, 1011);
+            return false;
+        }
+    }
+
+    // the sender removes the tail of the sync flush (RFC 7692 7.2.2)
+    data[len++] = 0x00;
+    data[len++] = 0x00;
+    data[len++] = 0xFF;
+    data[len++] = 0xFF;
+
+    uint8_t * out = NULL;
+    size_t outLen = 0;
+    int ret;
+    if(client->cDeflateRxNoContext) {
+        ret = raw_inflate(data, len, NULL, 0, &out, &outLen, WEBSOCKETS_MAX_DATA_SIZE);
+    } else {
+        ret = raw_inflate(data, len, client->rxWindow, client->rxWindowLen, &out, &outLen, WEBSOCKETS_MAX_DATA_SIZE);
+    }
+    free(data);
+
+    if(ret != RAW_DEFLATE_OK) {
+        DEBUG_WEBSOCKETS("[WS][%d][deflateFrame] inflate failed: %d\n", client->num, ret);
+        clientDisconnect(client, (ret == RAW_DEFLATE_SIZE_ERROR) ? 1009 : ((ret == RAW_DEFLATE_MEM_ERROR) ? 1011 : 1007));
+        return false;
+    }
+
+    if(!client->cDeflateRxNoContext) {
+        // keep the last bytes as dictionary for the next message
+        size_t windowSize = ((size_t)1 << client->cDeflateRxBits);
+        if(!client->rxWindow) {
+            client->rxWindow = (uint8_t *)malloc(windowSize);
+            if(!client->rxWindow) {
+                free(out);
+                clientDisconnect(client, 1011);
+                return false;
+            }
+        }
+        if(outLen >= windowSize) {
+            memcpy(client->rxWindow, &out[outLen - windowSize], windowSize);
+            client->rxWindowLen = windowSize;
+        } else {
+            if((client->rxWindowLen + outLen) > windowSize) {
+                size_t drop = (client->rxWindowLen + outLen) - windowSize;
+                memmove(client->rxWindow, &client->rxWindow[drop], client->rxWindowLen - drop);
+                client->rxWindowLen -= drop;
+            }
+            memcpy(&client->rxWindow[client->rxWindowLen], out, outLen);
+            client->rxWindowLen += outLen;
+        }
+    }
+
+    DEBUG_WEBSOCKETS("[WS][%d][deflateFrame] inflate %u -> %u\n", client->num, len - 4, outLen);
+
+    out[outLen]        = 0x00;
+    *payload           = out;
+    header->payloadLen = outLen;
+    header->fin        = true;
+    return true;
+}
+
+/**
+ * free the permessage-deflate state (on disconnect)
+ * @param client WSclient_t *
+ */
+void WebSockets::releaseDeflate(WSclient_t * client) {
+    if(client->rxWindow) {
+        free(client->rxWindow);
+        client->rxWindow = nullptr;
+    }
+    if(client->rxFragment) {
+        free(client->rxFragment);
+        client->rxFragment = nullptr;
+    }
+    client->rxWindowLen   = 0;
+    client->rxFragmentLen = 0;
+    client->cDeflate      = false;
+}
+#endif
+
+/**
+ * start a message that is send in fragments (see streamFrame)
+ * control frames may still be send, other messages are refused until the last fragment
+ * @param client WSclient_t *
+ * @param opcode WSopcode_t   WSop_text or WSop_binary
+ * @return true if ok
+ */
+bool WebSockets::streamBegin(WSclient_t * client, WSopcode_t opcode) {
+    if(client->status != WSC_CONNECTED || client->txStream) {
+        return false;
+    }
+    if(opcode != WSop_text && opcode != WSop_binary) {
+        return false;
+    }
+    client->txStream       = true;
+    client->txStreamOpcode = opcode;
+    return true;
+}
+
+/**
+ * send one fragment of the streamed message
+ * the payload is masked in a small stack buffer, so it can be const (flash, generator output, ...)
+ * write blocks until the data is accepted or WEBSOCKETS_TCP_TIMEOUT, which throttles the producer
+ * with the send queue of the server nothing is send while the queue is not empty (would block)
+ * @param client WSclient_t *
+ * @param payload const uint8_t *
+ * @param length size_t
+ * @param fin bool              last fragment, ends the message
+ * @return true if ok, on error the connection is closed (it stays open if the fragment would block)
+ */
+bool WebSockets::streamFrame(WSclient_t * client, const uint8_t * payload, size_t length, bool fin) {
+    if(!client->txStream || client->status != WSC_CONNECTED) {
+        return false;
+    }
+#ifdef WEBSOCKETS_HAS_SERVER_QUEUE
+    if(!client->cIsClient) {
+        // the rest of the last fragment has to be out first, else the queue fills up with fragments
+        if(client->txBufferLen > 0 && !flushCork(client)) {
+            return false;
+        }
+        queueDrain(client);
+        if(client->txQueueLen > 0) {
+            // would block, the producer tries again later
+            return false;
+        }
+    }
+#endif
+    if(!payload) {
+        length = 0;
+    }
+
+    uint8_t maskKey[4] = { 0x00, 0x00, 0x00, 0x00 };
+    uint8_t buffer[WEBSOCKETS_MAX_HEADER_SIZE + WEBSOCKETS_STREAM_BUFFER_SIZE];
+
+    if(client->cIsClient) {
+        for(uint8_t x = 0; x < sizeof(maskKey); x++) {
+            maskKey[x] = random(0xFF);
+        }
+    }
+
+    DEBUG_WEBSOCKETS("[WS][%d][streamFrame] fin: %u opCode: %u length: %u\n", client->num, fin, client->txStreamOpcode, length);
+
+#ifdef WEBSOCKETS_HAS_CAPTURE
+    if(client->capture) {
+        client->capture->frame(false, client->txStreamOpcode, fin, payload, length);
+    }
+#endif
+
+    size_t used   = createHeader(&buffer[0], client->txStreamOpcode, length, client->cIsClient, maskKey, fin);
+    size_t offset = 0;
+    bool ret      = true;
+
+    client->txStreamOpcode = WSop_continuation;
+    if(fin) {
+        client->txStream = false;
+    }
+
+    if(!client->cIsClient) {
+        // nothing to modify, send the payload as it is
+        ret = (write(client, &buffer[0], used) == used);
+        if(ret && length > 0) {
+            ret = (write(client, (uint8_t *)payload, length) == length);
+        }
+    } else {
+        do {
+            size_t n = std::min(length - offset, sizeof(buffer) - used);
+            for(size_t x = 0; x < n; x++) {
+                buffer[used + x] = (payload[offset + x] ^ maskKey[(offset + x) % 4]);
+            }
+            if(write(client, &buffer[0], used + n) != (used + n)) {
+                ret = false;
+                break;
+            }
+            offset += n;
+            used = 0;
+        } while(offset < length);
+    }
+
+    if(!ret) {
+        // the message can not be completed anymore
+        DEBUG_WEBSOCKETS("[WS][%d][streamFrame] write failed!\n", client->num);
+        client->txStream = false;
+        clientDisconnect(client);
+        return false;
+    }
+
+    WEBSOCKETS_METRIC_ADD("ws.tx.frames", 1);
+    WEBSOCKETS_METRIC_ADD("ws.tx.bytes", length);
+    return true;
+}
+
 /**
  * enable ping/pong heartbeat process
  * @param client WSclient_t *
@@ -759,3 +1851,23 @@ void WebSockets::handleHBTimeout(WSclient_t * client) {
         }
     }
 }
+
+/**
+ * next time handleHBPing or handleHBTimeout of the client have something to do
+ * @param client WSclient_t *
+ * @param deadline unsigned long *  millis
+ * @return false if the heartbeat is disabled
+ */
+bool WebSockets::heartbeatDeadline(WSclient_t * client, unsigned long * deadline) {
+    if(client->pingInterval == 0) {
+        return false;
+    }
+    uint32_t wait = client->pingInterval;
+    if(!client->pongReceived && client->pongTimeout < wait) {
+        wait = client->pongTimeout;
+    }
+    // both check for "more than", lastPing is 32 bit also where millis() is not
+    unsigned long now = millis();
+    *deadline         = now + (long)(int32_t)(client->lastPing + wait + 1 - (uint32_t)now);
+    return true;
+}
@@ -93,6 +93,16 @@
 #define WEBSOCKETS_YIELD() yield()
 #define WEBSOCKETS_YIELD_MORE() delay(1)
 
+#elif !defined(ARDUINO) && (defined(__linux__) || defined(__APPLE__))
+
+// host build with the Arduino API of extras/host (see CMakeLists.txt)
+#define WEBSOCKETS_HOST
+#define WEBSOCKETS_MAX_DATA_SIZE (15 * 1024)
+#define WEBSOCKETS_USE_BIG_MEM
+#define GET_FREE_HEAP (0x7FFFFFFFUL)
+#define WEBSOCKETS_YIELD() yield()
+#define WEBSOCKETS_YIELD_MORE() delay(1)
+
 #else
 
 // atmega328p has only 2KB ram!
@@ -107,6 +117,53 @@
 #define WEBSOCKETS_TCP_TIMEOUT (5000)
 #endif
 
+// size of the per client buffer used to coalesce small frames (see WebSockets::cork)
+#ifndef WEBSOCKETS_CORK_BUFFER_SIZE
+#ifdef WEBSOCKETS_USE_BIG_MEM
+#define WEBSOCKETS_CORK_BUFFER_SIZE (1460)
+#else
+#define WEBSOCKETS_CORK_BUFFER_SIZE (0)
+#endif
+#endif
+
+// stack buffer used to mask streamed message fragments (see WebSockets::streamFrame)
+#ifndef WEBSOCKETS_STREAM_BUFFER_SIZE
+#ifdef WEBSOCKETS_USE_BIG_MEM
+#define WEBSOCKETS_STREAM_BUFFER_SIZE (512)
+#else
+#define WEBSOCKETS_STREAM_BUFFER_SIZE (64)
+#endif
+#endif
+
+// one line of the HTTP response is collected here while the client waits for the upgrade
+#ifndef WEBSOCKETS_CLIENT_HEADER_LINE_SIZE
+#define WEBSOCKETS_CLIENT_HEADER_LINE_SIZE (256)
+#endif
+
+// permessage-deflate (RFC 7692), needs some heap for the LZ77 window
+#if defined(WEBSOCKETS_USE_BIG_MEM) && !defined(WEBSOCKETS_NO_DEFLATE)
+#define WEBSOCKETS_HAS_DEFLATE
+#endif
+
+// counters / gauges / histograms of WebSocketsMetrics.h, off with WEBSOCKETS_NO_METRICS
+#if defined(WEBSOCKETS_USE_BIG_MEM) && !defined(WEBSOCKETS_NO_METRICS)
+#define WEBSOCKETS_HAS_METRICS
+#endif
+
+// session capture of WebSocketsCapture.h (WebSocketsClient::setCapture), off with WEBSOCKETS_NO_CAPTURE
+#if defined(WEBSOCKETS_USE_BIG_MEM) && !defined(WEBSOCKETS_NO_CAPTURE)
+#define WEBSOCKETS_HAS_CAPTURE
+#endif
+
+// messages smaller then this are send uncompressed
+#ifndef WEBSOCKETS_DEFLATE_MIN_SIZE
+#define WEBSOCKETS_DEFLATE_MIN_SIZE (64)
+#endif
+
+// per write overhead used to estimate the bytes on wire saved by coalescing
+#define WEBSOCKETS_TCP_SEGMENT_OVERHEAD (40)    ///< IPv4 + TCP header
+#define WEBSOCKETS_TLS_RECORD_OVERHEAD (29)     ///< TLS record header + MAC + padding
+
 #define NETWORK_ESP8266_ASYNC (0)
 #define NETWORK_ESP8266 (1)
 #define NETWORK_W5100 (2)
@@ -114,10 +171,18 @@
 #define NETWORK_ESP32 (4)
 #define NETWORK_ESP32_ETH (5)
 #define NETWORK_RP2040 (6)
+#define NETWORK_POSIX (7)
 
 // max size of the WS Message Header
 #define WEBSOCKETS_MAX_HEADER_SIZE (14)
 
+// Sec-WebSocket-Accept is the base64 of a SHA-1 digest
+#define WEBSOCKETS_ACCEPT_KEY_LENGTH (28)
+// Sec-WebSocket-Key is 24 chars (RFC 6455), longer keys are refused
+#define WEBSOCKETS_MAX_KEY_LENGTH (64)
+
+#define WEBSOCKETS_BASE64_LENGTH(len) ((((len) + 2) / 3) * 4)
+
 #if !defined(WEBSOCKETS_NETWORK_TYPE)
 // select Network type based
 #if defined(ESP8266) || defined(ESP31B)
@@ -132,6 +197,9 @@
 #elif defined(ARDUINO_ARCH_RP2040)
 #define WEBSOCKETS_NETWORK_TYPE NETWORK_RP2040
 
+#elif defined(WEBSOCKETS_HOST)
+#define WEBSOCKETS_NETWORK_TYPE NETWORK_POSIX
+
 #else
 #define WEBSOCKETS_NETWORK_TYPE NETWORK_W5100
 
@@ -224,6 +292,12 @@
 #define WEBSOCKETS_NETWORK_SSL_CLASS WiFiClientSecure
 #define WEBSOCKETS_NETWORK_SERVER_CLASS WiFiServer
 
+#elif(WEBSOCKETS_NETWORK_TYPE == NETWORK_POSIX)
+
+#include "WebSocketsPosix.h"
+#define WEBSOCKETS_NETWORK_CLASS WSPosixClient
+#define WEBSOCKETS_NETWORK_SERVER_CLASS WSPosixServer
+
 #else
 #error "no network type selected!"
 #endif
@@ -232,6 +306,24 @@
 #define HAS_SSL
 #endif
 
+// messages per client the server keeps while the TCP buffer is full (see WebSocketsServerCore::setQueuePolicy)
+// the drain needs a working availableForWrite() of the network class
+#ifndef WEBSOCKETS_SERVER_QUEUE_SIZE
+#if defined(WEBSOCKETS_USE_BIG_MEM) && ((WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RP2040) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_POSIX))
+#define WEBSOCKETS_SERVER_QUEUE_SIZE (8)
+#else
+#define WEBSOCKETS_SERVER_QUEUE_SIZE (0)
+#endif
+#endif
+
+#if(WEBSOCKETS_SERVER_QUEUE_SIZE > 0) && (WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+#define WEBSOCKETS_HAS_SERVER_QUEUE
+#endif
+
+#include "WebSocketsMetrics.h"
+#include "WebSocketsAlloc.h"
+#include "WebSocketsCapture.h"
+
 // moves all Header strings to Flash (~300 Byte)
 #ifdef WEBSOCKETS_SAVE_RAM
 #define WEBSOCKETS_STRING(var) F(var)
@@ -243,7 +335,8 @@ typedef enum {
     WSC_NOT_CONNECTED,
     WSC_HEADER,
     WSC_BODY,
-    WSC_CONNECTED
+    WSC_CONNECTED,
+    WSC_CLOSING
 } WSclientsStatus_t;
 
 typedef enum {
@@ -285,6 +378,27 @@ typedef struct {
     uint8_t * maskKey;
 } WSMessageHeader_t;
 
+typedef struct {
+    uint16_t refs;        ///< owners of the frame, freed by frameRelease with the last one
+    WSopcode_t opcode;    ///< opcode of the encoded frame
+    bool whole;           ///< complete frame, a send queue may drop it
+    size_t length;        ///< header + payload
+    uint8_t * data;       ///< encoded frame (unmasked), same allocation as the struct
+} WSframe_t;
+
+#ifdef WEBSOCKETS_HAS_SERVER_QUEUE
+typedef enum {
+    WSQ_DROP_OLDEST,    ///< make room by dropping the oldest message not yet started
+    WSQ_DROP_NEWEST,    ///< the new message is not queued
+    WSQ_DISCONNECT      ///< the client is too slow, close the connection
+} WSqueuePolicy_t;
+
+typedef struct {
+    WSframe_t * frame;
+    unsigned long queued;    ///< millis() when the frame was queued
+} WSqueueEntry_t;
+#endif
+
 typedef struct {
     void init(uint8_t num,
         uint32_t pingInterval,
@@ -335,6 +449,11 @@ typedef struct {
     bool cHttpHeadersValid = false;    ///< non-websocket http header validity indicator
     size_t cMandatoryHeadersCount;     ///< non-websocket mandatory http headers present count
 
+    uint8_t cHeaderBuffer         = 0xFF;       ///< server: line buffer taken while the request is read, 0xFF = none
+    uint16_t cHeaderLen           = 0;          ///< server: bytes of the incomplete line
+    char * cHeaderRest            = nullptr;    ///< server: incomplete line kept between reads (heap)
+    unsigned long cHandshakeStart = 0;          ///< server: millis when the connection was accepted
+
     bool pongReceived              = false;
     uint32_t pingInterval          = 0;    // how often ping will be sent, 0 means "heartbeat is not active"
     uint32_t lastPing              = 0;    // millis when last pong has been received
@@ -342,6 +461,47 @@ typedef struct {
     uint8_t disconnectTimeoutCount = 0;    // after how many subsequent pong timeouts discconnect will happen, 0 means "do not disconnect"
     uint8_t pongTimeoutCount       = 0;    // current pong timeout count
 
+    uint8_t txCork        = 0;          ///< cork depth, writes are buffered while > 0
+    uint8_t * txBuffer    = nullptr;    ///< coalescing buffer (WEBSOCKETS_CORK_BUFFER_SIZE)
+    size_t txBufferLen    = 0;          ///< bytes pending in txBuffer
+    uint32_t txCoalesced  = 0;          ///< writes merged into an other segment
+    uint32_t txSavedBytes = 0;          ///< estimated bytes on wire saved by coalescing
+
+    unsigned long rxFrameStart = 0;    ///< micros when the reading of the last received frame started
+
+#ifdef WEBSOCKETS_HAS_CAPTURE
+    WebSocketsCapture * capture = nullptr;    ///< records the frames of the connection, see WebSocketsClient::setCapture
+#endif
+
+    bool txStream             = false;                ///< streamed message in progress
+    WSopcode_t txStreamOpcode = WSop_continuation;    ///< opcode of the next fragment of the streamed message
+
+#ifdef WEBSOCKETS_HAS_SERVER_QUEUE
+    WSqueueEntry_t txQueue[WEBSOCKETS_SERVER_QUEUE_SIZE];    ///< ring of frames waiting for the TCP buffer
+    uint8_t txQueueHead           = 0;                       ///< index of the oldest entry
+    uint8_t txQueueLen            = 0;                       ///< entries in use
+    uint8_t txQueuePeak           = 0;                       ///< max txQueueLen seen
+    size_t txQueueSent            = 0;                       ///< bytes of the oldest entry already written
+    uint32_t txQueueDropped       = 0;                       ///< messages dropped by the queue policy
+    WSqueuePolicy_t txQueuePolicy = WSQ_DROP_OLDEST;         ///< what to do if the queue is full
+    unsigned long txClosing       = 0;                       ///< millis() when the close frame was queued (WSC_CLOSING)
+#endif
+
+#ifdef WEBSOCKETS_HAS_DEFLATE
+    uint8_t cDeflateBits     = 0;        ///< configured max window bits, 0 = permessage-deflate disabled
+    bool cDeflateNoContext   = false;    ///< configured: ask the peer to reset its window for each message
+    bool cDeflate            = false;    ///< permessage-deflate negotiated
+    uint8_t cDeflateTxBits   = 15;       ///< window bits allowed for messages we send
+    uint8_t cDeflateRxBits   = 15;       ///< window bits used by the peer
+    bool cDeflateRxNoContext = false;    ///< peer resets its window for each message
+
+    uint8_t * rxWindow          = nullptr;              ///< history of the received messages (context takeover)
+    size_t rxWindowLen          = 0;                    ///< bytes used in rxWindow
+    uint8_t * rxFragment        = nullptr;              ///< compressed data of a fragmented message
+    size_t rxFragmentLen        = 0;                    ///< bytes used in rxFragment
+    WSopcode_t rxFragmentOpcode = WSop_continuation;    ///< opcode of the fragmented compressed message
+#endif
+
 #if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
     String cHttpLine;    ///< HTTP header lines
 #endif
@@ -363,9 +523,39 @@ class WebSockets {
 
     virtual void messageReceived(WSclient_t * client, WSopcode_t opcode, uint8_t * payload, size_t length, bool fin) = 0;
 
-    uint8_t createHeader(uint8_t * buf, WSopcode_t opcode, size_t length, bool mask, uint8_t maskKey[4], bool fin);
+    uint8_t createHeader(uint8_t * buf, WSopcode_t opcode, size_t length, bool mask, uint8_t maskKey[4], bool fin, bool rsv1 = false);
     bool sendFrameHeader(WSclient_t * client, WSopcode_t opcode, size_t length = 0, bool fin = true);
     bool sendFrame(WSclient_t * client, WSopcode_t opcode, uint8_t * payload = NULL, size_t length = 0, bool fin = true, bool headerToPayload = false);
+    bool sendFrame(WSclient_t * client, WSframe_t * frame);
+#ifdef WEBSOCKETS_HAS_SERVER_QUEUE
+    bool queueFrame(WSclient_t * client, WSframe_t * frame);
+    void queueDrain(WSclient_t * client);
+    void queueTrim(WSclient_t * client);
+    void queueRelease(WSclient_t * client);
+
+    /**
+     * called if the queue of the client was empty and got a frame, or the client waits for it to close
+     * the owner has to come back to drain it
+     */
+    virtual void queueWaiting(WSclient_t * client) {
+        (void)client;
+    }
+#endif
+
+    /**
+     * called if a write found the connection closed (the network class closes the socket on a send error)
+     * the owner has to come back to clean up the client, the poller does not report a closed socket
+     */
+    virtual void connectionLost(WSclient_t * client) {
+        (void)client;
+    }
+
+    WSframe_t * frameCreate(WSopcode_t opcode, const uint8_t * payload, size_t length, bool fin = true);
+#ifdef WEBSOCKETS_HAS_DEFLATE
+    WSframe_t * frameDeflate(WSopcode_t opcode, const uint8_t * payload, size_t length, uint8_t windowBits);
+#endif
+    WSframe_t * frameRetain(WSframe_t * frame);
+    void frameRelease(WSframe_t * frame);
 
     void headerDone(WSclient_t * client);
 
@@ -375,15 +565,46 @@ class WebSockets {
     void handleWebsocketCb(WSclient_t * client);
     void handleWebsocketPayloadCb(WSclient_t * client, bool ok, uint8_t * payload);
 
+    bool acceptKey(const char * clientKey, size_t keyLen, char * out);
     String acceptKey(String & clientKey);
+    size_t base64_encode(const uint8_t * data, size_t length, char * out, size_t outSize);
     String base64_encode(uint8_t * data, size_t length);
 
     bool readCb(WSclient_t * client, uint8_t * out, size_t n, WSreadWaitCb cb);
     virtual size_t write(WSclient_t * client, uint8_t * out, size_t n);
     size_t write(WSclient_t * client, const char * out);
 
+    void cork(WSclient_t * client);
+    bool uncork(WSclient_t * client);
+    bool flushCork(WSclient_t * client);
+    void releaseCork(WSclient_t * client);
+
+    bool streamBegin(WSclient_t * client, WSopcode_t opcode);
+    bool streamFrame(WSclient_t * client, const uint8_t * payload, size_t length, bool fin);
+
+#ifdef WEBSOCKETS_HAS_DEFLATE
+    String deflateOffer(WSclient_t * client);
+    bool deflateAccept(WSclient_t * client, String & response);
+    bool deflateConfirm(WSclient_t * client);
+    void releaseDeflate(WSclient_t * client);
+#endif
+
     void enableHeartbeat(WSclient_t * client, uint32_t pingInterval, uint32_t pongTimeout, uint8_t disconnectTimeoutCount);
     void handleHBTimeout(WSclient_t * client);
+    bool heartbeatDeadline(WSclient_t * client, unsigned long * deadline);
+
+  private:
+    size_t writeDirect(WSclient_t * client, uint8_t * out, size_t n);
+#ifdef WEBSOCKETS_HAS_SERVER_QUEUE
+    size_t writeAvailable(WSclient_t * client, uint8_t * out, size_t n);
+    bool queueWrite(WSclient_t * client, WSopcode_t opcode, bool whole, uint8_t * header, size_t headerLen, uint8_t * payload = NULL, size_t length = 0);
+    bool queuePush(WSclient_t * client, WSframe_t * frame);
+    void queuePop(WSclient_t * client, uint8_t index);
+#endif
+
+#ifdef WEBSOCKETS_HAS_DEFLATE
+    bool deflateFrame(WSclient_t * client, WSMessageHeader_t * header, uint8_t ** payload);
+#endif
 };
 
 #ifndef UNUSED
@@ -0,0 +1,367 @@
+/**
+ * @file WebSocketsAlloc.cpp
+ * @date 19.10.2026
+ *
+ * Copyright (c) 2026 WebSockets for Arduino contributors.
+ * This file is part of the WebSockets for Arduino.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "WebSockets.h"
+
+#ifdef WEBSOCKETS_HAS_ALLOC_PROFILE
+
+#if defined(WEBSOCKETS_HOST) && defined(__GLIBC__)
+#include <malloc.h>
+#include <errno.h>
+// the live bytes need the size of a block when it is freed
+#define WEBSOCKETS_ALLOC_LIVE
+#endif
+
+// nothing in here may allocate, it runs inside malloc
+
+typedef struct {
+    const char * name;
+    WebSocketsMetricValue allocs;
+#ifdef WEBSOCKETS_METRICS_NO_ATOMIC
+    uint64_t bytes;
+#else
+    std::atomic<uint64_t> bytes;
+#endif
+} WSallocSiteState_t;
+
+static WSallocSiteState_t allocSites[WEBSOCKETS_ALLOC_SITES] = { { "other" } };
+static WebSocketsMetricValue allocFrees;
+static WebSocketsMetricValue allocLive;
+static WebSocketsMetricValue allocPeak;
+static WSallocHeap_t allocHeap;
+
+#ifdef WEBSOCKETS_METRICS_NO_ATOMIC
+static uint8_t allocUsed = 1;
+static uint8_t allocSite = 0;
+
+static inline void allocAddBytes(WSallocSiteState_t * site, size_t size) {
+    site->bytes += size;
+}
+
+static inline uint64_t allocGetBytes(WSallocSiteState_t * site) {
+    return site->bytes;
+}
+
+static inline void allocLock(void) {
+}
+
+static inline void allocUnlock(void) {
+}
+#else
+static std::atomic<uint8_t> allocUsed(1);
+static thread_local uint8_t allocSite = 0;
+static std::atomic_flag allocCreate = ATOMIC_FLAG_INIT;
+
+static inline void allocAddBytes(WSallocSiteState_t * site, size_t size) {
+    site->bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+static inline uint64_t allocGetBytes(WSallocSiteState_t * site) {
+    return site->bytes.load(std::memory_order_relaxed);
+}
+
+static inline void allocLock(void) {
+    while(allocCreate.test_and_set(std::memory_order_acquire)) {
+    }
+}
+
+static inline void allocUnlock(void) {
+    allocCreate.clear(std::memory_order_release);
+}
+#endif
+
+static inline void allocCount(size_t size, size_t usable) {
+    WSallocSiteState_t * site = &allocSites[allocSite];
+    site->allocs.add(1);
+    allocAddBytes(site, size);
+#ifdef WEBSOCKETS_ALLOC_LIVE
+    allocLive.add(usable);
+    allocPeak.max(allocLive.get());
+#endif
+}
+
+static inline void freeCount(size_t usable) {
+    allocFrees.add(1);
+#ifdef WEBSOCKETS_ALLOC_LIVE
+    allocLive.add(-(uint32_t)usable);
+#endif
+}
+
+/**
+ * register a call site
+ * @param name const char *   literal, the pointer is kept
+ * @return site, 0 (other) if the table is full
+ */
+uint8_t WebSocketsAlloc::site(const char * name) {
+    uint8_t found = 0;
+    allocLock();
+    uint8_t used = allocUsed;
+    for(uint8_t i = 1; i < used; i++) {
+        if(strcmp(allocSites[i].name, name) == 0) {
+            found = i;
+            break;
+        }
+    }
+    if(found == 0 && used < WEBSOCKETS_ALLOC_SITES) {
+        allocSites[used].name = name;
+        found                 = used;
+        allocUsed             = (used + 1);
+    }
+    allocUnlock();
+    return found;
+}
+
+/**
+ * @param site uint8_t    site of the allocations from now on (this thread)
+ * @return the site before, for leave()
+ */
+uint8_t WebSocketsAlloc::enter(uint8_t site) {
+    uint8_t previous = allocSite;
+    allocSite        = site;
+    return previous;
+}
+
+void WebSocketsAlloc::leave(uint8_t previous) {
+    allocSite = previous;
+}
+
+/**
+ * count an allocation of the current site, called by the malloc hooks
+ * @param ptr void *      NULL if the allocation failed (not counted)
+ * @param size size_t     bytes requested
+ */
+void WebSocketsAlloc::allocated(void * ptr, size_t size) {
+    if(ptr) {
+#ifdef WEBSOCKETS_ALLOC_LIVE
+        allocCount(size, malloc_usable_size(ptr));
+#else
+        allocCount(size, 0);
+#endif
+    }
+}
+
+/**
+ * count a free, called by the free hook before the block is released
+ * @param ptr void *
+ */
+void WebSocketsAlloc::released(void * ptr) {
+    if(ptr) {
+#ifdef WEBSOCKETS_ALLOC_LIVE
+        freeCount(malloc_usable_size(ptr));
+#else
+        freeCount(0);
+#endif
+    }
+}
+
+/**
+ * take a heap sample, keeps the low water marks (call it periodically)
+ */
+void WebSocketsAlloc::sample(void) {
+    WSheapInfo_t info;
+    WebSocketsMetrics::heap(&info);
+    if(allocHeap.samples == 0 || info.free < allocHeap.minFree) {
+        allocHeap.minFree = info.free;
+    }
+    if(allocHeap.samples == 0 || info.largest < allocHeap.minLargest) {
+        allocHeap.minLargest = info.largest;
+    }
+    if(info.fragmentation > allocHeap.maxFragmentation) {
+        allocHeap.maxFragmentation = info.fragmentation;
+    }
+    allocHeap.last = info;
+    allocHeap.samples++;
+}
+
+/**
+ * start counting again (after a warm-up), the live bytes stay
+ */
+void WebSocketsAlloc::reset(void) {
+    for(uint8_t i = 0; i < WEBSOCKETS_ALLOC_SITES; i++) {
+        allocSites[i].allocs.take();
+#ifdef WEBSOCKETS_METRICS_NO_ATOMIC
+        allocSites[i].bytes = 0;
+#else
+        allocSites[i].bytes.store(0, std::memory_order_relaxed);
+#endif
+    }
+    allocFrees.take();
+    allocPeak.set(allocLive.get());
+    memset(&allocHeap, 0x00, sizeof(allocHeap));
+}
+
+uint32_t WebSocketsAlloc::allocs(void) {
+    uint32_t total = 0;
+    for(uint8_t i = 0; i < WEBSOCKETS_ALLOC_SITES; i++) {
+        total += allocSites[i].allocs.get();
+    }
+    return total;
+}
+
+uint32_t WebSocketsAlloc::frees(void) {
+    return allocFrees.get();
+}
+
+/**
+ * @return bytes allocated now (usable size), 0 if the platform does not tell
+ */
+size_t WebSocketsAlloc::live(void) {
+    return allocLive.get();
+}
+
+size_t WebSocketsAlloc::peak(void) {
+    return allocPeak.get();
+}
+
+const WSallocHeap_t & WebSocketsAlloc::heap(void) {
+    return allocHeap;
+}
+
+/**
+ * table of the sites (most bytes first), totals and heap low water marks
+ * @param out Print &
+ */
+void WebSocketsAlloc::printTo(Print & out) {
+    char line[160];
+    uint8_t order[WEBSOCKETS_ALLOC_SITES];
+    uint8_t used = allocUsed;
+    for(uint8_t i = 0; i < used; i++) {
+        order[i] = i;
+    }
+    for(uint8_t i = 1; i < used; i++) {
+        for(uint8_t j = i; j > 0 && allocGetBytes(&allocSites[order[j]]) > allocGetBytes(&allocSites[order[j - 1]]); j--) {
+            std::swap(order[j], order[j - 1]);
+        }
+    }
+
+    int n = snprintf(line, sizeof(line), "[alloc] %-24s %10s %12s %6s\n", "site", "allocs", "bytes", "avg");
+    out.write((const uint8_t *)line, std::min((size_t)n, sizeof(line) - 1));
+    for(uint8_t i = 0; i < used; i++) {
+        WSallocSiteState_t * site = &allocSites[order[i]];
+        uint32_t allocs           = site->allocs.get();
+        uint64_t bytes            = allocGetBytes(site);
+        n                         = snprintf(line, sizeof(line), "[alloc] %-24s %10lu %12llu %6lu\n", site->name, (unsigned long)allocs, (unsigned long long)bytes, (unsigned long)(allocs ? bytes / allocs : 0));
+        out.write((const uint8_t *)line, std::min((size_t)n, sizeof(line) - 1));
+    }
+    n = snprintf(line, sizeof(line), "[alloc] total %lu allocs %lu frees, live %lu B peak %lu B\n", (unsigned long)allocs(), (unsigned long)frees(), (unsigned long)live(), (unsigned long)peak());
+    out.write((const uint8_t *)line, std::min((size_t)n, sizeof(line) - 1));
+    if(allocHeap.samples > 0) {
+        n = snprintf(line, sizeof(line), "[alloc] heap free %lu largest %lu frag %u %% (min free %lu min largest %lu max frag %u %%)\n", (unsigned long)allocHeap.last.free, (unsigned long)allocHeap.last.largest, allocHeap.last.fragmentation, (unsigned long)allocHeap.minFree, (unsigned long)allocHeap.minLargest, allocHeap.maxFragmentation);
+        out.write((const uint8_t *)line, std::min((size_t)n, sizeof(line) - 1));
+    }
+}
+
+#if defined(WEBSOCKETS_HOST) && defined(__GLIBC__)
+
+// malloc & co. of the program replace the ones of the libc
+extern "C" {
+void * __libc_malloc(size_t size);
+void * __libc_calloc(size_t n, size_t size);
+void * __libc_realloc(void * ptr, size_t size);
+void * __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void * ptr);
+
+void * malloc(size_t size) {
+    void * ptr = __libc_malloc(size);
+    WebSocketsAlloc::allocated(ptr, size);
+    return ptr;
+}
+
+void * calloc(size_t n, size_t size) {
+    void * ptr = __libc_calloc(n, size);
+    WebSocketsAlloc::allocated(ptr, n * size);
+    return ptr;
+}
+
+void * realloc(void * ptr, size_t size) {
+    size_t old  = ptr ? malloc_usable_size(ptr) : 0;
+    void * next = __libc_realloc(ptr, size);
+    if(next || size == 0) {
+        if(ptr) {
+            freeCount(old);
+        }
+        WebSocketsAlloc::allocated(next, size);
+    }
+    return next;
+}
+
+void * memalign(size_t alignment, size_t size) {
+    void * ptr = __libc_memalign(alignment, size);
+    WebSocketsAlloc::allocated(ptr, size);
+    return ptr;
+}
+
+void * aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void ** out, size_t alignment, size_t size) {
+    *out = memalign(alignment, size);
+    return *out ? 0 : ENOMEM;
+}
+
+void free(void * ptr) {
+    WebSocketsAlloc::released(ptr);
+    __libc_free(ptr);
+}
+}
+
+#elif !defined(WEBSOCKETS_HOST)
+
+// -Wl,--wrap=malloc,--wrap=free,--wrap=calloc,--wrap=realloc
+extern "C" {
+void * __real_malloc(size_t size);
+void * __real_calloc(size_t n, size_t size);
+void * __real_realloc(void * ptr, size_t size);
+void __real_free(void * ptr);
+
+void * __wrap_malloc(size_t size) {
+    void * ptr = __real_malloc(size);
+    WebSocketsAlloc::allocated(ptr, size);
+    return ptr;
+}
+
+void * __wrap_calloc(size_t n, size_t size) {
+    void * ptr = __real_calloc(n, size);
+    WebSocketsAlloc::allocated(ptr, n * size);
+    return ptr;
+}
+
+void * __wrap_realloc(void * ptr, size_t size) {
+    void * next = __real_realloc(ptr, size);
+    if(next || size == 0) {
+        WebSocketsAlloc::released(ptr);
+        WebSocketsAlloc::allocated(next, size);
+    }
+    return next;
+}
+
+void __wrap_free(void * ptr) {
+    WebSocketsAlloc::released(ptr);
+    __real_free(ptr);
+}
+}
+
+#endif
+
+#endif
@@ -0,0 +1,103 @@
+/**
+ * @file WebSocketsAlloc.h
+ * @date 19.10.2026
+ *
+ * Copyright (c) 2026 WebSockets for Arduino contributors.
+ * This file is part of the WebSockets for Arduino.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef WEBSOCKETSALLOC_H_
+#define WEBSOCKETSALLOC_H_
+
+#include <Arduino.h>
+
+/*
+ * allocation profiler, counts malloc / calloc / realloc per call site (WEBSOCKETS_ALLOC_SCOPE)
+ * off by default, build with -DWEBSOCKETS_ALLOC_PROFILE (needs WEBSOCKETS_HAS_METRICS)
+ *  - glibc host: malloc & co. of the program are replaced, nothing else to do
+ *  - ESP32 / ESP8266 / RP2040: link with -Wl,--wrap=malloc,--wrap=free,--wrap=calloc,--wrap=realloc
+ */
+
+#ifndef WEBSOCKETS_ALLOC_SITES
+// call sites of the profiler, site 0 takes the allocations outside of any scope
+#define WEBSOCKETS_ALLOC_SITES (24)
+#endif
+
+#if defined(WEBSOCKETS_ALLOC_PROFILE) && defined(WEBSOCKETS_HAS_METRICS)
+#define WEBSOCKETS_HAS_ALLOC_PROFILE
+#endif
+
+#ifdef WEBSOCKETS_HAS_ALLOC_PROFILE
+
+typedef struct {
+    uint32_t samples;
+    WSheapInfo_t last;
+    uint32_t minFree;
+    uint32_t minLargest;
+    uint8_t maxFragmentation;
+} WSallocHeap_t;
+
+class WebSocketsAlloc {
+  public:
+    static uint8_t site(const char * name);
+    static uint8_t enter(uint8_t site);
+    static void leave(uint8_t previous);
+
+    static void allocated(void * ptr, size_t size);
+    static void released(void * ptr);
+
+    static void sample(void);
+    static void reset(void);
+
+    static uint32_t allocs(void);
+    static uint32_t frees(void);
+    static size_t live(void);
+    static size_t peak(void);
+    static const WSallocHeap_t & heap(void);
+
+    static void printTo(Print & out);
+};
+
+/**
+ * allocations while the scope lives count for its site, scopes nest
+ */
+class WebSocketsAllocScope {
+  public:
+    explicit WebSocketsAllocScope(uint8_t site)
+        : _previous(WebSocketsAlloc::enter(site)) {
+    }
+    ~WebSocketsAllocScope(void) {
+        WebSocketsAlloc::leave(_previous);
+    }
+
+  protected:
+    uint8_t _previous;
+};
+
+// the name has to be a literal, it is registered once per call site
+#define WEBSOCKETS_ALLOC_SCOPE(name)                                  \
+    static uint8_t _wsAllocSite = WebSocketsAlloc::site(name);        \
+    WebSocketsAllocScope _wsAllocScope(_wsAllocSite)
+
+#else
+
+#define WEBSOCKETS_ALLOC_SCOPE(name)
+
+#endif
+
+#endif /* WEBSOCKETSALLOC_H_ */
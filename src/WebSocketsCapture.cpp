@@ -0,0 +1,249 @@
+/**
+ * @file WebSocketsCapture.cpp
+ * @date 19.10.2026
+ *
+ * Copyright (c) 2026 WebSockets for Arduino contributors.
+ * This file is part of the WebSockets for Arduino.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "WebSockets.h"
+
+#ifdef WEBSOCKETS_HAS_CAPTURE
+
+WebSocketsCapture::WebSocketsCapture(Print & out)
+    : _out(&out)
+    , _active(false)
+    , _lastUs(0)
+    , _lastMs(0)
+    , _records(0)
+    , _bytes(0) {
+}
+
+/**
+ * write the file header, records are written from now on
+ */
+void WebSocketsCapture::begin(void) {
+    uint8_t version = WEBSOCKETS_CAPTURE_VERSION;
+    _records        = 0;
+    _bytes          = 0;
+    _lastUs         = micros();
+    _lastMs         = millis();
+    _active         = true;
+    write((const uint8_t *)WEBSOCKETS_CAPTURE_MAGIC, 4);
+    write(&version, 1);
+}
+
+/**
+ * stop recording, the Print is not closed
+ */
+void WebSocketsCapture::end(void) {
+    _active = false;
+}
+
+bool WebSocketsCapture::active(void) const {
+    return _active;
+}
+
+/**
+ * @param rx bool              true = received, false = sent
+ * @param opcode uint8_t       WSopcode_t
+ * @param fin bool
+ * @param payload const uint8_t *  unmasked / inflated
+ * @param length size_t
+ */
+void WebSocketsCapture::frame(bool rx, uint8_t opcode, bool fin, const uint8_t * payload, size_t length) {
+    if(!_active) {
+        return;
+    }
+    if(!payload) {
+        length = 0;
+    }
+    header(rx ? WSCAP_RX : WSCAP_TX, (opcode & 0x0F) | (fin ? 0x80 : 0x00), length);
+    write(payload, length);
+}
+
+void WebSocketsCapture::open(const String & url) {
+    if(!_active) {
+        return;
+    }
+    header(WSCAP_OPEN, 0, url.length());
+    write((const uint8_t *)url.c_str(), url.length());
+}
+
+void WebSocketsCapture::close(void) {
+    if(!_active) {
+        return;
+    }
+    header(WSCAP_CLOSE, 0, 0);
+}
+
+/**
+ * @param endpoint const String &  last part of the url (register, wifiList, ...)
+ * @param body const String &      posted JSON
+ */
+void WebSocketsCapture::httpRequest(const String & endpoint, const String & body) {
+    if(!_active) {
+        return;
+    }
+    header(WSCAP_HTTP_REQUEST, 0, endpoint.length() + 1 + body.length());
+    write((const uint8_t *)endpoint.c_str(), endpoint.length());
+    write((const uint8_t *)"\n", 1);
+    write((const uint8_t *)body.c_str(), body.length());
+}
+
+/**
+ * @param code int              HTTP status or the error of HTTPClient (< 0)
+ * @param body const String &
+ */
+void WebSocketsCapture::httpResponse(int code, const String & body) {
+    if(!_active) {
+        return;
+    }
+    header(WSCAP_HTTP_RESPONSE, zigzag(code), body.length());
+    write((const uint8_t *)body.c_str(), body.length());
+}
+
+uint32_t WebSocketsCapture::records(void) const {
+    return _records;
+}
+
+/**
+ * @return bytes written incl. the file header
+ */
+uint32_t WebSocketsCapture::bytes(void) const {
+    return _bytes;
+}
+
+uint32_t WebSocketsCapture::zigzag(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+int32_t WebSocketsCapture::unzigzag(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+void WebSocketsCapture::header(WScaptureType_t type, uint32_t arg, size_t length) {
+    unsigned long nowUs = micros();
+    unsigned long nowMs = millis();
+    uint64_t delta;
+    if((nowMs - _lastMs) > 60000) {
+        // micros() wraps after ~71 minutes
+        delta = (uint64_t)(nowMs - _lastMs) * 1000;
+    } else {
+        delta = (nowUs - _lastUs);
+    }
+    _lastUs = nowUs;
+    _lastMs = nowMs;
+
+    uint8_t t = type;
+    write(&t, 1);
+    varint(delta);
+    varint(arg);
+    varint(length);
+    _records++;
+}
+
+void WebSocketsCapture::write(const uint8_t * data, size_t length) {
+    if(length > 0) {
+        _bytes += _out->write(data, length);
+    }
+}
+
+void WebSocketsCapture::varint(uint64_t value) {
+    uint8_t buffer[10];
+    uint8_t len = 0;
+    do {
+        buffer[len] = (value & 0x7F);
+        value >>= 7;
+        if(value) {
+            buffer[len] |= 0x80;
+        }
+        len++;
+    } while(value);
+    write(buffer, len);
+}
+
+/**
+ * @param data const uint8_t *  the complete capture, has to stay valid while reading
+ * @param length size_t
+ */
+WebSocketsCaptureReader::WebSocketsCaptureReader(const uint8_t * data, size_t length)
+    : _data(data)
+    , _length(length)
+    , _pos(0)
+    , _time(0)
+    , _valid(false) {
+    _valid = (data && length >= 5 && memcmp(data, WEBSOCKETS_CAPTURE_MAGIC, 4) == 0 && data[4] == WEBSOCKETS_CAPTURE_VERSION);
+    rewind();
+}
+
+/**
+ * @return true if the data starts with the header of a known version
+ */
+bool WebSocketsCaptureReader::valid(void) const {
+    return _valid;
+}
+
+/**
+ * @param record WScaptureRecord_t *
+ * @return false at the end or if the rest is truncated (a capture cut off by a reset)
+ */
+bool WebSocketsCaptureReader::next(WScaptureRecord_t * record) {
+    uint64_t delta;
+    uint64_t arg;
+    uint64_t length;
+    if(!_valid || _pos >= _length) {
+        return false;
+    }
+    size_t start = _pos;
+    uint8_t type = _data[_pos++];
+    if(type < WSCAP_OPEN || type > WSCAP_HTTP_RESPONSE || !varint(&delta) || !varint(&arg) || !varint(&length) || length > (_length - _pos)) {
+        _pos = start;
+        return false;
+    }
+    _time += delta;
+    record->type    = (WScaptureType_t)type;
+    record->time    = _time;
+    record->arg     = (uint32_t)arg;
+    record->payload = &_data[_pos];
+    record->length  = (size_t)length;
+    _pos += length;
+    return true;
+}
+
+void WebSocketsCaptureReader::rewind(void) {
+    _pos  = 5;
+    _time = 0;
+}
+
+bool WebSocketsCaptureReader::varint(uint64_t * value) {
+    *value = 0;
+    for(uint8_t shift = 0; shift < 64; shift += 7) {
+        if(_pos >= _length) {
+            return false;
+        }
+        uint8_t b = _data[_pos++];
+        *value |= ((uint64_t)(b & 0x7F) << shift);
+        if(!(b & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif
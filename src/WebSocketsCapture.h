@@ -0,0 +1,120 @@
+/**
+ * @file WebSocketsCapture.h
+ * @date 19.10.2026
+ *
+ * Copyright (c) 2026 WebSockets for Arduino contributors.
+ * This file is part of the WebSockets for Arduino.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef WEBSOCKETSCAPTURE_H_
+#define WEBSOCKETSCAPTURE_H_
+
+#include <Arduino.h>
+
+/*
+ * capture of a session (WebSocketsClient::setCapture), replayed on the host by extras/replay
+ * file: "WSCP" + version, then the records
+ *   type uint8_t | time varint (us since the record before) | arg varint | length varint | payload
+ *  - frames: arg = opcode | fin << 7, payload as the application sees it (unmasked, inflated)
+ *  - HTTP:   WSCAP_HTTP_REQUEST payload = endpoint '\n' body
+ *            WSCAP_HTTP_RESPONSE arg = code (zigzag, HTTPClient errors are < 0), payload = body
+ */
+
+#define WEBSOCKETS_CAPTURE_MAGIC "WSCP"
+#define WEBSOCKETS_CAPTURE_VERSION (1)
+
+#ifdef WEBSOCKETS_HAS_CAPTURE
+
+typedef enum {
+    WSCAP_OPEN = 1,         ///< WebSocket connected, payload = url
+    WSCAP_CLOSE,            ///< WebSocket disconnected
+    WSCAP_RX,               ///< frame received
+    WSCAP_TX,               ///< frame sent
+    WSCAP_HTTP_REQUEST,     ///< request of Automata::sendHttp
+    WSCAP_HTTP_RESPONSE,    ///< result of Automata::sendHttp
+} WScaptureType_t;
+
+typedef struct {
+    WScaptureType_t type;
+    uint64_t time;              ///< us since the start of the capture
+    uint32_t arg;               ///< opcode | fin << 7, zigzag HTTP code
+    const uint8_t * payload;    ///< points into the data of the reader
+    size_t length;
+} WScaptureRecord_t;
+
+/**
+ * writes the records to a Print (File on SD / LittleFS, Serial, ...)
+ * only used from the loop of the client, there is no locking
+ */
+class WebSocketsCapture {
+  public:
+    explicit WebSocketsCapture(Print & out);
+
+    void begin(void);
+    void end(void);
+    bool active(void) const;
+
+    void frame(bool rx, uint8_t opcode, bool fin, const uint8_t * payload, size_t length);
+    void open(const String & url);
+    void close(void);
+    void httpRequest(const String & endpoint, const String & body);
+    void httpResponse(int code, const String & body);
+
+    uint32_t records(void) const;
+    uint32_t bytes(void) const;
+
+    static uint32_t zigzag(int32_t value);
+    static int32_t unzigzag(uint32_t value);
+
+  protected:
+    Print * _out;
+    bool _active;
+    unsigned long _lastUs;    ///< micros() of the record before
+    unsigned long _lastMs;    ///< millis() of the record before, for gaps longer then micros() can count
+    uint32_t _records;
+    uint32_t _bytes;
+
+    void header(WScaptureType_t type, uint32_t arg, size_t length);
+    void write(const uint8_t * data, size_t length);
+    void varint(uint64_t value);
+};
+
+/**
+ * reads the records of a capture in memory
+ */
+class WebSocketsCaptureReader {
+  public:
+    WebSocketsCaptureReader(const uint8_t * data, size_t length);
+
+    bool valid(void) const;
+    bool next(WScaptureRecord_t * record);
+    void rewind(void);
+
+  protected:
+    const uint8_t * _data;
+    size_t _length;
+    size_t _pos;
+    uint64_t _time;
+    bool _valid;
+
+    bool varint(uint64_t * value);
+};
+
+#endif
+
+#endif /* WEBSOCKETSCAPTURE_H_ */
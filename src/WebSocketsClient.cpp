@@ -30,13 +30,19 @@ WebSocketsClient::WebSocketsClient() {
     _client.num          = 0;
     _client.cIsClient    = true;
     _client.extraHeaders = WEBSOCKETS_STRING("Origin: file://");
-    _reconnectInterval   = 500;
     _port                = 0;
     _host                = "";
+    _handshake           = NULL;
+    _handshakeLen        = 0;
+    _headerLineLen       = 0;
+    _connectPhase        = WSCP_IDLE;
+    _phaseStart          = 0;
+    memset(&_connectStats, 0, sizeof(_connectStats));
 }
 
 WebSocketsClient::~WebSocketsClient() {
     disconnect();
+    releaseHandshake();
 }
 
 /**
@@ -86,8 +92,12 @@ void WebSocketsClient::begin(const char * host, uint16_t port, const char * url,
     asyncConnect();
 #endif
 
-    _lastConnectionFail = 0;
-    _lastHeaderSent     = 0;
+    _timers.clear();
+    _reconnect.reset();
+    _headerLineLen = 0;
+    _connectPhase  = WSCP_IDLE;
+
+    buildHandshake();
 
     DEBUG_WEBSOCKETS("[WS-Client] Websocket Version: " WEBSOCKETS_VERSION "\n");
 }
@@ -204,85 +214,219 @@ void WebSocketsClient::loop(void) {
         return;
     }
     WEBSOCKETS_YIELD();
+    if(_connectPhase >= WSCP_DNS && _connectPhase <= WSCP_TLS) {
+        // one connect phase per loop, the sketch runs in between
+        connectStep();
+        return;
+    }
     if(!clientIsConnected(&_client)) {
         // do not flood the server
-        if((millis() - _lastConnectionFail) < _reconnectInterval) {
+        if(_timers.remaining(WSCT_RECONNECT, millis()) > 0) {
             return;
         }
+        _timers.cancel(WSCT_RECONNECT);
+
+        if(connectBegin()) {
+            connectStep();
+        }
+    } else {
+        // frames created while handling this loop (pong, acks, heartbeat) leave in one write
+        WebSockets::cork(&_client);
+        handleClientData();
+        WEBSOCKETS_YIELD();
+        if(_client.status == WSC_CONNECTED && _timers.remaining(WSCT_HEARTBEAT, millis()) == 0) {
+            handleHBPing();
+            handleHBTimeout(&_client);
+            scheduleHeartbeat();
+        }
+        WebSockets::uncork(&_client);
+    }
+}
 
+/**
+ * create the network client and start a connection attempt with WSCP_DNS
+ * @return false if the network client can not be created
+ */
+bool WebSocketsClient::connectBegin(void) {
 #if defined(HAS_SSL)
-        if(_client.isSSL) {
-            DEBUG_WEBSOCKETS("[WS-Client] connect wss...\n");
-            if(_client.ssl) {
-                delete _client.ssl;
-                _client.ssl = NULL;
-                _client.tcp = NULL;
-            }
-            _client.ssl = new WEBSOCKETS_NETWORK_SSL_CLASS();
-            _client.tcp = _client.ssl;
-            if(_CA_cert) {
-                DEBUG_WEBSOCKETS("[WS-Client] setting CA certificate");
+    if(_client.isSSL) {
+        DEBUG_WEBSOCKETS("[WS-Client] connect wss...\n");
+        if(_client.ssl) {
+            delete _client.ssl;
+            _client.ssl = NULL;
+            _client.tcp = NULL;
+        }
+        _client.ssl = new WEBSOCKETS_NETWORK_SSL_CLASS();
+        _client.tcp = _client.ssl;
+        if(_CA_cert) {
+            DEBUG_WEBSOCKETS("[WS-Client] setting CA certificate");
 #if defined(ESP32)
-                _client.ssl->setCACert(_CA_cert);
+            _client.ssl->setCACert(_CA_cert);
 #elif defined(ESP8266) && defined(SSL_AXTLS)
-                _client.ssl->setCACert((const uint8_t *)_CA_cert, strlen(_CA_cert) + 1);
+            _client.ssl->setCACert((const uint8_t *)_CA_cert, strlen(_CA_cert) + 1);
 #elif(defined(ESP8266) || defined(ARDUINO_ARCH_RP2040)) && defined(SSL_BARESSL)
-                _client.ssl->setTrustAnchors(_CA_cert);
+            _client.ssl->setTrustAnchors(_CA_cert);
 #else
 #error setCACert not implemented
 #endif
 #if defined(ESP32)
-            } else if(!SSL_FINGERPRINT_IS_SET) {
-                _client.ssl->setInsecure();
+        } else if(!SSL_FINGERPRINT_IS_SET) {
+            _client.ssl->setInsecure();
 #elif defined(SSL_BARESSL)
-            } else if(SSL_FINGERPRINT_IS_SET) {
-                _client.ssl->setFingerprint(_fingerprint);
-            } else {
-                _client.ssl->setInsecure();
+        } else if(SSL_FINGERPRINT_IS_SET) {
+            _client.ssl->setFingerprint(_fingerprint);
+        } else {
+            _client.ssl->setInsecure();
+        }
+        if(_client_cert && _client_key) {
+            _client.ssl->setClientRSACert(_client_cert, _client_key);
+            DEBUG_WEBSOCKETS("[WS-Client] setting client certificate and key");
+#endif
+        }
+    } else {
+        DEBUG_WEBSOCKETS("[WS-Client] connect ws...\n");
+        if(_client.tcp) {
+            delete _client.tcp;
+            _client.tcp = NULL;
+        }
+        _client.tcp = new WEBSOCKETS_NETWORK_CLASS();
+    }
+#else
+    _client.tcp = new WEBSOCKETS_NETWORK_CLASS();
+#endif
+
+    if(!_client.tcp) {
+        DEBUG_WEBSOCKETS("[WS-Client] creating Network class failed!");
+        return false;
+    }
+
+    _connectStats.attempts++;
+    memset(_connectStats.duration, 0, sizeof(_connectStats.duration));
+#if defined(HAS_SSL)
+    if(_client.isSSL) {
+        // the TLS client connects by name (SNI, certificate check) and resolves the host itself
+        enterPhase(WSCP_TLS);
+        return true;
+    }
+#endif
+    enterPhase(WSCP_DNS);
+    return true;
+}
+
+/**
+ * run the current connect phase
+ * only NETWORK_POSIX connects without blocking: it starts a non blocking TCP connect and polls it in each loop
+ * on the device cores DNS, the TCP connect and the TLS handshake are one blocking call each, bounded by WEBSOCKETS_TCP_TIMEOUT
+ */
+void WebSocketsClient::connectStep(void) {
+    if(_timers.remaining(WSCT_CONNECT, millis()) == 0) {
+        DEBUG_WEBSOCKETS("[WS-Client] connect phase %d timeout\n", _connectPhase);
+        connectFailed();
+        return;
+    }
+
+    bool ok = true;
+    switch(_connectPhase) {
+        case WSCP_DNS:
+#ifdef WEBSOCKETS_CLIENT_RESOLVE
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_POSIX)
+            ok = WSPosixClient::resolve(_host.c_str(), _connectIP);
+#else
+            ok = (WiFi.hostByName(_host.c_str(), _connectIP) == 1);
+#endif
+            if(!ok) {
+                DEBUG_WEBSOCKETS("[WS-Client] can not resolve %s\n", _host.c_str());
+                break;
             }
-            if(_client_cert && _client_key) {
-                _client.ssl->setClientRSACert(_client_cert, _client_key);
-                DEBUG_WEBSOCKETS("[WS-Client] setting client certificate and key");
 #endif
+            enterPhase(WSCP_TCP);
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_POSIX)
+            if(_client.tcp->connectStart(_connectIP, _port) < 0) {
+                ok = false;
             }
-        } else {
-            DEBUG_WEBSOCKETS("[WS-Client] connect ws...\n");
-            if(_client.tcp) {
-                delete _client.tcp;
-                _client.tcp = NULL;
+#endif
+            break;
+
+        case WSCP_TCP:
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_POSIX)
+            switch(_client.tcp->connectPoll()) {
+                case 0:
+                    return;
+                case 1:
+                    break;
+                default:
+                    ok = false;
+                    break;
             }
-            _client.tcp = new WEBSOCKETS_NETWORK_CLASS();
-        }
+#elif defined(WEBSOCKETS_CLIENT_RESOLVE) && defined(ESP32)
+            ok = _client.tcp->connect(_connectIP, _port, WEBSOCKETS_TCP_TIMEOUT);
+#elif defined(WEBSOCKETS_CLIENT_RESOLVE)
+            ok = _client.tcp->connect(_connectIP, _port);
 #else
-        _client.tcp = new WEBSOCKETS_NETWORK_CLASS();
+            ok = _client.tcp->connect(_host.c_str(), _port);
 #endif
+            if(ok) {
+                enterPhase(WSCP_UPGRADE);
+                connectedCb();
+                return;
+            }
+            break;
 
-        if(!_client.tcp) {
-            DEBUG_WEBSOCKETS("[WS-Client] creating Network class failed!");
-            return;
-        }
-        WEBSOCKETS_YIELD();
+        case WSCP_TLS:
+            // by name, the TLS client needs it for SNI and the certificate check
 #if defined(ESP32)
-        if(_client.tcp->connect(_host.c_str(), _port, WEBSOCKETS_TCP_TIMEOUT)) {
+            ok = _client.tcp->connect(_host.c_str(), _port, WEBSOCKETS_TCP_TIMEOUT);
 #else
-        if(_client.tcp->connect(_host.c_str(), _port)) {
+            ok = _client.tcp->connect(_host.c_str(), _port);
 #endif
-            connectedCb();
-            _lastConnectionFail = 0;
-        } else {
-            connectFailedCb();
-            _lastConnectionFail = millis();
+            if(ok) {
+                enterPhase(WSCP_UPGRADE);
+                connectedCb();
+                return;
+            }
+            break;
+
+        default:
+            return;
+    }
+
+    if(!ok) {
+        connectFailed();
+    }
+}
+
+/**
+ * a connect phase failed, the next attempt is scheduled by clientDisconnect
+ */
+void WebSocketsClient::connectFailed(void) {
+    connectFailedCb();
+    clientDisconnect(&_client);
+}
+#endif
+
+/**
+ * end the current connect phase and record its duration
+ * a failure is counted when the attempt ends before WSCP_UPGRADE is done
+ * @param phase WSconnectPhase_t  next phase
+ */
+void WebSocketsClient::enterPhase(WSconnectPhase_t phase) {
+    unsigned long now = millis();
+    if(_connectPhase != WSCP_IDLE) {
+        _connectStats.duration[_connectPhase] = now - _phaseStart;
+        if(phase == WSCP_IDLE && _client.status != WSC_CONNECTED) {
+            _connectStats.failures++;
+            _connectStats.failedPhase = _connectPhase;
         }
+    }
+    _connectPhase = phase;
+    _phaseStart   = now;
+
+    if(phase >= WSCP_DNS && phase <= WSCP_TLS) {
+        _timers.set(WSCT_CONNECT, now + WEBSOCKETS_TCP_TIMEOUT);
     } else {
-        handleClientData();
-        WEBSOCKETS_YIELD();
-        if(_client.status == WSC_CONNECTED) {
-            handleHBPing();
-            handleHBTimeout(&_client);
-        }
+        _timers.cancel(WSCT_CONNECT);
     }
 }
-#endif
 
 /**
  * set callback function
@@ -381,6 +525,70 @@ void WebSocketsClient::disconnect(void) {
     }
 }
 
+/**
+ * collect all following frames in the cork buffer until uncork is called
+ * can be nested
+ */
+void WebSocketsClient::cork(void) {
+    WebSockets::cork(&_client);
+}
+
+/**
+ * send all frames collected since cork with one write
+ * @return true if ok, false if the write failed and the connection is closed
+ */
+bool WebSocketsClient::uncork(void) {
+    return WebSockets::uncork(&_client);
+}
+
+/**
+ * estimated bytes on wire saved by coalescing frames
+ * @return uint32_t
+ */
+uint32_t WebSocketsClient::corkSavedBytes(void) {
+    return _client.txSavedBytes;
+}
+
+/**
+ * start a message that is send in fragments with streamWrite / streamEnd
+ * the message does not need to be in RAM as a whole
+ * @param binary bool   send as binary instead of text message
+ * @return true if ok
+ */
+bool WebSocketsClient::streamBegin(bool binary) {
+    if(clientIsConnected(&_client)) {
+        return WebSockets::streamBegin(&_client, binary ? WSop_binary : WSop_text);
+    }
+    return false;
+}
+
+/**
+ * send the next fragment of the streamed message
+ * @param payload const uint8_t *
+ * @param length size_t
+ * @return true if ok
+ */
+bool WebSocketsClient::streamWrite(const uint8_t * payload, size_t length) {
+    if(length == 0) {
+        return true;
+    }
+    return streamFrame(&_client, payload, length, false);
+}
+
+bool WebSocketsClient::streamWrite(const char * payload) {
+    return streamWrite((const uint8_t *)payload, strlen(payload));
+}
+
+/**
+ * send the last fragment and end the streamed message
+ * @param payload const uint8_t *   (optional)
+ * @param length size_t
+ * @return true if ok
+ */
+bool WebSocketsClient::streamEnd(const uint8_t * payload, size_t length) {
+    return streamFrame(&_client, payload, length, true);
+}
+
 /**
  * set the Authorizatio for the http request
  * @param user const char *
@@ -392,6 +600,7 @@ void WebSocketsClient::setAuthorization(const char * user, const char * password
         auth += ":";
         auth += password;
         _client.base64Authorization = base64_encode((uint8_t *)auth.c_str(), auth.length());
+        releaseHandshake();
     }
 }
 
@@ -403,6 +612,7 @@ void WebSocketsClient::setAuthorization(const char * auth) {
     if(auth) {
         //_client.base64Authorization = auth;
         _client.plainAuthorization = auth;
+        releaseHandshake();
     }
 }
 
@@ -413,21 +623,94 @@ void WebSocketsClient::setAuthorization(const char * auth) {
  */
 void WebSocketsClient::setExtraHeaders(const char * extraHeaders) {
     _client.extraHeaders = extraHeaders;
+    releaseHandshake();
 }
 
 /**
  * set the reconnect Interval
  * how long to wait after a connection initiate failed
+ * fixed interval, see setReconnectBackoff for the default backoff
  * @param time in ms
  */
 void WebSocketsClient::setReconnectInterval(unsigned long time) {
-    _reconnectInterval = time;
+    _reconnect.setInterval(time, time);
+}
+
+/**
+ * wait random(0 .. min(max, base * 2^n)) ms before the n-th retry
+ * the backoff starts over when a connection lasted WEBSOCKETS_RECONNECT_STABLE_TIME
+ * @param base unsigned long  ms
+ * @param max unsigned long   ms
+ */
+void WebSocketsClient::setReconnectBackoff(unsigned long base, unsigned long max) {
+    _reconnect.setInterval(base, max);
 }
 
 bool WebSocketsClient::isConnected(void) {
     return (_client.status == WSC_CONNECTED);
 }
 
+/**
+ * for tracing a message through the layers above, valid in the event callback
+ * @return unsigned long micros when the reading of the last received frame started
+ */
+unsigned long WebSocketsClient::frameStart(void) {
+    return _client.rxFrameStart;
+}
+
+#ifdef WEBSOCKETS_HAS_CAPTURE
+/**
+ * record the frames and (re)connects of this client, see extras/replay
+ * @param capture WebSocketsCapture *   started with begin(), NULL = stop recording
+ */
+void WebSocketsClient::setCapture(WebSocketsCapture * capture) {
+    _client.capture = capture;
+    if(capture && _client.status == WSC_CONNECTED) {
+        capture->open(_client.cUrl);
+    }
+}
+#endif
+
+/**
+ * time until loop() has the next reconnect, handshake timeout or heartbeat to handle
+ * the network task can sleep this long if no data is expected
+ * @return long ms, 0 = now, -1 = nothing scheduled
+ */
+long WebSocketsClient::nextTimeout(void) {
+    if(_port == 0) {
+        return -1;
+    }
+    if(_connectPhase >= WSCP_DNS && _connectPhase <= WSCP_TLS) {
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_POSIX)
+        if(_connectPhase == WSCP_TCP) {
+            // the connect is polled, not reported by the socket
+            return std::min(_timers.remaining(WSCT_CONNECT, millis()), (long)WEBSOCKETS_CONNECT_POLL_INTERVAL);
+        }
+#endif
+        return 0;
+    }
+    if(_client.status == WSC_NOT_CONNECTED && !_timers.pending(WSCT_RECONNECT)) {
+        return 0;
+    }
+    return _timers.next(millis());
+}
+
+/**
+ * @return WSconnectPhase_t  phase of the connection attempt in progress, WSCP_IDLE if none
+ */
+WSconnectPhase_t WebSocketsClient::connectPhase(void) {
+    return _connectPhase;
+}
+
+/**
+ * per phase timing of the last connection attempt and attempt / failure counters
+ * the phases run in separate loop() calls, but only NETWORK_POSIX does the TCP connect without blocking,
+ * on the device cores each phase is one blocking call (wss has no WSCP_DNS, the TLS client resolves the host)
+ */
+const WSconnectStats_t & WebSocketsClient::connectStats(void) {
+    return _connectStats;
+}
+
 // #################################################################################
 // #################################################################################
 // #################################################################################
@@ -504,19 +787,40 @@ void WebSocketsClient::clientDisconnect(WSclient_t * client) {
         client->tcp = NULL;
     }
 
+    releaseCork(client);
+    client->txStream = false;
+#ifdef WEBSOCKETS_HAS_DEFLATE
+    releaseDeflate(client);
+#endif
+
     client->cCode        = 0;
     client->cKey         = "";
     client->cAccept      = "";
+    client->cExtensions  = "";
     client->cVersion     = 0;
     client->cIsUpgrade   = false;
     client->cIsWebsocket = false;
     client->cSessionId   = "";
+    _headerLineLen       = 0;
 
-    client->status      = WSC_NOT_CONNECTED;
-    _lastConnectionFail = millis();
+    if(_connectPhase != WSCP_IDLE) {
+        // attempt ends before the upgrade was done
+        enterPhase(WSCP_IDLE);
+    }
+
+    client->status = WSC_NOT_CONNECTED;
+    _timers.cancel(WSCT_HEADER);
+    _timers.cancel(WSCT_HEARTBEAT);
+    _timers.set(WSCT_RECONNECT, millis() + _reconnect.next(millis()));
+    WEBSOCKETS_METRIC_ADD("ws.reconnects", 1);
 
     DEBUG_WEBSOCKETS("[WS-Client] client disconnected.\n");
     if(event) {
+#ifdef WEBSOCKETS_HAS_CAPTURE
+        if(client->capture) {
+            client->capture->close();
+        }
+#endif
         runCbEvent(WStype_DISCONNECTED, NULL, 0);
     }
 }
@@ -556,7 +860,7 @@ bool WebSocketsClient::clientIsConnected(WSclient_t * client) {
  * Handel incomming data from Client
  */
 void WebSocketsClient::handleClientData(void) {
-    if((_client.status == WSC_HEADER || _client.status == WSC_BODY) && _lastHeaderSent + WEBSOCKETS_TCP_TIMEOUT < millis()) {
+    if((_client.status == WSC_HEADER || _client.status == WSC_BODY) && _timers.remaining(WSCT_HEADER, millis()) == 0) {
         DEBUG_WEBSOCKETS("[WS-Client][handleClientData] header response timeout.. disconnecting!\n");
         clientDisconnect(&_client);
         WEBSOCKETS_YIELD();
@@ -566,15 +870,25 @@ void WebSocketsClient::handleClientData(void) {
     int len = _client.tcp->available();
     if(len > 0) {
         switch(_client.status) {
-            case WSC_HEADER: {
-                String headerLine = _client.tcp->readStringUntil('\n');
-                handleHeader(&_client, &headerLine);
-            } break;
+            case WSC_HEADER:
+                // collect the line in place, the status changes with the last header line
+                while(len-- > 0 && _client.status == WSC_HEADER) {
+                    int c = _client.tcp->read();
+                    if(c < 0) {
+                        break;
+                    }
+                    if(c == '\n') {
+                        size_t lineLen = _headerLineLen;
+                        _headerLineLen = 0;
+                        handleHeaderLine(&_client, &_headerLine[0], lineLen);
+                    } else if(_headerLineLen < (sizeof(_headerLine) - 1)) {
+                        _headerLine[_headerLineLen++] = (char)c;
+                    }
+                }
+                break;
             case WSC_BODY: {
-                char buf[256] = { 0 };
-                _client.tcp->readBytes(&buf[0], std::min((size_t)len, sizeof(buf)));
-                String bodyLine = buf;
-                handleHeader(&_client, &bodyLine);
+                size_t bodyLen = _client.tcp->readBytes(&_headerLine[0], std::min((size_t)len, sizeof(_headerLine) - 1));
+                handleHeaderLine(&_client, &_headerLine[0], bodyLen);
             } break;
             case WSC_CONNECTED:
                 WebSockets::handleWebsocket(&_client);
@@ -589,164 +903,276 @@ void WebSocketsClient::handleClientData(void) {
 #endif
 
 /**
- * send the WebSocket header to Server
- * @param client WSclient_t *  ptr to the client struct
+ * 32 bit from the hardware RNG if there is one
  */
-void WebSocketsClient::sendHeader(WSclient_t * client) {
+static uint32_t randomWord(void) {
+#ifdef ESP8266
+    return RANDOM_REG32;
+#elif defined(ESP32)
+    return esp_random();
+#elif defined(ARDUINO_ARCH_RP2040)
+    return rp2040.hwrand32();
+#else
+    return ((uint32_t)random(0x10000) << 16) | (uint32_t)random(0x10000);
+#endif
+}
+
+/**
+ * build the upgrade request once (begin / settings changed),
+ * sendHeader only patches the key and the Socket.IO query into it
+ */
+void WebSocketsClient::buildHandshake(void) {
     static const char * NEW_LINE = "\r\n";
 
-    DEBUG_WEBSOCKETS("[WS-Client][sendHeader] sending header...\n");
+    releaseHandshake();
 
-    uint8_t randomKey[16] = { 0 };
+    String handshake = WEBSOCKETS_STRING("GET ");
+    handshake += _client.cUrl;
+    uint16_t urlEnd = handshake.length();
 
-    for(uint8_t i = 0; i < sizeof(randomKey); i++) {
-        randomKey[i] = random(0xFF);
+    handshake += WEBSOCKETS_STRING(
+        " HTTP/1.1\r\n"
+        "Host: ");
+    handshake += _host + ":" + _port + NEW_LINE;
+    uint16_t hostEnd = handshake.length();
+
+    handshake += WEBSOCKETS_STRING(
+        "Connection: Upgrade\r\n"
+        "Upgrade: websocket\r\n"
+        "Sec-WebSocket-Version: 13\r\n"
+        "Sec-WebSocket-Key: ");
+    uint16_t key = handshake.length();
+    // placeholder, same length as the base64 of the 16 byte key
+    handshake += WEBSOCKETS_STRING("AAAAAAAAAAAAAAAAAAAAAA==\r\n");
+
+    if(_client.cProtocol.length() > 0) {
+        handshake += WEBSOCKETS_STRING("Sec-WebSocket-Protocol: ");
+        handshake += _client.cProtocol + NEW_LINE;
     }
 
-    client->cKey = base64_encode(&randomKey[0], 16);
-
-#ifndef NODEBUG_WEBSOCKETS
-    unsigned long start = micros();
+#ifdef WEBSOCKETS_HAS_DEFLATE
+    if(_client.cDeflateBits > 0) {
+        handshake += WEBSOCKETS_STRING("Sec-WebSocket-Extensions: ");
+        handshake += deflateOffer(&_client) + NEW_LINE;
+    }
 #endif
+    uint16_t wsEnd = handshake.length();
 
-    String handshake;
-    bool ws_header = true;
-    String url     = client->cUrl;
+    // add extra headers; by default this includes "Origin: file://"
+    if(_client.extraHeaders.length() > 0) {
+        handshake += _client.extraHeaders + NEW_LINE;
+    }
 
-    if(client->isSocketIO) {
-        if(client->cSessionId.length() == 0) {
-            url += WEBSOCKETS_STRING("&transport=polling");
-            ws_header = false;
-        } else {
-            url += WEBSOCKETS_STRING("&transport=websocket&sid=");
-            url += client->cSessionId;
-        }
+    handshake += WEBSOCKETS_STRING("User-Agent: arduino-WebSocket-Client\r\n");
+
+    if(_client.base64Authorization.length() > 0) {
+        handshake += WEBSOCKETS_STRING("Authorization: Basic ");
+        handshake += _client.base64Authorization + NEW_LINE;
     }
 
-    handshake = WEBSOCKETS_STRING("GET ");
-    handshake += url + WEBSOCKETS_STRING(
-                           " HTTP/1.1\r\n"
-                           "Host: ");
-    handshake += _host + ":" + _port + NEW_LINE;
+    if(_client.plainAuthorization.length() > 0) {
+        handshake += WEBSOCKETS_STRING("Authorization: ");
+        handshake += _client.plainAuthorization + NEW_LINE;
+    }
 
-    if(ws_header) {
-        handshake += WEBSOCKETS_STRING(
-            "Connection: Upgrade\r\n"
-            "Upgrade: websocket\r\n"
-            "Sec-WebSocket-Version: 13\r\n"
-            "Sec-WebSocket-Key: ");
-        handshake += client->cKey + NEW_LINE;
-
-        if(client->cProtocol.length() > 0) {
-            handshake += WEBSOCKETS_STRING("Sec-WebSocket-Protocol: ");
-            handshake += client->cProtocol + NEW_LINE;
-        }
+    handshake += NEW_LINE;
 
-        if(client->cExtensions.length() > 0) {
-            handshake += WEBSOCKETS_STRING("Sec-WebSocket-Extensions: ");
-            handshake += client->cExtensions + NEW_LINE;
-        }
-    } else {
-        handshake += WEBSOCKETS_STRING("Connection: keep-alive\r\n");
+    _handshake = (char *)malloc(handshake.length() + 1);
+    if(!_handshake) {
+        DEBUG_WEBSOCKETS("[WS-Client][buildHandshake] no memory for handshake (%d)!\n", handshake.length());
+        return;
     }
+    memcpy(_handshake, handshake.c_str(), handshake.length() + 1);
+    _handshakeLen     = handshake.length();
+    _handshakeUrlEnd  = urlEnd;
+    _handshakeHostEnd = hostEnd;
+    _handshakeKey     = key;
+    _handshakeWsEnd   = wsEnd;
+}
 
-    // add extra headers; by default this includes "Origin: file://"
-    if(client->extraHeaders.length() > 0) {
-        handshake += client->extraHeaders + NEW_LINE;
+/**
+ * drop the prebuilt upgrade request, it is build again on the next connect
+ */
+void WebSocketsClient::releaseHandshake(void) {
+    if(_handshake) {
+        free(_handshake);
+        _handshake = NULL;
     }
+    _handshakeLen = 0;
+}
 
-    handshake += WEBSOCKETS_STRING("User-Agent: arduino-WebSocket-Client\r\n");
+/**
+ * send the WebSocket header to Server
+ * @param client WSclient_t *  ptr to the client struct
+ */
+void WebSocketsClient::sendHeader(WSclient_t * client) {
+    DEBUG_WEBSOCKETS("[WS-Client][sendHeader] sending header...\n");
 
-    if(client->base64Authorization.length() > 0) {
-        handshake += WEBSOCKETS_STRING("Authorization: Basic ");
-        handshake += client->base64Authorization + NEW_LINE;
+#ifndef NODEBUG_WEBSOCKETS
+    unsigned long start = micros();
+#endif
+
+    if(!_handshake) {
+        buildHandshake();
+        if(!_handshake) {
+            clientDisconnect(client);
+            return;
+        }
     }
 
-    if(client->plainAuthorization.length() > 0) {
-        handshake += WEBSOCKETS_STRING("Authorization: ");
-        handshake += client->plainAuthorization + NEW_LINE;
+    uint32_t randomKey[4];
+    for(uint8_t i = 0; i < 4; i++) {
+        randomKey[i] = randomWord();
     }
 
-    handshake += NEW_LINE;
+    char key[WEBSOCKETS_BASE64_LENGTH(sizeof(randomKey)) + 1];
+    base64_encode((uint8_t *)&randomKey[0], sizeof(randomKey), &key[0], sizeof(key));
+    memcpy(&_handshake[_handshakeKey], &key[0], sizeof(key) - 1);
+    client->cKey = key;
 
-    DEBUG_WEBSOCKETS("[WS-Client][sendHeader] handshake %s", (uint8_t *)handshake.c_str());
-    write(client, (uint8_t *)handshake.c_str(), handshake.length());
+    DEBUG_WEBSOCKETS("[WS-Client][sendHeader] handshake %s", _handshake);
+
+    if(client->isSocketIO) {
+        // the query goes behind the url, send the parts as one segment
+        WebSockets::cork(client);
+        write(client, (uint8_t *)&_handshake[0], _handshakeUrlEnd);
+        if(client->cSessionId.length() == 0) {
+            write(client, "&transport=polling");
+            write(client, (uint8_t *)&_handshake[_handshakeUrlEnd], _handshakeHostEnd - _handshakeUrlEnd);
+            write(client, "Connection: keep-alive\r\n");
+        } else {
+            write(client, "&transport=websocket&sid=");
+            write(client, client->cSessionId.c_str());
+            write(client, (uint8_t *)&_handshake[_handshakeUrlEnd], _handshakeWsEnd - _handshakeUrlEnd);
+        }
+        write(client, (uint8_t *)&_handshake[_handshakeWsEnd], _handshakeLen - _handshakeWsEnd);
+        if(!WebSockets::uncork(client)) {
+            // closed by flushCork
+            return;
+        }
+    } else {
+        write(client, (uint8_t *)&_handshake[0], _handshakeLen);
+    }
 
 #if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
     client->tcp->readStringUntil('\n', &(client->cHttpLine), std::bind(&WebSocketsClient::handleHeader, this, client, &(client->cHttpLine)));
 #endif
 
     DEBUG_WEBSOCKETS("[WS-Client][sendHeader] sending header... Done (%luus).\n", (micros() - start));
-    _lastHeaderSent = millis();
+    _timers.set(WSCT_HEADER, millis() + WEBSOCKETS_TCP_TIMEOUT);
 }
 
 /**
  * handle the WebSocket header reading
  * @param client WSclient_t *  ptr to the client struct
+ * @param headerLine String *
  */
 void WebSocketsClient::handleHeader(WSclient_t * client, String * headerLine) {
-    headerLine->trim();    // remove \r
+    size_t len = std::min((size_t)headerLine->length(), sizeof(_headerLine) - 1);
+    memcpy(&_headerLine[0], headerLine->c_str(), len);
+    (*headerLine) = "";
+    handleHeaderLine(client, &_headerLine[0], len);
+}
+
+/**
+ * handle one line of the server response, parsed in place
+ * @param client WSclient_t *  ptr to the client struct
+ * @param line char *  line without \n, one byte space for the terminating 0 is needed
+ * @param len size_t
+ */
+void WebSocketsClient::handleHeaderLine(WSclient_t * client, char * line, size_t len) {
+    // remove \r and white space (like String::trim)
+    while(len > 0 && isspace((unsigned char)line[len - 1])) {
+        len--;
+    }
+    line[len] = 0x00;
+    while(len > 0 && isspace((unsigned char)*line)) {
+        line++;
+        len--;
+    }
 
     // this code handels the http body for Socket.IO V3 requests
-    if(headerLine->length() > 0 && client->isSocketIO && client->status == WSC_BODY && client->cSessionId.length() == 0) {
-        DEBUG_WEBSOCKETS("[WS-Client][handleHeader] socket.io json: %s\n", headerLine->c_str());
-        String sid_begin = WEBSOCKETS_STRING("\"sid\":\"");
-        if(headerLine->indexOf(sid_begin) > -1) {
-            int start          = headerLine->indexOf(sid_begin) + sid_begin.length();
-            int end            = headerLine->indexOf('"', start);
-            client->cSessionId = headerLine->substring(start, end);
+    if(len > 0 && client->isSocketIO && client->status == WSC_BODY && client->cSessionId.length() == 0) {
+        DEBUG_WEBSOCKETS("[WS-Client][handleHeader] socket.io json: %s\n", line);
+        char * sid = strstr(line, "\"sid\":\"");
+        if(sid) {
+            sid += 7;
+            char * end = strchr(sid, '"');
+            if(end) {
+                *end = 0x00;
+            }
+            client->cSessionId = sid;
             DEBUG_WEBSOCKETS("[WS-Client][handleHeader]  - cSessionId: %s\n", client->cSessionId.c_str());
 
             // Trigger websocket connection code path
-            *headerLine = "";
+            len = 0;
         }
     }
 
     // headle HTTP header
-    if(headerLine->length() > 0) {
-        DEBUG_WEBSOCKETS("[WS-Client][handleHeader] RX: %s\n", headerLine->c_str());
+    if(len > 0) {
+        DEBUG_WEBSOCKETS("[WS-Client][handleHeader] RX: %s\n", line);
 
-        if(headerLine->startsWith(WEBSOCKETS_STRING("HTTP/1."))) {
+        char * value = strchr(line, ':');
+        if(strncmp(line, "HTTP/1.", 7) == 0) {
             // "HTTP/1.1 101 Switching Protocols"
-            client->cCode = headerLine->substring(9, headerLine->indexOf(' ', 9)).toInt();
-        } else if(headerLine->indexOf(':') >= 0) {
-            String headerName  = headerLine->substring(0, headerLine->indexOf(':'));
-            String headerValue = headerLine->substring(headerLine->indexOf(':') + 1);
+            client->cCode = (len > 9) ? atoi(&line[9]) : 0;
+        } else if(value) {
+            size_t nameLen = value - line;
+            *value++       = 0x00;
 
             // remove space in the beginning  (RFC2616)
-            if(headerValue[0] == ' ') {
-                headerValue.remove(0, 1);
+            if(*value == ' ') {
+                value++;
             }
 
-            if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Connection"))) {
-                if(headerValue.equalsIgnoreCase(WEBSOCKETS_STRING("upgrade"))) {
-                    client->cIsUpgrade = true;
-                }
-            } else if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Upgrade"))) {
-                if(headerValue.equalsIgnoreCase(WEBSOCKETS_STRING("websocket"))) {
-                    client->cIsWebsocket = true;
-                }
-            } else if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Sec-WebSocket-Accept"))) {
-                client->cAccept = headerValue;
-                client->cAccept.trim();    // see rfc6455
-            } else if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Sec-WebSocket-Protocol"))) {
-                client->cProtocol = headerValue;
-            } else if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Sec-WebSocket-Extensions"))) {
-                client->cExtensions = headerValue;
-            } else if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Sec-WebSocket-Version"))) {
-                client->cVersion = headerValue.toInt();
-            } else if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Set-Cookie")) && headerValue.indexOf(" io=") > -1) {
-                if(headerValue.indexOf(';') > -1) {
-                    client->cSessionId = headerValue.substring(headerValue.indexOf('=') + 1, headerValue.indexOf(";"));
-                } else {
-                    client->cSessionId = headerValue.substring(headerValue.indexOf('=') + 1);
-                }
+            // the length of the name selects the candidates
+            switch(nameLen) {
+                case 7:
+                    if(strcasecmp(line, "Upgrade") == 0 && strcasecmp(value, "websocket") == 0) {
+                        client->cIsWebsocket = true;
+                    }
+                    break;
+                case 10:
+                    if(strcasecmp(line, "Connection") == 0) {
+                        if(strcasecmp(value, "upgrade") == 0) {
+                            client->cIsUpgrade = true;
+                        }
+                    } else if(strcasecmp(line, "Set-Cookie") == 0 && strstr(value, " io=")) {
+                        char * sid = strchr(value, '=') + 1;
+                        char * end = strchr(sid, ';');
+                        if(end) {
+                            *end = 0x00;
+                        }
+                        client->cSessionId = sid;
+                    }
+                    break;
+                case 20:
+                    if(strcasecmp(line, "Sec-WebSocket-Accept") == 0) {
+                        client->cAccept = value;
+                        client->cAccept.trim();    // see rfc6455
+                    }
+                    break;
+                case 21:
+                    if(strcasecmp(line, "Sec-WebSocket-Version") == 0) {
+                        client->cVersion = atoi(value);
+                    }
+                    break;
+                case 22:
+                    if(strcasecmp(line, "Sec-WebSocket-Protocol") == 0) {
+                        client->cProtocol = value;
+                    }
+                    break;
+                case 24:
+                    if(strcasecmp(line, "Sec-WebSocket-Extensions") == 0) {
+                        client->cExtensions = value;
+                    }
+                    break;
             }
         } else {
-            DEBUG_WEBSOCKETS("[WS-Client][handleHeader] Header error (%s)\n", headerLine->c_str());
+            DEBUG_WEBSOCKETS("[WS-Client][handleHeader] Header error (%s)\n", line);
         }
 
-        (*headerLine) = "";
 #if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
         client->tcp->readStringUntil('\n', &(client->cHttpLine), std::bind(&WebSocketsClient::handleHeader, this, client, &(client->cHttpLine)));
 #endif
@@ -794,7 +1220,6 @@ void WebSocketsClient::handleHeader(WSclient_t * client, String * headerLine) {
                     ok = false;
                     DEBUG_WEBSOCKETS("[WS-Client][handleHeader] serverCode is not 101 (%d)\n", client->cCode);
                     clientDisconnect(client);
-                    _lastConnectionFail = millis();
                     break;
             }
         }
@@ -804,17 +1229,34 @@ void WebSocketsClient::handleHeader(WSclient_t * client, String * headerLine) {
                 ok = false;
             } else {
                 // generate Sec-WebSocket-Accept key for check
-                String sKey = acceptKey(client->cKey);
-                if(sKey != client->cAccept) {
+                char sKey[WEBSOCKETS_ACCEPT_KEY_LENGTH + 1];
+                if(!acceptKey(client->cKey.c_str(), client->cKey.length(), sKey) || client->cAccept != sKey) {
                     DEBUG_WEBSOCKETS("[WS-Client][handleHeader] Sec-WebSocket-Accept is wrong\n");
                     ok = false;
                 }
             }
         }
 
+#ifdef WEBSOCKETS_HAS_DEFLATE
+        if(ok && !deflateConfirm(client)) {
+            DEBUG_WEBSOCKETS("[WS-Client][handleHeader] Sec-WebSocket-Extensions is wrong\n");
+            ok = false;
+        }
+#endif
+
         if(ok) {
             DEBUG_WEBSOCKETS("[WS-Client][handleHeader] Websocket connection init done.\n");
             headerDone(client);
+            _timers.cancel(WSCT_HEADER);
+            enterPhase(WSCP_IDLE);
+            _reconnect.connected(millis());
+            scheduleHeartbeat();
+            WEBSOCKETS_METRIC_ADD("ws.connects", 1);
+#ifdef WEBSOCKETS_HAS_CAPTURE
+            if(client->capture) {
+                client->capture->open(client->cUrl);
+            }
+#endif
 
             runCbEvent(WStype_CONNECTED, (uint8_t *)client->cUrl.c_str(), client->cUrl.length());
 #if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
@@ -833,7 +1275,6 @@ void WebSocketsClient::handleHeader(WSclient_t * client, String * headerLine) {
 #endif
         } else {
             DEBUG_WEBSOCKETS("[WS-Client][handleHeader] no Websocket connection close.\n");
-            _lastConnectionFail = millis();
             if(clientIsConnected(client)) {
                 write(client, "This is a webSocket client!");
             }
@@ -866,7 +1307,7 @@ void WebSocketsClient::connectedCb() {
     _client.tcp->setTimeout(WEBSOCKETS_TCP_TIMEOUT);
 #endif
 
-#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RP2040)
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RP2040) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_POSIX)
     _client.tcp->setNoDelay(true);
 #endif
 
@@ -894,6 +1335,7 @@ void WebSocketsClient::connectedCb() {
 
 void WebSocketsClient::connectFailedCb() {
     DEBUG_WEBSOCKETS("[WS-Client] connection to %s:%u Failed\n", _host.c_str(), _port);
+    WEBSOCKETS_METRIC_ADD("ws.connect_failures", 1);
 }
 
 #if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
@@ -967,6 +1409,7 @@ void WebSocketsClient::handleHBPing() {
  */
 void WebSocketsClient::enableHeartbeat(uint32_t pingInterval, uint32_t pongTimeout, uint8_t disconnectTimeoutCount) {
     WebSockets::enableHeartbeat(&_client, pingInterval, pongTimeout, disconnectTimeoutCount);
+    scheduleHeartbeat();
 }
 
 /**
@@ -974,4 +1417,43 @@ void WebSocketsClient::enableHeartbeat(uint32_t pingInterval, uint32_t pongTimeo
  */
 void WebSocketsClient::disableHeartbeat() {
     _client.pingInterval = 0;
+    scheduleHeartbeat();
 }
+
+/**
+ * set the heartbeat timer to the next ping or pong timeout
+ */
+void WebSocketsClient::scheduleHeartbeat(void) {
+    unsigned long deadline;
+    if(_client.status != WSC_CONNECTED || !heartbeatDeadline(&_client, &deadline)) {
+        _timers.cancel(WSCT_HEARTBEAT);
+        return;
+    }
+    unsigned long now = millis();
+    if((long)(deadline - now) <= 0) {
+        // overdue, try again in the next ms
+        deadline = now + 1;
+    }
+    _timers.set(WSCT_HEARTBEAT, deadline);
+}
+
+#ifdef WEBSOCKETS_HAS_DEFLATE
+/**
+ * offer permessage-deflate (RFC 7692) on the next connect
+ * @param windowBits uint8_t         max LZ77 window of the server (8..15), the received history needs 2^windowBits byte
+ * @param noContextTakeover bool     ask the server to compress each message on its own (no history is kept)
+ */
+void WebSocketsClient::enableDeflate(uint8_t windowBits, bool noContextTakeover) {
+    _client.cDeflateBits      = std::max((uint8_t)8, std::min((uint8_t)15, windowBits));
+    _client.cDeflateNoContext = noContextTakeover;
+    releaseHandshake();
+}
+
+/**
+ * do not offer permessage-deflate on the next connect
+ */
+void WebSocketsClient::disableDeflate(void) {
+    _client.cDeflateBits = 0;
+    releaseHandshake();
+}
+#endif
@@ -26,6 +26,42 @@
 #define WEBSOCKETSCLIENT_H_
 
 #include "WebSockets.h"
+#include "WebSocketsTimer.h"
+#include "WebSocketsReconnect.h"
+
+typedef enum {
+    WSCT_RECONNECT,    ///< next connection attempt
+    WSCT_HEADER,       ///< handshake response timeout
+    WSCT_HEARTBEAT,    ///< next ping or pong timeout
+    WSCT_CONNECT,      ///< timeout of the current connect phase
+    WSCT_MAX
+} WSclientTimer_t;
+
+typedef enum {
+    WSCP_IDLE,       ///< not connecting
+    WSCP_DNS,        ///< resolve the host
+    WSCP_TCP,        ///< TCP connect
+    WSCP_TLS,        ///< DNS, TCP connect and TLS handshake in one call of the TLS client
+    WSCP_UPGRADE,    ///< HTTP upgrade request sent, waiting for the 101
+    WSCP_MAX
+} WSconnectPhase_t;
+
+typedef struct {
+    uint32_t duration[WSCP_MAX];     ///< ms spent in each phase by the last attempt, 0 = skipped
+    uint32_t attempts;               ///< connection attempts
+    uint32_t failures;               ///< attempts that did not reach WStype_CONNECTED
+    WSconnectPhase_t failedPhase;    ///< phase of the last failure
+} WSconnectStats_t;
+
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RP2040) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_POSIX)
+// the host is resolved in an own loop() step
+#define WEBSOCKETS_CLIENT_RESOLVE
+#endif
+
+#ifndef WEBSOCKETS_CONNECT_POLL_INTERVAL
+// nextTimeout() while a non blocking TCP connect is in progress
+#define WEBSOCKETS_CONNECT_POLL_INTERVAL (10)
+#endif
 
 class WebSocketsClient : protected WebSockets {
   public:
@@ -92,17 +128,41 @@ class WebSocketsClient : protected WebSockets {
 
     void disconnect(void);
 
+    void cork(void);
+    bool uncork(void);
+    uint32_t corkSavedBytes(void);
+
+    bool streamBegin(bool binary = false);
+    bool streamWrite(const uint8_t * payload, size_t length);
+    bool streamWrite(const char * payload);
+    bool streamEnd(const uint8_t * payload = NULL, size_t length = 0);
+
     void setAuthorization(const char * user, const char * password);
     void setAuthorization(const char * auth);
 
     void setExtraHeaders(const char * extraHeaders = NULL);
 
     void setReconnectInterval(unsigned long time);
+    void setReconnectBackoff(unsigned long base, unsigned long max = WEBSOCKETS_RECONNECT_MAX_INTERVAL);
 
     void enableHeartbeat(uint32_t pingInterval, uint32_t pongTimeout, uint8_t disconnectTimeoutCount);
     void disableHeartbeat();
 
+#ifdef WEBSOCKETS_HAS_DEFLATE
+    void enableDeflate(uint8_t windowBits = 15, bool noContextTakeover = false);
+    void disableDeflate(void);
+#endif
+
     bool isConnected(void);
+    long nextTimeout(void);
+    unsigned long frameStart(void);
+
+#ifdef WEBSOCKETS_HAS_CAPTURE
+    void setCapture(WebSocketsCapture * capture);
+#endif
+
+    WSconnectPhase_t connectPhase(void);
+    const WSconnectStats_t & connectStats(void);
 
   protected:
     String _host;
@@ -128,9 +188,13 @@ class WebSocketsClient : protected WebSockets {
 
     WebSocketClientEvent _cbEvent;
 
-    unsigned long _lastConnectionFail;
-    unsigned long _reconnectInterval;
-    unsigned long _lastHeaderSent;
+    WebSocketsReconnect _reconnect;    ///< delay of the next connection attempt
+    WebSocketsTimers<WSCT_MAX> _timers;    ///< deadlines by WSclientTimer_t
+
+    WSconnectPhase_t _connectPhase;
+    WSconnectStats_t _connectStats;
+    unsigned long _phaseStart;    ///< millis() the current phase started
+    IPAddress _connectIP;         ///< result of WSCP_DNS
 
     void messageReceived(WSclient_t * client, WSopcode_t opcode, uint8_t * payload, size_t length, bool fin);
 
@@ -140,13 +204,35 @@ class WebSocketsClient : protected WebSockets {
 #if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
     void handleClientData(void);
 #endif
+    void scheduleHeartbeat(void);
+
+    char * _handshake;             ///< prebuilt upgrade request, see buildHandshake()
+    uint16_t _handshakeLen;        ///< length of _handshake
+    uint16_t _handshakeUrlEnd;     ///< end of "GET <url>", the Socket.IO query is added here
+    uint16_t _handshakeHostEnd;    ///< end of the request and Host line
+    uint16_t _handshakeKey;        ///< offset of the Sec-WebSocket-Key value
+    uint16_t _handshakeWsEnd;      ///< end of the upgrade headers
+
+    char _headerLine[WEBSOCKETS_CLIENT_HEADER_LINE_SIZE];    ///< response line in progress
+    uint16_t _headerLineLen;
+
+    void buildHandshake(void);
+    void releaseHandshake(void);
 
     void sendHeader(WSclient_t * client);
     void handleHeader(WSclient_t * client, String * headerLine);
+    void handleHeaderLine(WSclient_t * client, char * line, size_t len);
 
     void connectedCb();
     void connectFailedCb();
 
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+    bool connectBegin(void);
+    void connectStep(void);
+    void connectFailed(void);
+#endif
+    void enterPhase(WSconnectPhase_t phase);
+
     void handleHBPing();    // send ping in specified intervals
 
 #if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
@@ -0,0 +1,333 @@
+/**
+ * @file WebSocketsMetrics.cpp
+ * @date 19.10.2026
+ *
+ * Copyright (c) 2026 WebSockets for Arduino contributors.
+ * This file is part of the WebSockets for Arduino.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "WebSockets.h"
+
+#ifdef WEBSOCKETS_HAS_METRICS
+
+#include <new>
+
+#if defined(WEBSOCKETS_HOST) && defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#define WEBSOCKETS_METRICS_SUB_COUNT (1UL << WEBSOCKETS_METRICS_SUB_BITS)
+
+WebSocketsMetrics::WSmetricsCounterSlot_t WebSocketsMetrics::_counters[WEBSOCKETS_METRICS_COUNTERS];
+WebSocketsMetrics::WSmetricsGaugeSlot_t WebSocketsMetrics::_gauges[WEBSOCKETS_METRICS_GAUGES];
+WebSocketsMetrics::WSmetricsHistogramSlot_t WebSocketsMetrics::_histograms[WEBSOCKETS_METRICS_HISTOGRAMS];
+
+#ifdef WEBSOCKETS_METRICS_NO_ATOMIC
+static uint8_t metricsUsed[3];
+
+static inline uint8_t metricsUsedGet(uint8_t kind) {
+    return metricsUsed[kind];
+}
+
+static inline void metricsUsedSet(uint8_t kind, uint8_t used) {
+    metricsUsed[kind] = used;
+}
+
+static inline void metricsLock(void) {
+}
+
+static inline void metricsUnlock(void) {
+}
+#else
+// a slot is filled before the count that makes it visible is stored
+static std::atomic<uint8_t> metricsUsed[3];
+static std::atomic_flag metricsCreate = ATOMIC_FLAG_INIT;
+
+static inline uint8_t metricsUsedGet(uint8_t kind) {
+    return metricsUsed[kind].load(std::memory_order_acquire);
+}
+
+static inline void metricsUsedSet(uint8_t kind, uint8_t used) {
+    metricsUsed[kind].store(used, std::memory_order_release);
+}
+
+static inline void metricsLock(void) {
+    while(metricsCreate.test_and_set(std::memory_order_acquire)) {
+    }
+}
+
+static inline void metricsUnlock(void) {
+    metricsCreate.clear(std::memory_order_release);
+}
+#endif
+
+/**
+ * allocate the buckets
+ * @return true if ok
+ */
+bool WebSocketsHistogram::begin(void) {
+    if(!_buckets) {
+        _buckets = new(std::nothrow) WebSocketsMetricValue[WEBSOCKETS_METRICS_BUCKETS];
+    }
+    return (_buckets != NULL);
+}
+
+/**
+ * count one value, lock-free
+ * @param value uint32_t
+ */
+void WebSocketsHistogram::record(uint32_t value) {
+    if(!_buckets) {
+        return;
+    }
+    _buckets[bucket(value)].add(1);
+    _max.max(value);
+}
+
+/**
+ * take the values recorded since the last snapshot
+ * the percentiles are the upper bound of their bucket (max if that is smaller)
+ * @param out WSmetricsHistogramSnapshot_t *
+ */
+void WebSocketsHistogram::snapshot(WSmetricsHistogramSnapshot_t * out) {
+    uint32_t counts[WEBSOCKETS_METRICS_BUCKETS];
+    memset(out, 0x00, sizeof(WSmetricsHistogramSnapshot_t));
+    if(!_buckets) {
+        return;
+    }
+
+    for(uint8_t i = 0; i < WEBSOCKETS_METRICS_BUCKETS; i++) {
+        counts[i] = _buckets[i].take();
+        out->count += counts[i];
+    }
+    out->max = _max.take();
+    if(out->count == 0) {
+        return;
+    }
+
+    const uint64_t count    = out->count;
+    const uint32_t ranks[3] = { (uint32_t)((count * 50 + 99) / 100), (uint32_t)((count * 90 + 99) / 100), (uint32_t)((count * 99 + 99) / 100) };
+    uint32_t * values[3]    = { &out->p50, &out->p90, &out->p99 };
+    uint8_t next            = 0;
+    uint32_t seen           = 0;
+    for(uint8_t i = 0; i < WEBSOCKETS_METRICS_BUCKETS && next < 3; i++) {
+        if(counts[i] == 0) {
+            continue;
+        }
+        seen += counts[i];
+        uint32_t value = bucketMax(i);
+        if(out->max > 0 && out->max < value) {
+            value = out->max;
+        }
+        while(next < 3 && seen >= ranks[next]) {
+            *values[next++] = value;
+        }
+    }
+
+    // a value recorded while the buckets were taken may have missed the max
+    if(out->max < out->p99) {
+        out->max = out->p99;
+    }
+}
+
+/**
+ * @param value uint32_t
+ * @return index of the bucket of the value
+ */
+uint8_t WebSocketsHistogram::bucket(uint32_t value) {
+    if(value < WEBSOCKETS_METRICS_SUB_COUNT) {
+        return value;
+    }
+    uint8_t exponent = (31 - __builtin_clz(value));
+    uint8_t group    = (exponent - WEBSOCKETS_METRICS_SUB_BITS + 1);
+    return ((group << WEBSOCKETS_METRICS_SUB_BITS) + ((value >> (exponent - WEBSOCKETS_METRICS_SUB_BITS)) & (WEBSOCKETS_METRICS_SUB_COUNT - 1)));
+}
+
+/**
+ * @param index uint8_t
+ * @return largest value of the bucket
+ */
+uint32_t WebSocketsHistogram::bucketMax(uint8_t index) {
+    if(index < WEBSOCKETS_METRICS_SUB_COUNT) {
+        return index;
+    }
+    uint8_t group  = (index >> WEBSOCKETS_METRICS_SUB_BITS);
+    uint32_t sub   = (index & (WEBSOCKETS_METRICS_SUB_COUNT - 1));
+    uint32_t lower = ((WEBSOCKETS_METRICS_SUB_COUNT + sub) << (group - 1));
+    return (lower + ((1UL << (group - 1)) - 1));
+}
+
+/**
+ * find the slot of a name or claim a free one
+ * @param slots T *         array of the kind
+ * @param kind uint8_t      0 counters, 1 gauges, 2 histograms
+ * @param max uint8_t       size of the array
+ * @param name const char *
+ * @return slot, NULL if the registry is full or the name too long
+ */
+template<typename T>
+T * WebSocketsMetrics::slot(T * slots, uint8_t kind, uint8_t max, const char * name) {
+    if(!name || strlen(name) >= WEBSOCKETS_METRICS_NAME_SIZE) {
+        DEBUG_WEBSOCKETS("[WS-Metrics] bad name: %s\n", name ? name : "");
+        return NULL;
+    }
+
+    uint8_t used = metricsUsedGet(kind);
+    for(uint8_t i = 0; i < used; i++) {
+        if(strcmp(slots[i].name, name) == 0) {
+            return &slots[i];
+        }
+    }
+
+    T * found = NULL;
+    metricsLock();
+    // another task may have added it meanwhile
+    used = metricsUsedGet(kind);
+    for(uint8_t i = 0; i < used; i++) {
+        if(strcmp(slots[i].name, name) == 0) {
+            found = &slots[i];
+            break;
+        }
+    }
+    if(!found && used < max) {
+        found = &slots[used];
+        strcpy(found->name, name);
+        metricsUsedSet(kind, used + 1);
+    }
+    metricsUnlock();
+
+    if(!found) {
+        DEBUG_WEBSOCKETS("[WS-Metrics] registry full, %s dropped\n", name);
+    }
+    return found;
+}
+
+/**
+ * @param name const char *     stored in the registry, max WEBSOCKETS_METRICS_NAME_SIZE - 1 chars
+ * @return the counter, NULL if the registry is full
+ */
+WebSocketsCounter * WebSocketsMetrics::counter(const char * name) {
+    WSmetricsCounterSlot_t * s = slot(_counters, 0, WEBSOCKETS_METRICS_COUNTERS, name);
+    return s ? &s->metric : NULL;
+}
+
+/**
+ * @param name const char *
+ * @return the gauge, NULL if the registry is full
+ */
+WebSocketsGauge * WebSocketsMetrics::gauge(const char * name) {
+    WSmetricsGaugeSlot_t * s = slot(_gauges, 1, WEBSOCKETS_METRICS_GAUGES, name);
+    return s ? &s->metric : NULL;
+}
+
+/**
+ * @param name const char *
+ * @return the histogram, NULL if the registry is full or there is no memory for the buckets
+ */
+WebSocketsHistogram * WebSocketsMetrics::histogram(const char * name) {
+    WSmetricsHistogramSlot_t * s = slot(_histograms, 2, WEBSOCKETS_METRICS_HISTOGRAMS, name);
+    if(!s) {
+        return NULL;
+    }
+    metricsLock();
+    bool ok = s->metric.begin();
+    metricsUnlock();
+    return ok ? &s->metric : NULL;
+}
+
+/**
+ * free heap, largest free block and fragmentation of the platform
+ * on a glibc host: free bytes inside the arena and the releasable top of it
+ * @param out WSheapInfo_t *   all 0 if the platform does not tell
+ */
+void WebSocketsMetrics::heap(WSheapInfo_t * out) {
+    memset(out, 0x00, sizeof(WSheapInfo_t));
+#if defined(ESP32)
+    out->free    = ESP.getFreeHeap();
+    out->largest = ESP.getMaxAllocHeap();
+#elif defined(ESP8266)
+    out->free    = ESP.getFreeHeap();
+    out->largest = ESP.getMaxFreeBlockSize();
+#elif defined(WEBSOCKETS_HOST) && defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 info = mallinfo2();
+    out->free             = info.fordblks;
+    out->largest          = info.keepcost;
+#elif !defined(WEBSOCKETS_HOST)
+    out->free    = GET_FREE_HEAP;
+    out->largest = out->free;
+#endif
+    if(out->free > 0 && out->largest <= out->free) {
+        out->fragmentation = 100 - (uint8_t)((100ULL * out->largest) / out->free);
+    }
+}
+
+/**
+ * set the heap gauges (free, largest block, fragmentation %, low water mark) of the platform
+ */
+void WebSocketsMetrics::sampleHeap(void) {
+    WSheapInfo_t info;
+    heap(&info);
+    WEBSOCKETS_METRIC_SET("heap.free", info.free);
+    WEBSOCKETS_METRIC_SET("heap.largest", info.largest);
+    WEBSOCKETS_METRIC_SET("heap.frag", info.fragmentation);
+#if defined(ESP32)
+    WEBSOCKETS_METRIC_SET("heap.min", ESP.getMinFreeHeap());
+#endif
+}
+
+/**
+ * compact JSON of all metrics, the histograms start a new interval
+ *  {"t":<millis>,"c":{"name":n,..},"g":{"name":v,..},"h":{"name":[count,p50,p90,p99,max],..}}
+ * @return String
+ */
+String WebSocketsMetrics::snapshot(void) {
+    char buffer[WEBSOCKETS_METRICS_NAME_SIZE + 64];
+    String out;
+
+    sampleHeap();
+
+    uint8_t counters   = metricsUsedGet(0);
+    uint8_t gauges     = metricsUsedGet(1);
+    uint8_t histograms = metricsUsedGet(2);
+    out.reserve(32 + counters * 24 + gauges * 24 + histograms * 56);
+
+    snprintf(buffer, sizeof(buffer), "{\"t\":%lu,\"c\":{", (unsigned long)millis());
+    out += buffer;
+    for(uint8_t i = 0; i < counters; i++) {
+        snprintf(buffer, sizeof(buffer), "%s\"%s\":%lu", (i ? "," : ""), _counters[i].name, (unsigned long)_counters[i].metric.value());
+        out += buffer;
+    }
+
+    out += "},\"g\":{";
+    for(uint8_t i = 0; i < gauges; i++) {
+        snprintf(buffer, sizeof(buffer), "%s\"%s\":%ld", (i ? "," : ""), _gauges[i].name, (long)_gauges[i].metric.value());
+        out += buffer;
+    }
+
+    out += "},\"h\":{";
+    for(uint8_t i = 0; i < histograms; i++) {
+        WSmetricsHistogramSnapshot_t h;
+        _histograms[i].metric.snapshot(&h);
+        snprintf(buffer, sizeof(buffer), "%s\"%s\":[%lu,%lu,%lu,%lu,%lu]", (i ? "," : ""), _histograms[i].name, (unsigned long)h.count, (unsigned long)h.p50, (unsigned long)h.p90, (unsigned long)h.p99, (unsigned long)h.max);
+        out += buffer;
+    }
+    out += "}}";
+    return out;
+}
+
+#endif
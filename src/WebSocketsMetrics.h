@@ -0,0 +1,268 @@
+/**
+ * @file WebSocketsMetrics.h
+ * @date 19.10.2026
+ *
+ * Copyright (c) 2026 WebSockets for Arduino contributors.
+ * This file is part of the WebSockets for Arduino.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef WEBSOCKETSMETRICS_H_
+#define WEBSOCKETSMETRICS_H_
+
+#include <Arduino.h>
+
+#ifndef WEBSOCKETS_METRICS_COUNTERS
+// counter slots of the registry
+#define WEBSOCKETS_METRICS_COUNTERS (48)
+#endif
+
+#ifndef WEBSOCKETS_METRICS_GAUGES
+// gauge slots of the registry
+#define WEBSOCKETS_METRICS_GAUGES (8)
+#endif
+
+#ifndef WEBSOCKETS_METRICS_HISTOGRAMS
+// histogram slots of the registry, the buckets are allocated on first use
+#define WEBSOCKETS_METRICS_HISTOGRAMS (12)
+#endif
+
+#ifndef WEBSOCKETS_METRICS_NAME_SIZE
+// max length of a metric name + 1
+#define WEBSOCKETS_METRICS_NAME_SIZE (24)
+#endif
+
+#ifndef WEBSOCKETS_METRICS_SUB_BITS
+// histogram buckets per power of two = 2^bits, the error of a percentile is below 1 / 2^bits
+#define WEBSOCKETS_METRICS_SUB_BITS (2)
+#endif
+
+#define WEBSOCKETS_METRICS_BUCKETS ((32 - WEBSOCKETS_METRICS_SUB_BITS + 1) << WEBSOCKETS_METRICS_SUB_BITS)
+
+#ifdef WEBSOCKETS_HAS_METRICS
+
+#if defined(ESP8266)
+// everything runs in the loop of the one core
+#define WEBSOCKETS_METRICS_NO_ATOMIC
+#else
+#include <atomic>
+#endif
+
+/**
+ * 32 bit value updated without a lock
+ */
+class WebSocketsMetricValue {
+  public:
+    constexpr WebSocketsMetricValue(void)
+        : _value(0) {
+    }
+
+#ifdef WEBSOCKETS_METRICS_NO_ATOMIC
+    inline void add(uint32_t n) {
+        _value += n;
+    }
+    inline void set(uint32_t v) {
+        _value = v;
+    }
+    inline uint32_t get(void) const {
+        return _value;
+    }
+    inline uint32_t take(void) {
+        uint32_t v = _value;
+        _value     = 0;
+        return v;
+    }
+    inline void max(uint32_t v) {
+        if(v > _value) {
+            _value = v;
+        }
+    }
+
+  private:
+    volatile uint32_t _value;
+#else
+    inline void add(uint32_t n) {
+        _value.fetch_add(n, std::memory_order_relaxed);
+    }
+    inline void set(uint32_t v) {
+        _value.store(v, std::memory_order_relaxed);
+    }
+    inline uint32_t get(void) const {
+        return _value.load(std::memory_order_relaxed);
+    }
+    inline uint32_t take(void) {
+        return _value.exchange(0, std::memory_order_relaxed);
+    }
+    inline void max(uint32_t v) {
+        uint32_t old = _value.load(std::memory_order_relaxed);
+        while(v > old && !_value.compare_exchange_weak(old, v, std::memory_order_relaxed)) {
+        }
+    }
+
+  private:
+    std::atomic<uint32_t> _value;
+#endif
+};
+
+/**
+ * monotonic count, reported as it is (the receiver builds the rate)
+ */
+class WebSocketsCounter {
+  public:
+    inline void add(uint32_t n = 1) {
+        _value.add(n);
+    }
+    inline uint32_t value(void) const {
+        return _value.get();
+    }
+
+  protected:
+    WebSocketsMetricValue _value;
+};
+
+/**
+ * last value set
+ */
+class WebSocketsGauge {
+  public:
+    inline void set(int32_t v) {
+        _value.set((uint32_t)v);
+    }
+    inline int32_t value(void) const {
+        return (int32_t)_value.get();
+    }
+
+  protected:
+    WebSocketsMetricValue _value;
+};
+
+typedef struct {
+    uint32_t count;
+    uint32_t max;
+    uint32_t p50;
+    uint32_t p90;
+    uint32_t p99;
+} WSmetricsHistogramSnapshot_t;
+
+typedef struct {
+    uint32_t free;            ///< bytes
+    uint32_t largest;         ///< largest block that can be allocated
+    uint8_t fragmentation;    ///< % of the free heap not in the largest block
+} WSheapInfo_t;
+
+/**
+ * log-linear buckets like HdrHistogram: values below 2^bits are exact,
+ * above each power of two is split into 2^bits buckets
+ * record() is lock-free, snapshot() takes the values since the last snapshot
+ */
+class WebSocketsHistogram {
+  public:
+    constexpr WebSocketsHistogram(void)
+        : _buckets(NULL) {
+    }
+
+    bool begin(void);
+    void record(uint32_t value);
+    void snapshot(WSmetricsHistogramSnapshot_t * out);
+
+    static uint8_t bucket(uint32_t value);
+    static uint32_t bucketMax(uint8_t index);
+
+  protected:
+    WebSocketsMetricValue * _buckets;
+    WebSocketsMetricValue _count;
+    WebSocketsMetricValue _max;
+};
+
+/**
+ * fixed size registry of named counters, gauges and histograms
+ * a name is looked up once, the returned pointer stays valid
+ */
+class WebSocketsMetrics {
+  public:
+    static WebSocketsCounter * counter(const char * name);
+    static WebSocketsGauge * gauge(const char * name);
+    static WebSocketsHistogram * histogram(const char * name);
+
+    static void heap(WSheapInfo_t * out);
+    static void sampleHeap(void);
+    static String snapshot(void);
+
+  protected:
+    typedef struct {
+        char name[WEBSOCKETS_METRICS_NAME_SIZE];
+        WebSocketsCounter metric;
+    } WSmetricsCounterSlot_t;
+
+    typedef struct {
+        char name[WEBSOCKETS_METRICS_NAME_SIZE];
+        WebSocketsGauge metric;
+    } WSmetricsGaugeSlot_t;
+
+    typedef struct {
+        char name[WEBSOCKETS_METRICS_NAME_SIZE];
+        WebSocketsHistogram metric;
+    } WSmetricsHistogramSlot_t;
+
+    static WSmetricsCounterSlot_t _counters[WEBSOCKETS_METRICS_COUNTERS];
+    static WSmetricsGaugeSlot_t _gauges[WEBSOCKETS_METRICS_GAUGES];
+    static WSmetricsHistogramSlot_t _histograms[WEBSOCKETS_METRICS_HISTOGRAMS];
+
+    template<typename T>
+    static T * slot(T * slots, uint8_t kind, uint8_t max, const char * name);
+};
+
+// the name has to be a literal, the metric is looked up once per call site
+#define WEBSOCKETS_METRIC_ADD(name, n)                                         \
+    do {                                                                       \
+        static WebSocketsCounter * _wsMetric = WebSocketsMetrics::counter(name); \
+        if(_wsMetric) {                                                        \
+            _wsMetric->add(n);                                                 \
+        }                                                                      \
+    } while(0)
+
+#define WEBSOCKETS_METRIC_SET(name, v)                                     \
+    do {                                                                   \
+        static WebSocketsGauge * _wsMetric = WebSocketsMetrics::gauge(name); \
+        if(_wsMetric) {                                                    \
+            _wsMetric->set(v);                                             \
+        }                                                                  \
+    } while(0)
+
+#define WEBSOCKETS_METRIC_RECORD(name, v)                                          \
+    do {                                                                           \
+        static WebSocketsHistogram * _wsMetric = WebSocketsMetrics::histogram(name); \
+        if(_wsMetric) {                                                            \
+            _wsMetric->record(v);                                                  \
+        }                                                                          \
+    } while(0)
+
+#else
+
+#define WEBSOCKETS_METRIC_ADD(name, n) \
+    do {                               \
+    } while(0)
+#define WEBSOCKETS_METRIC_SET(name, v) \
+    do {                               \
+    } while(0)
+#define WEBSOCKETS_METRIC_RECORD(name, v) \
+    do {                                  \
+    } while(0)
+
+#endif
+
+#endif /* WEBSOCKETSMETRICS_H_ */
@@ -0,0 +1,200 @@
+/**
+ * @file WebSocketsPoller.cpp
+ * @date 19.10.2026
+ *
+ * Copyright (c) 2026 WebSockets for Arduino contributors.
+ * This file is part of the WebSockets for Arduino.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "WebSocketsPoller.h"
+
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_POSIX)
+
+#include <errno.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+
+// epoll_event.data of the listen socket, clients use their num
+#define WS_POLL_SERVER (0xFFFFFFFF)
+
+WebSocketsPollerPosix::WebSocketsPollerPosix() {
+    _epoll    = epoll_create1(EPOLL_CLOEXEC);
+    _serverFd = -1;
+}
+
+WebSocketsPollerPosix::~WebSocketsPollerPosix() {
+    if(_epoll >= 0) {
+        close(_epoll);
+    }
+}
+
+bool WebSocketsPollerPosix::watchServer(WEBSOCKETS_NETWORK_SERVER_CLASS * server) {
+    struct epoll_event ev;
+    if(_epoll < 0 || !server || server->fd() < 0) {
+        return false;
+    }
+    if(_serverFd >= 0) {
+        epoll_ctl(_epoll, EPOLL_CTL_DEL, _serverFd, NULL);
+    }
+    _serverFd   = server->fd();
+    ev.events   = EPOLLIN;
+    ev.data.u64 = WS_POLL_SERVER;
+    return epoll_ctl(_epoll, EPOLL_CTL_ADD, _serverFd, &ev) == 0;
+}
+
+bool WebSocketsPollerPosix::watch(WSclient_t * client) {
+    struct epoll_event ev;
+    if(_epoll < 0 || !client->tcp || client->tcp->fd() < 0) {
+        return false;
+    }
+    // level triggered, data left in the socket is reported again
+    ev.events   = EPOLLIN | EPOLLRDHUP;
+    ev.data.u64 = client->num;
+    return epoll_ctl(_epoll, EPOLL_CTL_ADD, client->tcp->fd(), &ev) == 0;
+}
+
+void WebSocketsPollerPosix::unwatch(WSclient_t * client) {
+    if(_epoll < 0 || !client->tcp || client->tcp->fd() < 0) {
+        return;
+    }
+    epoll_ctl(_epoll, EPOLL_CTL_DEL, client->tcp->fd(), NULL);
+}
+
+int WebSocketsPollerPosix::wait(uint8_t * ready, uint8_t max, bool * accept, int timeout) {
+    struct epoll_event events[64];
+    int count = 0;
+    int n;
+
+    *accept = false;
+    if(_epoll < 0) {
+        return -1;
+    }
+
+    // one slot more for the listen socket
+    n = epoll_wait(_epoll, events, std::min((int)max + 1, 64), timeout);
+    if(n < 0) {
+        return (errno == EINTR) ? 0 : -1;
+    }
+    for(int i = 0; i < n; i++) {
+        if(events[i].data.u64 == WS_POLL_SERVER) {
+            *accept = true;
+        } else if(count < max) {
+            ready[count++] = (uint8_t)events[i].data.u64;
+        }
+    }
+    return count;
+}
+
+#else
+
+WebSocketsPollerPosix::WebSocketsPollerPosix() {
+    _fds      = NULL;
+    _nums     = NULL;
+    _count    = 1;
+    _size     = 0;
+    _serverFd = -1;
+}
+
+WebSocketsPollerPosix::~WebSocketsPollerPosix() {
+    free(_fds);
+    free(_nums);
+}
+
+bool WebSocketsPollerPosix::watchServer(WEBSOCKETS_NETWORK_SERVER_CLASS * server) {
+    if(!server || server->fd() < 0) {
+        return false;
+    }
+    _serverFd = server->fd();
+    return true;
+}
+
+bool WebSocketsPollerPosix::watch(WSclient_t * client) {
+    if(!client->tcp || client->tcp->fd() < 0) {
+        return false;
+    }
+    if(_count >= _size) {
+        size_t size         = _size ? _size * 2 : 16;
+        struct pollfd * fds = (struct pollfd *)realloc(_fds, size * sizeof(struct pollfd));
+        if(fds) {
+            _fds = fds;
+        }
+        uint8_t * nums = (uint8_t *)realloc(_nums, size * sizeof(uint8_t));
+        if(nums) {
+            _nums = nums;
+        }
+        if(!fds || !nums) {
+            return false;
+        }
+        _size = size;
+    }
+    _fds[_count].fd      = client->tcp->fd();
+    _fds[_count].events  = POLLIN;
+    _fds[_count].revents = 0;
+    _nums[_count]        = client->num;
+    _count++;
+    return true;
+}
+
+void WebSocketsPollerPosix::unwatch(WSclient_t * client) {
+    for(size_t i = 1; i < _count; i++) {
+        if(_nums[i] == client->num) {
+            _count--;
+            _fds[i]  = _fds[_count];
+            _nums[i] = _nums[_count];
+            return;
+        }
+    }
+}
+
+int WebSocketsPollerPosix::wait(uint8_t * ready, uint8_t max, bool * accept, int timeout) {
+    int count = 0;
+    int n;
+
+    *accept = false;
+    if(!_fds) {
+        // no client yet, only the listen socket
+        struct pollfd pfd;
+        pfd.fd      = _serverFd;
+        pfd.events  = POLLIN;
+        pfd.revents = 0;
+        n           = poll(&pfd, 1, timeout);
+        *accept     = (n > 0 && (pfd.revents & POLLIN));
+        return (n < 0 && errno != EINTR) ? -1 : 0;
+    }
+
+    _fds[0].fd      = _serverFd;
+    _fds[0].events  = POLLIN;
+    _fds[0].revents = 0;
+    n               = poll(_fds, _count, timeout);
+    if(n < 0) {
+        return (errno == EINTR) ? 0 : -1;
+    }
+    *accept = (_fds[0].revents & POLLIN);
+    for(size_t i = 1; i < _count && count < max; i++) {
+        if(_fds[i].revents) {
+            ready[count++] = _nums[i];
+        }
+    }
+    return count;
+}
+
+#endif
+
+#endif
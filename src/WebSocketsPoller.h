@@ -0,0 +1,97 @@
+/**
+ * @file WebSocketsPoller.h
+ * @date 19.10.2026
+ *
+ * Copyright (c) 2026 WebSockets for Arduino contributors.
+ * This file is part of the WebSockets for Arduino.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef WEBSOCKETSPOLLER_H_
+#define WEBSOCKETSPOLLER_H_
+
+#include "WebSockets.h"
+
+/**
+ * readiness source for WebSocketsServer (see WebSocketsServerCore::setPoller)
+ * without a poller the server asks every client for available() in each loop
+ */
+class WebSocketsPoller {
+  public:
+    virtual ~WebSocketsPoller() {}
+
+    /**
+     * watch the listen socket for new connections
+     * @param server WEBSOCKETS_NETWORK_SERVER_CLASS *
+     */
+    virtual bool watchServer(WEBSOCKETS_NETWORK_SERVER_CLASS * server) = 0;
+
+    /**
+     * watch a client for input (client->num is reported by wait)
+     * @param client WSclient_t *
+     */
+    virtual bool watch(WSclient_t * client) = 0;
+
+    /**
+     * stop watching, called before the connection is closed
+     * @param client WSclient_t *
+     */
+    virtual void unwatch(WSclient_t * client) = 0;
+
+    /**
+     * wait for input
+     * @param ready uint8_t *   filled with the num of the clients that have input or lost the connection
+     * @param max uint8_t       size of ready
+     * @param accept bool *     set if the listen socket has pending connections
+     * @param timeout int       max time to wait in ms, 0 returns at once
+     * @return number of entries in ready, -1 on error
+     */
+    virtual int wait(uint8_t * ready, uint8_t max, bool * accept, int timeout) = 0;
+};
+
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_POSIX)
+#ifndef __linux__
+#include <poll.h>
+#endif
+
+/**
+ * epoll (Linux) or poll() based WebSocketsPoller for NETWORK_POSIX
+ */
+class WebSocketsPollerPosix : public WebSocketsPoller {
+  public:
+    WebSocketsPollerPosix();
+    virtual ~WebSocketsPollerPosix();
+
+    bool watchServer(WEBSOCKETS_NETWORK_SERVER_CLASS * server) override;
+    bool watch(WSclient_t * client) override;
+    void unwatch(WSclient_t * client) override;
+    int wait(uint8_t * ready, uint8_t max, bool * accept, int timeout) override;
+
+  protected:
+#ifdef __linux__
+    int _epoll;    ///< epoll instance
+#else
+    struct pollfd * _fds;    ///< [0] is the listen socket
+    uint8_t * _nums;         ///< client num of _fds[i]
+    size_t _count;
+    size_t _size;
+#endif
+    int _serverFd;
+};
+#endif
+
+#endif /* WEBSOCKETSPOLLER_H_ */
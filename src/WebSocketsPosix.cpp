@@ -0,0 +1,469 @@
+/**
+ * @file WebSocketsPosix.cpp
+ * @date 19.10.2026
+ *
+ * Copyright (c) 2026 WebSockets for Arduino contributors.
+ * This file is part of the WebSockets for Arduino.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "WebSockets.h"
+
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_POSIX)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+#ifdef __linux__
+#include <linux/sockios.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#ifndef WEBSOCKETS_POSIX_LISTEN_BACKLOG
+#define WEBSOCKETS_POSIX_LISTEN_BACKLOG (128)
+#endif
+
+static void setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+}
+
+WSPosixClient::Socket::~Socket() {
+    if(fd >= 0) {
+        ::close(fd);
+    }
+}
+
+WSPosixClient::WSPosixClient() {
+}
+
+WSPosixClient::WSPosixClient(int fd) {
+    if(fd >= 0) {
+        setNonBlocking(fd);
+        _sock = std::make_shared<Socket>(fd);
+    }
+}
+
+int WSPosixClient::connect(IPAddress ip, uint16_t port) {
+    return connect(ip.toString().c_str(), port);
+}
+
+int WSPosixClient::connect(const char * host, uint16_t port) {
+    return connect(host, port, WEBSOCKETS_TCP_TIMEOUT);
+}
+
+/**
+ * resolve host and connect, waits at most timeout ms for each address
+ * @return 1 if connected
+ */
+int WSPosixClient::connect(const char * host, uint16_t port, int32_t timeout) {
+    struct addrinfo hints;
+    struct addrinfo * res = NULL;
+    struct addrinfo * ai;
+    char service[8];
+
+    stop();
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf(service, sizeof(service), "%u", port);
+
+    if(getaddrinfo(host, service, &hints, &res) != 0 || !res) {
+        DEBUG_WEBSOCKETS("[POSIX] can not resolve %s\n", host);
+        return 0;
+    }
+
+    for(ai = res; ai; ai = ai->ai_next) {
+        int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if(fd < 0) {
+            continue;
+        }
+        setNonBlocking(fd);
+
+        int rc = ::connect(fd, ai->ai_addr, ai->ai_addrlen);
+        if(rc < 0 && errno == EINPROGRESS) {
+            struct pollfd pfd;
+            int err       = 0;
+            socklen_t len = sizeof(err);
+            pfd.fd        = fd;
+            pfd.events    = POLLOUT;
+            pfd.revents   = 0;
+            if(poll(&pfd, 1, timeout) == 1 && getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err == 0) {
+                rc = 0;
+            }
+        }
+
+        if(rc == 0) {
+            _sock = std::make_shared<Socket>(fd);
+            break;
+        }
+        ::close(fd);
+    }
+    freeaddrinfo(res);
+
+    return _sock ? 1 : 0;
+}
+
+/**
+ * resolve an IPv4 address (blocking)
+ * @param host const char *  name or dotted address
+ * @param ip IPAddress &     result
+ * @return true if resolved
+ */
+bool WSPosixClient::resolve(const char * host, IPAddress & ip) {
+    struct addrinfo hints;
+    struct addrinfo * res = NULL;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if(getaddrinfo(host, NULL, &hints, &res) != 0 || !res) {
+        DEBUG_WEBSOCKETS("[POSIX] can not resolve %s\n", host);
+        return false;
+    }
+    ip = IPAddress((uint32_t)((struct sockaddr_in *)res->ai_addr)->sin_addr.s_addr);
+    freeaddrinfo(res);
+    return true;
+}
+
+/**
+ * start a non blocking connect, finish it with connectPoll()
+ * @return 1 connected, 0 in progress, -1 failed
+ */
+int WSPosixClient::connectStart(IPAddress ip, uint16_t port) {
+    struct sockaddr_in addr;
+
+    stop();
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(fd < 0) {
+        return -1;
+    }
+    setNonBlocking(fd);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(((uint32_t)ip[0] << 24) | ((uint32_t)ip[1] << 16) | ((uint32_t)ip[2] << 8) | ip[3]);
+    addr.sin_port        = htons(port);
+
+    if(::connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+        _sock = std::make_shared<Socket>(fd);
+        return 1;
+    }
+    if(errno != EINPROGRESS) {
+        ::close(fd);
+        return -1;
+    }
+    _sock             = std::make_shared<Socket>(fd);
+    _sock->connecting = true;
+    return 0;
+}
+
+/**
+ * check a connect started by connectStart(), never blocks
+ * @return 1 connected, 0 in progress, -1 failed
+ */
+int WSPosixClient::connectPoll(void) {
+    struct pollfd pfd;
+    int err       = 0;
+    socklen_t len = sizeof(err);
+
+    if(!_sock || _sock->fd < 0) {
+        return -1;
+    }
+    if(!_sock->connecting) {
+        return 1;
+    }
+
+    pfd.fd      = _sock->fd;
+    pfd.events  = POLLOUT;
+    pfd.revents = 0;
+    if(poll(&pfd, 1, 0) == 0) {
+        return 0;
+    }
+    if(getsockopt(_sock->fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0) {
+        DEBUG_WEBSOCKETS("[POSIX] connect failed: %d\n", err);
+        stop();
+        return -1;
+    }
+    _sock->connecting = false;
+    return 1;
+}
+
+size_t WSPosixClient::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+/**
+ * non blocking send
+ * @return bytes accepted by the kernel, 0 if the socket buffer is full or the connection is lost
+ */
+size_t WSPosixClient::write(const uint8_t * buf, size_t size) {
+    if(!_sock || _sock->fd < 0 || size == 0) {
+        return 0;
+    }
+    ssize_t n = send(_sock->fd, buf, size, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if(n < 0) {
+        if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            stop();
+        }
+        return 0;
+    }
+    return (size_t)n;
+}
+
+/**
+ * free space in the socket send buffer
+ */
+int WSPosixClient::availableForWrite() {
+    if(!_sock || _sock->fd < 0) {
+        return 0;
+    }
+#ifdef SIOCOUTQ
+    int size      = 0;
+    int queued    = 0;
+    socklen_t len = sizeof(size);
+    if(getsockopt(_sock->fd, SOL_SOCKET, SO_SNDBUF, &size, &len) == 0 && ioctl(_sock->fd, SIOCOUTQ, &queued) == 0) {
+        return size > queued ? size - queued : 0;
+    }
+#endif
+    struct pollfd pfd;
+    pfd.fd      = _sock->fd;
+    pfd.events  = POLLOUT;
+    pfd.revents = 0;
+    // no way to ask for the free space, a writable socket takes at least one segment
+    return (poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLOUT)) ? 1460 : 0;
+}
+
+int WSPosixClient::available() {
+    if(!_sock || _sock->fd < 0) {
+        return 0;
+    }
+    int n = 0;
+    if(ioctl(_sock->fd, FIONREAD, &n) < 0) {
+        return 0;
+    }
+    return n;
+}
+
+int WSPosixClient::read() {
+    uint8_t c;
+    if(read(&c, 1) != 1) {
+        return -1;
+    }
+    return c;
+}
+
+/**
+ * non blocking recv
+ * @return bytes read, -1 if nothing is available
+ */
+int WSPosixClient::read(uint8_t * buf, size_t size) {
+    if(!_sock || _sock->fd < 0) {
+        return -1;
+    }
+    ssize_t n = recv(_sock->fd, buf, size, MSG_DONTWAIT);
+    if(n == 0) {
+        // orderly shutdown by the peer
+        stop();
+        return -1;
+    }
+    if(n < 0) {
+        if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            stop();
+        }
+        return -1;
+    }
+    return (int)n;
+}
+
+int WSPosixClient::peek() {
+    uint8_t c;
+    if(!_sock || _sock->fd < 0) {
+        return -1;
+    }
+    if(recv(_sock->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) != 1) {
+        return -1;
+    }
+    return c;
+}
+
+void WSPosixClient::flush() {
+}
+
+/**
+ * close the socket, copies of this client see the connection as lost
+ */
+void WSPosixClient::stop() {
+    if(_sock && _sock->fd >= 0) {
+        ::close(_sock->fd);
+        _sock->fd = -1;
+    }
+    _sock.reset();
+}
+
+/**
+ * like WiFiClient the connection counts as open as long as received data is left
+ */
+uint8_t WSPosixClient::connected() {
+    uint8_t c;
+    if(!_sock || _sock->fd < 0) {
+        return 0;
+    }
+    ssize_t n = recv(_sock->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    if(n > 0) {
+        return 1;
+    }
+    if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return 1;
+    }
+    return 0;
+}
+
+WSPosixClient::operator bool() {
+    return _sock && _sock->fd >= 0;
+}
+
+void WSPosixClient::setNoDelay(bool nodelay) {
+    if(!_sock || _sock->fd < 0) {
+        return;
+    }
+    int v = nodelay ? 1 : 0;
+    setsockopt(_sock->fd, IPPROTO_TCP, TCP_NODELAY, &v, sizeof(v));
+}
+
+IPAddress WSPosixClient::remoteIP() {
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    if(!_sock || _sock->fd < 0 || getpeername(_sock->fd, (struct sockaddr *)&addr, &len) != 0) {
+        return IPAddress();
+    }
+    if(addr.ss_family == AF_INET) {
+        return IPAddress((uint32_t)((struct sockaddr_in *)&addr)->sin_addr.s_addr);
+    }
+    if(addr.ss_family == AF_INET6) {
+        // IPv4 mapped address
+        const uint8_t * b = ((struct sockaddr_in6 *)&addr)->sin6_addr.s6_addr;
+        return IPAddress(b[12], b[13], b[14], b[15]);
+    }
+    return IPAddress();
+}
+
+int WSPosixClient::fd() const {
+    return _sock ? _sock->fd : -1;
+}
+
+WSPosixServer::WSPosixServer(uint16_t port)
+    : _port(port)
+    , _fd(-1)
+    , _pending(-1) {
+}
+
+WSPosixServer::~WSPosixServer() {
+    close();
+}
+
+/**
+ * listen on all interfaces
+ */
+void WSPosixServer::begin(void) {
+    struct sockaddr_in addr;
+    int one = 1;
+
+    close();
+
+    _fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(_fd < 0) {
+        DEBUG_WEBSOCKETS("[POSIX] socket failed: %d\n", errno);
+        return;
+    }
+    setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setNonBlocking(_fd);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port        = htons(_port);
+
+    if(bind(_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(_fd, WEBSOCKETS_POSIX_LISTEN_BACKLOG) != 0) {
+        DEBUG_WEBSOCKETS("[POSIX] can not listen on port %u: %d\n", _port, errno);
+        ::close(_fd);
+        _fd = -1;
+    }
+}
+
+void WSPosixServer::close(void) {
+    if(_pending >= 0) {
+        ::close(_pending);
+        _pending = -1;
+    }
+    if(_fd >= 0) {
+        ::close(_fd);
+        _fd = -1;
+    }
+}
+
+void WSPosixServer::end(void) {
+    close();
+}
+
+/**
+ * accept the next pending connection (non blocking)
+ */
+bool WSPosixServer::hasClient(void) {
+    if(_pending < 0 && _fd >= 0) {
+        _pending = accept(_fd, NULL, NULL);
+    }
+    return _pending >= 0;
+}
+
+/**
+ * take the connection accepted by hasClient()
+ * @return WSPosixClient, not connected if there is none
+ */
+WSPosixClient WSPosixServer::available(void) {
+    if(!hasClient()) {
+        return WSPosixClient();
+    }
+    int fd   = _pending;
+    _pending = -1;
+    return WSPosixClient(fd);
+}
+
+int WSPosixServer::fd() const {
+    return _fd;
+}
+
+#endif
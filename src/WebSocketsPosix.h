@@ -0,0 +1,99 @@
+/**
+ * @file WebSocketsPosix.h
+ * @date 19.10.2026
+ *
+ * Copyright (c) 2026 WebSockets for Arduino contributors.
+ * This file is part of the WebSockets for Arduino.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef WEBSOCKETSPOSIX_H_
+#define WEBSOCKETSPOSIX_H_
+
+#include <memory>
+
+/**
+ * TCP client on a BSD socket (NETWORK_POSIX)
+ * the socket is non blocking, copies share the same socket like WiFiClient does
+ */
+class WSPosixClient : public Client {
+  public:
+    WSPosixClient();
+    explicit WSPosixClient(int fd);
+
+    int connect(IPAddress ip, uint16_t port) override;
+    int connect(const char * host, uint16_t port) override;
+    int connect(const char * host, uint16_t port, int32_t timeout);
+
+    static bool resolve(const char * host, IPAddress & ip);
+    int connectStart(IPAddress ip, uint16_t port);
+    int connectPoll(void);
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t * buf, size_t size) override;
+    using Print::write;
+    int availableForWrite();
+
+    int available() override;
+    int read() override;
+    int read(uint8_t * buf, size_t size) override;
+    int peek() override;
+
+    void flush() override;
+    void stop() override;
+    uint8_t connected() override;
+    operator bool() override;
+
+    void setNoDelay(bool nodelay);
+    IPAddress remoteIP();
+    int fd() const;
+
+  protected:
+    struct Socket {
+        int fd;
+        bool connecting;    ///< non blocking connect not finished yet
+        explicit Socket(int s)
+            : fd(s)
+            , connecting(false) {}
+        ~Socket();
+    };
+    std::shared_ptr<Socket> _sock;
+};
+
+/**
+ * listen socket for WebSocketsServer (NETWORK_POSIX)
+ */
+class WSPosixServer {
+  public:
+    explicit WSPosixServer(uint16_t port);
+    ~WSPosixServer();
+
+    void begin(void);
+    void close(void);
+    void end(void);
+
+    bool hasClient(void);
+    WSPosixClient available(void);
+    int fd() const;
+
+  protected:
+    uint16_t _port;
+    int _fd;         ///< listen socket
+    int _pending;    ///< connection accepted by hasClient() and not yet taken
+};
+
+#endif /* WEBSOCKETSPOSIX_H_ */
@@ -0,0 +1,131 @@
+/**
+ * @file WebSocketsReconnect.h
+ * @date 19.10.2026
+ *
+ * Copyright (c) 2026 WebSockets for Arduino contributors.
+ * This file is part of the WebSockets for Arduino.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef WEBSOCKETSRECONNECT_H_
+#define WEBSOCKETSRECONNECT_H_
+
+#include <Arduino.h>
+
+#ifndef WEBSOCKETS_RECONNECT_MAX_INTERVAL
+// upper bound of the backoff (ms)
+#define WEBSOCKETS_RECONNECT_MAX_INTERVAL (60000)
+#endif
+
+#ifndef WEBSOCKETS_RECONNECT_STABLE_TIME
+// a connection that lasted this long (ms) resets the backoff
+#define WEBSOCKETS_RECONNECT_STABLE_TIME (10000)
+#endif
+
+/**
+ * retry delays for a connection: capped exponential backoff with full jitter
+ * the n-th retry waits random(0 .. min(max, base * 2^n)), so devices that lost the
+ * same server do not come back in lockstep
+ * with max <= base it is a fixed interval without jitter
+ */
+class WebSocketsReconnect {
+  public:
+    WebSocketsReconnect(unsigned long base = 500, unsigned long max = WEBSOCKETS_RECONNECT_MAX_INTERVAL, unsigned long stable = WEBSOCKETS_RECONNECT_STABLE_TIME) {
+        setInterval(base, max);
+        _stable = stable;
+        reset();
+    }
+
+    /**
+     * @param base unsigned long  ms, limit of the first retry
+     * @param max unsigned long   ms, limit of any retry
+     */
+    void setInterval(unsigned long base, unsigned long max) {
+        _base = base;
+        _max  = max;
+    }
+
+    /**
+     * @param stable unsigned long  ms a connection must last to reset the backoff, 0 = reset at once
+     */
+    void setStableTime(unsigned long stable) {
+        _stable = stable;
+    }
+
+    void reset(void) {
+        _failures    = 0;
+        _connected   = false;
+        _connectedAt = 0;
+    }
+
+    /**
+     * the connection is up
+     * @param now unsigned long  millis
+     */
+    void connected(unsigned long now) {
+        _connected   = true;
+        _connectedAt = now;
+        if(_stable == 0) {
+            _failures = 0;
+        }
+    }
+
+    /**
+     * the attempt failed or the connection is lost
+     * @param now unsigned long  millis
+     * @return ms to wait before the next attempt
+     */
+    unsigned long next(unsigned long now) {
+        if(_connected && now - _connectedAt >= _stable) {
+            _failures = 0;
+        }
+        _connected = false;
+
+        if(_max <= _base) {
+            return _base;
+        }
+
+        unsigned long limit = _base;
+        for(uint8_t i = 0; i < _failures && limit < _max; i++) {
+            limit <<= 1;
+        }
+        if(limit > _max || limit < _base) {
+            limit = _max;
+        }
+        if(_failures < 0xFF) {
+            _failures++;
+        }
+        return (unsigned long)random(0, (long)limit + 1);
+    }
+
+    /**
+     * @return failed attempts since the last stable connection
+     */
+    uint8_t failures(void) const {
+        return _failures;
+    }
+
+  protected:
+    unsigned long _base;
+    unsigned long _max;
+    unsigned long _stable;
+    unsigned long _connectedAt;
+    uint8_t _failures;
+    bool _connected;
+};
+
+#endif /* WEBSOCKETSRECONNECT_H_ */
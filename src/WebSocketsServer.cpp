@@ -32,6 +32,32 @@ WebSocketsServerCore::WebSocketsServerCore(const String & origin, const String &
     _pingInterval           = 0;
     _pongTimeout            = 0;
     _disconnectTimeoutCount = 0;
+    _handshakeMax           = WEBSOCKETS_SERVER_HANDSHAKE_MAX;
+    _handshakeTimeout       = WEBSOCKETS_SERVER_HANDSHAKE_TIMEOUT;
+#ifdef WEBSOCKETS_HAS_ACCEPT_LIMIT
+    memset(&_rate[0], 0x00, sizeof(_rate));
+    _rateBurst       = 0;
+    _rateInterval    = 0;
+    _rejectedClients = 0;
+#endif
+#ifdef WEBSOCKETS_HAS_DEFLATE
+    _deflateBits      = 0;
+    _deflateNoContext = false;
+#endif
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+    _poller      = NULL;
+    _pollTimeout = 0;
+#endif
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+    memset(&_headerBufferUsed[0], 0x00, sizeof(_headerBufferUsed));
+#endif
+
+    memset(&_broadcastDelivered[0], 0x00, sizeof(_broadcastDelivered));
+    resetSlots();
+#ifdef WEBSOCKETS_HAS_SERVER_TOPICS
+    memset(&_topics[0], 0x00, sizeof(_topics));
+    _topicCount = 0;
+#endif
 
     _cbEvent = NULL;
 
@@ -106,6 +132,7 @@ void WebSocketsServerCore::close(void) {
     for(int i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
         _clients[i] = WSclient_t();
     }
+    resetSlots();
 }
 
 /**
@@ -185,22 +212,10 @@ bool WebSocketsServerCore::sendTXT(uint8_t num, String & payload) {
  * @return true if ok
  */
 bool WebSocketsServerCore::broadcastTXT(uint8_t * payload, size_t length, bool headerToPayload) {
-    WSclient_t * client;
-    bool ret = true;
     if(length == 0) {
         length = strlen((const char *)payload);
     }
-
-    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
-        client = &_clients[i];
-        if(clientIsConnected(client)) {
-            if(!sendFrame(client, WSop_text, payload, length, true, headerToPayload)) {
-                ret = false;
-            }
-        }
-        WEBSOCKETS_YIELD();
-    }
-    return ret;
+    return broadcastFrame(WSop_text, (payload + (headerToPayload ? WEBSOCKETS_MAX_HEADER_SIZE : 0)), length);
 }
 
 bool WebSocketsServerCore::broadcastTXT(const uint8_t * payload, size_t length) {
@@ -250,18 +265,7 @@ bool WebSocketsServerCore::sendBIN(uint8_t num, const uint8_t * payload, size_t
  * @return true if ok
  */
 bool WebSocketsServerCore::broadcastBIN(uint8_t * payload, size_t length, bool headerToPayload) {
-    WSclient_t * client;
-    bool ret = true;
-    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
-        client = &_clients[i];
-        if(clientIsConnected(client)) {
-            if(!sendFrame(client, WSop_binary, payload, length, true, headerToPayload)) {
-                ret = false;
-            }
-        }
-        WEBSOCKETS_YIELD();
-    }
-    return ret;
+    return broadcastFrame(WSop_binary, (payload + (headerToPayload ? WEBSOCKETS_MAX_HEADER_SIZE : 0)), length);
 }
 
 bool WebSocketsServerCore::broadcastBIN(const uint8_t * payload, size_t length) {
@@ -297,22 +301,332 @@ bool WebSocketsServerCore::sendPing(uint8_t num, String & payload) {
  * @return true if ping is send out
  */
 bool WebSocketsServerCore::broadcastPing(uint8_t * payload, size_t length) {
+    return broadcastFrame(WSop_ping, payload, length);
+}
+
+bool WebSocketsServerCore::broadcastPing(String & payload) {
+    return broadcastPing((uint8_t *)payload.c_str(), payload.length());
+}
+
+/**
+ * result of the last broadcast for one client
+ * @param num uint8_t client id
+ * @return true if the message was written to the client
+ */
+bool WebSocketsServerCore::broadcastDelivered(uint8_t num) {
+    if(num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+        return false;
+    }
+    return _broadcastDelivered[num];
+}
+
+#ifdef WEBSOCKETS_HAS_SERVER_TOPICS
+/**
+ * add the client to the subscribers of a topic, the topic is created on first use
+ * @param num uint8_t client id
+ * @param topic const char *  name (max WEBSOCKETS_SERVER_TOPIC_NAME_SIZE - 1 chars)
+ * @return false if the client is not connected or no topic is left
+ */
+bool WebSocketsServerCore::subscribe(uint8_t num, const char * topic) {
+    if(num >= WEBSOCKETS_SERVER_CLIENT_MAX || !clientIsConnected(&_clients[num])) {
+        return false;
+    }
+    WStopic_t * entry = findTopic(topic, true);
+    if(!entry) {
+        DEBUG_WEBSOCKETS("[WS-Server][%d] can not subscribe to %s\n", num, topic);
+        return false;
+    }
+    uint8_t mask = (1 << (num & 7));
+    if(!(entry->subscribers[num >> 3] & mask)) {
+        entry->subscribers[num >> 3] |= mask;
+        entry->count++;
+    }
+    return true;
+}
+
+/**
+ * remove the client from the subscribers, the topic is dropped with the last one
+ * @param num uint8_t client id
+ * @param topic const char *
+ * @return true if the client was subscribed
+ */
+bool WebSocketsServerCore::unsubscribe(uint8_t num, const char * topic) {
+    if(num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+        return false;
+    }
+    WStopic_t * entry = findTopic(topic, false);
+    uint8_t mask      = (1 << (num & 7));
+    if(!entry || !(entry->subscribers[num >> 3] & mask)) {
+        return false;
+    }
+    entry->subscribers[num >> 3] &= ~mask;
+    if(--entry->count == 0) {
+        removeTopic(entry);
+    }
+    return true;
+}
+
+/**
+ * remove the client from all topics (done on disconnect)
+ * @param num uint8_t client id
+ */
+void WebSocketsServerCore::unsubscribeAll(uint8_t num) {
+    if(num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+        return;
+    }
+    uint8_t mask = (1 << (num & 7));
+    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_TOPIC_SLOTS && _topicCount > 0;) {
+        WStopic_t * entry = &_topics[i];
+        if(entry->hash && (entry->subscribers[num >> 3] & mask)) {
+            entry->subscribers[num >> 3] &= ~mask;
+            if(--entry->count == 0) {
+                // an other topic may move into this slot
+                removeTopic(entry);
+                continue;
+            }
+        }
+        i++;
+    }
+}
+
+/**
+ * @param num uint8_t client id
+ * @param topic const char *
+ * @return true if the client gets the messages of the topic
+ */
+bool WebSocketsServerCore::isSubscribed(uint8_t num, const char * topic) {
+    if(num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+        return false;
+    }
+    WStopic_t * entry = findTopic(topic, false);
+    return entry && (entry->subscribers[num >> 3] & (1 << (num & 7)));
+}
+
+/**
+ * @param topic const char *
+ * @return number of clients subscribed to the topic
+ */
+uint8_t WebSocketsServerCore::subscribers(const char * topic) {
+    WStopic_t * entry = findTopic(topic, false);
+    return entry ? entry->count : 0;
+}
+
+/**
+ * send text data to the subscribers of a topic, encoded once like broadcastTXT
+ * @param topic const char *
+ * @param payload uint8_t *
+ * @param length size_t
+ * @param headerToPayload bool  (see sendFrame for more details)
+ * @return true if all subscribers got the message (broadcastDelivered has the details)
+ */
+bool WebSocketsServerCore::publishTXT(const char * topic, uint8_t * payload, size_t length, bool headerToPayload) {
+    WStopic_t * entry = findTopic(topic, false);
+    if(!entry) {
+        memset(&_broadcastDelivered[0], 0x00, sizeof(_broadcastDelivered));
+        return true;
+    }
+    if(length == 0) {
+        length = strlen((const char *)(payload + (headerToPayload ? WEBSOCKETS_MAX_HEADER_SIZE : 0)));
+    }
+    return broadcastFrame(WSop_text, (payload + (headerToPayload ? WEBSOCKETS_MAX_HEADER_SIZE : 0)), length, entry->subscribers);
+}
+
+bool WebSocketsServerCore::publishTXT(const char * topic, const uint8_t * payload, size_t length) {
+    return publishTXT(topic, (uint8_t *)payload, length);
+}
+
+bool WebSocketsServerCore::publishTXT(const char * topic, char * payload, size_t length, bool headerToPayload) {
+    return publishTXT(topic, (uint8_t *)payload, length, headerToPayload);
+}
+
+bool WebSocketsServerCore::publishTXT(const char * topic, const char * payload, size_t length) {
+    return publishTXT(topic, (uint8_t *)payload, length);
+}
+
+bool WebSocketsServerCore::publishTXT(const char * topic, String & payload) {
+    return publishTXT(topic, (uint8_t *)payload.c_str(), payload.length());
+}
+
+/**
+ * send binary data to the subscribers of a topic
+ * @param topic const char *
+ * @param payload uint8_t *
+ * @param length size_t
+ * @param headerToPayload bool  (see sendFrame for more details)
+ * @return true if all subscribers got the message
+ */
+bool WebSocketsServerCore::publishBIN(const char * topic, uint8_t * payload, size_t length, bool headerToPayload) {
+    WStopic_t * entry = findTopic(topic, false);
+    if(!entry) {
+        memset(&_broadcastDelivered[0], 0x00, sizeof(_broadcastDelivered));
+        return true;
+    }
+    return broadcastFrame(WSop_binary, (payload + (headerToPayload ? WEBSOCKETS_MAX_HEADER_SIZE : 0)), length, entry->subscribers);
+}
+
+bool WebSocketsServerCore::publishBIN(const char * topic, const uint8_t * payload, size_t length) {
+    return publishBIN(topic, (uint8_t *)payload, length);
+}
+
+/**
+ * hash lookup of a topic
+ * @param topic const char *
+ * @param create bool  add the topic if it is unknown
+ * @return WStopic_t * or NULL
+ */
+WStopic_t * WebSocketsServerCore::findTopic(const char * topic, bool create) {
+    if(!topic) {
+        return NULL;
+    }
+
+    // FNV-1a
+    uint32_t hash = 2166136261UL;
+    size_t len    = 0;
+    for(const char * c = topic; *c; c++, len++) {
+        hash ^= (uint8_t)*c;
+        hash *= 16777619UL;
+    }
+    if(hash == 0) {
+        hash = 1;
+    }
+    if(len == 0 || len >= WEBSOCKETS_SERVER_TOPIC_NAME_SIZE) {
+        return NULL;
+    }
+
+    uint8_t i = hash % WEBSOCKETS_SERVER_TOPIC_SLOTS;
+    while(_topics[i].hash) {
+        if(_topics[i].hash == hash && strcmp(_topics[i].name, topic) == 0) {
+            return &_topics[i];
+        }
+        i = (i + 1) % WEBSOCKETS_SERVER_TOPIC_SLOTS;
+    }
+
+    if(!create || _topicCount >= WEBSOCKETS_SERVER_TOPIC_MAX) {
+        return NULL;
+    }
+
+    WStopic_t * entry = &_topics[i];
+    memset(entry, 0x00, sizeof(WStopic_t));
+    entry->hash = hash;
+    memcpy(&entry->name[0], topic, len + 1);
+    _topicCount++;
+    return entry;
+}
+
+/**
+ * free the slot, following entries of the probe sequence are moved up (no tombstones)
+ * @param entry WStopic_t *
+ */
+void WebSocketsServerCore::removeTopic(WStopic_t * entry) {
+    uint8_t i = entry - &_topics[0];
+    uint8_t j = i;
+
+    while(true) {
+        j = (j + 1) % WEBSOCKETS_SERVER_TOPIC_SLOTS;
+        if(_topics[j].hash == 0) {
+            break;
+        }
+        uint8_t home = _topics[j].hash % WEBSOCKETS_SERVER_TOPIC_SLOTS;
+        // entries that are reachable from their home slot stay
+        if((i <= j) ? ((i < home) && (home <= j)) : ((i < home) || (home <= j))) {
+            continue;
+        }
+        _topics[i] = _topics[j];
+        i          = j;
+    }
+
+    _topics[i].hash = 0;
+    _topicCount--;
+}
+#endif
+
+/**
+ * encode the message once and write the same bytes to all connected clients,
+ * server frames are not masked so only the permessage-deflate clients need a second encoding
+ * @param opcode WSopcode_t
+ * @param payload uint8_t *
+ * @param length size_t
+ * @param subscribers const uint8_t *  bit per client id of a topic, NULL = all clients
+ * @return true if all connected clients got the message
+ */
+bool WebSocketsServerCore::broadcastFrame(WSopcode_t opcode, uint8_t * payload, size_t length, const uint8_t * subscribers) {
+    uint8_t targets[WEBSOCKETS_SERVER_CLIENT_MAX];
+    uint8_t count = 0;
     WSclient_t * client;
+    WSframe_t * frame = NULL;
+    WSframe_t * shared;
+    bool frameTried = false;
+    bool single;
     bool ret = true;
-    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
-        client = &_clients[i];
+#ifdef WEBSOCKETS_HAS_DEFLATE
+    WSframe_t * deflated = NULL;
+    uint8_t deflateBits  = 0;    ///< window bits of deflated, 0 = not tried yet
+#endif
+
+    memset(&_broadcastDelivered[0], 0x00, sizeof(_broadcastDelivered));
+
+    // take a copy, the active list can change while we write (disconnects)
+    if(subscribers) {
+        for(uint8_t b = 0; b < (WEBSOCKETS_SERVER_CLIENT_MAX + 7) / 8; b++) {
+            for(uint8_t bits = subscribers[b]; bits; bits &= (bits - 1)) {
+                targets[count++] = (b * 8) + __builtin_ctz(bits);
+            }
+        }
+    } else {
+        count = _activeCount;
+        memcpy(&targets[0], &_activeSlots[0], count);
+    }
+
+    for(uint8_t n = 0; n < count; n++) {
+        uint8_t i = targets[n];
+        client    = &_clients[i];
         if(clientIsConnected(client)) {
-            if(!sendFrame(client, WSop_ping, payload, length)) {
+            shared = NULL;
+            single = false;
+#ifdef WEBSOCKETS_HAS_DEFLATE
+            if(client->cDeflate && (opcode == WSop_text || opcode == WSop_binary)) {
+                if(deflateBits == 0) {
+                    deflateBits = client->cDeflateTxBits;
+                    deflated    = frameDeflate(opcode, payload, length, deflateBits);
+                }
+                if(client->cDeflateTxBits != deflateBits) {
+                    // other window size, this client gets its own encoding
+                    single = true;
+                }
+                shared = deflated;
+            }
+#endif
+            if(!shared && !single) {
+#ifdef WEBSOCKETS_USE_BIG_MEM
+                if(!frameTried && (GET_FREE_HEAP > (6000 + length))) {
+                    frame = frameCreate(opcode, payload, length);
+                }
+#endif
+                frameTried = true;
+                shared     = frame;
+            }
+
+            if(shared && !single) {
+#ifdef WEBSOCKETS_HAS_SERVER_QUEUE
+                _broadcastDelivered[i] = queueFrame(client, shared);
+#else
+                _broadcastDelivered[i] = sendFrame(client, shared);
+#endif
+            } else {
+                _broadcastDelivered[i] = sendFrame(client, opcode, payload, length);
+            }
+            if(!_broadcastDelivered[i]) {
                 ret = false;
             }
         }
         WEBSOCKETS_YIELD();
     }
-    return ret;
-}
 
-bool WebSocketsServerCore::broadcastPing(String & payload) {
-    return broadcastPing((uint8_t *)payload.c_str(), payload.length());
+    frameRelease(frame);
+#ifdef WEBSOCKETS_HAS_DEFLATE
+    frameRelease(deflated);
+#endif
+    return ret;
 }
 
 /**
@@ -320,11 +634,17 @@ bool WebSocketsServerCore::broadcastPing(String & payload) {
  */
 void WebSocketsServerCore::disconnect(void) {
     WSclient_t * client;
-    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
-        client = &_clients[i];
+    while(_activeCount > 0) {
+        client = &_clients[_activeSlots[_activeCount - 1]];
         if(clientIsConnected(client)) {
             WebSockets::clientDisconnect(client, 1000);
         }
+        if(client->status == WSC_CLOSING) {
+            // the server goes down, no waiting for the close frame of a slow client
+            clientDisconnect(client);
+        }
+        // lost connections are released by clientIsConnected
+        releaseSlot(client);
     }
 }
 
@@ -342,6 +662,177 @@ void WebSocketsServerCore::disconnect(uint8_t num) {
     }
 }
 
+/**
+ * collect all following frames for one client in the cork buffer until uncork is called
+ * @param num uint8_t client id
+ */
+void WebSocketsServerCore::cork(uint8_t num) {
+    if(num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+        return;
+    }
+    WebSockets::cork(&_clients[num]);
+}
+
+/**
+ * send all frames collected since cork with one write
+ * @param num uint8_t client id
+ * @return true if ok, false if the write failed and the client is disconnected
+ */
+bool WebSocketsServerCore::uncork(uint8_t num) {
+    if(num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+        return false;
+    }
+    return WebSockets::uncork(&_clients[num]);
+}
+
+/**
+ * estimated bytes on wire saved by coalescing frames for one client
+ * @param num uint8_t client id
+ * @return uint32_t
+ */
+uint32_t WebSocketsServerCore::corkSavedBytes(uint8_t num) {
+    if(num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+        return 0;
+    }
+    return _clients[num].txSavedBytes;
+}
+
+#ifdef WEBSOCKETS_HAS_SERVER_QUEUE
+/**
+ * what to do if the send queue of a client is full
+ * @param policy WSqueuePolicy_t  WSQ_DROP_OLDEST (default), WSQ_DROP_NEWEST or WSQ_DISCONNECT
+ */
+void WebSocketsServerCore::setQueuePolicy(WSqueuePolicy_t policy) {
+    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
+        _clients[i].txQueuePolicy = policy;
+    }
+}
+
+/**
+ * messages waiting for the TCP buffer of one client
+ * @param num uint8_t client id
+ * @return uint8_t
+ */
+uint8_t WebSocketsServerCore::queueDepth(uint8_t num) {
+    if(num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+        return 0;
+    }
+    return _clients[num].txQueueLen;
+}
+
+/**
+ * max queue depth of one client since it is connected
+ * @param num uint8_t client id
+ * @return uint8_t
+ */
+uint8_t WebSocketsServerCore::queuePeak(uint8_t num) {
+    if(num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+        return 0;
+    }
+    return _clients[num].txQueuePeak;
+}
+
+/**
+ * how long the oldest queued message of one client is waiting
+ * @param num uint8_t client id
+ * @return ms, 0 if nothing is queued
+ */
+unsigned long WebSocketsServerCore::queueLag(uint8_t num) {
+    if(num >= WEBSOCKETS_SERVER_CLIENT_MAX || _clients[num].txQueueLen == 0) {
+        return 0;
+    }
+    return (millis() - _clients[num].txQueue[_clients[num].txQueueHead].queued);
+}
+
+/**
+ * messages dropped by the queue policy for one client
+ * @param num uint8_t client id
+ * @return uint32_t
+ */
+uint32_t WebSocketsServerCore::queueDropped(uint8_t num) {
+    if(num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+        return 0;
+    }
+    return _clients[num].txQueueDropped;
+}
+#endif
+
+/**
+ * start a message to one client that is send in fragments with streamWrite / streamEnd
+ * the message does not need to be in RAM as a whole
+ * @param num uint8_t client id
+ * @param binary bool   send as binary instead of text message
+ * @return true if ok
+ */
+bool WebSocketsServerCore::streamBegin(uint8_t num, bool binary) {
+    if(num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+        return false;
+    }
+    WSclient_t * client = &_clients[num];
+    if(clientIsConnected(client)) {
+        return WebSockets::streamBegin(client, binary ? WSop_binary : WSop_text);
+    }
+    return false;
+}
+
+/**
+ * send the next fragment of the streamed message
+ * with the send queue nothing is send while the client has not taken the data before (see streamReady)
+ * without it the write blocks (at most WEBSOCKETS_TCP_TIMEOUT), a slow client slows down the producer
+ * @param num uint8_t client id
+ * @param payload const uint8_t *
+ * @param length size_t
+ * @return true if ok, false if it would block or on error (the client is disconnected)
+ */
+bool WebSocketsServerCore::streamWrite(uint8_t num, const uint8_t * payload, size_t length) {
+    if(num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+        return false;
+    }
+    if(length == 0) {
+        return true;
+    }
+    return streamFrame(&_clients[num], payload, length, false);
+}
+
+bool WebSocketsServerCore::streamWrite(uint8_t num, const char * payload) {
+    return streamWrite(num, (const uint8_t *)payload, strlen(payload));
+}
+
+/**
+ * send the last fragment and end the streamed message
+ * @param num uint8_t client id
+ * @param payload const uint8_t *   (optional)
+ * @param length size_t
+ * @return true if ok, false if it would block (see streamReady) or on error
+ */
+bool WebSocketsServerCore::streamEnd(uint8_t num, const uint8_t * payload, size_t length) {
+    if(num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+        return false;
+    }
+    return streamFrame(&_clients[num], payload, length, true);
+}
+
+/**
+ * check if the next fragment of the streamed message can be send without waiting
+ * @param num uint8_t client id
+ * @return true if the streamed message is open and nothing is queued for the client
+ */
+bool WebSocketsServerCore::streamReady(uint8_t num) {
+    if(num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+        return false;
+    }
+    WSclient_t * client = &_clients[num];
+    if(!client->txStream || client->status != WSC_CONNECTED) {
+        return false;
+    }
+#ifdef WEBSOCKETS_HAS_SERVER_QUEUE
+    queueDrain(client);
+    return (client->txQueueLen == 0);
+#else
+    return true;
+#endif
+}
+
 /*
  * set the Authorization for the http request
  * @param user const char *
@@ -373,10 +864,13 @@ void WebSocketsServerCore::setAuthorization(const char * auth) {
 int WebSocketsServerCore::connectedClients(bool ping) {
     WSclient_t * client;
     int count = 0;
-    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
-        client = &_clients[i];
+    for(uint8_t n = _activeCount; n-- > 0;) {
+        if(n >= _activeCount) {
+            continue;
+        }
+        client = &_clients[_activeSlots[n]];
         if(client->status == WSC_CONNECTED) {
-            if(ping != true || sendPing(i)) {
+            if(ping != true || sendPing(client->num)) {
                 count++;
             }
         }
@@ -396,7 +890,7 @@ bool WebSocketsServerCore::clientIsConnected(uint8_t num) {
     return clientIsConnected(client);
 }
 
-#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RP2040)
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RP2040) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_POSIX)
 /**
  * get an IP for a client
  * @param num uint8_t client id
@@ -423,60 +917,152 @@ IPAddress WebSocketsServerCore::remoteIP(uint8_t num) {
  * @param client
  */
 WSclient_t * WebSocketsServerCore::newClient(WEBSOCKETS_NETWORK_CLASS * TCPclient) {
-    WSclient_t * client;
-    // search free list entry for client
-    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
-        client = &_clients[i];
+    if(_handshakeMax < WEBSOCKETS_SERVER_CLIENT_MAX && handshakesInFlight() >= _handshakeMax) {
+        return nullptr;
+    }
+
+    WSclient_t * client = allocSlot();
+    if(!client) {
+        return nullptr;
+    }
 
-        // state is not connected or tcp connection is lost
-        if(!clientIsConnected(client)) {
-            client->tcp = TCPclient;
+    client->tcp             = TCPclient;
+    client->cHandshakeStart = millis();
 
 #if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32)
-            client->isSSL = false;
-            client->tcp->setNoDelay(true);
+    client->isSSL = false;
+    client->tcp->setNoDelay(true);
+#elif(WEBSOCKETS_NETWORK_TYPE == NETWORK_POSIX)
+    client->tcp->setNoDelay(true);
 #endif
 #if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
-            // set Timeout for readBytesUntil and readStringUntil
-            client->tcp->setTimeout(WEBSOCKETS_TCP_TIMEOUT);
+    // set Timeout for readBytesUntil and readStringUntil
+    client->tcp->setTimeout(WEBSOCKETS_TCP_TIMEOUT);
+    if(_poller) {
+        _poller->watch(client);
+    }
 #endif
-            client->status = WSC_HEADER;
-#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RP2040)
+    client->status = WSC_HEADER;
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RP2040) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_POSIX)
 #ifndef NODEBUG_WEBSOCKETS
-            IPAddress ip = client->tcp->remoteIP();
+    IPAddress ip = client->tcp->remoteIP();
 #endif
-            DEBUG_WEBSOCKETS("[WS-Server][%d] new client from %d.%d.%d.%d\n", client->num, ip[0], ip[1], ip[2], ip[3]);
+    DEBUG_WEBSOCKETS("[WS-Server][%d] new client from %d.%d.%d.%d\n", client->num, ip[0], ip[1], ip[2], ip[3]);
 #else
-            DEBUG_WEBSOCKETS("[WS-Server][%d] new client\n", client->num);
+    DEBUG_WEBSOCKETS("[WS-Server][%d] new client\n", client->num);
 #endif
 
 #if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
-            client->tcp->onDisconnect(std::bind([](WebSocketsServerCore * server, AsyncTCPbuffer * obj, WSclient_t * client) -> bool {
-                DEBUG_WEBSOCKETS("[WS-Server][%d] Disconnect client\n", client->num);
+    client->tcp->onDisconnect(std::bind([](WebSocketsServerCore * server, AsyncTCPbuffer * obj, WSclient_t * client) -> bool {
+        DEBUG_WEBSOCKETS("[WS-Server][%d] Disconnect client\n", client->num);
 
-                AsyncTCPbuffer ** sl = &server->_clients[client->num].tcp;
-                if(*sl == obj) {
-                    client->status = WSC_NOT_CONNECTED;
-                    *sl            = NULL;
-                }
-                return true;
-            },
-                this, std::placeholders::_1, client));
+        AsyncTCPbuffer ** sl = &server->_clients[client->num].tcp;
+        if(*sl == obj) {
+            client->status = WSC_NOT_CONNECTED;
+            *sl            = NULL;
+        }
+        return true;
+    },
+        this, std::placeholders::_1, client));
 
-            client->tcp->readStringUntil('\n', &(client->cHttpLine), std::bind(&WebSocketsServerCore::handleHeader, this, client, &(client->cHttpLine)));
+    client->tcp->readStringUntil('\n', &(client->cHttpLine), std::bind(&WebSocketsServerCore::handleHeader, this, client, &(client->cHttpLine)));
+#endif
+
+    client->pingInterval           = _pingInterval;
+    client->pongTimeout            = _pongTimeout;
+    client->disconnectTimeoutCount = _disconnectTimeoutCount;
+    client->lastPing               = millis();
+    client->pongReceived           = false;
+
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+    scheduleClient(client);
+#endif
+
+    return client;
+}
+
+/**
+ * all client ids are free
+ */
+void WebSocketsServerCore::resetSlots(void) {
+    // the stack hands out the lowest id first
+    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
+        _freeSlots[i]   = (WEBSOCKETS_SERVER_CLIENT_MAX - 1) - i;
+        _activeIndex[i] = 0xFF;
+    }
+    _freeCount   = WEBSOCKETS_SERVER_CLIENT_MAX;
+    _activeCount = 0;
+}
+
+/**
+ * check for a free client id
+ * @return true if allocSlot will succeed
+ */
+bool WebSocketsServerCore::hasFreeSlot(void) {
+    if(_freeCount == 0) {
+        // clean up connections that are lost but not noticed yet
+        for(uint8_t n = _activeCount; n-- > 0;) {
+            if(n < _activeCount) {
+                clientIsConnected(&_clients[_activeSlots[n]]);
+            }
+        }
+    }
+    return _freeCount > 0;
+}
+
+/**
+ * take a free client id, O(1)
+ * @return WSclient_t * or nullptr if all are in use
+ */
+WSclient_t * WebSocketsServerCore::allocSlot(void) {
+    if(!hasFreeSlot()) {
+        return nullptr;
+    }
+
+    uint8_t num                = _freeSlots[--_freeCount];
+    _activeIndex[num]          = _activeCount;
+    _activeSlots[_activeCount] = num;
+    _activeCount++;
+    return &_clients[num];
+}
+
+/**
+ * give the client id and its topics back, can be called more then once
+ * @param client WSclient_t *  ptr to the client struct
+ */
+void WebSocketsServerCore::releaseSlot(WSclient_t * client) {
+    uint8_t num   = client->num;
+    uint8_t index = _activeIndex[num];
+    if(index == 0xFF) {
+        return;
+    }
+
+#ifdef WEBSOCKETS_HAS_SERVER_TOPICS
+    // every way out of the server ends here, also the async close that skips clientDisconnect
+    unsubscribeAll(num);
+#endif
+
+    // move the last active client into the gap
+    _activeCount--;
+    _activeSlots[index]               = _activeSlots[_activeCount];
+    _activeIndex[_activeSlots[index]] = index;
+    _activeIndex[num]                 = 0xFF;
+    _freeSlots[_freeCount++]          = num;
+}
+
+/**
+ * free the handshake strings, they are not needed after the upgrade
+ * @param client WSclient_t *  ptr to the client struct
+ */
+void WebSocketsServerCore::releaseHeaders(WSclient_t * client) {
+    client->cUrl        = String();
+    client->cKey        = String();
+    client->cAccept     = String();
+    client->cProtocol   = String();
+    client->cExtensions = String();
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
+    client->cHttpLine = String();
 #endif
-
-            client->pingInterval           = _pingInterval;
-            client->pongTimeout            = _pongTimeout;
-            client->disconnectTimeoutCount = _disconnectTimeoutCount;
-            client->lastPing               = millis();
-            client->pongReceived           = false;
-
-            return client;
-            break;
-        }
-    }
-    return nullptr;
 }
 
 /**
@@ -542,6 +1128,12 @@ void WebSocketsServerCore::dropNativeClient(WSclient_t * client) {
  * @param client WSclient_t *  ptr to the client struct
  */
 void WebSocketsServerCore::clientDisconnect(WSclient_t * client) {
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+    if(_poller) {
+        _poller->unwatch(client);
+    }
+    _timers.cancel(client->num);
+#endif
 #if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RP2040)
     if(client->isSSL && client->ssl) {
         if(client->ssl->connected()) {
@@ -555,21 +1147,30 @@ void WebSocketsServerCore::clientDisconnect(WSclient_t * client) {
 #endif
 
     dropNativeClient(client);
+    releaseCork(client);
+    client->txStream = false;
+#ifdef WEBSOCKETS_HAS_SERVER_QUEUE
+    queueRelease(client);
+    client->txQueuePeak    = 0;
+    client->txQueueDropped = 0;
+#endif
+#ifdef WEBSOCKETS_HAS_DEFLATE
+    releaseDeflate(client);
+#endif
+
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+    releaseHeaderBuffer(client);
+#endif
 
-    client->cUrl         = "";
-    client->cKey         = "";
-    client->cProtocol    = "";
+    releaseHeaders(client);
     client->cVersion     = 0;
     client->cIsUpgrade   = false;
     client->cIsWebsocket = false;
 
     client->cWsRXsize = 0;
 
-#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
-    client->cHttpLine = "";
-#endif
-
     client->status = WSC_NOT_CONNECTED;
+    releaseSlot(client);
 
     DEBUG_WEBSOCKETS("[WS-Server][%d] client disconnected.\n", client->num);
 
@@ -583,6 +1184,10 @@ void WebSocketsServerCore::clientDisconnect(WSclient_t * client) {
  */
 bool WebSocketsServerCore::clientIsConnected(WSclient_t * client) {
     if(!client->tcp) {
+        // connection closed by the network layer (async)
+        if(client->status == WSC_NOT_CONNECTED) {
+            releaseSlot(client);
+        }
         return false;
     }
 
@@ -616,7 +1221,7 @@ WSclient_t * WebSocketsServerCore::handleNewClient(WEBSOCKETS_NETWORK_CLASS * tc
 
     if(!client) {
         // no free space to handle client
-#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RP2040)
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RP2040) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_POSIX)
 #ifndef NODEBUG_WEBSOCKETS
         IPAddress ip = tcpClient->remoteIP();
 #endif
@@ -641,12 +1246,23 @@ WSclient_t * WebSocketsServerCore::handleNewClient(WEBSOCKETS_NETWORK_CLASS * tc
  * Handle incoming Connection Request
  */
 void WebSocketsServer::handleNewClients(void) {
-#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RP2040)
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RP2040) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_POSIX)
     while(_server->hasClient()) {
-#endif
+        // refuse before a client object and id are spent on the connection
+        WEBSOCKETS_NETWORK_CLASS incoming = _server->available();
+        WSadmit_t admit                   = admitClient(incoming);
+        if(admit != WSA_OK) {
+            _rejectedClients++;
+            handleRejectedConnection(incoming, admit);
+            continue;
+        }
 
+        // store new connection
+        WEBSOCKETS_NETWORK_CLASS * tcpClient = new WEBSOCKETS_NETWORK_CLASS(incoming);
+#else
         // store new connection
         WEBSOCKETS_NETWORK_CLASS * tcpClient = new WEBSOCKETS_NETWORK_CLASS(_server->available());
+#endif
         if(!tcpClient) {
             DEBUG_WEBSOCKETS("[WS-Client] creating Network class failed!");
             return;
@@ -654,7 +1270,7 @@ void WebSocketsServer::handleNewClients(void) {
 
         handleNewClient(tcpClient);
 
-#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RP2040)
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RP2040) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_POSIX)
     }
 #endif
 }
@@ -663,34 +1279,189 @@ void WebSocketsServer::handleNewClients(void) {
  * Handel incomming data from Client
  */
 void WebSocketsServerCore::handleClientData(void) {
-    WSclient_t * client;
-    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
-        client = &_clients[i];
-        if(clientIsConnected(client)) {
-            int len = client->tcp->available();
-            if(len > 0) {
-                // DEBUG_WEBSOCKETS("[WS-Server][%d][handleClientData] len: %d\n", client->num, len);
-                switch(client->status) {
-                    case WSC_HEADER: {
-                        String headerLine = client->tcp->readStringUntil('\n');
-                        handleHeader(client, &headerLine);
-                    } break;
-                    case WSC_CONNECTED:
-                        WebSockets::handleWebsocket(client);
-                        break;
-                    default:
-                        DEBUG_WEBSOCKETS("[WS-Server][%d][handleClientData] unknown client status %d\n", client->num, client->status);
-                        WebSockets::clientDisconnect(client, 1002);
-                        break;
-                }
-            }
-
-            handleHBPing(client);
-            handleHBTimeout(client);
+    // only the clients in use, the current one may leave the list
+    for(uint8_t n = _activeCount; n-- > 0;) {
+        if(n >= _activeCount) {
+            continue;
         }
+        handleClient(&_clients[_activeSlots[n]]);
         WEBSOCKETS_YIELD();
     }
 }
+
+/**
+ * read what the client has send, drain its queue and do the heartbeat
+ * @param client WSclient_t *  ptr to the client struct
+ */
+void WebSocketsServerCore::handleClient(WSclient_t * client) {
+    if(!clientIsConnected(client)) {
+        return;
+    }
+    if(client->status == WSC_HEADER && _handshakeTimeout && (millis() - client->cHandshakeStart) > _handshakeTimeout) {
+        DEBUG_WEBSOCKETS("[WS-Server][%d][handleClient] handshake timeout\n", client->num);
+        clientDisconnect(client);
+        return;
+    }
+#ifdef WEBSOCKETS_HAS_SERVER_QUEUE
+    if(client->status == WSC_CLOSING) {
+        handleClosing(client);
+        return;
+    }
+    queueDrain(client);
+#endif
+    // answers and heartbeats of this loop leave in one write
+    WebSockets::cork(client);
+    int len = client->tcp->available();
+    if(len > 0) {
+        // DEBUG_WEBSOCKETS("[WS-Server][%d][handleClientData] len: %d\n", client->num, len);
+        switch(client->status) {
+            case WSC_HEADER:
+                handleHeaderData(client);
+                break;
+            case WSC_CONNECTED:
+                WebSockets::handleWebsocket(client);
+                break;
+            default:
+                DEBUG_WEBSOCKETS("[WS-Server][%d][handleClientData] unknown client status %d\n", client->num, client->status);
+                WebSockets::clientDisconnect(client, 1002);
+                break;
+        }
+    }
+
+    handleHBPing(client);
+    handleHBTimeout(client);
+    if(WebSockets::uncork(client)) {
+        // a failed flush has closed the client already
+        scheduleClient(client);
+    }
+}
+
+#ifdef WEBSOCKETS_HAS_SERVER_QUEUE
+/**
+ * write the queue in front of the close frame, the client is dropped when it is empty or after WEBSOCKETS_TCP_TIMEOUT
+ * @param client WSclient_t *  ptr to the client struct
+ */
+void WebSocketsServerCore::handleClosing(WSclient_t * client) {
+    uint8_t buffer[64];
+    // nothing is read anymore, the poller would report the data again and again
+    while(client->tcp->available() > 0 && client->tcp->read(buffer, sizeof(buffer)) > 0) {
+    }
+    queueDrain(client);
+    if(client->txQueueLen == 0 || (millis() - client->txClosing) > WEBSOCKETS_TCP_TIMEOUT) {
+        DEBUG_WEBSOCKETS("[WS-Server][%d][handleClosing] close frame %s\n", client->num, (client->txQueueLen == 0) ? "sent" : "TIMEOUT");
+        clientDisconnect(client);
+        return;
+    }
+    scheduleClient(client);
+}
+#endif
+
+/**
+ * handle the clients the poller reports and the ones with an expired deadline
+ */
+void WebSocketsServerCore::pollClients(void) {
+    uint8_t ready[WEBSOCKETS_SERVER_CLIENT_MAX];
+    bool accept = false;
+    int timeout = _pollTimeout;
+    long next   = _timers.next(millis());
+
+    // do not sleep past the next deadline
+    if(next >= 0 && (timeout < 0 || next < timeout)) {
+        timeout = (int)next;
+    }
+
+    int count = _poller->wait(ready, WEBSOCKETS_SERVER_CLIENT_MAX, &accept, timeout);
+    if(accept) {
+        handleNewClients();
+    }
+    for(int i = 0; i < count; i++) {
+        if(_activeIndex[ready[i]] != 0xFF) {
+            handleClient(&_clients[ready[i]]);
+        }
+    }
+
+    // handleClient sets the next deadline after now, the loop ends
+    unsigned long now = millis();
+    int num;
+    while((num = _timers.pop(now)) >= 0) {
+        if(_activeIndex[num] != 0xFF) {
+            handleClient(&_clients[num]);
+        }
+    }
+}
+
+/**
+ * set the timer of the client to its next deadline (handshake, heartbeat or queued data)
+ * @param client WSclient_t *  ptr to the client struct
+ */
+void WebSocketsServerCore::scheduleClient(WSclient_t * client) {
+    unsigned long now      = millis();
+    unsigned long deadline = 0;
+    bool armed             = false;
+
+    if(client->tcp && !client->tcp->connected()) {
+        // closed by a write, the poller will not report it anymore
+        _timers.set(client->num, now + 1);
+        return;
+    }
+
+    if(client->status == WSC_HEADER) {
+        deadline = client->cHandshakeStart + _handshakeTimeout + 1;
+        armed    = (_handshakeTimeout > 0);
+    } else if(client->status == WSC_CONNECTED) {
+        armed = heartbeatDeadline(client, &deadline);
+    }
+#ifdef WEBSOCKETS_HAS_SERVER_QUEUE
+    else if(client->status == WSC_CLOSING) {
+        deadline = client->txClosing + WEBSOCKETS_TCP_TIMEOUT + 1;
+        armed    = true;
+    }
+    if(client->txQueueLen > 0) {
+        unsigned long retry = now + WEBSOCKETS_QUEUE_RETRY_INTERVAL;
+        if(!armed || (long)(retry - deadline) < 0) {
+            deadline = retry;
+            armed    = true;
+        }
+    }
+#endif
+
+    if(!armed) {
+        _timers.cancel(client->num);
+        return;
+    }
+    if((long)(deadline - now) <= 0) {
+        // overdue, try again in the next ms
+        deadline = now + 1;
+    }
+    _timers.set(client->num, deadline);
+}
+
+/**
+ * recalculate the deadlines after a setting changed
+ */
+void WebSocketsServerCore::scheduleClients(void) {
+    for(uint8_t n = 0; n < _activeCount; n++) {
+        scheduleClient(&_clients[_activeSlots[n]]);
+    }
+}
+
+#ifdef WEBSOCKETS_HAS_SERVER_QUEUE
+/**
+ * the queue of the client got its first frame, come back to drain it
+ * @param client WSclient_t *  ptr to the client struct
+ */
+void WebSocketsServerCore::queueWaiting(WSclient_t * client) {
+    scheduleClient(client);
+}
+#endif
+
+/**
+ * a write found the socket closed, come back in the next ms to clean up the client
+ * @param client WSclient_t *  ptr to the client struct
+ */
+void WebSocketsServerCore::connectionLost(WSclient_t * client) {
+    scheduleClient(client);
+}
 #endif
 
 /*
@@ -705,58 +1476,249 @@ bool WebSocketsServerCore::hasMandatoryHeader(String headerName) {
     return false;
 }
 
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+/**
+ * read the HTTP request of the client into a line buffer and handle the complete lines
+ * the buffer is only taken while the data is read, an incomplete line waits on the heap (cHeaderRest)
+ * @param client WSclient_t *  ptr to the client struct
+ */
+void WebSocketsServerCore::handleHeaderData(WSclient_t * client) {
+    if(!takeHeaderBuffer(client)) {
+        // only possible if called again from a callback, the data stays in the socket
+        return;
+    }
+
+    char * buffer = &_headerBuffers[client->cHeaderBuffer][0];
+    while(client->status == WSC_HEADER) {
+        int len = client->tcp->available();
+        if(len <= 0) {
+            break;
+        }
+        // one byte is left for the terminating 0x00
+        size_t space = (WEBSOCKETS_SERVER_HEADER_LINE_SIZE - 1) - client->cHeaderLen;
+        len          = client->tcp->read((uint8_t *)&buffer[client->cHeaderLen], std::min((size_t)len, space));
+        if(len <= 0) {
+            break;
+        }
+        client->cHeaderLen += len;
+
+        size_t start = 0;
+        char * end;
+        while(client->status == WSC_HEADER && (end = (char *)memchr(&buffer[start], '\n', client->cHeaderLen - start))) {
+            char * line = &buffer[start];
+            start       = (end - buffer) + 1;
+            handleHeaderLine(client, line, end - line);
+        }
+
+        if(client->status != WSC_HEADER) {
+            // done or dropped, the client has to wait for our answer before it sends more (rfc6455 4.1)
+            break;
+        }
+
+        // keep the incomplete line
+        client->cHeaderLen -= start;
+        memmove(buffer, &buffer[start], client->cHeaderLen);
+
+        if(client->cHeaderLen >= (WEBSOCKETS_SERVER_HEADER_LINE_SIZE - 1)) {
+            handleHeaderTooLarge(client);
+            break;
+        }
+    }
+
+    if(client->status != WSC_HEADER || client->cHeaderBuffer == 0xFF) {
+        releaseHeaderBuffer(client);
+        return;
+    }
+
+    // the buffer is free for the next client, the incomplete line waits on the heap
+    char * rest = NULL;
+    if(client->cHeaderLen > 0) {
+        rest = (char *)malloc(client->cHeaderLen);
+        if(!rest) {
+            DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader] no memory for the header line!\n", client->num);
+            clientDisconnect(client);
+            return;
+        }
+        memcpy(rest, buffer, client->cHeaderLen);
+    }
+    _headerBufferUsed[client->cHeaderBuffer] = false;
+    client->cHeaderBuffer                    = 0xFF;
+    client->cHeaderRest                      = rest;
+}
+
+/**
+ * take a free line buffer for the request of the client, the incomplete line of the last read is moved into it
+ * @param client WSclient_t *  ptr to the client struct
+ * @return false if all are in use
+ */
+bool WebSocketsServerCore::takeHeaderBuffer(WSclient_t * client) {
+    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_HEADER_BUFFERS; i++) {
+        if(!_headerBufferUsed[i]) {
+            _headerBufferUsed[i]  = true;
+            client->cHeaderBuffer = i;
+            if(client->cHeaderRest) {
+                memcpy(&_headerBuffers[i][0], client->cHeaderRest, client->cHeaderLen);
+                free(client->cHeaderRest);
+                client->cHeaderRest = nullptr;
+            } else {
+                client->cHeaderLen = 0;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * give the line buffer back and drop the incomplete line, can be called more then once
+ * @param client WSclient_t *  ptr to the client struct
+ */
+void WebSocketsServerCore::releaseHeaderBuffer(WSclient_t * client) {
+    if(client->cHeaderBuffer < WEBSOCKETS_SERVER_HEADER_BUFFERS) {
+        _headerBufferUsed[client->cHeaderBuffer] = false;
+    }
+    if(client->cHeaderRest) {
+        free(client->cHeaderRest);
+        client->cHeaderRest = nullptr;
+    }
+    client->cHeaderBuffer = 0xFF;
+    client->cHeaderLen    = 0;
+}
+#endif
+
 /**
  * handles http header reading for WebSocket upgrade
  * @param client WSclient_t * ///< pointer to the client struct
  * @param headerLine String ///< the header being read / processed
  */
 void WebSocketsServerCore::handleHeader(WSclient_t * client, String * headerLine) {
+    char line[WEBSOCKETS_SERVER_HEADER_LINE_SIZE];
+    size_t len = headerLine->length();
+    if(len >= sizeof(line)) {
+        (*headerLine) = "";
+        handleHeaderTooLarge(client);
+        return;
+    }
+    memcpy(&line[0], headerLine->c_str(), len);
+    (*headerLine) = "";
+    handleHeaderLine(client, &line[0], len);
+}
+
+/**
+ * handle one line of the HTTP request, parsed in place
+ * @param client WSclient_t *  ptr to the client struct
+ * @param line char *  line without \n, one byte space for the terminating 0 is needed
+ * @param len size_t
+ */
+void WebSocketsServerCore::handleHeaderLine(WSclient_t * client, char * line, size_t len) {
     static const char * NEW_LINE = "\r\n";
 
-    headerLine->trim();    // remove \r
+    // remove \r and white space (like String::trim)
+    while(len > 0 && isspace((unsigned char)line[len - 1])) {
+        len--;
+    }
+    line[len] = 0x00;
+    while(len > 0 && isspace((unsigned char)*line)) {
+        line++;
+        len--;
+    }
+
+    if(len > 0) {
+        DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader] RX: %s\n", client->num, line);
 
-    if(headerLine->length() > 0) {
-        DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader] RX: %s\n", client->num, headerLine->c_str());
+        char * value = strchr(line, ':');
 
         // websocket requests always start with GET see rfc6455
-        if(headerLine->startsWith("GET ")) {
+        if(strncmp(line, "GET ", 4) == 0) {
             // cut URL out
-            client->cUrl = headerLine->substring(4, headerLine->indexOf(' ', 4));
+            char * end = strchr(&line[4], ' ');
+            if(end) {
+                *end = 0x00;
+            }
+            client->cUrl = &line[4];
 
             // reset non-websocket http header validation state for this client
             client->cHttpHeadersValid      = true;
             client->cMandatoryHeadersCount = 0;
 
-        } else if(headerLine->indexOf(':') >= 0) {
-            String headerName  = headerLine->substring(0, headerLine->indexOf(':'));
-            String headerValue = headerLine->substring(headerLine->indexOf(':') + 1);
+        } else if(value) {
+            size_t nameLen = value - line;
+            bool known     = true;
+            *value++       = 0x00;
 
             // remove space in the beginning (RFC2616)
-            if(headerValue[0] == ' ') {
-                headerValue.remove(0, 1);
+            if(*value == ' ') {
+                value++;
             }
 
-            if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Connection"))) {
-                headerValue.toLowerCase();
-                if(headerValue.indexOf(WEBSOCKETS_STRING("upgrade")) >= 0) {
-                    client->cIsUpgrade = true;
-                }
-            } else if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Upgrade"))) {
-                if(headerValue.equalsIgnoreCase(WEBSOCKETS_STRING("websocket"))) {
-                    client->cIsWebsocket = true;
-                }
-            } else if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Sec-WebSocket-Version"))) {
-                client->cVersion = headerValue.toInt();
-            } else if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Sec-WebSocket-Key"))) {
-                client->cKey = headerValue;
-                client->cKey.trim();    // see rfc6455
-            } else if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Sec-WebSocket-Protocol"))) {
-                client->cProtocol = headerValue;
-            } else if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Sec-WebSocket-Extensions"))) {
-                client->cExtensions = headerValue;
-            } else if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Authorization"))) {
-                client->base64Authorization = headerValue;
-            } else {
+            // the length of the name selects the candidate
+            switch(nameLen) {
+                case 7:
+                    if(strcasecmp(line, "Upgrade") == 0) {
+                        if(strcasecmp(value, "websocket") == 0) {
+                            client->cIsWebsocket = true;
+                        }
+                    } else {
+                        known = false;
+                    }
+                    break;
+                case 10:
+                    if(strcasecmp(line, "Connection") == 0) {
+                        for(char * c = value; *c; c++) {
+                            *c = tolower((unsigned char)*c);
+                        }
+                        if(strstr(value, "upgrade")) {
+                            client->cIsUpgrade = true;
+                        }
+                    } else {
+                        known = false;
+                    }
+                    break;
+                case 13:
+                    if(strcasecmp(line, "Authorization") == 0) {
+                        client->base64Authorization = value;
+                    } else {
+                        known = false;
+                    }
+                    break;
+                case 17:
+                    if(strcasecmp(line, "Sec-WebSocket-Key") == 0) {
+                        client->cKey = value;
+                        client->cKey.trim();    // see rfc6455
+                    } else {
+                        known = false;
+                    }
+                    break;
+                case 21:
+                    if(strcasecmp(line, "Sec-WebSocket-Version") == 0) {
+                        client->cVersion = atoi(value);
+                    } else {
+                        known = false;
+                    }
+                    break;
+                case 22:
+                    if(strcasecmp(line, "Sec-WebSocket-Protocol") == 0) {
+                        client->cProtocol = value;
+                    } else {
+                        known = false;
+                    }
+                    break;
+                case 24:
+                    if(strcasecmp(line, "Sec-WebSocket-Extensions") == 0) {
+                        client->cExtensions = value;
+                    } else {
+                        known = false;
+                    }
+                    break;
+                default:
+                    known = false;
+                    break;
+            }
+
+            // Strings are only needed for the custom validation
+            if(!known && (_httpHeaderValidationFunc || _mandatoryHttpHeaderCount > 0)) {
+                String headerName  = line;
+                String headerValue = value;
                 client->cHttpHeadersValid &= execHttpHeaderValidation(headerName, headerValue);
                 if(_mandatoryHttpHeaderCount > 0 && hasMandatoryHeader(headerName)) {
                     client->cMandatoryHeadersCount++;
@@ -764,10 +1726,9 @@ void WebSocketsServerCore::handleHeader(WSclient_t * client, String * headerLine
             }
 
         } else {
-            DEBUG_WEBSOCKETS("[WS-Client][handleHeader] Header error (%s)\n", headerLine->c_str());
+            DEBUG_WEBSOCKETS("[WS-Client][handleHeader] Header error (%s)\n", line);
         }
 
-        (*headerLine) = "";
 #if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
         client->tcp->readStringUntil('\n', &(client->cHttpLine), std::bind(&WebSocketsServerCore::handleHeader, this, client, &(client->cHttpLine)));
 #endif
@@ -790,7 +1751,7 @@ void WebSocketsServerCore::handleHeader(WSclient_t * client, String * headerLine
             if(client->cUrl.length() == 0) {
                 ok = false;
             }
-            if(client->cKey.length() == 0) {
+            if(client->cKey.length() == 0 || client->cKey.length() > WEBSOCKETS_MAX_KEY_LENGTH) {
                 ok = false;
             }
             if(client->cVersion != 13) {
@@ -818,9 +1779,10 @@ void WebSocketsServerCore::handleHeader(WSclient_t * client, String * headerLine
             DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader] Websocket connection incoming.\n", client->num);
 
             // generate Sec-WebSocket-Accept key
-            String sKey = acceptKey(client->cKey);
+            char sKey[WEBSOCKETS_ACCEPT_KEY_LENGTH + 1];
+            acceptKey(client->cKey.c_str(), client->cKey.length(), sKey);
 
-            DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader]  - sKey: %s\n", client->num, sKey.c_str());
+            DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader]  - sKey: %s\n", client->num, sKey);
 
             client->status = WSC_CONNECTED;
 
@@ -831,17 +1793,33 @@ void WebSocketsServerCore::handleHeader(WSclient_t * client, String * headerLine
                 "Connection: Upgrade\r\n"
                 "Sec-WebSocket-Version: 13\r\n"
                 "Sec-WebSocket-Accept: ");
-            handshake += sKey + NEW_LINE;
+            // one allocation for the whole response
+            handshake.reserve(256);
+            handshake += sKey;
+            handshake += NEW_LINE;
 
             if(_origin.length() > 0) {
                 handshake += WEBSOCKETS_STRING("Access-Control-Allow-Origin: ");
-                handshake += _origin + NEW_LINE;
+                handshake += _origin;
+                handshake += NEW_LINE;
             }
 
             if(client->cProtocol.length() > 0) {
                 handshake += WEBSOCKETS_STRING("Sec-WebSocket-Protocol: ");
-                handshake += _protocol + NEW_LINE;
+                handshake += _protocol;
+                handshake += NEW_LINE;
+            }
+
+#ifdef WEBSOCKETS_HAS_DEFLATE
+            client->cDeflateBits      = _deflateBits;
+            client->cDeflateNoContext = _deflateNoContext;
+            String extensions;
+            if(deflateAccept(client, extensions)) {
+                handshake += WEBSOCKETS_STRING("Sec-WebSocket-Extensions: ");
+                handshake += extensions;
+                handshake += NEW_LINE;
             }
+#endif
 
             // header end
             handshake += NEW_LINE;
@@ -857,6 +1835,7 @@ void WebSocketsServerCore::handleHeader(WSclient_t * client, String * headerLine
 
             runCbEvent(client->num, WStype_CONNECTED, (uint8_t *)client->cUrl.c_str(), client->cUrl.length());
 
+            releaseHeaders(client);
         } else {
             handleNonWebsocketConnection(client);
         }
@@ -895,7 +1874,134 @@ void WebSocketsServerCore::enableHeartbeat(uint32_t pingInterval, uint32_t pongT
         client = &_clients[i];
         WebSockets::enableHeartbeat(client, pingInterval, pongTimeout, disconnectTimeoutCount);
     }
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+    scheduleClients();
+#endif
+}
+
+/**
+ * limit the clients in the HTTP handshake, a burst of reconnects can not take all client ids
+ * @param maxHandshakes uint8_t  clients in the handshake at the same time, more are refused (503), 0 = no limit
+ * @param timeout uint32_t       ms a client may take for the handshake before it is dropped, 0 = no timeout
+ */
+void WebSocketsServerCore::setHandshakeLimit(uint8_t maxHandshakes, uint32_t timeout) {
+    _handshakeMax     = maxHandshakes ? maxHandshakes : WEBSOCKETS_SERVER_CLIENT_MAX;
+    _handshakeTimeout = timeout;
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+    scheduleClients();
+#endif
+}
+
+/**
+ * count the clients that are connected but not upgraded yet
+ * @return uint8_t
+ */
+uint8_t WebSocketsServerCore::handshakesInFlight(void) {
+    uint8_t count = 0;
+    for(uint8_t n = 0; n < _activeCount; n++) {
+        if(_clients[_activeSlots[n]].status == WSC_HEADER) {
+            count++;
+        }
+    }
+    return count;
+}
+
+#ifdef WEBSOCKETS_HAS_ACCEPT_LIMIT
+/**
+ * limit how often one remote address may connect (token bucket per address)
+ * @param burst uint8_t        connections an address can open at once, 0 = no rate limit
+ * @param interval uint32_t    ms until the address may open one more
+ */
+void WebSocketsServerCore::setAcceptRateLimit(uint8_t burst, uint32_t interval) {
+    _rateBurst    = interval ? burst : 0;
+    _rateInterval = interval;
+    memset(&_rate[0], 0x00, sizeof(_rate));
+}
+
+/**
+ * @return uint32_t number of connections refused since start
+ */
+uint32_t WebSocketsServerCore::rejectedClients(void) {
+    return _rejectedClients;
+}
+
+/**
+ * decide about a new connection before a client id is used for it
+ * @param tcpClient WEBSOCKETS_NETWORK_CLASS &
+ * @return WSadmit_t WSA_OK if the connection can be taken
+ */
+WSadmit_t WebSocketsServerCore::admitClient(WEBSOCKETS_NETWORK_CLASS & tcpClient) {
+    WSadmit_t admit = WSA_OK;
+
+    if(_rateBurst && !acceptRate(tcpClient.remoteIP())) {
+        admit = WSA_RATE;
+    } else if(!hasFreeSlot()) {
+        admit = WSA_FULL;
+    } else if(_handshakeMax < WEBSOCKETS_SERVER_CLIENT_MAX && handshakesInFlight() >= _handshakeMax) {
+        admit = WSA_BUSY;
+    }
+
+    if(admit != WSA_OK) {
+#ifndef NODEBUG_WEBSOCKETS
+        IPAddress ip = tcpClient.remoteIP();
+#endif
+        DEBUG_WEBSOCKETS("[WS-Server] refuse client from %d.%d.%d.%d reason: %d\n", ip[0], ip[1], ip[2], ip[3], admit);
+    }
+    return admit;
+}
+
+/**
+ * take a token from the bucket of the address
+ * @param ip IPAddress
+ * @return true if the address may connect now
+ */
+bool WebSocketsServerCore::acceptRate(IPAddress ip) {
+    uint32_t addr     = ((uint32_t)ip[0] << 24) | ((uint32_t)ip[1] << 16) | ((uint32_t)ip[2] << 8) | ip[3];
+    unsigned long now = millis();
+    WSrate_t * entry  = NULL;
+    WSrate_t * oldest = &_rate[0];
+
+    if(addr == 0) {
+        // address unknown
+        return true;
+    }
+
+    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_RATE_SLOTS; i++) {
+        if(_rate[i].ip == addr) {
+            entry = &_rate[i];
+            break;
+        }
+        // unused entries first, then the one idle for the longest time
+        if(oldest->ip && (!_rate[i].ip || (now - _rate[i].last) > (now - oldest->last))) {
+            oldest = &_rate[i];
+        }
+    }
+
+    if(!entry) {
+        entry         = oldest;
+        entry->ip     = addr;
+        entry->last   = now;
+        entry->tokens = _rateBurst;
+    }
+
+    uint32_t refill = (now - entry->last) / _rateInterval;
+    if(refill) {
+        if(entry->tokens + refill >= _rateBurst) {
+            entry->tokens = _rateBurst;
+            entry->last   = now;
+        } else {
+            entry->tokens += refill;
+            entry->last   += refill * _rateInterval;
+        }
+    }
+
+    if(entry->tokens == 0) {
+        return false;
+    }
+    entry->tokens--;
+    return true;
 }
+#endif
 
 /**
  * disable ping/pong heartbeat process
@@ -908,7 +2014,29 @@ void WebSocketsServerCore::disableHeartbeat() {
         client               = &_clients[i];
         client->pingInterval = 0;
     }
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+    scheduleClients();
+#endif
+}
+
+#ifdef WEBSOCKETS_HAS_DEFLATE
+/**
+ * accept permessage-deflate (RFC 7692) offers of new clients
+ * @param windowBits uint8_t         max LZ77 window of the clients (8..15), the received history needs 2^windowBits byte per client
+ * @param noContextTakeover bool     ask the clients to compress each message on its own (no history is kept)
+ */
+void WebSocketsServerCore::enableDeflate(uint8_t windowBits, bool noContextTakeover) {
+    _deflateBits      = std::max((uint8_t)8, std::min((uint8_t)15, windowBits));
+    _deflateNoContext = noContextTakeover;
+}
+
+/**
+ * do not accept permessage-deflate for new clients
+ */
+void WebSocketsServerCore::disableDeflate(void) {
+    _deflateBits = 0;
 }
+#endif
 
 ////////////////////
 // WebSocketServer
@@ -919,13 +2047,18 @@ void WebSocketsServerCore::disableHeartbeat() {
 void WebSocketsServer::begin(void) {
     WebSocketsServerCore::begin();
     _server->begin();
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+    if(_poller) {
+        _poller->watchServer(_server);
+    }
+#endif
 
     DEBUG_WEBSOCKETS("[WS-Server] Server Started.\n");
 }
 
 void WebSocketsServer::close(void) {
     WebSocketsServerCore::close();
-#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RP2040)
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RP2040) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_POSIX)
     _server->close();
 #elif(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
     _server->end();
@@ -941,7 +2074,11 @@ void WebSocketsServer::close(void) {
 void WebSocketsServerCore::loop(void) {
     if(_runnning) {
         WEBSOCKETS_YIELD();
-        handleClientData();
+        if(_poller) {
+            pollClients();
+        } else {
+            handleClientData();
+        }
     }
 }
 
@@ -951,8 +2088,35 @@ void WebSocketsServerCore::loop(void) {
 void WebSocketsServer::loop(void) {
     if(_runnning) {
         WEBSOCKETS_YIELD();
-        handleNewClients();
+        if(!_poller) {
+            handleNewClients();
+        }
         WebSocketsServerCore::loop();
     }
 }
+
+/**
+ * wait for input with a WebSocketsPoller instead of asking every client in each loop
+ * call before begin(), the poller is not owned by the server
+ * @param poller WebSocketsPoller *  NULL to go back to polling every client
+ * @param timeout int                max ms loop() may sleep when nothing happens, -1 = until input or the next deadline
+ */
+void WebSocketsServerCore::setPoller(WebSocketsPoller * poller, int timeout) {
+    _poller      = poller;
+    _pollTimeout = timeout;
+    if(_poller) {
+        for(uint8_t n = 0; n < _activeCount; n++) {
+            _poller->watch(&_clients[_activeSlots[n]]);
+        }
+    }
+}
+
+/**
+ * time until the next heartbeat, handshake timeout or send retry of any client
+ * without a poller the network task can sleep this long if no input is expected
+ * @return long ms, 0 = now, -1 = nothing scheduled
+ */
+long WebSocketsServerCore::nextTimeout(void) {
+    return _timers.next(millis());
+}
 #endif
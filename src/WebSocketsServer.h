@@ -26,11 +26,102 @@
 #define WEBSOCKETSSERVER_H_
 
 #include "WebSockets.h"
+#include "WebSocketsPoller.h"
+#include "WebSocketsTimer.h"
 
 #ifndef WEBSOCKETS_SERVER_CLIENT_MAX
 #define WEBSOCKETS_SERVER_CLIENT_MAX (5)
 #endif
 
+#if(WEBSOCKETS_SERVER_CLIENT_MAX > 255)
+#error "WEBSOCKETS_SERVER_CLIENT_MAX is limited to 255 (client ids are uint8_t)"
+#endif
+
+// topics for publish / subscribe (see WebSocketsServerCore::subscribe), 0 = disabled
+#ifndef WEBSOCKETS_SERVER_TOPIC_MAX
+#ifdef WEBSOCKETS_USE_BIG_MEM
+#define WEBSOCKETS_SERVER_TOPIC_MAX (16)
+#else
+#define WEBSOCKETS_SERVER_TOPIC_MAX (0)
+#endif
+#endif
+
+// max length of a topic name incl. the terminating 0x00
+#ifndef WEBSOCKETS_SERVER_TOPIC_NAME_SIZE
+#define WEBSOCKETS_SERVER_TOPIC_NAME_SIZE (32)
+#endif
+
+#if(WEBSOCKETS_SERVER_TOPIC_MAX > 127)
+#error "WEBSOCKETS_SERVER_TOPIC_MAX is limited to 127 (topic slots are uint8_t, the table has twice as many)"
+#endif
+
+#if(WEBSOCKETS_SERVER_TOPIC_MAX > 0)
+#define WEBSOCKETS_HAS_SERVER_TOPICS
+// open addressing, the table is kept at most half full
+#define WEBSOCKETS_SERVER_TOPIC_SLOTS (WEBSOCKETS_SERVER_TOPIC_MAX * 2)
+
+typedef struct {
+    uint32_t hash;                                             ///< FNV-1a of name, 0 = slot unused
+    uint8_t count;                                             ///< number of subscribers
+    uint8_t subscribers[(WEBSOCKETS_SERVER_CLIENT_MAX + 7) / 8];    ///< one bit per client id
+    char name[WEBSOCKETS_SERVER_TOPIC_NAME_SIZE];
+} WStopic_t;
+#endif
+
+// the HTTP request of a new client is parsed line by line in one of these buffers while its data is read,
+// an incomplete line waits on the heap until the next data arrives
+#ifndef WEBSOCKETS_SERVER_HEADER_BUFFERS
+#define WEBSOCKETS_SERVER_HEADER_BUFFERS (1)
+#endif
+
+// longer request lines are refused with 431 (see handleHeaderTooLarge)
+#ifndef WEBSOCKETS_SERVER_HEADER_LINE_SIZE
+#define WEBSOCKETS_SERVER_HEADER_LINE_SIZE (256)
+#endif
+
+// max clients in the HTTP handshake at the same time (see setHandshakeLimit)
+#ifndef WEBSOCKETS_SERVER_HANDSHAKE_MAX
+#define WEBSOCKETS_SERVER_HANDSHAKE_MAX (WEBSOCKETS_SERVER_CLIENT_MAX)
+#endif
+
+// a client that has not finished the handshake in this time (ms) is dropped, 0 = no timeout (see setHandshakeLimit)
+#ifndef WEBSOCKETS_SERVER_HANDSHAKE_TIMEOUT
+#define WEBSOCKETS_SERVER_HANDSHAKE_TIMEOUT (0)
+#endif
+
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RP2040) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_POSIX)
+// new connections are checked before a client object is created for them
+#define WEBSOCKETS_HAS_ACCEPT_LIMIT
+
+// remote addresses tracked by the accept rate limit (see setAcceptRateLimit)
+#ifndef WEBSOCKETS_SERVER_RATE_SLOTS
+#ifdef WEBSOCKETS_USE_BIG_MEM
+#define WEBSOCKETS_SERVER_RATE_SLOTS (16)
+#else
+#define WEBSOCKETS_SERVER_RATE_SLOTS (4)
+#endif
+#endif
+
+typedef enum {
+    WSA_OK,
+    WSA_FULL,    ///< all client ids are in use
+    WSA_BUSY,    ///< too many handshakes in progress
+    WSA_RATE     ///< the remote address connects too often
+} WSadmit_t;
+
+typedef struct {
+    uint32_t ip;           ///< remote address, 0 = entry unused
+    unsigned long last;    ///< millis of the last refill
+    uint8_t tokens;        ///< connections left
+} WSrate_t;
+#endif
+
+// with a WebSocketsPoller only clients with input or an expired deadline are handled in each loop,
+// a client with queued data is visited again after this interval (ms)
+#ifndef WEBSOCKETS_QUEUE_RETRY_INTERVAL
+#define WEBSOCKETS_QUEUE_RETRY_INTERVAL (20)
+#endif
+
 class WebSocketsServerCore : protected WebSockets {
   public:
     WebSocketsServerCore(const String & origin = "", const String & protocol = "arduino");
@@ -77,9 +168,46 @@ class WebSocketsServerCore : protected WebSockets {
     bool broadcastPing(uint8_t * payload = NULL, size_t length = 0);
     bool broadcastPing(String & payload);
 
+    bool broadcastDelivered(uint8_t num);
+
+#ifdef WEBSOCKETS_HAS_SERVER_TOPICS
+    bool subscribe(uint8_t num, const char * topic);
+    bool unsubscribe(uint8_t num, const char * topic);
+    void unsubscribeAll(uint8_t num);
+    bool isSubscribed(uint8_t num, const char * topic);
+    uint8_t subscribers(const char * topic);
+
+    bool publishTXT(const char * topic, uint8_t * payload, size_t length = 0, bool headerToPayload = false);
+    bool publishTXT(const char * topic, const uint8_t * payload, size_t length = 0);
+    bool publishTXT(const char * topic, char * payload, size_t length = 0, bool headerToPayload = false);
+    bool publishTXT(const char * topic, const char * payload, size_t length = 0);
+    bool publishTXT(const char * topic, String & payload);
+
+    bool publishBIN(const char * topic, uint8_t * payload, size_t length, bool headerToPayload = false);
+    bool publishBIN(const char * topic, const uint8_t * payload, size_t length);
+#endif
+
     void disconnect(void);
     void disconnect(uint8_t num);
 
+    void cork(uint8_t num);
+    bool uncork(uint8_t num);
+    uint32_t corkSavedBytes(uint8_t num);
+
+#ifdef WEBSOCKETS_HAS_SERVER_QUEUE
+    void setQueuePolicy(WSqueuePolicy_t policy);
+    uint8_t queueDepth(uint8_t num);
+    uint8_t queuePeak(uint8_t num);
+    unsigned long queueLag(uint8_t num);
+    uint32_t queueDropped(uint8_t num);
+#endif
+
+    bool streamBegin(uint8_t num, bool binary = false);
+    bool streamWrite(uint8_t num, const uint8_t * payload, size_t length);
+    bool streamWrite(uint8_t num, const char * payload);
+    bool streamEnd(uint8_t num, const uint8_t * payload = NULL, size_t length = 0);
+    bool streamReady(uint8_t num);
+
     void setAuthorization(const char * user, const char * password);
     void setAuthorization(const char * auth);
 
@@ -90,11 +218,25 @@ class WebSocketsServerCore : protected WebSockets {
     void enableHeartbeat(uint32_t pingInterval, uint32_t pongTimeout, uint8_t disconnectTimeoutCount);
     void disableHeartbeat();
 
-#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RP2040)
+    void setHandshakeLimit(uint8_t maxHandshakes, uint32_t timeout = WEBSOCKETS_TCP_TIMEOUT);
+    uint8_t handshakesInFlight(void);
+#ifdef WEBSOCKETS_HAS_ACCEPT_LIMIT
+    void setAcceptRateLimit(uint8_t burst, uint32_t interval);
+    uint32_t rejectedClients(void);
+#endif
+
+#ifdef WEBSOCKETS_HAS_DEFLATE
+    void enableDeflate(uint8_t windowBits = 15, bool noContextTakeover = false);
+    void disableDeflate(void);
+#endif
+
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RP2040) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_POSIX)
     IPAddress remoteIP(uint8_t num);
 #endif
 
 #if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+    void setPoller(WebSocketsPoller * poller, int timeout = 0);
+    long nextTimeout(void);
     void loop(void);    // handle client data only
 #endif
 
@@ -108,6 +250,28 @@ class WebSocketsServerCore : protected WebSockets {
     size_t _mandatoryHttpHeaderCount;
 
     WSclient_t _clients[WEBSOCKETS_SERVER_CLIENT_MAX];
+    uint8_t _freeSlots[WEBSOCKETS_SERVER_CLIENT_MAX];      ///< stack of unused client ids
+    uint8_t _freeCount;                                    ///< entries in _freeSlots
+    uint8_t _activeSlots[WEBSOCKETS_SERVER_CLIENT_MAX];    ///< client ids in use (unordered)
+    uint8_t _activeCount;                                  ///< entries in _activeSlots
+    uint8_t _activeIndex[WEBSOCKETS_SERVER_CLIENT_MAX];    ///< position in _activeSlots per client id, 0xFF = free
+    bool _broadcastDelivered[WEBSOCKETS_SERVER_CLIENT_MAX];    ///< result of the last broadcast per client
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+    char _headerBuffers[WEBSOCKETS_SERVER_HEADER_BUFFERS][WEBSOCKETS_SERVER_HEADER_LINE_SIZE];
+    bool _headerBufferUsed[WEBSOCKETS_SERVER_HEADER_BUFFERS];
+#endif
+    uint8_t _handshakeMax;          ///< clients allowed in WSC_HEADER at the same time
+    uint32_t _handshakeTimeout;    ///< ms a client may stay in WSC_HEADER
+#ifdef WEBSOCKETS_HAS_ACCEPT_LIMIT
+    WSrate_t _rate[WEBSOCKETS_SERVER_RATE_SLOTS];
+    uint8_t _rateBurst;            ///< connections per address without waiting, 0 = no rate limit
+    uint32_t _rateInterval;        ///< ms until an address gets one more connection
+    uint32_t _rejectedClients;     ///< connections refused by admitClient
+#endif
+#ifdef WEBSOCKETS_HAS_SERVER_TOPICS
+    WStopic_t _topics[WEBSOCKETS_SERVER_TOPIC_SLOTS];
+    uint8_t _topicCount;    ///< used entries in _topics
+#endif
 
     WebSocketServerEvent _cbEvent;
     WebSocketServerHttpHeaderValFunc _httpHeaderValidationFunc;
@@ -118,6 +282,17 @@ class WebSocketsServerCore : protected WebSockets {
     uint32_t _pongTimeout;
     uint8_t _disconnectTimeoutCount;
 
+#ifdef WEBSOCKETS_HAS_DEFLATE
+    uint8_t _deflateBits;       ///< max window bits of the received messages, 0 = permessage-deflate disabled
+    bool _deflateNoContext;    ///< ask the clients to compress each message on its own
+#endif
+
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+    WebSocketsPoller * _poller;    ///< readiness source, NULL = ask every client in each loop
+    int _pollTimeout;              ///< max ms loop() waits for input
+    WebSocketsTimers<WEBSOCKETS_SERVER_CLIENT_MAX> _timers;    ///< next deadline per client id
+#endif
+
     void messageReceived(WSclient_t * client, WSopcode_t opcode, uint8_t * payload, size_t length, bool fin);
 
     void clientDisconnect(WSclient_t * client);
@@ -125,12 +300,34 @@ class WebSocketsServerCore : protected WebSockets {
 
 #if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
     void handleClientData(void);
+    void handleClient(WSclient_t * client);
+    void pollClients(void);
+    void scheduleClient(WSclient_t * client);
+    void scheduleClients(void);
+#ifdef WEBSOCKETS_HAS_SERVER_QUEUE
+    void handleClosing(WSclient_t * client);
+    void queueWaiting(WSclient_t * client) override;
+#endif
+    void connectionLost(WSclient_t * client) override;
 #endif
 
     void handleHeader(WSclient_t * client, String * headerLine);
+    void handleHeaderLine(WSclient_t * client, char * line, size_t len);
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+    void handleHeaderData(WSclient_t * client);
+    bool takeHeaderBuffer(WSclient_t * client);
+    void releaseHeaderBuffer(WSclient_t * client);
+#endif
 
     void handleHBPing(WSclient_t * client);    // send ping in specified intervals
 
+    bool broadcastFrame(WSopcode_t opcode, uint8_t * payload, size_t length, const uint8_t * subscribers = NULL);
+
+#ifdef WEBSOCKETS_HAS_SERVER_TOPICS
+    WStopic_t * findTopic(const char * topic, bool create);
+    void removeTopic(WStopic_t * entry);
+#endif
+
     /**
      * called if a non Websocket connection is coming in.
      * Note: can be override
@@ -150,6 +347,22 @@ class WebSocketsServerCore : protected WebSockets {
         clientDisconnect(client);
     }
 
+    /**
+     * called if a line of the HTTP request does not fit into WEBSOCKETS_SERVER_HEADER_LINE_SIZE
+     * Note: can be override
+     * @param client WSclient_t *  ptr to the client struct
+     */
+    virtual void handleHeaderTooLarge(WSclient_t * client) {
+        DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader] header line too long, close.\n", client->num);
+        client->tcp->write(
+            "HTTP/1.1 431 Request Header Fields Too Large\r\n"
+            "Server: arduino-WebSocket-Server\r\n"
+            "Content-Length: 0\r\n"
+            "Connection: close\r\n"
+            "\r\n");
+        clientDisconnect(client);
+    }
+
     /**
      * called if a non Authorization connection is coming in.
      * Note: can be override
@@ -201,6 +414,30 @@ class WebSocketsServerCore : protected WebSockets {
 
 #if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
     WSclient_t * handleNewClient(WEBSOCKETS_NETWORK_CLASS * tcpClient);
+    virtual void handleNewClients(void) {}
+#endif
+
+#ifdef WEBSOCKETS_HAS_ACCEPT_LIMIT
+    WSadmit_t admitClient(WEBSOCKETS_NETWORK_CLASS & tcpClient);
+    bool acceptRate(IPAddress ip);
+
+    /**
+     * called if a new connection is refused by admitClient, no client slot is used for it
+     * Note: can be override
+     * @param tcpClient WEBSOCKETS_NETWORK_CLASS &
+     * @param reason WSadmit_t
+     */
+    virtual void handleRejectedConnection(WEBSOCKETS_NETWORK_CLASS & tcpClient, WSadmit_t reason) {
+        (void)reason;
+        tcpClient.write(
+            "HTTP/1.1 503 Service Unavailable\r\n"
+            "Server: arduino-WebSocket-Server\r\n"
+            "Retry-After: 1\r\n"
+            "Content-Length: 0\r\n"
+            "Connection: close\r\n"
+            "\r\n");
+        tcpClient.stop();
+    }
 #endif
 
     /**
@@ -208,6 +445,12 @@ class WebSocketsServerCore : protected WebSockets {
      */
     void dropNativeClient(WSclient_t * client);
 
+    void resetSlots(void);
+    bool hasFreeSlot(void);
+    WSclient_t * allocSlot(void);
+    void releaseSlot(WSclient_t * client);
+    void releaseHeaders(WSclient_t * client);
+
   private:
     /*
      * returns an indicator whether the given named header exists in the configured _mandatoryHttpHeaders collection
@@ -233,7 +476,7 @@ class WebSocketsServer : public WebSocketsServerCore {
 
   protected:
 #if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
-    void handleNewClients(void);
+    void handleNewClients(void) override;
 #endif
 
     uint16_t _port;
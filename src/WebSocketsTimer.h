@@ -0,0 +1,188 @@
+/**
+ * @file WebSocketsTimer.h
+ * @date 19.10.2026
+ *
+ * Copyright (c) 2026 WebSockets for Arduino contributors.
+ * This file is part of the WebSockets for Arduino.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef WEBSOCKETSTIMER_H_
+#define WEBSOCKETSTIMER_H_
+
+#include <stdint.h>
+
+/**
+ * deadlines (millis) of up to N timers, ids 0..N-1, as binary min-heap
+ * set / cancel / pop are O(log N), the next deadline is O(1)
+ * deadlines are compared like millis() - x, so they survive the millis() overflow
+ * as long as they are less than 24 days away
+ */
+template <uint8_t N>
+class WebSocketsTimers {
+  public:
+    WebSocketsTimers() {
+        clear();
+    }
+
+    void clear(void) {
+        for(uint8_t i = 0; i < N; i++) {
+            _pos[i] = 0xFF;
+        }
+        _count = 0;
+    }
+
+    /**
+     * start a timer or move it to a new deadline
+     * @param id uint8_t
+     * @param deadline unsigned long  millis
+     */
+    void set(uint8_t id, unsigned long deadline) {
+        if(id >= N) {
+            return;
+        }
+        uint8_t i = _pos[id];
+        if(i == 0xFF) {
+            i           = _count++;
+            _heap[i].id = id;
+            _pos[id]    = i;
+        }
+        _heap[i].deadline = deadline;
+        up(i);
+        down(_pos[id]);
+    }
+
+    /**
+     * stop a timer, nothing happens if it is not running
+     * @param id uint8_t
+     */
+    void cancel(uint8_t id) {
+        if(id >= N || _pos[id] == 0xFF) {
+            return;
+        }
+        uint8_t i = _pos[id];
+        _pos[id]  = 0xFF;
+        _count--;
+        if(i < _count) {
+            // the last entry fills the gap
+            _heap[i]          = _heap[_count];
+            _pos[_heap[i].id] = i;
+            up(i);
+            down(_pos[_heap[i].id]);
+        }
+    }
+
+    bool pending(uint8_t id) const {
+        return (id < N && _pos[id] != 0xFF);
+    }
+
+    /**
+     * @param id uint8_t
+     * @param now unsigned long  millis
+     * @return ms until the timer expires, 0 if it is expired, -1 if it is not running
+     */
+    long remaining(uint8_t id, unsigned long now) const {
+        if(!pending(id)) {
+            return -1;
+        }
+        long left = (long)(_heap[_pos[id]].deadline - now);
+        return (left > 0) ? left : 0;
+    }
+
+    /**
+     * @param now unsigned long  millis
+     * @return ms until the first timer expires, 0 if one is expired, -1 if none is running
+     */
+    long next(unsigned long now) const {
+        if(_count == 0) {
+            return -1;
+        }
+        long left = (long)(_heap[0].deadline - now);
+        return (left > 0) ? left : 0;
+    }
+
+    /**
+     * take the first expired timer, it is stopped
+     * @param now unsigned long  millis
+     * @return id or -1 if no timer is expired
+     */
+    int pop(unsigned long now) {
+        if(_count == 0 || (long)(_heap[0].deadline - now) > 0) {
+            return -1;
+        }
+        uint8_t id = _heap[0].id;
+        cancel(id);
+        return id;
+    }
+
+    uint8_t count(void) const {
+        return _count;
+    }
+
+  protected:
+    typedef struct {
+        unsigned long deadline;
+        uint8_t id;
+    } entry_t;
+
+    entry_t _heap[N];
+    uint8_t _pos[N];    ///< index in _heap per id, 0xFF = not running
+    uint8_t _count;
+
+    bool before(uint8_t a, uint8_t b) const {
+        return (long)(_heap[a].deadline - _heap[b].deadline) < 0;
+    }
+
+    void swap(uint8_t a, uint8_t b) {
+        entry_t t         = _heap[a];
+        _heap[a]          = _heap[b];
+        _heap[b]          = t;
+        _pos[_heap[a].id] = a;
+        _pos[_heap[b].id] = b;
+    }
+
+    void up(uint8_t i) {
+        while(i > 0) {
+            uint8_t parent = (i - 1) / 2;
+            if(!before(i, parent)) {
+                return;
+            }
+            swap(i, parent);
+            i = parent;
+        }
+    }
+
+    void down(uint8_t i) {
+        while(true) {
+            uint16_t first = (uint16_t)i * 2 + 1;
+            uint8_t min    = i;
+            if(first < _count && before(first, min)) {
+                min = first;
+            }
+            if(first + 1 < _count && before(first + 1, min)) {
+                min = first + 1;
+            }
+            if(min == i) {
+                return;
+            }
+            swap(i, min);
+            i = min;
+        }
+    }
+};
+
+#endif /* WEBSOCKETSTIMER_H_ */
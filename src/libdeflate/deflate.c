@@ -0,0 +1,231 @@
+/* ================ deflate.c ================ */
+/*
+raw DEFLATE encoder (RFC 1951)
+
+greedy LZ77 with hash chains over the message itself and the fixed Huffman code.
+the working memory is two uint16_t tables (hash heads + chain) allocated per call,
+so nothing has to be kept between messages (no context takeover on our side).
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "libdeflate.h"
+
+#ifndef RAW_DEFLATE_HASH_BITS
+#define RAW_DEFLATE_HASH_BITS 10
+#endif
+
+#ifndef RAW_DEFLATE_MAX_CHAIN
+#define RAW_DEFLATE_MAX_CHAIN 32
+#endif
+
+#define DEF_HASH_SIZE (1U << RAW_DEFLATE_HASH_BITS)
+#define DEF_MIN_MATCH 3
+#define DEF_MAX_MATCH 258
+#define DEF_NIL 0xFFFF
+
+typedef struct {
+    uint8_t * out;
+    size_t outSize;
+    size_t outPos;
+    uint32_t bitBuf;
+    uint8_t bitCnt;
+    int overflow;
+} def_state;
+
+static const uint16_t def_len_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t def_len_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t def_dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t def_dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+static void def_bits(def_state * s, uint32_t value, uint8_t n) {
+    s->bitBuf |= value << s->bitCnt;
+    s->bitCnt += n;
+    while(s->bitCnt >= 8) {
+        if(s->outPos >= s->outSize) {
+            s->overflow = 1;
+            s->bitCnt   = 0;
+            s->bitBuf   = 0;
+            return;
+        }
+        s->out[s->outPos++] = (uint8_t)s->bitBuf;
+        s->bitBuf >>= 8;
+        s->bitCnt -= 8;
+    }
+}
+
+/* Huffman codes are packed starting with the most significant bit */
+static void def_code(def_state * s, uint16_t code, uint8_t len) {
+    uint16_t rev = 0;
+    uint8_t i;
+    for(i = 0; i < len; i++) {
+        rev = (rev << 1) | ((code >> i) & 1);
+    }
+    def_bits(s, rev, len);
+}
+
+static void def_symbol(def_state * s, uint16_t sym) {
+    if(sym < 144) {
+        def_code(s, 0x30 + sym, 8);
+    } else if(sym < 256) {
+        def_code(s, 0x190 + (sym - 144), 9);
+    } else if(sym < 280) {
+        def_code(s, sym - 256, 7);
+    } else {
+        def_code(s, 0xC0 + (sym - 280), 8);
+    }
+}
+
+static void def_match(def_state * s, uint16_t len, uint16_t dist) {
+    uint8_t code = 0;
+
+    while(code < 28 && def_len_base[code + 1] <= len) {
+        code++;
+    }
+    def_symbol(s, 257 + code);
+    if(def_len_extra[code]) {
+        def_bits(s, len - def_len_base[code], def_len_extra[code]);
+    }
+
+    code = 0;
+    while(code < 29 && def_dist_base[code + 1] <= dist) {
+        code++;
+    }
+    def_code(s, code, 5);
+    if(def_dist_extra[code]) {
+        def_bits(s, dist - def_dist_base[code], def_dist_extra[code]);
+    }
+}
+
+static uint16_t def_hash(const uint8_t * p) {
+    uint32_t v = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+    return (uint16_t)((uint32_t)(v * 2654435761UL) >> (32 - RAW_DEFLATE_HASH_BITS));
+}
+
+size_t raw_deflate(const uint8_t * in, size_t inLen, uint8_t * out, size_t outSize, uint8_t windowBits) {
+    def_state s;
+    uint16_t * head;
+    uint16_t * prev;
+    size_t window;
+    size_t pos;
+    size_t bestLen;
+    size_t bestDist;
+    size_t maxLen;
+    size_t len;
+    uint16_t h;
+    uint16_t cand;
+    uint8_t chain;
+
+    /* positions are stored as uint16_t */
+    if(inLen >= DEF_NIL) {
+        return 0;
+    }
+    if(windowBits < 8) {
+        windowBits = 8;
+    } else if(windowBits > 15) {
+        windowBits = 15;
+    }
+    window = (size_t)1 << windowBits;
+    /* no need for a window bigger then the message */
+    while(window > 256 && (window >> 1) >= inLen) {
+        window >>= 1;
+    }
+
+    head = (uint16_t *)malloc(DEF_HASH_SIZE * sizeof(uint16_t));
+    prev = (uint16_t *)malloc(window * sizeof(uint16_t));
+    if(!head || !prev) {
+        free(head);
+        free(prev);
+        return 0;
+    }
+    memset(head, 0xFF, DEF_HASH_SIZE * sizeof(uint16_t));
+
+    memset(&s, 0, sizeof(s));
+    s.out     = out;
+    s.outSize = outSize;
+
+    /* BFINAL = 0, BTYPE = 01 (fixed Huffman) */
+    def_bits(&s, 0, 1);
+    def_bits(&s, 1, 2);
+
+    pos = 0;
+    while(pos < inLen && !s.overflow) {
+        bestLen  = 0;
+        bestDist = 0;
+
+        if(pos + DEF_MIN_MATCH <= inLen) {
+            maxLen = inLen - pos;
+            if(maxLen > DEF_MAX_MATCH) {
+                maxLen = DEF_MAX_MATCH;
+            }
+            h     = def_hash(&in[pos]);
+            cand  = head[h];
+            chain = RAW_DEFLATE_MAX_CHAIN;
+            while(cand != DEF_NIL && (pos - cand) <= window && chain--) {
+                if(in[cand + bestLen] == in[pos + bestLen]) {
+                    len = 0;
+                    while(len < maxLen && in[cand + len] == in[pos + len]) {
+                        len++;
+                    }
+                    if(len > bestLen) {
+                        bestLen  = len;
+                        bestDist = pos - cand;
+                        if(len == maxLen) {
+                            break;
+                        }
+                    }
+                }
+                if(prev[cand & (window - 1)] >= cand) {
+                    /* slot was overwritten by a newer position */
+                    break;
+                }
+                cand = prev[cand & (window - 1)];
+            }
+            prev[pos & (window - 1)] = head[h];
+            head[h]                  = (uint16_t)pos;
+        }
+
+        if(bestLen >= DEF_MIN_MATCH && bestDist < window) {
+            def_match(&s, (uint16_t)bestLen, (uint16_t)bestDist);
+            /* insert the skipped positions into the hash chains */
+            for(len = 1; len < bestLen; len++) {
+                if(pos + len + DEF_MIN_MATCH <= inLen) {
+                    h                                = def_hash(&in[pos + len]);
+                    prev[(pos + len) & (window - 1)] = head[h];
+                    head[h]                          = (uint16_t)(pos + len);
+                }
+            }
+            pos += bestLen;
+        } else {
+            def_symbol(&s, in[pos]);
+            pos++;
+        }
+    }
+
+    free(head);
+    free(prev);
+
+    /* end of block */
+    def_symbol(&s, 256);
+    /* sync flush: empty stored block header, LEN / NLEN (0x00 0x00 0xFF 0xFF) are left out */
+    def_bits(&s, 0, 3);
+    if(s.bitCnt > 0) {
+        def_bits(&s, 0, 8 - s.bitCnt);
+    }
+
+    if(s.overflow) {
+        return 0;
+    }
+    return s.outPos;
+}
+
+/* ================ end of deflate.c ================ */
@@ -0,0 +1,415 @@
+/* ================ inflate.c ================ */
+/*
+raw DEFLATE decoder (RFC 1951)
+
+canonical Huffman decoding in the style of tinf / puff:
+the tables only hold the code length counts and the sorted symbols,
+so the decoder needs less than 1.5 KB of stack and no heap besides the output.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "libdeflate.h"
+
+#define INF_MAX_BITS 15
+#define INF_MAX_LCODES 286
+#define INF_MAX_DCODES 30
+#define INF_FIX_LCODES 288
+
+typedef struct {
+    uint16_t count[INF_MAX_BITS + 1];    /* number of codes of each length */
+    uint16_t symbol[INF_FIX_LCODES];     /* symbols ordered by code */
+} inf_huffman;
+
+typedef struct {
+    const uint8_t * in;
+    size_t inLen;
+    size_t inPos;
+    uint32_t bitBuf;
+    uint8_t bitCnt;
+
+    const uint8_t * dict;
+    size_t dictLen;
+
+    uint8_t * out;
+    size_t outLen;
+    size_t outSize;
+    size_t maxOut;
+
+    int error;
+} inf_state;
+
+static const uint16_t inf_len_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t inf_len_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t inf_dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t inf_dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+static const uint8_t inf_clen_order[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+static uint32_t inf_bits(inf_state * s, uint8_t need) {
+    uint32_t val;
+    while(s->bitCnt < need) {
+        if(s->inPos >= s->inLen) {
+            s->error = RAW_DEFLATE_DATA_ERROR;
+            return 0;
+        }
+        s->bitBuf |= (uint32_t)s->in[s->inPos++] << s->bitCnt;
+        s->bitCnt += 8;
+    }
+    val = s->bitBuf & ((1UL << need) - 1);
+    s->bitBuf >>= need;
+    s->bitCnt -= need;
+    return val;
+}
+
+/* build the decoding table from the code lengths, returns 0 if the lengths are usable */
+static int inf_build(inf_huffman * h, const uint8_t * length, uint16_t n) {
+    uint16_t offs[INF_MAX_BITS + 1];
+    uint16_t sym;
+    uint8_t len;
+    int left;
+
+    memset(h->count, 0, sizeof(h->count));
+    for(sym = 0; sym < n; sym++) {
+        h->count[length[sym]]++;
+    }
+    if(h->count[0] == n) {
+        /* no codes, valid for an unused distance tree */
+        return 0;
+    }
+
+    /* over subscribed set of lengths is an error */
+    left = 1;
+    for(len = 1; len <= INF_MAX_BITS; len++) {
+        left <<= 1;
+        left -= h->count[len];
+        if(left < 0) {
+            return -1;
+        }
+    }
+
+    offs[1] = 0;
+    for(len = 1; len < INF_MAX_BITS; len++) {
+        offs[len + 1] = offs[len] + h->count[len];
+    }
+    for(sym = 0; sym < n; sym++) {
+        if(length[sym] != 0) {
+            h->symbol[offs[length[sym]]++] = sym;
+        }
+    }
+    return 0;
+}
+
+static int inf_decode(inf_state * s, const inf_huffman * h) {
+    int code  = 0;    /* bits read so far */
+    int first = 0;    /* first code of the current length */
+    int index = 0;    /* index of the first code of the current length in symbol[] */
+    int count;
+    uint8_t len;
+
+    for(len = 1; len <= INF_MAX_BITS; len++) {
+        code |= (int)inf_bits(s, 1);
+        if(s->error) {
+            return -1;
+        }
+        count = h->count[len];
+        if(code - count < first) {
+            return h->symbol[index + (code - first)];
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    s->error = RAW_DEFLATE_DATA_ERROR;
+    return -1;
+}
+
+static int inf_reserve(inf_state * s, size_t n) {
+    size_t size;
+    uint8_t * buf;
+
+    if(s->outLen + n <= s->outSize) {
+        return 0;
+    }
+    if(s->outLen + n > s->maxOut) {
+        s->error = RAW_DEFLATE_SIZE_ERROR;
+        return -1;
+    }
+    size = s->outSize ? s->outSize : 256;
+    while(size < s->outLen + n) {
+        size <<= 1;
+    }
+    if(size > s->maxOut) {
+        size = s->maxOut;
+    }
+    /* + 1 for the terminating 0x00 of text messages */
+    buf = (uint8_t *)realloc(s->out, size + 1);
+    if(!buf) {
+        s->error = RAW_DEFLATE_MEM_ERROR;
+        return -1;
+    }
+    s->out     = buf;
+    s->outSize = size;
+    return 0;
+}
+
+static int inf_stored(inf_state * s) {
+    uint16_t len;
+    uint16_t nlen;
+
+    /* discard the rest of the current byte */
+    s->bitBuf = 0;
+    s->bitCnt = 0;
+
+    if(s->inPos + 4 > s->inLen) {
+        return RAW_DEFLATE_DATA_ERROR;
+    }
+    len  = s->in[s->inPos] | (s->in[s->inPos + 1] << 8);
+    nlen = s->in[s->inPos + 2] | (s->in[s->inPos + 3] << 8);
+    s->inPos += 4;
+    if((len ^ nlen) != 0xFFFF) {
+        return RAW_DEFLATE_DATA_ERROR;
+    }
+    if(s->inPos + len > s->inLen) {
+        return RAW_DEFLATE_DATA_ERROR;
+    }
+    if(inf_reserve(s, len)) {
+        return s->error;
+    }
+    memcpy(&s->out[s->outLen], &s->in[s->inPos], len);
+    s->outLen += len;
+    s->inPos += len;
+    return RAW_DEFLATE_OK;
+}
+
+static int inf_codes(inf_state * s, const inf_huffman * lencode, const inf_huffman * distcode) {
+    int symbol;
+    size_t len;
+    size_t dist;
+
+    for(;;) {
+        symbol = inf_decode(s, lencode);
+        if(symbol < 0) {
+            return s->error;
+        }
+        if(symbol < 256) {
+            if(inf_reserve(s, 1)) {
+                return s->error;
+            }
+            s->out[s->outLen++] = (uint8_t)symbol;
+            continue;
+        }
+        if(symbol == 256) {
+            return RAW_DEFLATE_OK;
+        }
+
+        symbol -= 257;
+        if(symbol >= 29) {
+            return RAW_DEFLATE_DATA_ERROR;
+        }
+        len = inf_len_base[symbol] + inf_bits(s, inf_len_extra[symbol]);
+
+        symbol = inf_decode(s, distcode);
+        if(symbol < 0 || symbol >= 30) {
+            return RAW_DEFLATE_DATA_ERROR;
+        }
+        dist = inf_dist_base[symbol] + inf_bits(s, inf_dist_extra[symbol]);
+        if(s->error) {
+            return s->error;
+        }
+        if(dist > s->outLen + s->dictLen) {
+            /* reference before the known history */
+            return RAW_DEFLATE_DATA_ERROR;
+        }
+        if(inf_reserve(s, len)) {
+            return s->error;
+        }
+
+        /* part of the match may be located in the dictionary */
+        while(len > 0 && dist > s->outLen) {
+            s->out[s->outLen] = s->dict[s->dictLen - (dist - s->outLen)];
+            s->outLen++;
+            len--;
+        }
+        while(len > 0) {
+            s->out[s->outLen] = s->out[s->outLen - dist];
+            s->outLen++;
+            len--;
+        }
+    }
+}
+
+static int inf_fixed(inf_state * s) {
+    inf_huffman lencode;
+    inf_huffman distcode;
+    uint8_t lengths[INF_FIX_LCODES];
+    uint16_t sym;
+
+    for(sym = 0; sym < 144; sym++) {
+        lengths[sym] = 8;
+    }
+    for(; sym < 256; sym++) {
+        lengths[sym] = 9;
+    }
+    for(; sym < 280; sym++) {
+        lengths[sym] = 7;
+    }
+    for(; sym < INF_FIX_LCODES; sym++) {
+        lengths[sym] = 8;
+    }
+    inf_build(&lencode, lengths, INF_FIX_LCODES);
+
+    for(sym = 0; sym < INF_MAX_DCODES; sym++) {
+        lengths[sym] = 5;
+    }
+    inf_build(&distcode, lengths, INF_MAX_DCODES);
+
+    return inf_codes(s, &lencode, &distcode);
+}
+
+static int inf_dynamic(inf_state * s) {
+    inf_huffman lencode;
+    inf_huffman distcode;
+    uint8_t lengths[INF_MAX_LCODES + INF_MAX_DCODES];
+    uint16_t nlen;
+    uint16_t ndist;
+    uint16_t ncode;
+    uint16_t index;
+    int symbol;
+    uint8_t len;
+    uint8_t rep;
+
+    nlen  = inf_bits(s, 5) + 257;
+    ndist = inf_bits(s, 5) + 1;
+    ncode = inf_bits(s, 4) + 4;
+    if(s->error || nlen > INF_MAX_LCODES || ndist > INF_MAX_DCODES) {
+        return RAW_DEFLATE_DATA_ERROR;
+    }
+
+    /* code length code lengths */
+    memset(lengths, 0, 19);
+    for(index = 0; index < ncode; index++) {
+        lengths[inf_clen_order[index]] = inf_bits(s, 3);
+    }
+    if(s->error || inf_build(&lencode, lengths, 19)) {
+        return RAW_DEFLATE_DATA_ERROR;
+    }
+
+    /* literal/length and distance code lengths */
+    index = 0;
+    while(index < nlen + ndist) {
+        symbol = inf_decode(s, &lencode);
+        if(symbol < 0) {
+            return RAW_DEFLATE_DATA_ERROR;
+        }
+        if(symbol < 16) {
+            lengths[index++] = (uint8_t)symbol;
+            continue;
+        }
+        len = 0;
+        if(symbol == 16) {
+            if(index == 0) {
+                return RAW_DEFLATE_DATA_ERROR;
+            }
+            len = lengths[index - 1];
+            rep = 3 + inf_bits(s, 2);
+        } else if(symbol == 17) {
+            rep = 3 + inf_bits(s, 3);
+        } else {
+            rep = 11 + inf_bits(s, 7);
+        }
+        if(s->error || index + rep > nlen + ndist) {
+            return RAW_DEFLATE_DATA_ERROR;
+        }
+        while(rep--) {
+            lengths[index++] = len;
+        }
+    }
+
+    /* a block without end of block code can not be decoded */
+    if(lengths[256] == 0) {
+        return RAW_DEFLATE_DATA_ERROR;
+    }
+    if(inf_build(&lencode, lengths, nlen) || inf_build(&distcode, lengths + nlen, ndist)) {
+        return RAW_DEFLATE_DATA_ERROR;
+    }
+
+    return inf_codes(s, &lencode, &distcode);
+}
+
+int raw_inflate(const uint8_t * in, size_t inLen, const uint8_t * dict, size_t dictLen, uint8_t ** out, size_t * outLen, size_t maxOut) {
+    inf_state s;
+    uint8_t last;
+    uint8_t type;
+    int ret = RAW_DEFLATE_OK;
+
+    memset(&s, 0, sizeof(s));
+    s.in      = in;
+    s.inLen   = inLen;
+    s.dict    = dict;
+    s.dictLen = dict ? dictLen : 0;
+    s.maxOut  = maxOut;
+
+    *out    = NULL;
+    *outLen = 0;
+
+    /* initial guess, grows when needed */
+    if(inf_reserve(&s, inLen * 4 < maxOut ? inLen * 4 : maxOut)) {
+        return s.error;
+    }
+    if(!s.out) {
+        s.out = (uint8_t *)malloc(1);
+        if(!s.out) {
+            return RAW_DEFLATE_MEM_ERROR;
+        }
+    }
+
+    do {
+        last = inf_bits(&s, 1);
+        type = inf_bits(&s, 2);
+        if(s.error) {
+            ret = s.error;
+            break;
+        }
+        switch(type) {
+            case 0:
+                ret = inf_stored(&s);
+                break;
+            case 1:
+                ret = inf_fixed(&s);
+                break;
+            case 2:
+                ret = inf_dynamic(&s);
+                break;
+            default:
+                ret = RAW_DEFLATE_DATA_ERROR;
+                break;
+        }
+        if(ret == RAW_DEFLATE_OK && s.error) {
+            ret = s.error;
+        }
+        /* a sync flushed stream ends without BFINAL */
+    } while(ret == RAW_DEFLATE_OK && !last && s.inPos < s.inLen);
+
+    if(ret != RAW_DEFLATE_OK) {
+        free(s.out);
+        return ret;
+    }
+
+    s.out[s.outLen] = 0x00;
+    *out            = s.out;
+    *outLen         = s.outLen;
+    return RAW_DEFLATE_OK;
+}
+
+/* ================ end of inflate.c ================ */
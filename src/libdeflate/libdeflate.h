@@ -0,0 +1,46 @@
+/* ================ libdeflate.h ================ */
+/*
+raw DEFLATE (RFC 1951) for permessage-deflate (RFC 7692)
+
+small footprint implementation:
+ - inflate supports stored, fixed and dynamic Huffman blocks
+   and a preset dictionary (the LZ77 window of the previous messages)
+ - deflate emits one fixed Huffman block followed by the sync flush
+   header, the trailing 0x00 0x00 0xFF 0xFF is not written (see RFC 7692 7.2.1)
+*/
+
+#ifndef LIBDEFLATE_H_
+#define LIBDEFLATE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RAW_DEFLATE_OK (0)
+#define RAW_DEFLATE_DATA_ERROR (-1)      /* invalid or truncated stream */
+#define RAW_DEFLATE_MEM_ERROR (-2)       /* malloc failed */
+#define RAW_DEFLATE_SIZE_ERROR (-3)      /* output would exceed the given limit */
+
+/*
+ * compress in[0..inLen) as a raw DEFLATE block
+ * windowBits limits the LZ77 distance (8..15), only data of this message is referenced
+ * returns the number of bytes written to out, 0 if out is too small or no memory
+ */
+size_t raw_deflate(const uint8_t * in, size_t inLen, uint8_t * out, size_t outSize, uint8_t windowBits);
+
+/*
+ * decompress a raw DEFLATE stream
+ * dict / dictLen is the output history used for back references beyond the start of the output
+ * *out is malloc'ed (with one spare byte for a terminating 0x00) and must be freed by the caller
+ * maxOut limits the decompressed size
+ */
+int raw_inflate(const uint8_t * in, size_t inLen, const uint8_t * dict, size_t dictLen, uint8_t ** out, size_t * outLen, size_t maxOut);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBDEFLATE_H_ */
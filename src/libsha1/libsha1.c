@@ -28,6 +28,12 @@ A million repetitions of "a"
 
 #include "libsha1.h"
 
+#if defined(__SHA__) && defined(__SSE4_1__)
+/* x86 SHA extensions (host builds with -msha -msse4.1 or -march=native) */
+#define SHA1_USE_SHANI
+#include <immintrin.h>
+#endif
+
 
 #define rol(value, bits) (((value) << (bits)) | ((value) >> (32 - (bits))))
 
@@ -54,6 +60,81 @@ A million repetitions of "a"
 
 /* Hash a single 512-bit block. This is the core of the algorithm. */
 
+#ifdef SHA1_USE_SHANI
+
+/* next message schedule block: W[g] from W[g-4] .. W[g-1] */
+#define SHANI_MSG(w0, w1, w2, w3) \
+    _mm_sha1msg2_epu32(_mm_xor_si128(_mm_sha1msg1_epu32(w0, w1), w2), w3)
+
+/* 4 rounds with round function f, e1 gets the E input of the next 4 rounds */
+#define SHANI_ROUNDS(f, e0, e1, w)              \
+    e1   = abcd;                                \
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, f);    \
+    e1   = _mm_sha1nexte_epu32(e1, w);
+
+void SHA1Transform(uint32_t state[5], const unsigned char buffer[64])
+{
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+    __m128i abcd, abcdSave, e0, e1, eSave;
+    __m128i w0, w1, w2, w3;
+
+    abcd     = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state), 0x1B);
+    e0       = _mm_set_epi32((int)state[4], 0, 0, 0);
+    abcdSave = abcd;
+    eSave    = e0;
+
+    w0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(buffer + 0)), mask);
+    w1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(buffer + 16)), mask);
+    w2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(buffer + 32)), mask);
+    w3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(buffer + 48)), mask);
+
+    e0 = _mm_add_epi32(e0, w0);
+    SHANI_ROUNDS(0, e0, e1, w1);                                /* 0-3 */
+    SHANI_ROUNDS(0, e1, e0, w2);                                /* 4-7 */
+    SHANI_ROUNDS(0, e0, e1, w3);                                /* 8-11 */
+    w0 = SHANI_MSG(w0, w1, w2, w3);
+    SHANI_ROUNDS(0, e1, e0, w0);                                /* 12-15 */
+    w1 = SHANI_MSG(w1, w2, w3, w0);
+    SHANI_ROUNDS(0, e0, e1, w1);                                /* 16-19 */
+    w2 = SHANI_MSG(w2, w3, w0, w1);
+    SHANI_ROUNDS(1, e1, e0, w2);                                /* 20-23 */
+    w3 = SHANI_MSG(w3, w0, w1, w2);
+    SHANI_ROUNDS(1, e0, e1, w3);                                /* 24-27 */
+    w0 = SHANI_MSG(w0, w1, w2, w3);
+    SHANI_ROUNDS(1, e1, e0, w0);                                /* 28-31 */
+    w1 = SHANI_MSG(w1, w2, w3, w0);
+    SHANI_ROUNDS(1, e0, e1, w1);                                /* 32-35 */
+    w2 = SHANI_MSG(w2, w3, w0, w1);
+    SHANI_ROUNDS(1, e1, e0, w2);                                /* 36-39 */
+    w3 = SHANI_MSG(w3, w0, w1, w2);
+    SHANI_ROUNDS(2, e0, e1, w3);                                /* 40-43 */
+    w0 = SHANI_MSG(w0, w1, w2, w3);
+    SHANI_ROUNDS(2, e1, e0, w0);                                /* 44-47 */
+    w1 = SHANI_MSG(w1, w2, w3, w0);
+    SHANI_ROUNDS(2, e0, e1, w1);                                /* 48-51 */
+    w2 = SHANI_MSG(w2, w3, w0, w1);
+    SHANI_ROUNDS(2, e1, e0, w2);                                /* 52-55 */
+    w3 = SHANI_MSG(w3, w0, w1, w2);
+    SHANI_ROUNDS(2, e0, e1, w3);                                /* 56-59 */
+    w0 = SHANI_MSG(w0, w1, w2, w3);
+    SHANI_ROUNDS(3, e1, e0, w0);                                /* 60-63 */
+    w1 = SHANI_MSG(w1, w2, w3, w0);
+    SHANI_ROUNDS(3, e0, e1, w1);                                /* 64-67 */
+    w2 = SHANI_MSG(w2, w3, w0, w1);
+    SHANI_ROUNDS(3, e1, e0, w2);                                /* 68-71 */
+    w3 = SHANI_MSG(w3, w0, w1, w2);
+    SHANI_ROUNDS(3, e0, e1, w3);                                /* 72-75 */
+    SHANI_ROUNDS(3, e1, e0, eSave);                             /* 76-79 */
+
+    /* e0 = final E + saved E, add the saved ABCD */
+    abcd = _mm_add_epi32(abcd, abcdSave);
+
+    _mm_storeu_si128((__m128i *)state, _mm_shuffle_epi32(abcd, 0x1B));
+    state[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+}
+
+#else
+
 void SHA1Transform(uint32_t state[5], const unsigned char buffer[64])
 {
     uint32_t a, b, c, d, e;
@@ -112,6 +193,8 @@ void SHA1Transform(uint32_t state[5], const unsigned char buffer[64])
 #endif
 }
 
+#endif /* SHA1_USE_SHANI */
+
 
 /* SHA1Init - Initialize new context */
 
@@ -155,9 +238,9 @@ void SHA1Update(SHA1_CTX* context, const unsigned char* data, uint32_t len)
 
 void SHA1Final(unsigned char digest[20], SHA1_CTX* context)
 {
+    static const unsigned char padding[64] = { 0200 };
     unsigned i;
     unsigned char finalcount[8];
-    unsigned char c;
 
 #if 0	/* untested "improvement" by DHR */
     /* Convert context->count to a sequence of bytes
@@ -181,12 +264,9 @@ void SHA1Final(unsigned char digest[20], SHA1_CTX* context)
          >> ((3-(i & 3)) * 8) ) & 255);  /* Endian independent */
     }
 #endif
-    c = 0200;
-    SHA1Update(context, &c, 1);
-    while ((context->count[0] & 504) != 448) {
-	c = 0000;
-        SHA1Update(context, &c, 1);
-    }
+    /* 0x80 and zeros up to 56 mod 64, in one go */
+    i = (context->count[0] >> 3) & 63;
+    SHA1Update(context, padding, (i < 56) ? (56 - i) : (120 - i));
     SHA1Update(context, finalcount, 8);  /* Should cause a SHA1Transform() */
     for (i = 0; i < 20; i++) {
         digest[i] = (unsigned char)